@@ -0,0 +1,395 @@
+# Compression benchmark: LZ77 over 4 KiB of generated text, with a hash of
+# the next three bytes finding match candidates, then decompression and a
+# round trip check.
+#
+# The compressed stream is a sequence of tokens:
+#   0x00-0x7F  literal run of token + 1 bytes, followed by the bytes
+#   0x80-0xFF  match of (token & 0x7F) + 3 bytes, followed by the 16-bit
+#              little endian distance back
+    .set noreorder
+    .text
+
+    .equ INPUT_SIZE, 4096
+    .equ MAX_MATCH, 130
+    .equ MAX_LITERALS, 128
+
+    .globl main
+    .ent main
+main:
+    addiu   $sp, $sp, -20
+    sw      $ra, 16($sp)
+    sw      $s3, 12($sp)
+    sw      $s2, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+
+    balc    generate
+    lui     $t0, %hi(iterations)
+    lw      $s0, %lo(iterations)($t0)
+1:
+    balc    compress
+    move    $s1, $v0
+    move    $s2, $v1
+    move    $a0, $s1
+    balc    decompress
+    move    $s3, $v0
+    addiu   $s0, $s0, -1
+    bgtzc   $s0, 1b
+
+    lui     $a0, %hi(label_input)
+    addiu   $a0, $a0, %lo(label_input)
+    addiu   $a1, $zero, INPUT_SIZE
+    balc    print_field
+    lui     $a0, %hi(label_compressed)
+    addiu   $a0, $a0, %lo(label_compressed)
+    move    $a1, $s1
+    balc    print_field
+    lui     $a0, %hi(label_matches)
+    addiu   $a0, $a0, %lo(label_matches)
+    move    $a1, $s2
+    balc    print_field
+
+    # Round trip if the decompressed bytes are the input
+    addiu   $a1, $zero, 0
+    addiu   $t0, $zero, INPUT_SIZE
+    bnec    $s3, $t0, 3f
+    lui     $t0, %hi(input)
+    addiu   $t0, $t0, %lo(input)
+    lui     $t1, %hi(decompressed)
+    addiu   $t1, $t1, %lo(decompressed)
+    addiu   $t2, $t0, INPUT_SIZE
+2:
+    lbu     $t3, 0($t0)
+    lbu     $t4, 0($t1)
+    bnec    $t3, $t4, 3f
+    addiu   $t0, $t0, 1
+    addiu   $t1, $t1, 1
+    bnec    $t0, $t2, 2b
+    addiu   $a1, $zero, 1
+3:
+    lui     $a0, %hi(label_roundtrip)
+    addiu   $a0, $a0, %lo(label_roundtrip)
+    balc    print_field
+
+    # Adler-32 of the compressed stream
+    lui     $t0, %hi(compressed)
+    addiu   $t0, $t0, %lo(compressed)
+    addu    $t1, $t0, $s1
+    addiu   $t2, $zero, 1
+    addiu   $t3, $zero, 0
+    ori     $t4, $zero, 65521
+4:
+    lbu     $t5, 0($t0)
+    addu    $t2, $t2, $t5
+    modu    $t2, $t2, $t4
+    addu    $t3, $t3, $t2
+    modu    $t3, $t3, $t4
+    addiu   $t0, $t0, 1
+    bnec    $t0, $t1, 4b
+    sll     $t3, $t3, 16
+    or      $a1, $t3, $t2
+    lui     $a0, %hi(label_adler)
+    addiu   $a0, $a0, %lo(label_adler)
+    balc    print_hex_field
+
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $s2, 8($sp)
+    lw      $s3, 12($sp)
+    lw      $ra, 16($sp)
+    addiu   $sp, $sp, 20
+    jrc     $ra
+    .end main
+
+    # Fills the input with words picked by a linear congruential generator,
+    # separated by spaces and the odd newline
+    .ent generate
+generate:
+    lui     $t0, %hi(input)
+    addiu   $t0, $t0, %lo(input)
+    addiu   $t1, $t0, INPUT_SIZE
+    addiu   $t2, $zero, 1
+    lui     $t3, %hi(words)
+    addiu   $t3, $t3, %lo(words)
+    lui     $t6, 0x41c6
+    ori     $t6, $t6, 0x4e6d
+1:
+    beqc    $t0, $t1, 4f
+    mul     $t2, $t2, $t6
+    addiu   $t2, $t2, 12345
+    srl     $t4, $t2, 16
+    andi    $t4, $t4, 15
+    sll     $t4, $t4, 2
+    addu    $t4, $t3, $t4
+    lw      $t4, 0($t4)
+2:
+    lbu     $t5, 0($t4)
+    beqzc   $t5, 3f
+    nop
+    beqc    $t0, $t1, 4f
+    sb      $t5, 0($t0)
+    addiu   $t0, $t0, 1
+    addiu   $t4, $t4, 1
+    bc      2b
+3:
+    beqc    $t0, $t1, 4f
+    srl     $t5, $t2, 8
+    andi    $t5, $t5, 7
+    addiu   $t7, $zero, '\n'
+    addiu   $t8, $zero, ' '
+    seleqz  $t7, $t7, $t5
+    selnez  $t8, $t8, $t5
+    or      $t5, $t7, $t8
+    sb      $t5, 0($t0)
+    addiu   $t0, $t0, 1
+    bc      1b
+4:
+    jrc     $ra
+    .end generate
+
+    # compress() returns the compressed size in v0 and the number of
+    # matches in v1. s0 is the input, s1 the position, s2 the start of the
+    # pending literals and s3 the output.
+    .ent compress
+compress:
+    addiu   $sp, $sp, -28
+    sw      $ra, 24($sp)
+    sw      $s5, 20($sp)
+    sw      $s4, 16($sp)
+    sw      $s3, 12($sp)
+    sw      $s2, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+
+    lui     $s0, %hi(input)
+    addiu   $s0, $s0, %lo(input)
+    lui     $s3, %hi(compressed)
+    addiu   $s3, $s3, %lo(compressed)
+    lui     $s4, %hi(table)
+    addiu   $s4, $s4, %lo(table)
+    addiu   $s1, $zero, 0
+    addiu   $s2, $zero, 0
+    addiu   $s5, $zero, 0
+
+    # Positions are stored plus one, zero is empty
+    move    $t0, $s4
+    addiu   $t1, $s4, 4096 * 4
+1:
+    sw      $zero, 0($t0)
+    addiu   $t0, $t0, 4
+    bnec    $t0, $t1, 1b
+
+    lui     $t9, 0x9e37
+    ori     $t9, $t9, 0x79b1
+2:
+    addiu   $t0, $s1, 3
+    addiu   $t1, $zero, INPUT_SIZE
+    bltuc   $t1, $t0, 8f
+
+    # Hash of the next three bytes
+    addu    $t1, $s0, $s1
+    lbu     $t2, 0($t1)
+    lbu     $t3, 1($t1)
+    lbu     $t4, 2($t1)
+    sll     $t3, $t3, 8
+    sll     $t4, $t4, 16
+    or      $t2, $t2, $t3
+    or      $t2, $t2, $t4
+    mul     $t2, $t2, $t9
+    srl     $t2, $t2, 20
+    sll     $t2, $t2, 2
+    addu    $t2, $s4, $t2
+    lw      $t3, 0($t2)
+    addiu   $t4, $s1, 1
+    sw      $t4, 0($t2)
+    beqzc   $t3, 7f
+
+    addiu   $t3, $t3, -1
+    addu    $t5, $s0, $t3
+    lbu     $t6, 0($t5)
+    lbu     $t7, 0($t1)
+    bnec    $t6, $t7, 7f
+    lbu     $t6, 1($t5)
+    lbu     $t7, 1($t1)
+    bnec    $t6, $t7, 7f
+    lbu     $t6, 2($t5)
+    lbu     $t7, 2($t1)
+    bnec    $t6, $t7, 7f
+
+    # t8 = match length, up to the end of the input or MAX_MATCH
+    addiu   $t8, $zero, 3
+    addiu   $t0, $zero, INPUT_SIZE
+    subu    $t0, $t0, $s1
+    addiu   $t6, $zero, MAX_MATCH
+    bgeuc   $t0, $t6, 3f
+    move    $t6, $t0
+3:
+    bgeuc   $t8, $t6, 4f
+    addu    $t7, $t5, $t8
+    lbu     $t7, 0($t7)
+    addu    $a2, $t1, $t8
+    lbu     $a2, 0($a2)
+    bnec    $t7, $a2, 4f
+    addiu   $t8, $t8, 1
+    bc      3b
+4:
+    move    $a0, $s2
+    move    $a1, $s1
+    balc    flush_literals
+    subu    $t0, $s1, $t3
+    addiu   $t7, $t8, 0x80 - 3
+    sb      $t7, 0($s3)
+    sb      $t0, 1($s3)
+    srl     $t0, $t0, 8
+    sb      $t0, 2($s3)
+    addiu   $s3, $s3, 3
+    addiu   $s5, $s5, 1
+    addu    $s1, $s1, $t8
+    move    $s2, $s1
+    bc      2b
+7:
+    addiu   $s1, $s1, 1
+    bc      2b
+8:
+    move    $a0, $s2
+    addiu   $a1, $zero, INPUT_SIZE
+    balc    flush_literals
+
+    lui     $t0, %hi(compressed)
+    addiu   $t0, $t0, %lo(compressed)
+    subu    $v0, $s3, $t0
+    move    $v1, $s5
+
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $s2, 8($sp)
+    lw      $s3, 12($sp)
+    lw      $s4, 16($sp)
+    lw      $s5, 20($sp)
+    lw      $ra, 24($sp)
+    addiu   $sp, $sp, 28
+    jrc     $ra
+    .end compress
+
+    # flush_literals(a0 = start, a1 = end) writes input[start, end) as
+    # literal runs at s3. Only uses the a and v registers.
+    .ent flush_literals
+flush_literals:
+    bgeuc   $a0, $a1, 3f
+    subu    $a2, $a1, $a0
+    addiu   $a3, $zero, MAX_LITERALS
+    bgeuc   $a3, $a2, 1f
+    move    $a2, $a3
+1:
+    addiu   $a3, $a2, -1
+    sb      $a3, 0($s3)
+    addiu   $s3, $s3, 1
+    addu    $a3, $s0, $a0
+    addu    $a0, $a0, $a2
+2:
+    lbu     $v0, 0($a3)
+    sb      $v0, 0($s3)
+    addiu   $a3, $a3, 1
+    addiu   $s3, $s3, 1
+    addiu   $a2, $a2, -1
+    bnezc   $a2, 2b
+    nop
+    bc      flush_literals
+3:
+    jrc     $ra
+    .end flush_literals
+
+    # decompress(a0 = compressed size) returns the decompressed size
+    .ent decompress
+decompress:
+    lui     $t0, %hi(compressed)
+    addiu   $t0, $t0, %lo(compressed)
+    addu    $t1, $t0, $a0
+    lui     $t2, %hi(decompressed)
+    addiu   $t2, $t2, %lo(decompressed)
+1:
+    bgeuc   $t0, $t1, 4f
+    lbu     $t3, 0($t0)
+    addiu   $t0, $t0, 1
+    sltiu   $t4, $t3, 0x80
+    beqzc   $t4, 3f
+    addiu   $t3, $t3, 1
+2:
+    lbu     $t4, 0($t0)
+    sb      $t4, 0($t2)
+    addiu   $t0, $t0, 1
+    addiu   $t2, $t2, 1
+    addiu   $t3, $t3, -1
+    bnezc   $t3, 2b
+    nop
+    bc      1b
+3:
+    andi    $t3, $t3, 0x7f
+    addiu   $t3, $t3, 3
+    lbu     $t4, 0($t0)
+    lbu     $t5, 1($t0)
+    sll     $t5, $t5, 8
+    or      $t4, $t4, $t5
+    addiu   $t0, $t0, 2
+    subu    $t4, $t2, $t4
+5:
+    lbu     $t5, 0($t4)
+    sb      $t5, 0($t2)
+    addiu   $t4, $t4, 1
+    addiu   $t2, $t2, 1
+    addiu   $t3, $t3, -1
+    bnezc   $t3, 5b
+    nop
+    bc      1b
+4:
+    lui     $t0, %hi(decompressed)
+    addiu   $t0, $t0, %lo(decompressed)
+    subu    $v0, $t2, $t0
+    jrc     $ra
+    .end decompress
+
+    .section .rodata
+word_0:  .asciz "the"
+word_1:  .asciz "quick"
+word_2:  .asciz "brown"
+word_3:  .asciz "fox"
+word_4:  .asciz "jumps"
+word_5:  .asciz "over"
+word_6:  .asciz "lazy"
+word_7:  .asciz "dog"
+word_8:  .asciz "emulator"
+word_9:  .asciz "mips"
+word_10: .asciz "register"
+word_11: .asciz "branch"
+word_12: .asciz "delay"
+word_13: .asciz "slot"
+word_14: .asciz "cache"
+word_15: .asciz "memory"
+
+label_input:
+    .asciz "input"
+label_compressed:
+    .asciz "compressed"
+label_matches:
+    .asciz "matches"
+label_roundtrip:
+    .asciz "roundtrip"
+label_adler:
+    .asciz "adler32"
+
+    .align 2
+words:
+    .word word_0, word_1, word_2, word_3, word_4, word_5, word_6, word_7
+    .word word_8, word_9, word_10, word_11, word_12, word_13, word_14
+    .word word_15
+
+    .bss
+    .align 2
+table:
+    .space 4096 * 4
+input:
+    .space INPUT_SIZE
+compressed:
+    .space INPUT_SIZE + INPUT_SIZE / MAX_LITERALS
+decompressed:
+    .space INPUT_SIZE + MAX_MATCH
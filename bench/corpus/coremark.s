@@ -0,0 +1,588 @@
+# CoreMark style benchmark: linked list search, reversal and sorting, 8x8
+# integer matrix multiplication and a number parsing state machine, each
+# folded into a CRC-16 and combined into one final CRC.
+#
+# Every iteration initialises its data from the same seeds, so the results
+# don't depend on the number of iterations.
+    .set noreorder
+    .text
+
+    .equ LIST_SIZE, 32
+    .equ MATRIX_N, 8
+
+    # List node fields
+    .equ NEXT, 0
+    .equ VALUE, 4
+    .equ INDEX, 8
+    .equ NODE_SIZE, 12
+
+    # Offsets into results
+    .equ LIST_CRC, 0
+    .equ LIST_FOUND, 4
+    .equ LIST_INDEX_SUM, 8
+    .equ MATRIX_CRC, 12
+    .equ STATE_INT, 16
+    .equ STATE_FLOAT, 20
+    .equ STATE_SCIENTIFIC, 24
+    .equ STATE_INVALID, 28
+    .equ STATE_CRC, 32
+    .equ FINAL_CRC, 36
+    .equ RESULTS_SIZE, 40
+
+    # Parser states
+    .equ START, 0
+    .equ INVALID, 1
+    .equ SIGN, 2
+    .equ INT, 3
+    .equ FLOAT, 4
+    .equ EXPONENT, 5
+    .equ EXPONENT_SIGN, 6
+    .equ SCIENTIFIC, 7
+
+    .globl main
+    .ent main
+main:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+    lui     $t0, %hi(iterations)
+    lw      $s0, %lo(iterations)($t0)
+1:
+    balc    bench_list
+    balc    bench_matrix
+    balc    bench_state
+    lui     $t0, %hi(results)
+    lw      $a0, %lo(results + LIST_CRC)($t0)
+    addiu   $a1, $zero, 0
+    balc    crcu16
+    lui     $t0, %hi(results)
+    lw      $a0, %lo(results + MATRIX_CRC)($t0)
+    move    $a1, $v0
+    balc    crcu16
+    lui     $t0, %hi(results)
+    lw      $a0, %lo(results + STATE_CRC)($t0)
+    move    $a1, $v0
+    balc    crcu16
+    lui     $t0, %hi(results)
+    sw      $v0, %lo(results + FINAL_CRC)($t0)
+    addiu   $s0, $s0, -1
+    bgtzc   $s0, 1b
+    nop
+
+    balc    report
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end main
+
+    # crcu16(a0 = value, a1 = crc) returns the CRC-16 (0xA001, reflected)
+    # of the low and then the high byte of value
+    .ent crcu16
+crcu16:
+    addiu   $t2, $zero, 2
+    ori     $t3, $zero, 0xa001
+1:
+    andi    $t0, $a0, 0xff
+    xor     $a1, $a1, $t0
+    srl     $a0, $a0, 8
+    addiu   $t1, $zero, 8
+2:
+    andi    $t0, $a1, 1
+    srl     $a1, $a1, 1
+    subu    $t0, $zero, $t0
+    and     $t0, $t0, $t3
+    xor     $a1, $a1, $t0
+    addiu   $t1, $t1, -1
+    bnezc   $t1, 2b
+    addiu   $t2, $t2, -1
+    bnezc   $t2, 1b
+    move    $v0, $a1
+    jrc     $ra
+    .end crcu16
+
+    # Builds the list in index order, reverses it, looks for eight values
+    # (the last one isn't in the list) and insertion sorts it by value
+    .ent bench_list
+bench_list:
+    addiu   $sp, $sp, -20
+    sw      $ra, 16($sp)
+    sw      $s3, 12($sp)
+    sw      $s2, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+
+    # value = (index * 0x3a7 + 0x1d1) & 0x3ff
+    lui     $t0, %hi(nodes)
+    addiu   $t0, $t0, %lo(nodes)
+    addiu   $t1, $zero, 0
+    addiu   $t3, $zero, LIST_SIZE
+1:
+    addiu   $t2, $zero, 0x3a7
+    mul     $t2, $t1, $t2
+    addiu   $t2, $t2, 0x1d1
+    andi    $t2, $t2, 0x3ff
+    sw      $t2, VALUE($t0)
+    sw      $t1, INDEX($t0)
+    addiu   $t1, $t1, 1
+    addiu   $t2, $t0, NODE_SIZE
+    subu    $t4, $t3, $t1
+    selnez  $t2, $t2, $t4
+    sw      $t2, NEXT($t0)
+    move    $t0, $t2
+    bnec    $t1, $t3, 1b
+
+    lui     $a0, %hi(nodes)
+    addiu   $a0, $a0, %lo(nodes)
+    balc    list_reverse
+    move    $s0, $v0
+
+    # s1 = found, s2 = sum of their indices, s3 = k
+    addiu   $s1, $zero, 0
+    addiu   $s2, $zero, 0
+    addiu   $s3, $zero, 0
+2:
+    addiu   $t0, $zero, 5 * 0x3a7
+    mul     $a1, $s3, $t0
+    addiu   $a1, $a1, 0x1d1
+    andi    $a1, $a1, 0x3ff
+    move    $a0, $s0
+    balc    list_find
+    beqzc   $v0, 3f
+    addiu   $s1, $s1, 1
+    lw      $t0, INDEX($v0)
+    addu    $s2, $s2, $t0
+3:
+    addiu   $s3, $s3, 1
+    addiu   $t0, $zero, 8
+    bnec    $s3, $t0, 2b
+
+    move    $a0, $s0
+    balc    list_sort
+    move    $s0, $v0
+    addiu   $s3, $zero, 0
+4:
+    beqzc   $s0, 5f
+    lw      $a0, VALUE($s0)
+    move    $a1, $s3
+    balc    crcu16
+    lw      $a0, INDEX($s0)
+    move    $a1, $v0
+    balc    crcu16
+    move    $s3, $v0
+    lw      $s0, NEXT($s0)
+    bc      4b
+5:
+    move    $a0, $s1
+    move    $a1, $s3
+    balc    crcu16
+    move    $a0, $s2
+    move    $a1, $v0
+    balc    crcu16
+
+    lui     $t0, %hi(results)
+    addiu   $t0, $t0, %lo(results)
+    sw      $v0, LIST_CRC($t0)
+    sw      $s1, LIST_FOUND($t0)
+    sw      $s2, LIST_INDEX_SUM($t0)
+
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $s2, 8($sp)
+    lw      $s3, 12($sp)
+    lw      $ra, 16($sp)
+    addiu   $sp, $sp, 20
+    jrc     $ra
+    .end bench_list
+
+    # list_reverse(a0 = head) returns the new head
+    .ent list_reverse
+list_reverse:
+    addiu   $v0, $zero, 0
+1:
+    beqzc   $a0, 2f
+    lw      $t0, NEXT($a0)
+    sw      $v0, NEXT($a0)
+    move    $v0, $a0
+    move    $a0, $t0
+    bc      1b
+2:
+    jrc     $ra
+    .end list_reverse
+
+    # list_find(a0 = head, a1 = value) returns the first node with the
+    # value or 0
+    .ent list_find
+list_find:
+    move    $v0, $a0
+1:
+    beqzc   $v0, 2f
+    lw      $t0, VALUE($v0)
+    beqc    $t0, $a1, 2f
+    lw      $v0, NEXT($v0)
+    bc      1b
+2:
+    jrc     $ra
+    .end list_find
+
+    # list_sort(a0 = head) returns the head of the list sorted by value,
+    # nodes with equal values keep their order
+    .ent list_sort
+list_sort:
+    addiu   $v0, $zero, 0
+1:
+    beqzc   $a0, 5f
+    lw      $t0, NEXT($a0)
+    lw      $t1, VALUE($a0)
+    beqzc   $v0, 2f
+    lw      $t2, VALUE($v0)
+    bgeuc   $t1, $t2, 3f
+2:
+    sw      $v0, NEXT($a0)
+    move    $v0, $a0
+    move    $a0, $t0
+    bc      1b
+
+    # Insert after the last node with a value <= t1
+3:
+    move    $t3, $v0
+4:
+    lw      $t4, NEXT($t3)
+    beqzc   $t4, 6f
+    lw      $t2, VALUE($t4)
+    bltuc   $t1, $t2, 6f
+    move    $t3, $t4
+    bc      4b
+6:
+    sw      $t4, NEXT($a0)
+    sw      $a0, NEXT($t3)
+    move    $a0, $t0
+    bc      1b
+5:
+    jrc     $ra
+    .end list_sort
+
+    # Multiplies A by B, adds 7 to every element of A and multiplies again,
+    # folding both products into the CRC
+    .ent bench_matrix
+bench_matrix:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+
+    # A[i][j] = ((n * 0x3b + 0x15) & 0xff) - 0x80,
+    # B[i][j] = ((n * 0x61 + 0x2f) & 0x3f) - 0x20 with n = i * 8 + j
+    lui     $t0, %hi(matrix_a)
+    addiu   $t0, $t0, %lo(matrix_a)
+    lui     $t1, %hi(matrix_b)
+    addiu   $t1, $t1, %lo(matrix_b)
+    addiu   $t2, $zero, 0
+    addiu   $t5, $zero, 0x3b
+    addiu   $t6, $zero, 0x61
+1:
+    mul     $t3, $t2, $t5
+    addiu   $t3, $t3, 0x15
+    andi    $t3, $t3, 0xff
+    addiu   $t3, $t3, -0x80
+    sw      $t3, 0($t0)
+    mul     $t4, $t2, $t6
+    addiu   $t4, $t4, 0x2f
+    andi    $t4, $t4, 0x3f
+    addiu   $t4, $t4, -0x20
+    sw      $t4, 0($t1)
+    addiu   $t0, $t0, 4
+    addiu   $t1, $t1, 4
+    addiu   $t2, $t2, 1
+    addiu   $t3, $zero, MATRIX_N * MATRIX_N
+    bnec    $t2, $t3, 1b
+    nop
+
+    balc    matrix_multiply
+    addiu   $a0, $zero, 0
+    balc    matrix_crc
+    move    $s0, $v0
+
+    lui     $t0, %hi(matrix_a)
+    addiu   $t0, $t0, %lo(matrix_a)
+    addiu   $t1, $t0, MATRIX_N * MATRIX_N * 4
+2:
+    lw      $t2, 0($t0)
+    addiu   $t2, $t2, 7
+    sw      $t2, 0($t0)
+    addiu   $t0, $t0, 4
+    bnec    $t0, $t1, 2b
+    nop
+
+    balc    matrix_multiply
+    move    $a0, $s0
+    balc    matrix_crc
+    lui     $t0, %hi(results)
+    sw      $v0, %lo(results + MATRIX_CRC)($t0)
+
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end bench_matrix
+
+    # matrix_c = matrix_a * matrix_b
+    .ent matrix_multiply
+matrix_multiply:
+    lui     $a0, %hi(matrix_a)
+    addiu   $a0, $a0, %lo(matrix_a)
+    lui     $a1, %hi(matrix_b)
+    addiu   $a1, $a1, %lo(matrix_b)
+    lui     $a2, %hi(matrix_c)
+    addiu   $a2, $a2, %lo(matrix_c)
+    addiu   $t8, $zero, MATRIX_N
+    addiu   $t0, $zero, 0
+1:
+    addiu   $t1, $zero, 0
+2:
+    addiu   $t2, $zero, 0
+    sll     $t3, $t0, 5
+    addu    $t3, $a0, $t3
+    sll     $t4, $t1, 2
+    addu    $t4, $a1, $t4
+    addiu   $t5, $zero, MATRIX_N
+3:
+    lw      $t6, 0($t3)
+    lw      $t7, 0($t4)
+    mul     $t6, $t6, $t7
+    addu    $t2, $t2, $t6
+    addiu   $t3, $t3, 4
+    addiu   $t4, $t4, MATRIX_N * 4
+    addiu   $t5, $t5, -1
+    bnezc   $t5, 3b
+    sw      $t2, 0($a2)
+    addiu   $a2, $a2, 4
+    addiu   $t1, $t1, 1
+    bnec    $t1, $t8, 2b
+    addiu   $t0, $t0, 1
+    bnec    $t0, $t8, 1b
+    nop
+    jrc     $ra
+    .end matrix_multiply
+
+    # matrix_crc(a0 = crc) folds the low 16 bits of each element of
+    # matrix_c into the CRC
+    .ent matrix_crc
+matrix_crc:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+    move    $v0, $a0
+    lui     $s0, %hi(matrix_c)
+    addiu   $s0, $s0, %lo(matrix_c)
+    addiu   $s1, $s0, MATRIX_N * MATRIX_N * 4
+1:
+    lw      $a0, 0($s0)
+    andi    $a0, $a0, 0xffff
+    move    $a1, $v0
+    balc    crcu16
+    addiu   $s0, $s0, 4
+    bnec    $s0, $s1, 1b
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end matrix_crc
+
+    # Classifies each comma separated token of the input by the state the
+    # parser ends in
+    .ent bench_state
+bench_state:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+
+    lui     $s1, %hi(state_counts)
+    addiu   $s1, $s1, %lo(state_counts)
+    sw      $zero, 0($s1)
+    sw      $zero, 4($s1)
+    sw      $zero, 8($s1)
+    sw      $zero, 12($s1)
+    sw      $zero, 16($s1)
+    sw      $zero, 20($s1)
+    sw      $zero, 24($s1)
+    sw      $zero, 28($s1)
+
+    lui     $s0, %hi(tokens)
+    addiu   $s0, $s0, %lo(tokens)
+    lui     $t9, %hi(transitions)
+    addiu   $t9, $t9, %lo(transitions)
+1:
+    addiu   $t0, $zero, START
+2:
+    lbu     $t1, 0($s0)
+    beqzc   $t1, 3f
+    addiu   $t2, $zero, ','
+    beqc    $t1, $t2, 3f
+
+    # t2 = character class: digit, sign, dot, exponent or other
+    addiu   $t2, $t1, -'0'
+    sltiu   $t2, $t2, 10
+    addiu   $t3, $zero, 0
+    bnezc   $t2, 4f
+    addiu   $t3, $zero, 1
+    addiu   $t2, $zero, '+'
+    beqc    $t1, $t2, 4f
+    addiu   $t2, $zero, '-'
+    beqc    $t1, $t2, 4f
+    addiu   $t3, $zero, 2
+    addiu   $t2, $zero, '.'
+    beqc    $t1, $t2, 4f
+    addiu   $t3, $zero, 3
+    ori     $t2, $t1, 0x20
+    addiu   $t4, $zero, 'e'
+    beqc    $t2, $t4, 4f
+    addiu   $t3, $zero, 4
+4:
+    # Rows of 5 classes per state
+    sll     $t2, $t0, 2
+    addu    $t2, $t2, $t0
+    addu    $t2, $t2, $t3
+    addu    $t2, $t9, $t2
+    lbu     $t0, 0($t2)
+    addiu   $s0, $s0, 1
+    bc      2b
+3:
+    sll     $t2, $t0, 2
+    addu    $t2, $s1, $t2
+    lw      $t3, 0($t2)
+    addiu   $t3, $t3, 1
+    sw      $t3, 0($t2)
+    addiu   $s0, $s0, 1
+    bnezc   $t1, 1b
+
+    addiu   $s0, $zero, 0
+    addiu   $v0, $zero, 0
+5:
+    addu    $t0, $s1, $s0
+    lw      $a0, 0($t0)
+    move    $a1, $v0
+    balc    crcu16
+    addiu   $s0, $s0, 4
+    addiu   $t0, $zero, 8 * 4
+    bnec    $s0, $t0, 5b
+
+    lui     $t0, %hi(results)
+    addiu   $t0, $t0, %lo(results)
+    sw      $v0, STATE_CRC($t0)
+    lw      $t1, INT * 4($s1)
+    sw      $t1, STATE_INT($t0)
+    lw      $t1, FLOAT * 4($s1)
+    sw      $t1, STATE_FLOAT($t0)
+    lw      $t1, SCIENTIFIC * 4($s1)
+    sw      $t1, STATE_SCIENTIFIC($t0)
+    lw      $t1, INVALID * 4($s1)
+    sw      $t1, STATE_INVALID($t0)
+
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end bench_state
+
+    # Prints results, in hex for the CRCs
+    .ent report
+report:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+    lui     $s0, %hi(report_fields)
+    addiu   $s0, $s0, %lo(report_fields)
+    lui     $s1, %hi(results)
+    addiu   $s1, $s1, %lo(results)
+1:
+    lw      $a0, 0($s0)
+    beqzc   $a0, 3f
+    lw      $t0, 4($s0)
+    lw      $a1, 0($s1)
+    addiu   $s0, $s0, 8
+    addiu   $s1, $s1, 4
+    bnezc   $t0, 2f
+    nop
+    balc    print_field
+    bc      1b
+2:
+    balc    print_hex_field
+    bc      1b
+3:
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end report
+
+    .section .rodata
+    # Next state by state and character class
+transitions:
+    .byte INT, SIGN, FLOAT, INVALID, INVALID                # START
+    .byte INVALID, INVALID, INVALID, INVALID, INVALID       # INVALID
+    .byte INT, INVALID, FLOAT, INVALID, INVALID             # SIGN
+    .byte INT, INVALID, FLOAT, INVALID, INVALID             # INT
+    .byte FLOAT, INVALID, INVALID, EXPONENT, INVALID        # FLOAT
+    .byte SCIENTIFIC, EXPONENT_SIGN, INVALID, INVALID, INVALID # EXPONENT
+    .byte SCIENTIFIC, INVALID, INVALID, INVALID, INVALID    # EXPONENT_SIGN
+    .byte SCIENTIFIC, INVALID, INVALID, INVALID, INVALID    # SCIENTIFIC
+
+tokens:
+    .asciz "5012,1.23,-874,+122,7,123e4,0x1f,-.5e-2,abc,,45.,3.14159,-0.001e+3,1e5,++1,.e1,42,-17,8.5E2,9999999,0.5e,e,+.,314,2.71828e0,-,77x,1.2.3,-6.02e23,.25,1000000,+0.75E-1,x9,256"
+
+label_list_crc:
+    .asciz "list_crc"
+label_list_found:
+    .asciz "list_found"
+label_list_index_sum:
+    .asciz "list_index_sum"
+label_matrix_crc:
+    .asciz "matrix_crc"
+label_state_int:
+    .asciz "state_int"
+label_state_float:
+    .asciz "state_float"
+label_state_scientific:
+    .asciz "state_scientific"
+label_state_invalid:
+    .asciz "state_invalid"
+label_state_crc:
+    .asciz "state_crc"
+label_crc:
+    .asciz "crc"
+
+    # Label and 1 if hex, in the order of results
+    .align 2
+report_fields:
+    .word label_list_crc, 1
+    .word label_list_found, 0
+    .word label_list_index_sum, 0
+    .word label_matrix_crc, 1
+    .word label_state_int, 0
+    .word label_state_float, 0
+    .word label_state_scientific, 0
+    .word label_state_invalid, 0
+    .word label_state_crc, 1
+    .word label_crc, 1
+    .word 0
+
+    .bss
+    .align 2
+results:
+    .space RESULTS_SIZE
+nodes:
+    .space LIST_SIZE * NODE_SIZE
+matrix_a:
+    .space MATRIX_N * MATRIX_N * 4
+matrix_b:
+    .space MATRIX_N * MATRIX_N * 4
+matrix_c:
+    .space MATRIX_N * MATRIX_N * 4
+state_counts:
+    .space 8 * 4
@@ -0,0 +1,609 @@
+# Dhrystone 2.1 style benchmark: the main loop of Proc_1 to Proc_8 and
+# Func_1 to Func_3 over records, strings and arrays, printing the final
+# state in the order of the original program.
+#
+# All globals and main's locals live in one block addressed through gp.
+# Enumerations are Ident_1 = 0 to Ident_5 = 4, characters are stored as
+# words.
+    .set noreorder
+    .text
+
+    .equ INT_GLOB, 0
+    .equ BOOL_GLOB, 4
+    .equ CH_1_GLOB, 8
+    .equ CH_2_GLOB, 12
+    .equ PTR_GLOB, 16
+    .equ NEXT_PTR_GLOB, 20
+    .equ INT_1_LOC, 24
+    .equ INT_2_LOC, 28
+    .equ INT_3_LOC, 32
+    .equ ENUM_LOC, 36
+    .equ STR_1_LOC, 40
+    .equ STR_2_LOC, 72
+    .equ ARR_1_GLOB, 104
+    .equ ARR_2_GLOB, 304
+    .equ RECORD_A, 10304
+    .equ RECORD_B, 10352
+    .equ GLOBALS_SIZE, 10400
+
+    # Record fields
+    .equ PTR_COMP, 0
+    .equ DISCR, 4
+    .equ ENUM_COMP, 8
+    .equ INT_COMP, 12
+    .equ STR_COMP, 16
+    .equ RECORD_SIZE, 48
+
+    .globl main
+    .ent main
+main:
+    addiu   $sp, $sp, -16
+    sw      $ra, 12($sp)
+    sw      $s2, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+
+    lui     $gp, %hi(globals)
+    addiu   $gp, $gp, %lo(globals)
+    addiu   $t0, $gp, RECORD_A
+    addiu   $t1, $gp, RECORD_B
+    sw      $t1, NEXT_PTR_GLOB($gp)
+    sw      $t0, PTR_GLOB($gp)
+    sw      $t1, PTR_COMP($t0)
+    sw      $zero, DISCR($t0)
+    addiu   $t2, $zero, 2
+    sw      $t2, ENUM_COMP($t0)
+    addiu   $t2, $zero, 40
+    sw      $t2, INT_COMP($t0)
+    addiu   $a0, $t0, STR_COMP
+    lui     $a1, %hi(some_string)
+    addiu   $a1, $a1, %lo(some_string)
+    balc    strcpy
+    addiu   $a0, $gp, STR_1_LOC
+    lui     $a1, %hi(first_string)
+    addiu   $a1, $a1, %lo(first_string)
+    balc    strcpy
+    addiu   $t0, $zero, 10
+    sw      $t0, ARR_2_GLOB + (8 * 50 + 7) * 4($gp)
+
+    # s0 = Run_Index, s1 = Number_Of_Runs
+    lui     $t0, %hi(iterations)
+    lw      $s1, %lo(iterations)($t0)
+    addiu   $s0, $zero, 1
+1:
+    bltc    $s1, $s0, 6f
+    nop
+    balc    proc_5
+    balc    proc_4
+    addiu   $t0, $zero, 2
+    sw      $t0, INT_1_LOC($gp)
+    addiu   $t0, $zero, 3
+    sw      $t0, INT_2_LOC($gp)
+    addiu   $a0, $gp, STR_2_LOC
+    lui     $a1, %hi(second_string)
+    addiu   $a1, $a1, %lo(second_string)
+    balc    strcpy
+    addiu   $t0, $zero, 1
+    sw      $t0, ENUM_LOC($gp)
+    addiu   $a0, $gp, STR_1_LOC
+    addiu   $a1, $gp, STR_2_LOC
+    balc    func_2
+    sltiu   $v0, $v0, 1
+    sw      $v0, BOOL_GLOB($gp)
+2:
+    lw      $a0, INT_1_LOC($gp)
+    lw      $a1, INT_2_LOC($gp)
+    bgec    $a0, $a1, 3f
+    sll     $t0, $a0, 2
+    addu    $t0, $t0, $a0
+    subu    $t0, $t0, $a1
+    sw      $t0, INT_3_LOC($gp)
+    addiu   $a2, $gp, INT_3_LOC
+    balc    proc_7
+    lw      $t0, INT_1_LOC($gp)
+    addiu   $t0, $t0, 1
+    sw      $t0, INT_1_LOC($gp)
+    bc      2b
+3:
+    addiu   $a0, $gp, ARR_1_GLOB
+    addiu   $a1, $gp, ARR_2_GLOB
+    lw      $a2, INT_1_LOC($gp)
+    lw      $a3, INT_3_LOC($gp)
+    balc    proc_8
+    lw      $a0, PTR_GLOB($gp)
+    balc    proc_1
+
+    # s2 = Ch_Index
+    addiu   $s2, $zero, 'A'
+4:
+    lw      $t0, CH_2_GLOB($gp)
+    bltc    $t0, $s2, 5f
+    move    $a0, $s2
+    addiu   $a1, $zero, 'C'
+    balc    func_1
+    lw      $t0, ENUM_LOC($gp)
+    bnec    $v0, $t0, 7f
+    addiu   $a0, $zero, 0
+    addiu   $a1, $gp, ENUM_LOC
+    balc    proc_6
+    addiu   $a0, $gp, STR_2_LOC
+    lui     $a1, %hi(third_string)
+    addiu   $a1, $a1, %lo(third_string)
+    balc    strcpy
+    sw      $s0, INT_2_LOC($gp)
+    sw      $s0, INT_GLOB($gp)
+7:
+    addiu   $s2, $s2, 1
+    bc      4b
+5:
+    lw      $t0, INT_2_LOC($gp)
+    lw      $t1, INT_1_LOC($gp)
+    lw      $t2, INT_3_LOC($gp)
+    mul     $t0, $t0, $t1
+    div     $t1, $t0, $t2
+    sw      $t1, INT_1_LOC($gp)
+    subu    $t0, $t0, $t2
+    addiu   $t3, $zero, 7
+    mul     $t0, $t0, $t3
+    subu    $t0, $t0, $t1
+    sw      $t0, INT_2_LOC($gp)
+    addiu   $a0, $gp, INT_1_LOC
+    balc    proc_2
+    addiu   $s0, $s0, 1
+    bc      1b
+6:
+    balc    report
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $s2, 8($sp)
+    lw      $ra, 12($sp)
+    addiu   $sp, $sp, 16
+    jrc     $ra
+    .end main
+
+    # proc_1(a0 = Ptr_Val_Par)
+    .ent proc_1
+proc_1:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a0
+    lw      $s1, PTR_COMP($s0)
+
+    move    $a0, $s1
+    lw      $a1, PTR_GLOB($gp)
+    balc    copy_record
+    addiu   $t0, $zero, 5
+    sw      $t0, INT_COMP($s0)
+    sw      $t0, INT_COMP($s1)
+    lw      $t0, PTR_COMP($s0)
+    sw      $t0, PTR_COMP($s1)
+    addiu   $a0, $s1, PTR_COMP
+    balc    proc_3
+
+    lw      $t0, DISCR($s1)
+    bnezc   $t0, 1f
+    addiu   $t0, $zero, 6
+    sw      $t0, INT_COMP($s1)
+    lw      $a0, ENUM_COMP($s0)
+    addiu   $a1, $s1, ENUM_COMP
+    balc    proc_6
+    lw      $t0, PTR_GLOB($gp)
+    lw      $t0, PTR_COMP($t0)
+    sw      $t0, PTR_COMP($s1)
+    lw      $a0, INT_COMP($s1)
+    addiu   $a1, $zero, 10
+    addiu   $a2, $s1, INT_COMP
+    balc    proc_7
+    bc      2f
+1:
+    move    $a0, $s0
+    lw      $a1, PTR_COMP($s0)
+    balc    copy_record
+2:
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end proc_1
+
+    # proc_2(a0 = Int_Par_Ref). The original do-while always ends after
+    # one pass, Ch_1_Glob is 'A' by then.
+    .ent proc_2
+proc_2:
+    lw      $t0, CH_1_GLOB($gp)
+    addiu   $t1, $zero, 'A'
+    bnec    $t0, $t1, 1f
+    lw      $t0, 0($a0)
+    addiu   $t0, $t0, 10 - 1
+    lw      $t1, INT_GLOB($gp)
+    subu    $t0, $t0, $t1
+    sw      $t0, 0($a0)
+1:
+    jrc     $ra
+    .end proc_2
+
+    # proc_3(a0 = Ptr_Ref_Par)
+    .ent proc_3
+proc_3:
+    addiu   $sp, $sp, -4
+    sw      $ra, 0($sp)
+    lw      $t0, PTR_GLOB($gp)
+    beqzc   $t0, 1f
+    lw      $t1, PTR_COMP($t0)
+    sw      $t1, 0($a0)
+1:
+    addiu   $a0, $zero, 10
+    lw      $a1, INT_GLOB($gp)
+    addiu   $a2, $t0, INT_COMP
+    balc    proc_7
+    lw      $ra, 0($sp)
+    addiu   $sp, $sp, 4
+    jrc     $ra
+    .end proc_3
+
+    .ent proc_4
+proc_4:
+    lw      $t0, CH_1_GLOB($gp)
+    xori    $t0, $t0, 'A'
+    sltiu   $t0, $t0, 1
+    lw      $t1, BOOL_GLOB($gp)
+    or      $t0, $t0, $t1
+    sw      $t0, BOOL_GLOB($gp)
+    addiu   $t0, $zero, 'B'
+    sw      $t0, CH_2_GLOB($gp)
+    jrc     $ra
+    .end proc_4
+
+    .ent proc_5
+proc_5:
+    addiu   $t0, $zero, 'A'
+    sw      $t0, CH_1_GLOB($gp)
+    sw      $zero, BOOL_GLOB($gp)
+    jrc     $ra
+    .end proc_5
+
+    # proc_6(a0 = Enum_Val_Par, a1 = Enum_Ref_Par)
+    .ent proc_6
+proc_6:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a0
+    move    $s1, $a1
+
+    sw      $s0, 0($s1)
+    balc    func_3
+    bnezc   $v0, 1f
+    addiu   $t0, $zero, 3
+    sw      $t0, 0($s1)
+1:
+    # Ident_1 and Ident_2 (Int_Glob <= 100) give Ident_1 and Ident_4,
+    # Ident_3 gives Ident_2, Ident_5 gives Ident_3, Ident_4 is unchanged
+    beqzc   $s0, 2f
+    addiu   $t0, $zero, 1
+    beqc    $s0, $t0, 3f
+    addiu   $t0, $zero, 2
+    beqc    $s0, $t0, 4f
+    addiu   $t0, $zero, 4
+    beqc    $s0, $t0, 5f
+    nop
+    bc      6f
+2:
+    sw      $zero, 0($s1)
+    bc      6f
+3:
+    lw      $t0, INT_GLOB($gp)
+    slti    $t0, $t0, 101
+    addiu   $t1, $zero, 3
+    mul     $t0, $t0, $t1
+    sw      $t0, 0($s1)
+    bc      6f
+4:
+    addiu   $t0, $zero, 1
+    sw      $t0, 0($s1)
+    bc      6f
+5:
+    addiu   $t0, $zero, 2
+    sw      $t0, 0($s1)
+6:
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end proc_6
+
+    # proc_7(a0 = Int_1_Par_Val, a1 = Int_2_Par_Val, a2 = Int_Par_Ref)
+    .ent proc_7
+proc_7:
+    addiu   $t0, $a0, 2
+    addu    $t0, $a1, $t0
+    sw      $t0, 0($a2)
+    jrc     $ra
+    .end proc_7
+
+    # proc_8(a0 = Arr_1_Par_Ref, a1 = Arr_2_Par_Ref, a2 = Int_1_Par_Val,
+    #        a3 = Int_2_Par_Val)
+    .ent proc_8
+proc_8:
+    addiu   $t0, $a2, 5
+    sll     $t1, $t0, 2
+    addu    $t1, $a0, $t1
+    sw      $a3, 0($t1)
+    sw      $a3, 4($t1)
+    sw      $t0, 30 * 4($t1)
+    addiu   $t2, $zero, 50 * 4
+    mul     $t2, $t0, $t2
+    addu    $t2, $a1, $t2
+    sll     $t3, $t0, 2
+    addu    $t3, $t2, $t3
+    sw      $t0, 0($t3)
+    sw      $t0, 4($t3)
+    lw      $t4, -4($t3)
+    addiu   $t4, $t4, 1
+    sw      $t4, -4($t3)
+    lw      $t4, 0($t1)
+    sw      $t4, 20 * 50 * 4($t3)
+    addiu   $t0, $zero, 5
+    sw      $t0, INT_GLOB($gp)
+    jrc     $ra
+    .end proc_8
+
+    # func_1(a0 = Ch_1_Par_Val, a1 = Ch_2_Par_Val)
+    .ent func_1
+func_1:
+    addiu   $v0, $zero, 0
+    bnec    $a0, $a1, 1f
+    sw      $a0, CH_1_GLOB($gp)
+    addiu   $v0, $zero, 1
+1:
+    jrc     $ra
+    .end func_1
+
+    # func_2(a0 = Str_1_Par_Ref, a1 = Str_2_Par_Ref)
+    .ent func_2
+func_2:
+    addiu   $sp, $sp, -20
+    sw      $ra, 16($sp)
+    sw      $s3, 12($sp)
+    sw      $s2, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a0
+    move    $s1, $a1
+
+    # s2 = Int_Loc, s3 = Ch_Loc
+    addiu   $s2, $zero, 2
+    addiu   $s3, $zero, 0
+1:
+    addiu   $t0, $zero, 2
+    bltc    $t0, $s2, 2f
+    addu    $t0, $s0, $s2
+    lbu     $a0, 0($t0)
+    addu    $t0, $s1, $s2
+    lbu     $a1, 1($t0)
+    balc    func_1
+    bnezc   $v0, 1b
+    addiu   $s3, $zero, 'A'
+    addiu   $s2, $s2, 1
+    bc      1b
+2:
+    addiu   $t0, $s3, -'W'
+    sltiu   $t0, $t0, 3
+    beqzc   $t0, 3f
+    addiu   $s2, $zero, 7
+3:
+    addiu   $v0, $zero, 1
+    addiu   $t0, $zero, 'R'
+    beqc    $s3, $t0, 4f
+    move    $a0, $s0
+    move    $a1, $s1
+    balc    strcmp
+    blezc   $v0, 5f
+    addiu   $s2, $s2, 7
+    sw      $s2, INT_GLOB($gp)
+    addiu   $v0, $zero, 1
+    bc      4f
+5:
+    addiu   $v0, $zero, 0
+4:
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $s2, 8($sp)
+    lw      $s3, 12($sp)
+    lw      $ra, 16($sp)
+    addiu   $sp, $sp, 20
+    jrc     $ra
+    .end func_2
+
+    # func_3(a0 = Enum_Par_Val)
+    .ent func_3
+func_3:
+    xori    $a0, $a0, 2
+    sltiu   $v0, $a0, 1
+    jrc     $ra
+    .end func_3
+
+    # copy_record(a0 = destination, a1 = source)
+    .ent copy_record
+copy_record:
+    addiu   $t0, $a1, RECORD_SIZE
+1:
+    lw      $t1, 0($a1)
+    sw      $t1, 0($a0)
+    addiu   $a0, $a0, 4
+    addiu   $a1, $a1, 4
+    bnec    $a1, $t0, 1b
+    nop
+    jrc     $ra
+    .end copy_record
+
+    .ent strcpy
+strcpy:
+    lbu     $t0, 0($a1)
+    sb      $t0, 0($a0)
+    addiu   $a0, $a0, 1
+    addiu   $a1, $a1, 1
+    bnezc   $t0, strcpy
+    nop
+    jrc     $ra
+    .end strcpy
+
+    .ent strcmp
+strcmp:
+    lbu     $t0, 0($a0)
+    lbu     $t1, 0($a1)
+    subu    $v0, $t0, $t1
+    bnezc   $v0, 1f
+    nop
+    beqzc   $t0, 1f
+    addiu   $a0, $a0, 1
+    addiu   $a1, $a1, 1
+    bc      strcmp
+1:
+    jrc     $ra
+    .end strcmp
+
+    # Prints the fields listed in report_fields, then Arr_2_Glob[8][7]
+    # less the number of runs
+    .ent report
+report:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+
+    lui     $s0, %hi(report_fields)
+    addiu   $s0, $s0, %lo(report_fields)
+1:
+    lw      $a0, 0($s0)
+    beqzc   $a0, 3f
+    lw      $a1, 4($s0)
+    addu    $a1, $gp, $a1
+    lw      $t0, 8($s0)
+    bnezc   $t0, 2f
+    lw      $a1, 0($a1)
+    balc    print_field
+    addiu   $s0, $s0, 12
+    bc      1b
+2:
+    balc    print_string_field
+    addiu   $s0, $s0, 12
+    bc      1b
+3:
+    lui     $a0, %hi(label_arr_2)
+    addiu   $a0, $a0, %lo(label_arr_2)
+    lw      $a1, ARR_2_GLOB + (8 * 50 + 7) * 4($gp)
+    lui     $t0, %hi(iterations)
+    lw      $t0, %lo(iterations)($t0)
+    subu    $a1, $a1, $t0
+    balc    print_field
+
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end report
+
+    # print_string_field(a0 = label, a1 = string): "label string\n"
+    .ent print_string_field
+print_string_field:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a1
+    balc    print_string
+    addiu   $a0, $zero, ' '
+    balc    print_char
+    move    $a0, $s0
+    balc    print_string
+    addiu   $a0, $zero, '\n'
+    balc    print_char
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end print_string_field
+
+    .section .rodata
+some_string:
+    .asciz "DHRYSTONE PROGRAM, SOME STRING"
+first_string:
+    .asciz "DHRYSTONE PROGRAM, 1'ST STRING"
+second_string:
+    .asciz "DHRYSTONE PROGRAM, 2'ND STRING"
+third_string:
+    .asciz "DHRYSTONE PROGRAM, 3'RD STRING"
+
+label_int_glob:
+    .asciz "Int_Glob"
+label_bool_glob:
+    .asciz "Bool_Glob"
+label_ch_1_glob:
+    .asciz "Ch_1_Glob"
+label_ch_2_glob:
+    .asciz "Ch_2_Glob"
+label_arr_1:
+    .asciz "Arr_1_Glob[8]"
+label_arr_2:
+    .asciz "Arr_2_Glob[8][7]-runs"
+label_ptr_discr:
+    .asciz "Ptr_Glob->Discr"
+label_ptr_enum:
+    .asciz "Ptr_Glob->Enum_Comp"
+label_ptr_int:
+    .asciz "Ptr_Glob->Int_Comp"
+label_ptr_str:
+    .asciz "Ptr_Glob->Str_Comp"
+label_next_discr:
+    .asciz "Next_Ptr_Glob->Discr"
+label_next_enum:
+    .asciz "Next_Ptr_Glob->Enum_Comp"
+label_next_int:
+    .asciz "Next_Ptr_Glob->Int_Comp"
+label_next_str:
+    .asciz "Next_Ptr_Glob->Str_Comp"
+label_int_1_loc:
+    .asciz "Int_1_Loc"
+label_int_2_loc:
+    .asciz "Int_2_Loc"
+label_int_3_loc:
+    .asciz "Int_3_Loc"
+label_enum_loc:
+    .asciz "Enum_Loc"
+label_str_1_loc:
+    .asciz "Str_1_Loc"
+label_str_2_loc:
+    .asciz "Str_2_Loc"
+
+    # Label, offset from gp, 1 if a string
+    .align 2
+report_fields:
+    .word label_int_glob, INT_GLOB, 0
+    .word label_bool_glob, BOOL_GLOB, 0
+    .word label_ch_1_glob, CH_1_GLOB, 0
+    .word label_ch_2_glob, CH_2_GLOB, 0
+    .word label_arr_1, ARR_1_GLOB + 8 * 4, 0
+    .word label_ptr_discr, RECORD_A + DISCR, 0
+    .word label_ptr_enum, RECORD_A + ENUM_COMP, 0
+    .word label_ptr_int, RECORD_A + INT_COMP, 0
+    .word label_ptr_str, RECORD_A + STR_COMP, 1
+    .word label_next_discr, RECORD_B + DISCR, 0
+    .word label_next_enum, RECORD_B + ENUM_COMP, 0
+    .word label_next_int, RECORD_B + INT_COMP, 0
+    .word label_next_str, RECORD_B + STR_COMP, 1
+    .word label_int_1_loc, INT_1_LOC, 0
+    .word label_int_2_loc, INT_2_LOC, 0
+    .word label_int_3_loc, INT_3_LOC, 0
+    .word label_enum_loc, ENUM_LOC, 0
+    .word label_str_1_loc, STR_1_LOC, 1
+    .word label_str_2_loc, STR_2_LOC, 1
+    .word 0
+
+    .bss
+    .align 2
+globals:
+    .space GLOBALS_SIZE
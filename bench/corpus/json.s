@@ -0,0 +1,421 @@
+# JSON benchmark: recursive descent parse of an embedded document, counting
+# the values by type and hashing every string (FNV-1a) and key on the way.
+#
+# The parser keeps its cursor in s0 for the whole parse. Numbers contribute
+# their integer part to a sum, fractions are skipped.
+    .set noreorder
+    .text
+
+    # Offsets into stats
+    .equ OBJECTS, 0
+    .equ ARRAYS, 4
+    .equ STRINGS, 8
+    .equ NUMBERS, 12
+    .equ LITERALS, 16
+    .equ DEPTH, 20
+    .equ SUM, 24
+    .equ HASH, 28
+    .equ VALID, 32
+
+    .globl main
+    .ent main
+main:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+    lui     $t0, %hi(iterations)
+    lw      $s1, %lo(iterations)($t0)
+1:
+    balc    parse_document
+    addiu   $s1, $s1, -1
+    bgtzc   $s1, 1b
+    nop
+
+    balc    report
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end main
+
+    .ent parse_document
+parse_document:
+    addiu   $sp, $sp, -4
+    sw      $ra, 0($sp)
+
+    lui     $t0, %hi(stats)
+    addiu   $t0, $t0, %lo(stats)
+    sw      $zero, OBJECTS($t0)
+    sw      $zero, ARRAYS($t0)
+    sw      $zero, STRINGS($t0)
+    sw      $zero, NUMBERS($t0)
+    sw      $zero, LITERALS($t0)
+    sw      $zero, DEPTH($t0)
+    sw      $zero, SUM($t0)
+    lui     $t1, 0x811c
+    ori     $t1, $t1, 0x9dc5
+    sw      $t1, HASH($t0)
+    sw      $zero, VALID($t0)
+
+    lui     $s0, %hi(document)
+    addiu   $s0, $s0, %lo(document)
+    addiu   $a0, $zero, 1
+    balc    parse_value
+    bnezc   $v0, 1f
+    nop
+    balc    skip_whitespace
+    lbu     $t0, 0($s0)
+    bnezc   $t0, 1f
+    lui     $t0, %hi(stats)
+    addiu   $t1, $zero, 1
+    sw      $t1, %lo(stats + VALID)($t0)
+1:
+    lw      $ra, 0($sp)
+    addiu   $sp, $sp, 4
+    jrc     $ra
+    .end parse_document
+
+    .ent skip_whitespace
+skip_whitespace:
+    lbu     $t0, 0($s0)
+    addiu   $t1, $zero, ' '
+    beqc    $t0, $t1, 1f
+    addiu   $t1, $zero, '\n'
+    beqc    $t0, $t1, 1f
+    addiu   $t1, $zero, '\t'
+    beqc    $t0, $t1, 1f
+    addiu   $t1, $zero, '\r'
+    beqc    $t0, $t1, 1f
+    nop
+    jrc     $ra
+1:
+    addiu   $s0, $s0, 1
+    bc      skip_whitespace
+    .end skip_whitespace
+
+    # Increments the stats counter at offset a0
+    .ent count
+count:
+    lui     $t0, %hi(stats)
+    addiu   $t0, $t0, %lo(stats)
+    addu    $t0, $t0, $a0
+    lw      $t1, 0($t0)
+    addiu   $t1, $t1, 1
+    sw      $t1, 0($t0)
+    jrc     $ra
+    .end count
+
+    # parse_value(a0 = depth), v0 = 0 on success
+    .ent parse_value
+parse_value:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s1, 0($sp)
+    move    $s1, $a0
+
+    lui     $t0, %hi(stats)
+    lw      $t1, %lo(stats + DEPTH)($t0)
+    bgeuc   $t1, $s1, 1f
+    sw      $s1, %lo(stats + DEPTH)($t0)
+1:
+    balc    skip_whitespace
+    lbu     $t0, 0($s0)
+    addiu   $t1, $zero, '{'
+    beqc    $t0, $t1, object
+    addiu   $t1, $zero, '['
+    beqc    $t0, $t1, array
+    addiu   $t1, $zero, '"'
+    beqc    $t0, $t1, string
+    lui     $a1, %hi(literal_true)
+    addiu   $a1, $a1, %lo(literal_true)
+    addiu   $t1, $zero, 't'
+    beqc    $t0, $t1, literal
+    lui     $a1, %hi(literal_false)
+    addiu   $a1, $a1, %lo(literal_false)
+    addiu   $t1, $zero, 'f'
+    beqc    $t0, $t1, literal
+    lui     $a1, %hi(literal_null)
+    addiu   $a1, $a1, %lo(literal_null)
+    addiu   $t1, $zero, 'n'
+    beqc    $t0, $t1, literal
+    addiu   $t1, $zero, '-'
+    beqc    $t0, $t1, number
+    addiu   $t1, $t0, -'0'
+    sltiu   $t1, $t1, 10
+    bnezc   $t1, number
+    nop
+    bc      error
+
+object:
+    addiu   $a0, $zero, OBJECTS
+    balc    count
+    addiu   $s0, $s0, 1
+    balc    skip_whitespace
+    lbu     $t0, 0($s0)
+    addiu   $t1, $zero, '}'
+    beqc    $t0, $t1, close
+    nop
+2:
+    balc    skip_whitespace
+    lbu     $t0, 0($s0)
+    addiu   $t1, $zero, '"'
+    bnec    $t0, $t1, error
+    nop
+    balc    parse_string
+    balc    skip_whitespace
+    lbu     $t0, 0($s0)
+    addiu   $t1, $zero, ':'
+    bnec    $t0, $t1, error
+    addiu   $s0, $s0, 1
+    addiu   $a0, $s1, 1
+    balc    parse_value
+    bnezc   $v0, error
+    nop
+    balc    skip_whitespace
+    lbu     $t0, 0($s0)
+    addiu   $s0, $s0, 1
+    addiu   $t1, $zero, ','
+    beqc    $t0, $t1, 2b
+    addiu   $t1, $zero, '}'
+    beqc    $t0, $t1, success
+    nop
+    bc      error
+
+array:
+    addiu   $a0, $zero, ARRAYS
+    balc    count
+    addiu   $s0, $s0, 1
+    balc    skip_whitespace
+    lbu     $t0, 0($s0)
+    addiu   $t1, $zero, ']'
+    beqc    $t0, $t1, close
+3:
+    addiu   $a0, $s1, 1
+    balc    parse_value
+    bnezc   $v0, error
+    nop
+    balc    skip_whitespace
+    lbu     $t0, 0($s0)
+    addiu   $s0, $s0, 1
+    addiu   $t1, $zero, ','
+    beqc    $t0, $t1, 3b
+    addiu   $t1, $zero, ']'
+    beqc    $t0, $t1, success
+    nop
+    bc      error
+
+string:
+    balc    parse_string
+    bc      success
+
+    # Compares with the NUL terminated word at a1
+literal:
+    lbu     $t1, 0($a1)
+    beqzc   $t1, 4f
+    lbu     $t0, 0($s0)
+    bnec    $t0, $t1, error
+    addiu   $s0, $s0, 1
+    addiu   $a1, $a1, 1
+    bc      literal
+4:
+    addiu   $a0, $zero, LITERALS
+    balc    count
+    bc      success
+
+number:
+    addiu   $a0, $zero, NUMBERS
+    balc    count
+    lbu     $t0, 0($s0)
+    addiu   $t1, $zero, '-'
+    subu    $t3, $t0, $t1
+    sltiu   $t3, $t3, 1         # t3 = negative
+    addu    $s0, $s0, $t3
+    addiu   $t2, $zero, 0
+    addiu   $t4, $zero, 10
+5:
+    lbu     $t0, 0($s0)
+    addiu   $t0, $t0, -'0'
+    bgeuc   $t0, $t4, 6f
+    mul     $t2, $t2, $t4
+    addu    $t2, $t2, $t0
+    addiu   $s0, $s0, 1
+    bc      5b
+6:
+    addiu   $t0, $t0, '0'
+    addiu   $t1, $zero, '.'
+    bnec    $t0, $t1, 8f
+7:
+    addiu   $s0, $s0, 1
+    lbu     $t0, 0($s0)
+    addiu   $t0, $t0, -'0'
+    bltuc   $t0, $t4, 7b
+    nop
+8:
+    beqzc   $t3, 9f
+    subu    $t2, $zero, $t2
+9:
+    lui     $t0, %hi(stats)
+    lw      $t1, %lo(stats + SUM)($t0)
+    addu    $t1, $t1, $t2
+    sw      $t1, %lo(stats + SUM)($t0)
+    bc      success
+
+close:
+    addiu   $s0, $s0, 1
+success:
+    addiu   $v0, $zero, 0
+    bc      10f
+error:
+    addiu   $v0, $zero, 1
+10:
+    lw      $s1, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end parse_value
+
+    # Hashes the string at s0, a backslash escapes the next character
+    .ent parse_string
+parse_string:
+    lui     $t0, %hi(stats)
+    lw      $t2, %lo(stats + HASH)($t0)
+    lui     $t3, 0x0100
+    ori     $t3, $t3, 0x0193    # FNV prime
+    addiu   $t4, $zero, '"'
+    addiu   $t5, $zero, '\\'
+    addiu   $s0, $s0, 1
+1:
+    lbu     $t1, 0($s0)
+    addiu   $s0, $s0, 1
+    beqc    $t1, $t4, 2f
+    nop
+    bnec    $t1, $t5, 3f
+    lbu     $t1, 0($s0)
+    addiu   $s0, $s0, 1
+3:
+    xor     $t2, $t2, $t1
+    mul     $t2, $t2, $t3
+    bc      1b
+2:
+    sw      $t2, %lo(stats + HASH)($t0)
+    lw      $t1, %lo(stats + STRINGS)($t0)
+    addiu   $t1, $t1, 1
+    sw      $t1, %lo(stats + STRINGS)($t0)
+    jrc     $ra
+    .end parse_string
+
+    .ent report
+report:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+
+    # Labels and stats are in the same order, the last two in hex
+    lui     $s0, %hi(labels)
+    addiu   $s0, $s0, %lo(labels)
+    lui     $s1, %hi(stats)
+    addiu   $s1, $s1, %lo(stats)
+    lw      $a0, 0($s0)
+    lw      $a1, VALID($s1)
+    balc    print_field
+1:
+    lw      $a0, 4($s0)
+    lw      $a1, 0($s1)
+    balc    print_field
+    addiu   $s0, $s0, 4
+    addiu   $s1, $s1, 4
+    lui     $t0, %hi(stats + SUM)
+    addiu   $t0, $t0, %lo(stats + SUM)
+    bnec    $s1, $t0, 1b
+2:
+    lw      $a0, 4($s0)
+    lw      $a1, 0($s1)
+    balc    print_hex_field
+    addiu   $s0, $s0, 4
+    addiu   $s1, $s1, 4
+    lui     $t0, %hi(stats + VALID)
+    addiu   $t0, $t0, %lo(stats + VALID)
+    bnec    $s1, $t0, 2b
+
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end report
+
+    .section .rodata
+literal_true:
+    .asciz "true"
+literal_false:
+    .asciz "false"
+literal_null:
+    .asciz "null"
+
+label_valid:
+    .asciz "valid"
+label_objects:
+    .asciz "objects"
+label_arrays:
+    .asciz "arrays"
+label_strings:
+    .asciz "strings"
+label_numbers:
+    .asciz "numbers"
+label_literals:
+    .asciz "literals"
+label_depth:
+    .asciz "depth"
+label_sum:
+    .asciz "sum"
+label_hash:
+    .asciz "hash"
+
+    .align 2
+labels:
+    .word label_valid, label_objects, label_arrays, label_strings
+    .word label_numbers, label_literals, label_depth, label_sum, label_hash
+
+document:
+    .ascii "{\n"
+    .ascii "  \"name\": \"mips-emulator\",\n"
+    .ascii "  \"version\": \"0.4.2\",\n"
+    .ascii "  \"description\": \"A \\\"small\\\" MIPS32 emulator with an interpreter and a recompiler\",\n"
+    .ascii "  \"license\": \"MIT\",\n"
+    .ascii "  \"private\": false,\n"
+    .ascii "  \"keywords\": [\"mips\", \"emulator\", \"jit\", \"elf\", \"benchmark\"],\n"
+    .ascii "  \"targets\": [\n"
+    .ascii "    {\"triple\": \"mipsel-unknown-linux-gnu\", \"cpu\": \"mips32r6\", \"endian\": \"little\", \"bits\": 32, \"fpu\": null},\n"
+    .ascii "    {\"triple\": \"mips-unknown-linux-gnu\", \"cpu\": \"mips32r2\", \"endian\": \"big\", \"bits\": 32, \"fpu\": \"hard\"}\n"
+    .ascii "  ],\n"
+    .ascii "  \"memory\": {\n"
+    .ascii "    \"segments\": [\n"
+    .ascii "      {\"name\": \"kuseg\", \"start\": 0, \"size\": 2147483647, \"mapped\": true},\n"
+    .ascii "      {\"name\": \"kseg0\", \"start\": 2147483647, \"size\": 536870912, \"mapped\": false, \"cached\": true},\n"
+    .ascii "      {\"name\": \"kseg1\", \"start\": -1610612736, \"size\": 536870912, \"mapped\": false, \"cached\": false}\n"
+    .ascii "    ],\n"
+    .ascii "    \"page_size\": 4096,\n"
+    .ascii "    \"tlb_entries\": 16\n"
+    .ascii "  },\n"
+    .ascii "  \"benchmarks\": [\n"
+    .ascii "    {\"id\": 1, \"name\": \"coremark\", \"iterations\": 10, \"score\": 182.5, \"tags\": [\"list\", \"matrix\", \"state\", \"crc\"]},\n"
+    .ascii "    {\"id\": 2, \"name\": \"dhrystone\", \"iterations\": 500, \"score\": 1043.25, \"tags\": []},\n"
+    .ascii "    {\"id\": 3, \"name\": \"compress\", \"iterations\": 4, \"ratio\": -0.62, \"tags\": [\"lz77\"]},\n"
+    .ascii "    {\"id\": 4, \"name\": \"sort\", \"iterations\": 8, \"score\": 77, \"tags\": [\"quicksort\", \"insertion\"]},\n"
+    .ascii "    {\"id\": 5, \"name\": \"json\", \"iterations\": 50, \"score\": 310, \"tags\": [[\"nested\", [\"deeper\", [\"deepest\", {\"level\": 6}]]]]}\n"
+    .ascii "  ],\n"
+    .ascii "  \"registers\": [0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31],\n"
+    .ascii "  \"paths\": {\"windows\": \"C:\\\\mips\\\\bin\", \"unix\": \"/usr/local/bin\"},\n"
+    .ascii "  \"matrix\": [[1, -2, 3], [-4, 5, -6], [7, -8, 9]],\n"
+    .ascii "  \"empty\": {},\n"
+    .ascii "  \"flags\": [true, false, null, true, true, false]\n"
+    .ascii "}\n"
+    .byte 0
+
+    .bss
+    .align 2
+stats:
+    .space 36
@@ -0,0 +1,177 @@
+# Startup code and output helpers shared by the benchmark corpus, linked
+# into every program, see the benchmark section of README.md.
+#
+# Programs define main, which runs its kernel `iterations` times and prints
+# its results once. Output is appended to `output`, `output_length` bytes
+# long, so the harness can compare it with the expected output. The program
+# ends with a trap when main returns.
+    .set noreorder
+    .text
+
+    .globl __start
+    .ent __start
+__start:
+    lui     $sp, %hi(stack_top)
+    addiu   $sp, $sp, %lo(stack_top)
+    balc    main
+    teq     $zero, $zero
+    .end __start
+
+    # print_char(a0 = character), drops output past the buffer
+    .globl print_char
+    .ent print_char
+print_char:
+    lui     $t0, %hi(output_length)
+    lw      $t1, %lo(output_length)($t0)
+    sltiu   $t2, $t1, 4096
+    beqzc   $t2, 1f
+    lui     $t3, %hi(output)
+    addiu   $t3, $t3, %lo(output)
+    addu    $t3, $t3, $t1
+    sb      $a0, 0($t3)
+    addiu   $t1, $t1, 1
+    sw      $t1, %lo(output_length)($t0)
+1:
+    jrc     $ra
+    .end print_char
+
+    # print_string(a0 = NUL terminated string)
+    .globl print_string
+    .ent print_string
+print_string:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a0
+1:
+    lbu     $a0, 0($s0)
+    beqzc   $a0, 2f
+    addiu   $s0, $s0, 1
+    balc    print_char
+    bc      1b
+2:
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end print_string
+
+    # print_hex(a0 = value) as 8 digits
+    .globl print_hex
+    .ent print_hex
+print_hex:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a0
+    addiu   $s1, $zero, 28
+1:
+    srlv    $a0, $s0, $s1
+    andi    $a0, $a0, 0xf
+    sltiu   $t0, $a0, 10
+    addiu   $a0, $a0, '0'
+    bnezc   $t0, 2f
+    addiu   $a0, $a0, 'a' - '0' - 10
+2:
+    balc    print_char
+    addiu   $s1, $s1, -4
+    bgezc   $s1, 1b
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end print_hex
+
+    # print_dec(a0 = unsigned value)
+    .globl print_dec
+    .ent print_dec
+print_dec:
+    addiu   $sp, $sp, -24
+    sw      $ra, 20($sp)
+    sw      $s0, 16($sp)
+    # Digits are collected backwards in 0..11($sp)
+    addiu   $s0, $sp, 12
+    addiu   $t1, $zero, 10
+1:
+    modu    $t2, $a0, $t1
+    divu    $a0, $a0, $t1
+    addiu   $t2, $t2, '0'
+    addiu   $s0, $s0, -1
+    sb      $t2, 0($s0)
+    bnezc   $a0, 1b
+2:
+    lbu     $a0, 0($s0)
+    balc    print_char
+    addiu   $s0, $s0, 1
+    addiu   $t0, $sp, 12
+    bnec    $s0, $t0, 2b
+    lw      $s0, 16($sp)
+    lw      $ra, 20($sp)
+    addiu   $sp, $sp, 24
+    jrc     $ra
+    .end print_dec
+
+    # print_field(a0 = label, a1 = value): "label value\n" in decimal
+    .globl print_field
+    .ent print_field
+print_field:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a1
+    balc    print_string
+    addiu   $a0, $zero, ' '
+    balc    print_char
+    move    $a0, $s0
+    balc    print_dec
+    addiu   $a0, $zero, '\n'
+    balc    print_char
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end print_field
+
+    # print_hex_field(a0 = label, a1 = value): "label 0x<hex>\n"
+    .globl print_hex_field
+    .ent print_hex_field
+print_hex_field:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a1
+    balc    print_string
+    addiu   $a0, $zero, ' '
+    balc    print_char
+    addiu   $a0, $zero, '0'
+    balc    print_char
+    addiu   $a0, $zero, 'x'
+    balc    print_char
+    move    $a0, $s0
+    balc    print_hex
+    addiu   $a0, $zero, '\n'
+    balc    print_char
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end print_hex_field
+
+    .data
+    .globl iterations
+iterations:
+    .word 1
+    .globl output_length
+output_length:
+    .word 0
+
+    .bss
+    .globl output
+output:
+    .space 4096
+    .align 3
+stack:
+    .space 16384
+stack_top:
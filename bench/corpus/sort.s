@@ -0,0 +1,201 @@
+# Sorting benchmark: quicksort (Hoare partitioning, insertion sort below 16
+# elements) of 2048 pseudo-random signed words, then a check that the
+# result is sorted and a position weighted checksum.
+    .set noreorder
+    .text
+
+    .globl main
+    .ent main
+main:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+    lui     $t0, %hi(iterations)
+    lw      $s0, %lo(iterations)($t0)
+1:
+    balc    fill
+    lui     $a0, %hi(array)
+    addiu   $a0, $a0, %lo(array)
+    addiu   $a1, $a0, 2047 * 4
+    balc    quicksort
+    addiu   $s0, $s0, -1
+    bgtzc   $s0, 1b
+    nop
+
+    balc    report
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    addiu   $sp, $sp, 8
+    jrc     $ra
+    .end main
+
+    # Fills the array from a xorshift32 sequence
+    .ent fill
+fill:
+    lui     $t0, %hi(array)
+    addiu   $t0, $t0, %lo(array)
+    addiu   $t1, $t0, 2048 * 4
+    lui     $t2, 0x1234
+    ori     $t2, $t2, 0x5678
+1:
+    sll     $t3, $t2, 13
+    xor     $t2, $t2, $t3
+    srl     $t3, $t2, 17
+    xor     $t2, $t2, $t3
+    sll     $t3, $t2, 5
+    xor     $t2, $t2, $t3
+    sw      $t2, 0($t0)
+    addiu   $t0, $t0, 4
+    bnec    $t0, $t1, 1b
+    nop
+    jrc     $ra
+    .end fill
+
+    # quicksort(a0 = first, a1 = last element, inclusive). Recurses into
+    # the smaller partition and loops on the larger one.
+    .ent quicksort
+quicksort:
+    addiu   $sp, $sp, -12
+    sw      $ra, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+    move    $s0, $a0
+    move    $s1, $a1
+1:
+    subu    $t0, $s1, $s0
+    sltiu   $t1, $t0, 16 * 4
+    bnezc   $t1, 5f
+
+    # Middle element as the pivot
+    srl     $t0, $t0, 3
+    sll     $t0, $t0, 2
+    addu    $t0, $s0, $t0
+    lw      $t2, 0($t0)
+    addiu   $t3, $s0, -4
+    addiu   $t4, $s1, 4
+2:
+    addiu   $t3, $t3, 4
+    lw      $t5, 0($t3)
+    bltc    $t5, $t2, 2b
+3:
+    addiu   $t4, $t4, -4
+    lw      $t6, 0($t4)
+    bltc    $t2, $t6, 3b
+    nop
+    bgeuc   $t3, $t4, 4f
+    sw      $t6, 0($t3)
+    sw      $t5, 0($t4)
+    bc      2b
+
+    # Partitions [s0, t4] and [t4 + 4, s1]
+4:
+    subu    $t0, $t4, $s0
+    subu    $t1, $s1, $t4
+    bltuc   $t1, $t0, 6f
+    move    $a0, $s0
+    move    $a1, $t4
+    addiu   $s0, $t4, 4
+    balc    quicksort
+    bc      1b
+6:
+    addiu   $a0, $t4, 4
+    move    $a1, $s1
+    move    $s1, $t4
+    balc    quicksort
+    bc      1b
+
+    # Insertion sort of [s0, s1]
+5:
+    addiu   $t0, $s0, 4
+7:
+    bltuc   $s1, $t0, 9f
+    lw      $t1, 0($t0)
+    move    $t2, $t0
+8:
+    beqc    $t2, $s0, 10f
+    lw      $t3, -4($t2)
+    bgec    $t1, $t3, 10f
+    sw      $t3, 0($t2)
+    addiu   $t2, $t2, -4
+    bc      8b
+10:
+    sw      $t1, 0($t2)
+    addiu   $t0, $t0, 4
+    bc      7b
+9:
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $ra, 8($sp)
+    addiu   $sp, $sp, 12
+    jrc     $ra
+    .end quicksort
+
+    .ent report
+report:
+    addiu   $sp, $sp, -16
+    sw      $ra, 12($sp)
+    sw      $s2, 8($sp)
+    sw      $s1, 4($sp)
+    sw      $s0, 0($sp)
+
+    # s0 = elements out of order, s1 = sum of a[i] * (i + 1)
+    lui     $t0, %hi(array)
+    addiu   $t0, $t0, %lo(array)
+    addiu   $t1, $t0, 2048 * 4
+    addiu   $s0, $zero, 0
+    addiu   $s1, $zero, 0
+    addiu   $t2, $zero, 1
+    lw      $t3, 0($t0)
+1:
+    lw      $t4, 0($t0)
+    slt     $t5, $t4, $t3
+    addu    $s0, $s0, $t5
+    mul     $t5, $t4, $t2
+    addu    $s1, $s1, $t5
+    move    $t3, $t4
+    addiu   $t2, $t2, 1
+    addiu   $t0, $t0, 4
+    bnec    $t0, $t1, 1b
+
+    lui     $a0, %hi(label_sorted)
+    addiu   $a0, $a0, %lo(label_sorted)
+    sltiu   $a1, $s0, 1
+    balc    print_field
+    lui     $a0, %hi(label_checksum)
+    addiu   $a0, $a0, %lo(label_checksum)
+    move    $a1, $s1
+    balc    print_hex_field
+
+    lui     $s2, %hi(array)
+    addiu   $s2, $s2, %lo(array)
+    lui     $a0, %hi(label_min)
+    addiu   $a0, $a0, %lo(label_min)
+    lw      $a1, 0($s2)
+    balc    print_hex_field
+    lui     $a0, %hi(label_max)
+    addiu   $a0, $a0, %lo(label_max)
+    lw      $a1, 2047 * 4($s2)
+    balc    print_hex_field
+
+    lw      $s0, 0($sp)
+    lw      $s1, 4($sp)
+    lw      $s2, 8($sp)
+    lw      $ra, 12($sp)
+    addiu   $sp, $sp, 16
+    jrc     $ra
+    .end report
+
+    .section .rodata
+label_sorted:
+    .asciz "sorted"
+label_checksum:
+    .asciz "checksum"
+label_min:
+    .asciz "min"
+label_max:
+    .asciz "max"
+
+    .bss
+    .align 2
+array:
+    .space 2048 * 4
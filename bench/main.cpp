@@ -0,0 +1,295 @@
+#include "perf_counters.hpp"
+
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/handler_profile.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace mips_emulator;
+using mips_emulator::bench::PerfCounters;
+
+namespace {
+    using Func = Instruction::Func;
+    using IOp = Instruction::ITypeOpcode;
+    using R = RegisterName;
+
+    constexpr uint32_t MEMORY_SIZE = 0x10000;
+
+    struct Benchmark {
+        std::string name;
+        // Loaded at address 0 and executed until step() fails, so every
+        // program ends in a trap
+        std::vector<Instruction> program;
+    };
+
+    const Instruction NOP(Func::e_sll, R::e_0, R::e_0, R::e_0);
+    const Instruction STOP(Func::e_teq, R::e_0, R::e_0, R::e_0);
+
+    // Straight line arithmetic, the branch is always taken
+    Benchmark make_alu_loop() {
+        return {"alu_loop",
+                {
+                    Instruction(IOp::e_aui, R::e_t0, R::e_0, 0x40),
+                    // loop:
+                    Instruction(IOp::e_addiu, R::e_t1, R::e_t1, 3),
+                    Instruction(Func::e_xor, R::e_t2, R::e_t1, R::e_t0),
+                    Instruction(Func::e_sll, R::e_t3, R::e_0, R::e_t2, 2),
+                    Instruction(Func::e_addu, R::e_t4, R::e_t4, R::e_t3),
+                    Instruction(IOp::e_addiu, R::e_t0, R::e_t0, 0xFFFF),
+                    Instruction(IOp::e_bne, R::e_0, R::e_t0, 0xFFFA),
+                    NOP,
+                    STOP,
+                }};
+    }
+
+    // Load, add and store over a 4 KiB buffer
+    Benchmark make_memory_loop() {
+        return {"memory_loop",
+                {
+                    Instruction(IOp::e_addiu, R::e_s0, R::e_0, 4096),
+                    // outer:
+                    Instruction(IOp::e_addiu, R::e_t1, R::e_0, 0x2000),
+                    Instruction(IOp::e_addiu, R::e_t0, R::e_0, 0x1000),
+                    // inner:
+                    Instruction(IOp::e_lw, R::e_t2, R::e_t0, 0),
+                    Instruction(Func::e_addu, R::e_t3, R::e_t3, R::e_t2),
+                    Instruction(IOp::e_sw, R::e_t3, R::e_t0, 0),
+                    Instruction(IOp::e_addiu, R::e_t0, R::e_t0, 4),
+                    Instruction(IOp::e_bne, R::e_t1, R::e_t0, 0xFFFB),
+                    NOP,
+                    Instruction(IOp::e_addiu, R::e_s0, R::e_s0, 0xFFFF),
+                    Instruction(IOp::e_bne, R::e_0, R::e_s0, 0xFFF6),
+                    NOP,
+                    STOP,
+                }};
+    }
+
+    // Branches on the low bit of a xorshift sequence, which the host branch
+    // predictor can't learn
+    Benchmark make_branchy_loop() {
+        return {"branchy_loop",
+                {
+                    Instruction(IOp::e_aui, R::e_s0, R::e_0, 0x10),
+                    Instruction(IOp::e_addiu, R::e_t0, R::e_0, 12345),
+                    // loop:
+                    Instruction(Func::e_sll, R::e_t1, R::e_0, R::e_t0, 13),
+                    Instruction(Func::e_xor, R::e_t0, R::e_t0, R::e_t1),
+                    Instruction(Func::e_srl, R::e_t1, R::e_0, R::e_t0, 17),
+                    Instruction(Func::e_xor, R::e_t0, R::e_t0, R::e_t1),
+                    Instruction(Func::e_sll, R::e_t1, R::e_0, R::e_t0, 5),
+                    Instruction(Func::e_xor, R::e_t0, R::e_t0, R::e_t1),
+                    Instruction(IOp::e_andi, R::e_t2, R::e_t0, 1),
+                    Instruction(IOp::e_beq, R::e_0, R::e_t2, 2),
+                    NOP,
+                    Instruction(IOp::e_addiu, R::e_t3, R::e_t3, 1),
+                    // skip:
+                    Instruction(IOp::e_addiu, R::e_s0, R::e_s0, 0xFFFF),
+                    Instruction(IOp::e_bne, R::e_0, R::e_s0, 0xFFF4),
+                    NOP,
+                    STOP,
+                }};
+    }
+
+    // A program from bench/corpus, built from <name>.s and checked against
+    // <name>.expected
+    struct CorpusProgram {
+        std::string name;
+        uint32_t iterations; // Patched into the program's `iterations`
+    };
+
+    constexpr uint32_t CORPUS_BASE = 0x00400000;
+    constexpr uint32_t CORPUS_MEMORY_SIZE = 0x10000;
+
+    const std::string CORPUS_DIR = MIPS_EMULATOR_BENCH_CORPUS_DIR;
+
+    // Iterations are picked for roughly 20 million guest instructions each
+    const std::vector<CorpusProgram> CORPUS = {
+        {"coremark", 450},
+        {"dhrystone", 30000},
+        {"compress", 190},
+        {"sort", 130},
+        {"json", 800},
+    };
+
+    struct Measurement {
+        uint64_t guest_instructions = 0;
+        double seconds = 0;
+        PerfCounters::Reading counters;
+        bool output_matches = true;
+    };
+
+    Measurement run(const Benchmark& benchmark, PerfCounters& counters) {
+        Emulator<RuntimeStaticMemory<>> emulator(MEMORY_SIZE);
+
+        uint32_t address = 0;
+        for (const Instruction instr : benchmark.program) {
+            const auto result =
+                emulator.get_memory().template store<uint32_t>(address,
+                                                               instr.raw);
+            if (result.is_error()) return {};
+            address += 4;
+        }
+
+        Measurement measurement;
+
+        const auto start = std::chrono::steady_clock::now();
+        counters.start();
+
+        uint64_t retired = 0;
+        while (emulator.step())
+            ++retired;
+
+        measurement.counters = counters.stop();
+        const auto end = std::chrono::steady_clock::now();
+
+        measurement.guest_instructions = retired;
+        measurement.seconds =
+            std::chrono::duration<double>(end - start).count();
+        return measurement;
+    }
+
+    std::string read_file(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    // The program's output buffer, see bench/corpus/runtime.s
+    std::string read_output(const ElfFile& elf, RuntimeStaticMemory<>& memory) {
+        const auto* output = elf.find_symbol("output");
+        const auto* length = elf.find_symbol("output_length");
+        if (!output || !length) return {};
+
+        const auto size = memory.read<uint32_t>(length->address);
+        if (size.is_error()) return {};
+
+        std::string text;
+        for (uint32_t i = 0; i < size.get_value(); ++i) {
+            const auto c = memory.read<uint8_t>(output->address + i);
+            if (c.is_error()) break;
+            text.push_back(static_cast<char>(c.get_value()));
+        }
+        return text;
+    }
+
+    Measurement run(const CorpusProgram& program, PerfCounters& counters) {
+        const std::string path = CORPUS_DIR + "/" + program.name;
+        Measurement failed;
+        failed.output_matches = false;
+
+        ElfFile elf;
+        if (elf.load_file(path + ".elf").is_error()) return failed;
+
+        Emulator<RuntimeStaticMemory<>> emulator(CORPUS_MEMORY_SIZE,
+                                                 CORPUS_BASE);
+        const auto* iterations = elf.find_symbol("iterations");
+        if (!iterations || !elf.load_into(emulator.get_memory()) ||
+            emulator.get_memory()
+                .store<uint32_t>(iterations->address, program.iterations)
+                .is_error())
+            return failed;
+        emulator.set_pc(elf.get_entry());
+
+        Measurement measurement;
+
+        const auto start = std::chrono::steady_clock::now();
+        counters.start();
+
+        // main returns to a trap
+        uint64_t retired = 0;
+        while (emulator.step())
+            ++retired;
+
+        measurement.counters = counters.stop();
+        const auto end = std::chrono::steady_clock::now();
+
+        measurement.guest_instructions = retired;
+        measurement.seconds =
+            std::chrono::duration<double>(end - start).count();
+        measurement.output_matches =
+            read_output(elf, emulator.get_memory()) ==
+            read_file(path + ".expected");
+        return measurement;
+    }
+
+    void report(const std::string& name, const Measurement& measurement) {
+        const double mips =
+            measurement.guest_instructions / measurement.seconds / 1e6;
+        std::printf("%-16s %12llu instructions %8.3f s %9.1f MIPS\n",
+                    name.c_str(),
+                    static_cast<unsigned long long>(
+                        measurement.guest_instructions),
+                    measurement.seconds, mips);
+
+        if (measurement.guest_instructions == 0) return;
+
+        std::printf("%-16s per guest instruction:", "");
+        for (std::size_t i = 0; i < PerfCounters::EVENT_COUNT; ++i) {
+            std::printf(" %s=", PerfCounters::get_name(i));
+            if (measurement.counters.valid[i]) {
+                std::printf("%.4f", measurement.counters.values[i] /
+                                        measurement.guest_instructions);
+            }
+            else {
+                std::printf("n/a");
+            }
+        }
+        std::printf("\n");
+
+        if (!measurement.output_matches)
+            std::printf("%-16s output differs from %s.expected\n", "",
+                        name.c_str());
+    }
+} // namespace
+
+// Usage: mips_emulator_bench [name filter]
+// Exits with 1 if a corpus program's output isn't the expected one
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : "";
+
+    const std::vector<Benchmark> benchmarks = {
+        make_alu_loop(),
+        make_memory_loop(),
+        make_branchy_loop(),
+    };
+
+    PerfCounters counters;
+    if (!counters.is_available()) {
+        std::printf("perf events are not available, only reporting time "
+                    "(see /proc/sys/kernel/perf_event_paranoid)\n");
+    }
+
+    for (const auto& benchmark : benchmarks) {
+        if (benchmark.name.find(filter) == std::string::npos) continue;
+        report(benchmark.name, run(benchmark, counters));
+    }
+
+    int status = 0;
+    for (const auto& program : CORPUS) {
+        if (program.name.find(filter) == std::string::npos) continue;
+        const Measurement measurement = run(program, counters);
+        report(program.name, measurement);
+        if (!measurement.output_matches) status = 1;
+    }
+
+#if defined(MIPS_EMULATOR_PROFILE_HANDLERS)
+    std::printf("\nhandler latencies, 1 in %u calls sampled:\n",
+                HandlerProfile::thread_profile().get_sample_interval());
+    std::fflush(stdout);
+    HandlerProfile::thread_profile().write_report(std::cout);
+#endif
+
+    return status;
+}
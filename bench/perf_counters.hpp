@@ -0,0 +1,157 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+namespace mips_emulator::bench {
+    // Host hardware counters read through perf_event_open around a region
+    // of code. Every event is opened on its own so that a CPU (or VM)
+    // lacking one of them only loses that column. If perf events aren't
+    // permitted at all (see /proc/sys/kernel/perf_event_paranoid) nothing is
+    // counted and is_available() returns false.
+    class PerfCounters {
+    public:
+        enum Event : std::size_t {
+            e_cycles,
+            e_instructions,
+            e_branch_misses,
+            e_l1d_misses,
+            e_l1i_misses,
+            e_dtlb_misses,
+            EVENT_COUNT,
+        };
+
+        struct Reading {
+            std::array<bool, EVENT_COUNT> valid = {};
+            std::array<double, EVENT_COUNT> values = {};
+        };
+
+        static const char* get_name(const std::size_t event) {
+            static const char* names[EVENT_COUNT] = {
+                "cycles",    "instructions", "branch-misses",
+                "L1d-misses", "L1i-misses",  "dTLB-misses",
+            };
+            return names[event];
+        }
+
+        PerfCounters() {
+#if defined(__linux__)
+            for (std::size_t i = 0; i < EVENT_COUNT; ++i)
+                fds[i] = open_event(static_cast<Event>(i));
+#endif
+        }
+
+        ~PerfCounters() {
+#if defined(__linux__)
+            for (const int fd : fds) {
+                if (fd >= 0) close(fd);
+            }
+#endif
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        bool is_available() const noexcept {
+            for (const int fd : fds) {
+                if (fd >= 0) return true;
+            }
+            return false;
+        }
+
+        void start() noexcept {
+#if defined(__linux__)
+            for (const int fd : fds) {
+                if (fd < 0) continue;
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        Reading stop() noexcept {
+            Reading reading;
+#if defined(__linux__)
+            for (const int fd : fds) {
+                if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+
+            for (std::size_t i = 0; i < EVENT_COUNT; ++i) {
+                if (fds[i] < 0) continue;
+
+                // value, time_enabled, time_running
+                uint64_t data[3] = {};
+                if (read(fds[i], data, sizeof(data)) != sizeof(data)) continue;
+                if (data[2] == 0) continue;
+
+                // Scale in case the kernel had to multiplex the counters
+                reading.valid[i] = true;
+                reading.values[i] = static_cast<double>(data[0]) *
+                                    static_cast<double>(data[1]) /
+                                    static_cast<double>(data[2]);
+            }
+#endif
+            return reading;
+        }
+
+    private:
+#if defined(__linux__)
+        static uint64_t cache_miss(const uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        }
+
+        static int open_event(const Event event) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            switch (event) {
+                case e_cycles:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                    break;
+                case e_instructions:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                    break;
+                case e_branch_misses:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                    break;
+                case e_l1d_misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1D);
+                    break;
+                case e_l1i_misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1I);
+                    break;
+                case e_dtlb_misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+                    break;
+                default: return -1;
+            }
+
+            // Measure this thread on any CPU
+            return static_cast<int>(
+                syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+
+        std::array<int, EVENT_COUNT> fds = {-1, -1, -1, -1, -1, -1};
+    };
+} // namespace mips_emulator::bench
@@ -0,0 +1,281 @@
+#include "mips-emulator/c_api.h"
+
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/loop_detector.hpp"
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace mips_emulator;
+
+struct mips_instance {
+    using Instance = Emulator<RuntimeStaticMemory<>>;
+
+    mips_instance(const uint32_t memory_base, const uint32_t memory_size)
+        : instance(memory_size, memory_base), memory_base(memory_base),
+          memory_size(memory_size),
+          ram(instance.get_memory().get_memory()) {
+        // Instances of a batch run on different threads, each one records
+        // into its own counters
+        instance.set_metrics(&metrics);
+    }
+
+    // Host pointer to [address, address + size) if it is in RAM
+    uint8_t* host(const uint32_t address, const uint32_t size) const {
+        const uint32_t offset = address - memory_base;
+        if (address < memory_base || offset > memory_size ||
+            memory_size - offset < size)
+            return nullptr;
+        return ram + offset;
+    }
+
+    Instance instance;
+    uint32_t memory_base;
+    uint32_t memory_size;
+    uint8_t* ram;
+
+    MetricCounters metrics;
+    std::unique_ptr<LoopDetector> loop_detector;
+};
+
+struct mips_snapshot {
+    uint32_t memory_base;
+    RegisterFile registers;
+    std::vector<uint8_t> memory;
+};
+
+namespace {
+    // NOTE: Exceptions must not cross the C boundary, allocation failures
+    // are returned as nullptr
+    mips_instance* allocate(const uint32_t memory_base,
+                            const uint32_t memory_size) {
+        try {
+            return new mips_instance(memory_base, memory_size);
+        } catch (const std::bad_alloc&) {
+            return nullptr;
+        }
+    }
+
+    // Loops are detected across runs, so a host running in budget slices
+    // still sees them. Changes the host makes behind the program's back
+    // start the detection over.
+    void state_changed(mips_instance& emulator) {
+        if (emulator.loop_detector) emulator.loop_detector->reset();
+    }
+
+    mips_run_result run(mips_instance& emulator, const uint64_t budget) {
+        const RunResult result = emulator.instance.run(budget);
+        return {static_cast<uint32_t>(result.reason),
+                emulator.instance.get_register_file().get_pc(), result.steps};
+    }
+
+    static_assert(static_cast<uint32_t>(StopReason::e_budget_exhausted) ==
+                  MIPS_STOP_BUDGET_EXHAUSTED);
+    static_assert(static_cast<uint32_t>(StopReason::e_fault) ==
+                  MIPS_STOP_FAULT);
+    static_assert(static_cast<uint32_t>(StopReason::e_infinite_loop) ==
+                  MIPS_STOP_INFINITE_LOOP);
+} // namespace
+
+extern "C" {
+uint32_t mips_api_version(void) { return MIPS_API_VERSION; }
+
+mips_instance* mips_create(const uint8_t* image, uint32_t image_size,
+                           uint32_t memory_base, uint32_t memory_size,
+                           uint32_t entry) {
+    if (memory_size == 0 || image_size > memory_size ||
+        (!image && image_size != 0))
+        return nullptr;
+
+    auto* emulator = allocate(memory_base, memory_size);
+    if (!emulator) return nullptr;
+
+    if (image_size != 0) std::memcpy(emulator->ram, image, image_size);
+    emulator->instance.set_pc(entry);
+    return emulator;
+}
+
+mips_instance* mips_create_from_elf(const uint8_t* elf, size_t elf_size,
+                                    uint32_t memory_base, uint32_t memory_size,
+                                    mips_status* status) {
+    const auto fail = [status](const mips_status error) -> mips_instance* {
+        if (status) *status = error;
+        return nullptr;
+    };
+
+    if (!elf || memory_size == 0) return fail(MIPS_ERROR_INVALID_ARGUMENT);
+
+    ElfFile file;
+    try {
+        if (file.parse(elf, elf_size).is_error())
+            return fail(MIPS_ERROR_BAD_IMAGE);
+    } catch (const std::bad_alloc&) {
+        return fail(MIPS_ERROR_OUT_OF_MEMORY);
+    }
+
+    auto* emulator = allocate(memory_base, memory_size);
+    if (!emulator) return fail(MIPS_ERROR_OUT_OF_MEMORY);
+
+    if (!file.load_into(emulator->instance.get_memory())) {
+        delete emulator;
+        return fail(MIPS_ERROR_OUT_OF_BOUNDS);
+    }
+
+    emulator->instance.set_pc(file.get_entry());
+    if (status) *status = MIPS_OK;
+    return emulator;
+}
+
+void mips_destroy(mips_instance* emulator) { delete emulator; }
+
+mips_status mips_set_loop_detection(mips_instance* emulator,
+                                    uint32_t interval) {
+    if (!emulator) return MIPS_ERROR_INVALID_ARGUMENT;
+
+    emulator->instance.set_loop_detector(nullptr);
+    emulator->loop_detector.reset();
+    if (interval == 0) return MIPS_OK;
+
+    try {
+        emulator->loop_detector = std::make_unique<LoopDetector>(interval);
+    } catch (const std::bad_alloc&) {
+        return MIPS_ERROR_OUT_OF_MEMORY;
+    }
+    emulator->instance.set_loop_detector(emulator->loop_detector.get());
+    return MIPS_OK;
+}
+
+mips_status mips_run(mips_instance* emulator, uint64_t budget,
+                     mips_run_result* result) {
+    if (!emulator || !result) return MIPS_ERROR_INVALID_ARGUMENT;
+
+    *result = run(*emulator, budget);
+    return MIPS_OK;
+}
+
+mips_status mips_run_batch(mips_instance* const* emulators, size_t count,
+                           uint64_t budget, mips_run_result* results,
+                           uint32_t threads) {
+    if ((!emulators || !results) && count != 0)
+        return MIPS_ERROR_INVALID_ARGUMENT;
+    for (size_t i = 0; i < count; ++i) {
+        if (!emulators[i]) return MIPS_ERROR_INVALID_ARGUMENT;
+    }
+
+    std::atomic<size_t> next{0};
+    const auto worker = [&]() {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+            results[i] = run(*emulators[i], budget);
+    };
+
+    size_t thread_count =
+        threads != 0 ? threads : std::thread::hardware_concurrency();
+    thread_count = std::max<size_t>(1, std::min(thread_count, count));
+
+    // Falls back to fewer threads if they can't be started
+    std::vector<std::thread> pool;
+    try {
+        for (size_t i = 1; i < thread_count; ++i)
+            pool.emplace_back(worker);
+    } catch (const std::system_error&) {
+    } catch (const std::bad_alloc&) {
+    }
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+
+    return MIPS_OK;
+}
+
+mips_status mips_read_memory(mips_instance* emulator, uint32_t address,
+                             void* out, uint32_t size) {
+    if (!emulator || (!out && size != 0)) return MIPS_ERROR_INVALID_ARGUMENT;
+
+    const uint8_t* source = emulator->host(address, size);
+    if (!source) return MIPS_ERROR_OUT_OF_BOUNDS;
+
+    if (size != 0) std::memcpy(out, source, size);
+    return MIPS_OK;
+}
+
+mips_status mips_write_memory(mips_instance* emulator, uint32_t address,
+                              const void* data, uint32_t size) {
+    if (!emulator || (!data && size != 0)) return MIPS_ERROR_INVALID_ARGUMENT;
+
+    uint8_t* target = emulator->host(address, size);
+    if (!target) return MIPS_ERROR_OUT_OF_BOUNDS;
+
+    if (size != 0) std::memcpy(target, data, size);
+    state_changed(*emulator);
+    return MIPS_OK;
+}
+
+mips_status mips_read_registers(const mips_instance* emulator,
+                                uint32_t* registers) {
+    if (!emulator || !registers) return MIPS_ERROR_INVALID_ARGUMENT;
+
+    const RegisterFile& reg_file = emulator->instance.get_register_file();
+    for (uint8_t i = 0; i < RegisterFile::REGISTER_COUNT; ++i)
+        registers[i] = reg_file.get(i).u;
+    registers[MIPS_REG_PC] = reg_file.get_pc();
+    registers[MIPS_REG_HI] = reg_file.get_hi();
+    registers[MIPS_REG_LO] = reg_file.get_lo();
+    return MIPS_OK;
+}
+
+mips_status mips_write_registers(mips_instance* emulator,
+                                 const uint32_t* registers) {
+    if (!emulator || !registers) return MIPS_ERROR_INVALID_ARGUMENT;
+
+    RegisterFile reg_file = emulator->instance.clone_register_file();
+    for (uint8_t i = 0; i < RegisterFile::REGISTER_COUNT; ++i)
+        reg_file.set_unsigned(i, registers[i]);
+    reg_file.set_pc(registers[MIPS_REG_PC]);
+    reg_file.set_hi(registers[MIPS_REG_HI]);
+    reg_file.set_lo(registers[MIPS_REG_LO]);
+    emulator->instance.set_register_file(reg_file);
+    state_changed(*emulator);
+    return MIPS_OK;
+}
+
+mips_snapshot* mips_snapshot_create(const mips_instance* emulator) {
+    if (!emulator) return nullptr;
+
+    try {
+        auto snapshot = std::make_unique<mips_snapshot>();
+        snapshot->memory_base = emulator->memory_base;
+        snapshot->registers = emulator->instance.get_register_file();
+        snapshot->memory.assign(emulator->ram,
+                                emulator->ram + emulator->memory_size);
+        return snapshot.release();
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+mips_status mips_snapshot_restore(mips_instance* emulator,
+                                  const mips_snapshot* snapshot) {
+    if (!emulator || !snapshot) return MIPS_ERROR_INVALID_ARGUMENT;
+    if (snapshot->memory_base != emulator->memory_base ||
+        snapshot->memory.size() != emulator->memory_size)
+        return MIPS_ERROR_OUT_OF_BOUNDS;
+
+    emulator->instance.set_register_file(snapshot->registers);
+    std::memcpy(emulator->ram, snapshot->memory.data(),
+                snapshot->memory.size());
+    state_changed(*emulator);
+    return MIPS_OK;
+}
+
+void mips_snapshot_destroy(mips_snapshot* snapshot) { delete snapshot; }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <unordered_map>
+
+namespace mips_emulator {
+    // How often each instruction ran in an interpreter run, see
+    // Emulator::set_block_profile. Recompiler::set_block_profile looks up
+    // the start of every basic block in it.
+    //
+    // The file has a line per executed instruction, its address in hex and
+    // how often it ran in decimal, e.g. "400120 4096". Lines for the same
+    // address add up.
+    class BlockProfile {
+    public:
+        void record(const uint32_t pc) { ++counts[pc]; }
+
+        void clear() noexcept { counts.clear(); }
+
+        // Sorted by address
+        std::map<uint32_t, uint64_t> get_counts() const {
+            return {counts.begin(), counts.end()};
+        }
+
+        // Returns false if the stream fails
+        bool write(std::ostream& out) const {
+            for (const auto& [address, count] : get_counts())
+                out << std::hex << address << ' ' << std::dec << count << '\n';
+            return static_cast<bool>(out);
+        }
+
+        // Adds the counts of a file written by write. Returns false if
+        // anything but whitespace is left unparsed.
+        bool read(std::istream& in) {
+            uint32_t address;
+            uint64_t count;
+            while (in >> std::hex >> address >> std::dec >> count)
+                counts[address] += count;
+            return in.eof();
+        }
+
+    private:
+        std::unordered_map<uint32_t, uint64_t> counts;
+    };
+} // namespace mips_emulator
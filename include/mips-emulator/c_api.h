@@ -0,0 +1,118 @@
+#ifndef MIPS_EMULATOR_C_API_H
+#define MIPS_EMULATOR_C_API_H
+
+/*
+ * C interface to the emulator for FFI users, built as the mips_emulator_c
+ * library. Every call is meant to do a lot of work (run many instructions,
+ * copy whole buffers, run many instances), since a crossing from Python or
+ * Go costs far more than an emulated instruction.
+ *
+ * Instances run MIPS32r6 code on a single contiguous block of RAM. An
+ * instance must only be used by one thread at a time.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIPS_API_VERSION 1
+
+typedef struct mips_instance mips_instance;
+typedef struct mips_snapshot mips_snapshot;
+
+typedef enum mips_status {
+    MIPS_OK = 0,
+    MIPS_ERROR_INVALID_ARGUMENT = 1,
+    MIPS_ERROR_OUT_OF_BOUNDS = 2,
+    MIPS_ERROR_BAD_IMAGE = 3,
+    MIPS_ERROR_OUT_OF_MEMORY = 4,
+} mips_status;
+
+typedef enum mips_stop_reason {
+    MIPS_STOP_BUDGET_EXHAUSTED = 0,
+    MIPS_STOP_FAULT = 1,
+    MIPS_STOP_INFINITE_LOOP = 2,
+} mips_stop_reason;
+
+typedef struct mips_run_result {
+    uint32_t reason; /* mips_stop_reason */
+    uint32_t pc;
+    uint64_t steps;  /* Instructions executed */
+} mips_run_result;
+
+/* Layout of the arrays used by mips_read_registers/mips_write_registers */
+#define MIPS_REG_PC 32
+#define MIPS_REG_HI 33
+#define MIPS_REG_LO 34
+#define MIPS_REGISTER_ARRAY_SIZE 35
+
+uint32_t mips_api_version(void);
+
+/*
+ * Creates an instance with memory_size bytes of RAM at memory_base, with
+ * image copied to the start of it and the PC at entry. Returns NULL on
+ * invalid arguments or allocation failure.
+ */
+mips_instance* mips_create(const uint8_t* image, uint32_t image_size,
+                           uint32_t memory_base, uint32_t memory_size,
+                           uint32_t entry);
+
+/*
+ * Same as mips_create, but loads the segments of a MIPS ELF executable
+ * and starts at its entry point.
+ */
+mips_instance* mips_create_from_elf(const uint8_t* elf, size_t elf_size,
+                                    uint32_t memory_base, uint32_t memory_size,
+                                    mips_status* status);
+
+void mips_destroy(mips_instance* emulator);
+
+/*
+ * Stops the run when the program repeats its state every interval
+ * backward branches, 0 disables detection (the default). Detection carries
+ * over from one run to the next and starts over when this is called or the
+ * host writes memory or registers or restores a snapshot.
+ */
+mips_status mips_set_loop_detection(mips_instance* emulator,
+                                    uint32_t interval);
+
+mips_status mips_run(mips_instance* emulator, uint64_t budget,
+                     mips_run_result* result);
+
+/*
+ * Runs count instances with the same budget on up to threads threads
+ * (0 uses every hardware thread). results must hold count entries. The
+ * instances must be distinct.
+ */
+mips_status mips_run_batch(mips_instance* const* emulators, size_t count,
+                           uint64_t budget, mips_run_result* results,
+                           uint32_t threads);
+
+mips_status mips_read_memory(mips_instance* emulator, uint32_t address,
+                             void* out, uint32_t size);
+mips_status mips_write_memory(mips_instance* emulator, uint32_t address,
+                              const void* data, uint32_t size);
+
+/* Arrays of MIPS_REGISTER_ARRAY_SIZE words */
+mips_status mips_read_registers(const mips_instance* emulator,
+                                uint32_t* registers);
+mips_status mips_write_registers(mips_instance* emulator,
+                                 const uint32_t* registers);
+
+/*
+ * Copies the registers and memory of an instance. A snapshot can be
+ * restored into any instance with the same memory layout.
+ */
+mips_snapshot* mips_snapshot_create(const mips_instance* emulator);
+mips_status mips_snapshot_restore(mips_instance* emulator,
+                                  const mips_snapshot* snapshot);
+void mips_snapshot_destroy(mips_snapshot* snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIPS_EMULATOR_C_API_H */
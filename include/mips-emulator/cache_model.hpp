@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mips_emulator {
+    // Set associative cache with LRU replacement that only counts hits and
+    // misses, for studying cache and TLB configurations offline. A TLB is a
+    // cache whose line is a page: 64 entries of 4 KiB are a 256 KiB cache
+    // with 4 KiB lines.
+    class CacheModel {
+    public:
+        // Which accesses the cache sees
+        enum class Stream : uint8_t {
+            e_instruction, // Fetches
+            e_data,        // Loads and stores
+            e_unified,     // Everything
+        };
+
+        struct Config {
+            std::string name;
+            Stream stream = Stream::e_data;
+            uint32_t size = 32 * 1024; // Bytes
+            uint32_t ways = 8;         // 0 is fully associative
+            uint32_t line = 64;        // Bytes
+        };
+
+        struct Stats {
+            uint64_t accesses = 0;
+            uint64_t misses = 0;
+        };
+
+        // Size and line must be powers of two and the cache must have a
+        // power of two number of sets, see is_valid
+        explicit CacheModel(const Config& config)
+            : config(config), line_bits(log2(config.line)),
+              ways(config.ways != 0 ? config.ways : config.size / config.line),
+              set_mask(config.size / config.line / ways - 1),
+              tags(config.size / config.line), last_use(tags.size()) {}
+
+        static bool is_valid(const Config& config) noexcept {
+            if (!is_power_of_two(config.size) ||
+                !is_power_of_two(config.line) || config.line > config.size)
+                return false;
+
+            const uint32_t lines = config.size / config.line;
+            if (config.ways == 0) return true;
+            return config.ways <= lines && lines % config.ways == 0 &&
+                   is_power_of_two(lines / config.ways);
+        }
+
+        const Config& get_config() const noexcept { return config; }
+        const Stats& get_stats() const noexcept { return stats; }
+
+        // Returns true if every line the access touches was cached
+        bool access(const uint32_t address, const uint32_t size) noexcept {
+            const uint32_t first = address >> line_bits;
+            const uint32_t last = (address + size - 1) >> line_bits;
+
+            bool hit = access_line(first);
+            if (last != first) hit &= access_line(last);
+
+            ++stats.accesses;
+            if (!hit) ++stats.misses;
+            return hit;
+        }
+
+    private:
+        static bool is_power_of_two(const uint32_t value) noexcept {
+            return value != 0 && (value & (value - 1)) == 0;
+        }
+
+        static uint32_t log2(uint32_t value) noexcept {
+            uint32_t bits = 0;
+            while (value >>= 1)
+                ++bits;
+            return bits;
+        }
+
+        // Tags are the line number plus one, zero is an empty way
+        bool access_line(const uint32_t line) noexcept {
+            const uint64_t tag = uint64_t(line) + 1;
+            const std::size_t base = std::size_t(line & set_mask) * ways;
+            ++clock;
+
+            std::size_t victim = base;
+            for (std::size_t way = base; way < base + ways; ++way) {
+                if (tags[way] == tag) {
+                    last_use[way] = clock;
+                    return true;
+                }
+                if (last_use[way] < last_use[victim]) victim = way;
+            }
+
+            tags[victim] = tag;
+            last_use[victim] = clock;
+            return false;
+        }
+
+        Config config;
+        uint32_t line_bits;
+        uint32_t ways;
+        uint32_t set_mask;
+
+        // Per way, sets are consecutive runs of ways. Empty ways were never
+        // used, so they're picked as victims first.
+        std::vector<uint64_t> tags;
+        std::vector<uint64_t> last_use;
+        uint64_t clock = 0;
+
+        Stats stats;
+    };
+} // namespace mips_emulator
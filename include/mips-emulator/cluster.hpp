@@ -0,0 +1,164 @@
+#pragma once
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/nic.hpp"
+#include "mips-emulator/run_result.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mips_emulator {
+    // Runs boards connected by NICs on a pool of host threads.
+    //
+    // Time advances in quanta of a fixed number of instructions per board.
+    // Each thread runs its share of the boards for a quantum, then all
+    // threads meet at a barrier. Packets sent in a quantum are received in
+    // the next, so the quantum is the network latency in instructions and
+    // the result doesn't depend on the number of threads.
+    //
+    // The cluster doesn't own the boards or NICs.
+    template <typename Memory, Isa isa = Isa::e_mips32r6>
+    class Cluster {
+    public:
+        using Board = Emulator<Memory, isa>;
+
+        struct Options {
+            uint64_t quantum = 10000; // Instructions
+            unsigned threads = 0;     // 0 uses every hardware thread
+        };
+
+        Cluster() : Cluster(Options{}) {}
+        explicit Cluster(const Options& options)
+            : quantum(std::max<uint64_t>(options.quantum, 1)),
+              threads(options.threads != 0
+                          ? options.threads
+                          : std::max(1U, std::thread::hardware_concurrency())) {
+        }
+
+        // Boards without metrics get counters of their own for the life of
+        // the cluster, so boards on different threads never write to the
+        // same counters
+        void add_board(Board& board, Nic& nic) {
+            if (!board.get_metrics()) {
+                board.set_metrics(&counters.emplace_back());
+                owned.push_back(&board);
+            }
+            nodes.push_back(
+                {&board, &nic, {StopReason::e_budget_exhausted, 0}});
+        }
+
+        ~Cluster() {
+            for (Board* board : owned)
+                board->set_metrics(nullptr);
+        }
+
+        // Runs every board until it stops or has executed budget
+        // instructions, returns the results in the order the boards were
+        // added
+        std::vector<RunResult> run(const uint64_t budget) {
+            for (Node& node : nodes)
+                node.result = {StopReason::e_budget_exhausted, 0};
+            stopped.assign(nodes.size(), budget == 0);
+            running = !nodes.empty() && budget != 0;
+
+            const unsigned thread_count = std::max<unsigned>(
+                1, std::min<std::size_t>(threads, nodes.size()));
+            arrived = 0;
+
+            std::vector<std::thread> pool;
+            for (unsigned i = 1; i < thread_count; ++i) {
+                pool.emplace_back(
+                    [&, i]() { worker(i, thread_count, budget); });
+            }
+            worker(0, thread_count, budget);
+            for (auto& thread : pool)
+                thread.join();
+
+            std::vector<RunResult> results;
+            for (const Node& node : nodes)
+                results.push_back(node.result);
+            return results;
+        }
+
+        // Quanta run so far, over all calls to run
+        uint64_t get_quanta() const noexcept { return quanta; }
+
+    private:
+        struct Node {
+            Board* board;
+            Nic* nic;
+            RunResult result;
+        };
+
+        // Boards are assigned round robin, a thread only touches its own
+        void worker(const unsigned index, const unsigned thread_count,
+                    const uint64_t budget) {
+            uint64_t current = quanta;
+            while (wait_for_quantum(current)) {
+                for (std::size_t i = index; i < nodes.size();
+                     i += thread_count) {
+                    if (stopped[i]) continue;
+                    run_quantum(nodes[i], current, budget);
+                    stopped[i] = nodes[i].result.reason !=
+                                     StopReason::e_budget_exhausted ||
+                                 nodes[i].result.steps == budget;
+                }
+
+                finish_quantum(thread_count);
+                ++current;
+            }
+        }
+
+        void run_quantum(Node& node, const uint64_t current,
+                         const uint64_t budget) {
+            node.nic->deliver(current);
+
+            const uint64_t slice =
+                std::min(quantum, budget - node.result.steps);
+            const RunResult result = node.board->run(slice);
+            node.result.reason = result.reason;
+            node.result.steps += result.steps;
+        }
+
+        // Returns false once every board has stopped
+        bool wait_for_quantum(const uint64_t current) {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return quanta == current; });
+            return running;
+        }
+
+        // The last thread to arrive starts the next quantum
+        void finish_quantum(const unsigned thread_count) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++arrived < thread_count) return;
+
+            arrived = 0;
+            running = std::find(stopped.begin(), stopped.end(), false) !=
+                      stopped.end();
+            ++quanta;
+            condition.notify_all();
+        }
+
+        uint64_t quantum;
+        unsigned threads;
+        std::vector<Node> nodes;
+        std::deque<MetricCounters> counters; // Never moves its elements
+        std::vector<Board*> owned;            // Boards using counters
+
+        // Written by the owning thread during a quantum, read by the last
+        // thread at the barrier
+        std::vector<uint8_t> stopped;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        unsigned arrived = 0;
+        uint64_t quanta = 0;
+        bool running = false;
+    };
+} // namespace mips_emulator
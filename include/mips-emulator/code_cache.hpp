@@ -0,0 +1,384 @@
+#pragma once
+#include "mips-emulator/perf_map.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+namespace mips_emulator {
+    // Executable memory for host code generated from guest code, shared by
+    // code generators.
+    //
+    // Code lives in fixed size mmap'd arenas that are never writable and
+    // executable at the same time (W^X): an arena is made writable while a
+    // block is copied in or a link is patched, and executable again before
+    // the call returns. At most capacity bytes are mapped. When the current
+    // arena is full the next one is reused, flushing the oldest generation
+    // of blocks at once, so the footprint stays bounded however much guest
+    // code runs.
+    //
+    // Generated code can jump straight to another block through a link
+    // slot, a pointer in its own code. Linking records the slot on the
+    // target, and evicting the target writes the slot's unlinked value
+    // (e.g. the address of an exit to the dispatcher) back before the
+    // target's memory is reused.
+    //
+    // NOTE: Only Linux is supported, on other platforms add fails. Patching
+    // changes the protection of a whole arena, so no thread may execute
+    // cached code while blocks are added, linked or evicted. If the
+    // protection of an arena can't be changed, it may be left without
+    // execute permission, so every block in it is evicted and add or link
+    // fails.
+    class CodeCache {
+    public:
+        struct Options {
+            std::size_t arena_size = 1 << 20;
+            std::size_t capacity = 16 << 20; // Rounded down to arenas
+        };
+
+        struct Block {
+            uint32_t guest_start;
+            uint32_t guest_end;
+            const void* code;
+            std::size_t size;
+        };
+
+        struct Stats {
+            std::size_t blocks = 0;
+            std::size_t mapped_bytes = 0;
+            uint64_t evictions = 0;
+            uint64_t flushes = 0; // Arenas reused
+        };
+
+        // Called with a block before its code is reused
+        using EvictionHandler = std::function<void(const Block&)>;
+
+        CodeCache() : CodeCache(Options{}) {}
+
+        explicit CodeCache(const Options& options)
+            : arena_size(round_to_pages(options.arena_size)),
+              max_arenas(std::max<std::size_t>(
+                  1, options.capacity / round_to_pages(options.arena_size))) {}
+
+        ~CodeCache() {
+#if defined(__linux__)
+            for (const Arena& arena : arenas)
+                munmap(arena.memory, arena_size);
+#endif
+        }
+
+        CodeCache(const CodeCache&) = delete;
+        CodeCache& operator=(const CodeCache&) = delete;
+
+        // Every added block is registered with the map, which must outlive
+        // the cache or be reset with nullptr
+        void set_perf_map(PerfMap* map) noexcept { perf_map = map; }
+
+        void set_eviction_handler(EvictionHandler handler) {
+            on_evict = std::move(handler);
+        }
+
+        // Reserves size bytes and lets emit write the code: emit(write, code)
+        // gets the writable address and the address the code will run at.
+        // A block already cached for guest_start is evicted first. Returns
+        // nullptr if the block is larger than an arena or the arena's
+        // protection couldn't be changed, which flushes the arena.
+        template <typename Emit>
+        const Block* add(const uint32_t guest_start, const uint32_t guest_end,
+                         const std::size_t size, Emit&& emit,
+                         const std::string& symbol = {}) {
+            if (size == 0 || size > arena_size) return nullptr;
+
+            evict(guest_start);
+            Arena* arena = reserve(size);
+            if (!arena) return nullptr;
+
+            uint8_t* code = arena->memory + arena->used;
+            if (!set_writable(*arena, true)) {
+                flush(*arena);
+                return nullptr;
+            }
+            emit(code, static_cast<const void*>(code));
+            if (!set_writable(*arena, false)) {
+                flush(*arena);
+                return nullptr;
+            }
+            arena->used += size;
+#if defined(__linux__)
+            __builtin___clear_cache(reinterpret_cast<char*>(code),
+                                    reinterpret_cast<char*>(code + size));
+#endif
+
+            Entry& entry = blocks[guest_start];
+            entry.block = {guest_start, guest_end, code, size};
+            entry.arena = static_cast<std::size_t>(arena - arenas.data());
+            arena->blocks.push_back(guest_start);
+            max_guest_size = std::max(max_guest_size, guest_end - guest_start);
+
+            if (perf_map)
+                perf_map->register_code(code, size, guest_start, guest_end,
+                                        symbol);
+            return &entry.block;
+        }
+
+        // Copies finished position independent code
+        const Block* add(const uint32_t guest_start, const uint32_t guest_end,
+                         const void* code, const std::size_t size,
+                         const std::string& symbol = {}) {
+            return add(
+                guest_start, guest_end, size,
+                [code, size](uint8_t* write, const void*) {
+                    std::memcpy(write, code, size);
+                },
+                symbol);
+        }
+
+        const Block* find(const uint32_t guest_start) const {
+            const auto entry = blocks.find(guest_start);
+            return entry == blocks.end() ? nullptr : &entry->second.block;
+        }
+
+        // Makes the pointer sized slot in from's code jump to to's code until
+        // to is evicted, when unlinked is written back. Returns false if
+        // either block isn't cached, the slot isn't in from's code or it
+        // couldn't be written, which flushes from's arena.
+        bool link(const uint32_t from, void* slot, const uint32_t to,
+                  const uintptr_t unlinked) {
+            const auto source = blocks.find(from);
+            const auto target = blocks.find(to);
+            if (source == blocks.end() || target == blocks.end()) return false;
+
+            const Block& block = source->second.block;
+            const auto* begin = static_cast<const uint8_t*>(block.code);
+            const auto* at = static_cast<const uint8_t*>(slot);
+            if (at < begin || at + sizeof(uintptr_t) > begin + block.size)
+                return false;
+
+            if (!write_slot(source->second.arena, slot,
+                            reinterpret_cast<uintptr_t>(
+                                target->second.block.code))) {
+                flush(arenas[source->second.arena]);
+                return false;
+            }
+
+            // Relinking a slot replaces its old link
+            for (const Link& old : source->second.outgoing) {
+                if (old.slot == slot)
+                    erase_link(blocks.at(old.other).incoming, slot);
+            }
+            erase_link(source->second.outgoing, slot);
+
+            target->second.incoming.push_back({slot, from, unlinked});
+            source->second.outgoing.push_back({slot, to, unlinked});
+            return true;
+        }
+
+        // Evicts the block starting at guest_start, returns false if there
+        // is none. Its memory is reused when its arena is flushed.
+        bool evict(const uint32_t guest_start) {
+            const auto entry = blocks.find(guest_start);
+            if (entry == blocks.end()) return false;
+
+            remove(entry);
+            return true;
+        }
+
+        // Evicts every block whose guest range overlaps the given range,
+        // e.g. after the guest code was overwritten
+        std::size_t invalidate(const uint32_t address, const uint32_t size) {
+            const uint64_t end = uint64_t(address) + size;
+            const uint32_t first =
+                address > max_guest_size ? address - max_guest_size : 0;
+
+            std::size_t evicted = 0;
+            auto entry = blocks.lower_bound(first);
+            while (entry != blocks.end() && entry->first < end) {
+                const Block& block = entry->second.block;
+                if (block.guest_end > address) {
+                    entry = remove(entry);
+                    ++evicted;
+                }
+                else {
+                    ++entry;
+                }
+            }
+            return evicted;
+        }
+
+        // Evicts every block, like invalidate over the whole address space
+        std::size_t invalidate_all() {
+            const std::size_t evicted = blocks.size();
+            clear();
+            return evicted;
+        }
+
+        // Evicts everything
+        void clear() {
+            while (!blocks.empty()) remove(blocks.begin());
+            for (Arena& arena : arenas) {
+                arena.blocks.clear();
+                arena.used = 0;
+            }
+        }
+
+        Stats get_stats() const noexcept {
+            Stats copy = stats;
+            copy.blocks = blocks.size();
+            copy.mapped_bytes = arenas.size() * arena_size;
+            return copy;
+        }
+
+        std::size_t get_arena_size() const noexcept { return arena_size; }
+
+    private:
+        struct Link {
+            void* slot;
+            uint32_t other; // Guest start of the block at the other end
+            uintptr_t unlinked;
+        };
+
+        struct Entry {
+            Block block;
+            std::size_t arena;
+            std::vector<Link> incoming;
+            std::vector<Link> outgoing;
+        };
+
+        struct Arena {
+            uint8_t* memory;
+            std::size_t used;
+            std::vector<uint32_t> blocks; // Guest starts, maybe evicted
+        };
+
+        using Entries = std::map<uint32_t, Entry>;
+
+        static std::size_t round_to_pages(const std::size_t size) {
+#if defined(__linux__)
+            const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+            const std::size_t page = 4096;
+#endif
+            return std::max(page, (size + page - 1) / page * page);
+        }
+
+        // An arena with size free bytes, flushing the oldest one if all
+        // arenas are in use
+        Arena* reserve(const std::size_t size) {
+            if (!arenas.empty() && arena_size - arenas[current].used >= size)
+                return &arenas[current];
+
+            if (arenas.size() < max_arenas) {
+#if defined(__linux__)
+                void* memory = mmap(nullptr, arena_size, PROT_READ | PROT_EXEC,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (memory == MAP_FAILED) return nullptr;
+
+                arenas.push_back({static_cast<uint8_t*>(memory), 0, {}});
+                current = arenas.size() - 1;
+                return &arenas[current];
+#else
+                return nullptr;
+#endif
+            }
+
+            current = (current + 1) % arenas.size();
+            flush(arenas[current]);
+            return &arenas[current];
+        }
+
+        void flush(Arena& arena) {
+            const auto index = static_cast<std::size_t>(&arena - arenas.data());
+
+            // Removing a block can flush other arenas, or this one again if
+            // it can't be made executable, so take the list first
+            std::vector<uint32_t> starts;
+            starts.swap(arena.blocks);
+            arena.used = 0;
+            ++stats.flushes;
+
+            for (const uint32_t guest_start : starts) {
+                // The start may have been evicted and added elsewhere since
+                const auto entry = blocks.find(guest_start);
+                if (entry != blocks.end() && entry->second.arena == index)
+                    remove(entry);
+            }
+        }
+
+        Entries::iterator remove(const Entries::iterator entry) {
+            const uint32_t guest_start = entry->first;
+            Entry& removed = entry->second;
+
+            // Jumps into the block go back to their exits. If a jump can't
+            // be restored, the arena holding it is flushed once the block
+            // is gone: the jump would enter reused memory and the arena may
+            // have been left without execute permission.
+            std::vector<std::size_t> stale;
+            for (const Link& link : removed.incoming) {
+                Entry& source = blocks.at(link.other);
+                if (!write_slot(source.arena, link.slot, link.unlinked))
+                    stale.push_back(source.arena);
+                erase_link(source.outgoing, link.slot);
+            }
+            for (const Link& link : removed.outgoing)
+                erase_link(blocks.at(link.other).incoming, link.slot);
+
+            if (on_evict) on_evict(removed.block);
+            ++stats.evictions;
+            const auto next = blocks.erase(entry);
+            if (stale.empty()) return next;
+
+            for (const std::size_t arena : stale) {
+                if (!arenas[arena].blocks.empty()) flush(arenas[arena]);
+            }
+            return blocks.upper_bound(guest_start);
+        }
+
+        static void erase_link(std::vector<Link>& links, const void* slot) {
+            links.erase(std::remove_if(links.begin(), links.end(),
+                                       [slot](const Link& link) {
+                                           return link.slot == slot;
+                                       }),
+                        links.end());
+        }
+
+        [[nodiscard]] bool write_slot(const std::size_t arena, void* slot,
+                                      const uintptr_t value) {
+            if (!set_writable(arenas[arena], true)) return false;
+            std::memcpy(slot, &value, sizeof(value));
+            return set_writable(arenas[arena], false);
+        }
+
+        [[nodiscard]] bool set_writable(Arena& arena, const bool writable) {
+#if defined(__linux__)
+            return mprotect(arena.memory, arena_size,
+                            writable ? PROT_READ | PROT_WRITE
+                                     : PROT_READ | PROT_EXEC) == 0;
+#else
+            (void)arena;
+            (void)writable;
+            return false;
+#endif
+        }
+
+        std::size_t arena_size;
+        std::size_t max_arenas;
+        std::vector<Arena> arenas;
+        std::size_t current = 0;
+
+        Entries blocks;
+        uint32_t max_guest_size = 0;
+
+        PerfMap* perf_map = nullptr;
+        EvictionHandler on_evict;
+        Stats stats;
+    };
+} // namespace mips_emulator
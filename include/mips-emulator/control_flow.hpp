@@ -0,0 +1,145 @@
+#pragma once
+#include "mips-emulator/instruction.hpp"
+
+#include <cstdint>
+
+namespace mips_emulator {
+    // Static description of how an instruction affects the PC, used by
+    // anything that needs to find basic blocks without executing code.
+    // Targets are computed the same way as in the Executor.
+    struct ControlFlow {
+        enum class Kind : uint8_t {
+            e_sequential, // Continues at address + 4
+            e_direct,     // Transfers to a known target
+            e_indirect,   // Transfers to a register value
+            e_invalid,    // Can't be decoded
+        };
+
+        Kind kind = Kind::e_sequential;
+        bool conditional = false;
+        bool link = false;
+        bool delayed = false; // Has a delay slot
+        uint32_t target = 0;
+
+        bool is_block_end() const noexcept {
+            return kind != Kind::e_sequential;
+        }
+
+        static ControlFlow analyze(const Instruction instr,
+                                   const uint32_t address) {
+            using Type = Instruction::Type;
+            using Func = Instruction::Func;
+            using IOp = Instruction::ITypeOpcode;
+            using JOp = Instruction::JTypeOpcode;
+            using RegimmOp = Instruction::RegimmITypeOp;
+
+            // The Executor computes targets after the PC has been updated
+            const uint32_t pc = address + 4;
+            const uint32_t branch_target =
+                pc + (sign_ext(instr.itype.imm, 16) << 2);
+
+            const auto type = instr.get_type();
+            if (type.is_error()) return {Kind::e_invalid};
+
+            switch (type.get_value()) {
+                case Type::e_rtype: {
+                    switch (static_cast<Func>(instr.rtype.func)) {
+                        case Func::e_jr:
+                            return {Kind::e_indirect, false, false, true};
+                        case Func::e_jalr:
+                            return {Kind::e_indirect, false, true, true};
+                        default: return {};
+                    }
+                }
+
+                case Type::e_jtype: {
+                    const uint32_t address26 = instr.jtype.address;
+                    const uint32_t jta = (address26 << 2) | (pc & 0xf0000000);
+                    const uint32_t offset = pc + (sign_ext(address26, 26) << 2);
+
+                    switch (static_cast<JOp>(instr.jtype.op)) {
+                        case JOp::e_j:
+                            return {Kind::e_direct, false, false, true, jta};
+                        case JOp::e_jal:
+                            return {Kind::e_direct, false, true, true, jta};
+                        case JOp::e_bc:
+                            return {Kind::e_direct, false, false, false,
+                                    offset};
+                        case JOp::e_balc:
+                            return {Kind::e_direct, false, true, false, offset};
+                    }
+                    return {Kind::e_invalid};
+                }
+
+                case Type::e_regimm_itype: {
+                    switch (static_cast<RegimmOp>(instr.regimm_itype.op)) {
+                        case RegimmOp::e_bgez:
+                        case RegimmOp::e_bltz:
+                            return {Kind::e_direct, true, false, true,
+                                    branch_target};
+                        default: return {};
+                    }
+                }
+
+                case Type::e_itype:
+                case Type::e_longimm_itype: {
+                    const bool rs_zero = instr.itype.rs == 0;
+                    const bool rt_zero = instr.itype.rt == 0;
+
+                    switch (static_cast<IOp>(instr.itype.op)) {
+                        case IOp::e_beq:
+                        case IOp::e_bne:
+                            return {Kind::e_direct, true, false, true,
+                                    branch_target};
+
+                        // BLEZ/BGTZ when rt is zero, compact branches
+                        // otherwise
+                        case IOp::e_pop06:
+                        case IOp::e_pop07:
+                            if (rt_zero) {
+                                return {Kind::e_direct, true, false, true,
+                                        branch_target};
+                            }
+                            return {Kind::e_direct, true,
+                                    rs_zero ||
+                                        instr.itype.rs == instr.itype.rt,
+                                    false, branch_target};
+
+                        case IOp::e_pop10:
+                        case IOp::e_pop30:
+                            return {Kind::e_direct, true, rs_zero && !rt_zero,
+                                    false, branch_target};
+
+                        case IOp::e_pop26:
+                        case IOp::e_pop27:
+                            return {Kind::e_direct, true, false, false,
+                                    branch_target};
+
+                        // JIC/JIALC when rs is zero, BEQZC/BNEZC otherwise
+                        case IOp::e_pop66:
+                        case IOp::e_pop76: {
+                            const IOp op = static_cast<IOp>(instr.itype.op);
+                            const bool link = op == IOp::e_pop76;
+                            if (rs_zero)
+                                return {Kind::e_indirect, false, link, false};
+
+                            return {Kind::e_direct, true, false, false,
+                                    pc + (sign_ext(instr.longimm_itype.imm, 21)
+                                          << 2)};
+                        }
+
+                        default: return {};
+                    }
+                }
+
+                default: return {};
+            }
+        }
+
+    private:
+        static uint32_t sign_ext(const uint32_t value, const uint32_t bits) {
+            const uint32_t sign = 1U << (bits - 1);
+            return (value ^ sign) - sign;
+        }
+    };
+} // namespace mips_emulator
@@ -0,0 +1,324 @@
+#pragma once
+#include "mips-emulator/memory.hpp"
+#include "mips-emulator/result.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+namespace mips_emulator {
+    // Coprocessor 0 registers, indexed by the rd field of MFC0/MTC0 (all
+    // with select 0)
+    enum class Cp0Register : uint8_t {
+        e_index = 0,
+        e_random = 1,
+        e_entry_lo0 = 2,
+        e_entry_lo1 = 3,
+        e_context = 4,
+        e_page_mask = 5,
+        e_wired = 6,
+        e_bad_vaddr = 8,
+        e_count = 9,
+        e_entry_hi = 10,
+        e_compare = 11,
+        e_status = 12,
+        e_cause = 13,
+        e_epc = 14,
+    };
+
+    // System control coprocessor: the TLB and its registers.
+    //
+    // Besides the architectural TLB this keeps a software cache of 4 KiB
+    // page translations per ASID, filled by the Mmu on TLB lookups. Writing a
+    // TLB entry only flushes the cached pages of the entry it replaces, and
+    // switching ASID through EntryHi just switches tables.
+    //
+    // Count isn't incremented, it's computed from the cycle count given to
+    // set_cycles and an offset that MTC0 Count adjusts. Compare is only
+    // checked in set_cycles too.
+    class Cp0 {
+    public:
+        static constexpr uint32_t TLB_SIZE = 16;
+        static constexpr uint32_t ASID_COUNT = 256;
+
+        static constexpr uint32_t PAGE_BITS = 12;
+        static constexpr uint32_t PAGE_SIZE = 1U << PAGE_BITS;
+        static constexpr uint32_t CACHE_SIZE = 256;
+
+        struct TlbEntry {
+            uint32_t page_mask = 0;
+            uint32_t vpn2 = 0;
+            uint8_t asid = 0;
+            bool global = false;
+            uint32_t entry_lo[2] = {};
+        };
+
+        // A cached 4 KiB translation. The host pointers are null when the
+        // page can't be accessed directly, e.g. MMIO or a clean page for
+        // stores.
+        struct CachedPage {
+            uint32_t vpn = INVALID_VPN;
+            uint32_t physical_page = 0;
+            uint8_t* read_host = nullptr;
+            uint8_t* write_host = nullptr;
+        };
+
+        Cp0() : current(&get_table(0)) {
+            get(Cp0Register::e_random) = TLB_SIZE - 1;
+        }
+
+        uint32_t read_register(const uint8_t reg, const uint8_t sel) const {
+            if (reg == uint8_t(Cp0Register::e_count) && sel == 0)
+                return get_count();
+            return registers[index(reg, sel)];
+        }
+
+        // Advances Count to the given number of cycles since the emulator
+        // started, and sets Cause.TI if Count has reached Compare since the
+        // last call.
+        void set_cycles(const uint64_t now) {
+            cycles = now;
+
+            const uint32_t count = get_count();
+            const uint32_t compare = get(Cp0Register::e_compare);
+            if (uint32_t(compare - timer_checked - 1) <
+                uint32_t(count - timer_checked))
+                get(Cp0Register::e_cause) |= CAUSE_TI | CAUSE_IP7;
+            timer_checked = count;
+        }
+
+        void write_register(const uint8_t reg, const uint8_t sel,
+                            const uint32_t value) {
+            uint32_t& target = registers[index(reg, sel)];
+            if (sel != 0) {
+                target = value;
+                return;
+            }
+
+            switch (static_cast<Cp0Register>(reg)) {
+                case Cp0Register::e_index:
+                    target =
+                        (target & PROBE_FAILURE) | (value & (TLB_SIZE - 1));
+                    break;
+                case Cp0Register::e_random: break; // Read only
+                case Cp0Register::e_entry_lo0:
+                case Cp0Register::e_entry_lo1:
+                    target = value & ENTRY_LO_MASK;
+                    break;
+                case Cp0Register::e_page_mask:
+                    target = value & PAGE_MASK_MASK;
+                    break;
+                case Cp0Register::e_wired:
+                    target = value & (TLB_SIZE - 1);
+                    get(Cp0Register::e_random) = TLB_SIZE - 1;
+                    break;
+                case Cp0Register::e_bad_vaddr: break; // Read only
+                case Cp0Register::e_count:
+                    count_offset = value - static_cast<uint32_t>(cycles);
+                    timer_checked = value;
+                    break;
+                case Cp0Register::e_compare:
+                    // Acknowledges the timer interrupt
+                    target = value;
+                    timer_checked = get_count();
+                    get(Cp0Register::e_cause) &= ~(CAUSE_TI | CAUSE_IP7);
+                    break;
+                case Cp0Register::e_entry_hi: {
+                    target = value & ENTRY_HI_MASK;
+                    current = &get_table(target & ASID_MASK);
+                    break;
+                }
+                default: target = value; break;
+            }
+        }
+
+        // TLBP
+        void tlb_probe() {
+            const uint32_t entry_hi = get(Cp0Register::e_entry_hi);
+            const uint8_t asid = entry_hi & ASID_MASK;
+
+            for (uint32_t i = 0; i < TLB_SIZE; ++i) {
+                const TlbEntry& entry = tlb[i];
+                const uint32_t mask = ~(entry.page_mask | 0x1FFF);
+                if ((entry_hi & mask) == entry.vpn2 &&
+                    (entry.global || entry.asid == asid)) {
+                    get(Cp0Register::e_index) = i;
+                    return;
+                }
+            }
+            get(Cp0Register::e_index) |= PROBE_FAILURE;
+        }
+
+        // TLBR
+        void tlb_read() {
+            const TlbEntry& entry =
+                tlb[get(Cp0Register::e_index) & (TLB_SIZE - 1)];
+            const uint32_t global = entry.global ? 1 : 0;
+
+            get(Cp0Register::e_page_mask) = entry.page_mask;
+            get(Cp0Register::e_entry_hi) = entry.vpn2 | entry.asid;
+            get(Cp0Register::e_entry_lo0) = entry.entry_lo[0] | global;
+            get(Cp0Register::e_entry_lo1) = entry.entry_lo[1] | global;
+            current = &get_table(entry.asid);
+        }
+
+        // TLBWI
+        void tlb_write_indexed() {
+            write_entry(get(Cp0Register::e_index) & (TLB_SIZE - 1));
+        }
+
+        // TLBWR
+        // NOTE: Random is decremented on every TLBWR instead of every cycle,
+        // which keeps runs deterministic
+        void tlb_write_random() {
+            uint32_t& random = get(Cp0Register::e_random);
+            write_entry(random);
+
+            const uint32_t wired = get(Cp0Register::e_wired);
+            random = random <= wired ? TLB_SIZE - 1 : random - 1;
+        }
+
+        const TlbEntry& get_tlb_entry(const uint32_t i) const {
+            return tlb[i & (TLB_SIZE - 1)];
+        }
+
+        // Cache slot of a virtual address for the current ASID, the caller
+        // checks the tag
+        CachedPage& get_cached_page(const uint32_t address) noexcept {
+            return (*current)[(address >> PAGE_BITS) & (CACHE_SIZE - 1)];
+        }
+
+        // Full TLB search. Records BadVAddr, Context and EntryHi on a miss
+        // like a TLB exception would.
+        Result<uint32_t, MemoryError> translate(const uint32_t address,
+                                                const bool store) {
+            const uint32_t entry_hi = get(Cp0Register::e_entry_hi);
+            const uint8_t asid = entry_hi & ASID_MASK;
+
+            for (const TlbEntry& entry : tlb) {
+                const uint32_t mask = entry.page_mask | 0x1FFF;
+                if ((address & ~mask) != entry.vpn2 ||
+                    !(entry.global || entry.asid == asid))
+                    continue;
+
+                const uint32_t page_size = (mask + 1) >> 1;
+                const uint32_t lo = entry.entry_lo[(address & page_size) != 0];
+
+                if (!(lo & ENTRY_LO_V)) {
+                    record_fault(address);
+                    return MemoryError::tlb_invalid;
+                }
+                if (store && !(lo & ENTRY_LO_D)) {
+                    record_fault(address);
+                    return MemoryError::tlb_modified;
+                }
+
+                const uint32_t frame = (lo >> 6) << PAGE_BITS;
+                return (frame & ~(page_size - 1)) | (address & (page_size - 1));
+            }
+
+            record_fault(address);
+            return MemoryError::tlb_miss;
+        }
+
+        void flush_cache() {
+            for (auto& table : tables) {
+                if (table) table->fill(CachedPage{});
+            }
+        }
+
+        static constexpr uint32_t PROBE_FAILURE = 0x80000000;
+        static constexpr uint32_t ENTRY_LO_G = 1 << 0;
+        static constexpr uint32_t ENTRY_LO_V = 1 << 1;
+        static constexpr uint32_t ENTRY_LO_D = 1 << 2;
+        static constexpr uint32_t ASID_MASK = 0xFF;
+        static constexpr uint32_t CAUSE_TI = 1U << 30;
+        static constexpr uint32_t CAUSE_IP7 = 1U << 15;
+
+    private:
+        using CacheTable = std::array<CachedPage, CACHE_SIZE>;
+
+        static constexpr uint32_t INVALID_VPN = ~0U;
+        static constexpr uint32_t ENTRY_LO_MASK = 0x3FFFFFFF;
+        static constexpr uint32_t PAGE_MASK_MASK = 0x1FFFE000;
+        static constexpr uint32_t ENTRY_HI_MASK = 0xFFFFE0FF;
+        static constexpr uint32_t SELECT_COUNT = 8;
+
+        static constexpr uint32_t index(const uint8_t reg, const uint8_t sel) {
+            return (reg & 31) * SELECT_COUNT + (sel & (SELECT_COUNT - 1));
+        }
+
+        uint32_t& get(const Cp0Register reg) {
+            return registers[index(static_cast<uint8_t>(reg), 0)];
+        }
+
+        uint32_t get_count() const {
+            return static_cast<uint32_t>(cycles) + count_offset;
+        }
+
+        CacheTable& get_table(const uint32_t asid) {
+            auto& table = tables[asid & ASID_MASK];
+            if (!table) {
+                table = std::make_unique<CacheTable>();
+                table->fill(CachedPage{});
+            }
+            return *table;
+        }
+
+        void write_entry(const uint32_t i) {
+            flush_entry(tlb[i]);
+
+            const uint32_t entry_hi = get(Cp0Register::e_entry_hi);
+            const uint32_t lo0 = get(Cp0Register::e_entry_lo0);
+            const uint32_t lo1 = get(Cp0Register::e_entry_lo1);
+
+            TlbEntry& entry = tlb[i];
+            entry.page_mask = get(Cp0Register::e_page_mask);
+            entry.vpn2 = entry_hi & ~(entry.page_mask | 0x1FFF);
+            entry.asid = entry_hi & ASID_MASK;
+            entry.global = (lo0 & lo1 & ENTRY_LO_G) != 0;
+            entry.entry_lo[0] = lo0 & ~ENTRY_LO_G;
+            entry.entry_lo[1] = lo1 & ~ENTRY_LO_G;
+        }
+
+        // Drops the cached pages that were translated through entry
+        void flush_entry(const TlbEntry& entry) {
+            const uint32_t mask = ~(entry.page_mask | 0x1FFF);
+            const auto flush_table = [&](CacheTable& table) {
+                for (CachedPage& page : table) {
+                    if (page.vpn != INVALID_VPN &&
+                        ((page.vpn << PAGE_BITS) & mask) == entry.vpn2)
+                        page = CachedPage{};
+                }
+            };
+
+            if (!entry.global) {
+                if (tables[entry.asid]) flush_table(*tables[entry.asid]);
+                return;
+            }
+
+            for (auto& table : tables) {
+                if (table) flush_table(*table);
+            }
+        }
+
+        void record_fault(const uint32_t address) {
+            get(Cp0Register::e_bad_vaddr) = address;
+
+            uint32_t& entry_hi = get(Cp0Register::e_entry_hi);
+            entry_hi = (address & ~0x1FFFU) | (entry_hi & ASID_MASK);
+
+            uint32_t& context = get(Cp0Register::e_context);
+            context = (context & 0xFF800000) | ((address >> 9) & 0x007FFFF0);
+        }
+
+        std::array<uint32_t, 32 * SELECT_COUNT> registers = {};
+        uint64_t cycles = 0;
+        uint32_t count_offset = 0;
+        uint32_t timer_checked = 0; // Count at the last set_cycles
+        std::array<TlbEntry, TLB_SIZE> tlb = {};
+
+        std::array<std::unique_ptr<CacheTable>, ASID_COUNT> tables;
+        CacheTable* current;
+    };
+} // namespace mips_emulator
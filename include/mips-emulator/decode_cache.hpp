@@ -0,0 +1,243 @@
+#pragma once
+#include "mips-emulator/control_flow.hpp"
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/instruction.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace mips_emulator {
+    // Instructions decoded ahead of time, so execution doesn't decode on
+    // every step (see Emulator::set_decode_cache).
+    //
+    // Ranges are decoded in parallel in fixed size chunks. A first pass over
+    // each chunk only looks at the opcode and func bits to find branch
+    // candidates, which the compiler can vectorize, so ControlFlow only has
+    // to look at the few instructions that can branch. Block starts (range
+    // starts, instructions after block ends and direct branch targets) are
+    // marked as well.
+    //
+    // NOTE: Block information is computed with r6 semantics, see
+    // ControlFlow
+    template <Isa isa = Isa::e_mips32r6>
+    class DecodeCache {
+    public:
+        enum Flags : uint8_t {
+            e_valid = 1 << 0,
+            e_block_start = 1 << 1,
+            e_branch_target = 1 << 2,
+        };
+
+        struct Entry {
+            Instruction instr = Instruction(0U);
+            Instruction::Type type = Instruction::Type::e_rtype;
+            uint8_t flags = 0;
+
+            bool is_valid() const noexcept { return flags & e_valid; }
+        };
+
+        struct Options {
+            // 0 uses std::thread::hardware_concurrency
+            unsigned threads = 0;
+            uint32_t chunk_size = 16 * 1024; // Instructions
+        };
+
+        // Predecodes every executable segment
+        void add_elf(const ElfFile& elf, const Options& options = {}) {
+            for (const auto& segment : elf.get_segments()) {
+                if (!segment.is_executable()) continue;
+                add_range(segment.address, segment.data.data(),
+                          static_cast<uint32_t>(segment.data.size()), options);
+            }
+        }
+
+        // Predecodes size bytes of code at address, which must contain the
+        // same bytes when the code runs
+        void add_range(const uint32_t address, const uint8_t* bytes,
+                       const uint32_t size, const Options& options = {}) {
+            Range range;
+            range.base = address;
+            range.entries.resize(size / 4);
+
+            std::vector<uint32_t> words(range.entries.size());
+            if (!words.empty())
+                std::memcpy(words.data(), bytes, words.size() * 4);
+
+            decode(range, words, options);
+            ranges.push_back(std::move(range));
+        }
+
+        // Returns nullptr for addresses outside of the predecoded ranges and
+        // for invalidated instructions
+        const Entry* find(const uint32_t address) const noexcept {
+            for (const Range& range : ranges) {
+                const uint32_t index = (address - range.base) >> 2;
+                if (index < range.entries.size() && (address & 3) == 0) {
+                    const Entry& entry = range.entries[index];
+                    return entry.is_valid() ? &entry : nullptr;
+                }
+            }
+            return nullptr;
+        }
+
+        // Drops the instructions overlapping [address, address + size),
+        // they are decoded from memory again when executed
+        void invalidate(const uint32_t address, const uint32_t size) noexcept {
+            // 64 bits, ranges and stores can end at the top of the address
+            // space
+            const uint64_t begin = address;
+            const uint64_t end = begin + size;
+            for (Range& range : ranges) {
+                const uint64_t base = range.base;
+                const uint64_t range_end = base + range.entries.size() * 4;
+                if (begin >= range_end || end <= base) continue;
+
+                const auto first = static_cast<std::size_t>(
+                    (std::max(begin, base) - base) >> 2);
+                const auto last = static_cast<std::size_t>(
+                    (std::min(end, range_end) - base + 3) >> 2);
+                for (std::size_t i = first; i < last; ++i)
+                    range.entries[i].flags &= ~e_valid;
+            }
+        }
+
+        // Drops every instruction, no range can name all of the address
+        // space
+        void invalidate_all() noexcept {
+            for (Range& range : ranges) {
+                for (Entry& entry : range.entries)
+                    entry.flags &= ~e_valid;
+            }
+        }
+
+        bool contains(const uint32_t address) const noexcept {
+            for (const Range& range : ranges) {
+                if (address - range.base < range.entries.size() * 4)
+                    return true;
+            }
+            return false;
+        }
+
+    private:
+        struct Range {
+            uint32_t base = 0;
+            std::vector<Entry> entries;
+        };
+
+        // Flags for an entry that may belong to another chunk
+        struct Mark {
+            uint32_t address;
+            uint8_t flags;
+        };
+
+        // Opcodes of instructions that can transfer control (r6): REGIMM,
+        // J, JAL, BEQ, BNE, POP06, POP07, POP10, POP26, POP27, POP30, BC,
+        // POP66, BALC and POP76. JR and JALR are SPECIAL.
+        static constexpr uint64_t BRANCH_OPCODES =
+            (1ULL << 1) | (1ULL << 2) | (1ULL << 3) | (1ULL << 4) |
+            (1ULL << 5) | (1ULL << 6) | (1ULL << 7) | (1ULL << 8) |
+            (1ULL << 22) | (1ULL << 23) | (1ULL << 24) | (1ULL << 50) |
+            (1ULL << 54) | (1ULL << 58) | (1ULL << 62);
+
+        static void decode(Range& range, const std::vector<uint32_t>& words,
+                           const Options& options) {
+            const uint32_t count = static_cast<uint32_t>(words.size());
+            const uint32_t chunk_size =
+                std::max<uint32_t>(options.chunk_size, 1);
+            const uint32_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+            // Direct branch targets can be in any chunk, they're marked once
+            // all chunks are done
+            std::vector<std::vector<Mark>> marks(chunk_count);
+
+            std::atomic<uint32_t> next_chunk{0};
+            const auto worker = [&]() {
+                std::vector<uint8_t> candidates;
+                for (uint32_t chunk = next_chunk.fetch_add(1);
+                     chunk < chunk_count; chunk = next_chunk.fetch_add(1)) {
+                    const uint32_t begin = chunk * chunk_size;
+                    const uint32_t end = std::min(begin + chunk_size, count);
+                    decode_chunk(range, words.data(), begin, end, candidates,
+                                 marks[chunk]);
+                }
+            };
+
+            unsigned threads = options.threads != 0
+                                   ? options.threads
+                                   : std::thread::hardware_concurrency();
+            threads = std::max(1U, std::min(threads, chunk_count));
+
+            std::vector<std::thread> pool;
+            for (unsigned i = 1; i < threads; ++i)
+                pool.emplace_back(worker);
+            worker();
+            for (auto& thread : pool)
+                thread.join();
+
+            if (!range.entries.empty())
+                range.entries[0].flags |= e_block_start;
+
+            for (const auto& chunk_marks : marks) {
+                for (const Mark& mark : chunk_marks) {
+                    const uint32_t index = (mark.address - range.base) >> 2;
+                    if (index < count) range.entries[index].flags |= mark.flags;
+                }
+            }
+        }
+
+        static void decode_chunk(Range& range, const uint32_t* words,
+                                 const uint32_t begin, const uint32_t end,
+                                 std::vector<uint8_t>& candidates,
+                                 std::vector<Mark>& marks) {
+            // Branch candidates from the opcode (and func for JR/JALR)
+            candidates.resize(end - begin);
+            for (uint32_t i = begin; i < end; ++i) {
+                const uint32_t word = words[i];
+                const uint32_t op = word >> 26;
+                const uint32_t is_jump_register =
+                    (op == 0) & ((word & 0x3E) == 0x08);
+                candidates[i - begin] = static_cast<uint8_t>(
+                    ((BRANCH_OPCODES >> op) & 1) | is_jump_register);
+            }
+
+            for (uint32_t i = begin; i < end; ++i) {
+                Entry& entry = range.entries[i];
+                entry.instr = Instruction(words[i]);
+
+                const auto type = entry.instr.template get_type<isa>();
+                if (!type.is_error()) {
+                    entry.type = type.get_value();
+                    entry.flags |= e_valid;
+                }
+            }
+
+            for (uint32_t i = begin; i < end; ++i) {
+                if (!candidates[i - begin]) continue;
+
+                const uint32_t address = range.base + i * 4;
+                const ControlFlow flow =
+                    ControlFlow::analyze(range.entries[i].instr, address);
+                if (!flow.is_block_end()) continue;
+
+                if (flow.kind == ControlFlow::Kind::e_direct)
+                    marks.push_back(
+                        {flow.target, e_block_start | e_branch_target});
+
+                const uint32_t next = i + (flow.delayed ? 2 : 1);
+                if (next < range.entries.size()) {
+                    // Another chunk may own the next entry
+                    if (next < end)
+                        range.entries[next].flags |= e_block_start;
+                    else
+                        marks.push_back({range.base + next * 4, e_block_start});
+                }
+            }
+        }
+
+        std::vector<Range> ranges;
+    };
+} // namespace mips_emulator
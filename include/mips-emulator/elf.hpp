@@ -0,0 +1,245 @@
+#pragma once
+#include "mips-emulator/result.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace mips_emulator {
+    enum class ElfError : uint8_t {
+        file_not_found,
+        truncated,
+        bad_magic,
+        unsupported_class,
+        unsupported_endianness,
+        unsupported_machine,
+        bad_segment,
+    };
+
+    // Minimal reader for statically linked 32-bit little-endian MIPS ELF
+    // executables. Only what's needed to run a program is kept: the entry
+    // point, the loadable segments and the symbol table.
+    class ElfFile {
+    public:
+        struct Segment {
+            uint32_t address;
+            uint32_t memory_size;
+            uint32_t flags;
+            std::vector<uint8_t> data;
+
+            bool is_executable() const noexcept { return flags & PF_X; }
+            bool contains(const uint32_t addr) const noexcept {
+                return addr - address < memory_size;
+            }
+        };
+
+        struct Symbol {
+            std::string name;
+            uint32_t address;
+            uint32_t size;
+            bool is_function;
+        };
+
+        [[nodiscard]] Result<void, ElfError>
+        load_file(const std::string& path) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) return ElfError::file_not_found;
+
+            const std::vector<uint8_t> bytes(
+                (std::istreambuf_iterator<char>(file)),
+                std::istreambuf_iterator<char>());
+            return parse(bytes.data(), bytes.size());
+        }
+
+        [[nodiscard]] Result<void, ElfError> parse(const uint8_t* bytes,
+                                                   const std::size_t size) {
+            segments.clear();
+            symbols.clear();
+
+            if (size < EHDR_SIZE) return ElfError::truncated;
+            if (std::memcmp(bytes, "\x7f"
+                                   "ELF",
+                            4) != 0)
+                return ElfError::bad_magic;
+            if (bytes[4] != ELFCLASS32) return ElfError::unsupported_class;
+            if (bytes[5] != ELFDATA2LSB)
+                return ElfError::unsupported_endianness;
+            if (read16(bytes + 18) != EM_MIPS)
+                return ElfError::unsupported_machine;
+
+            entry = read32(bytes + 24);
+
+            const uint32_t phoff = read32(bytes + 28);
+            const uint32_t shoff = read32(bytes + 32);
+            const uint16_t phentsize = read16(bytes + 42);
+            const uint16_t phnum = read16(bytes + 44);
+            const uint16_t shentsize = read16(bytes + 46);
+            const uint16_t shnum = read16(bytes + 48);
+
+            // Entries may be larger than the fields read from them, not
+            // smaller
+            if (phnum != 0 && phentsize < PHDR_SIZE) return ElfError::truncated;
+            if (phoff + uint64_t(phnum) * phentsize > size)
+                return ElfError::truncated;
+
+            for (uint16_t i = 0; i < phnum; ++i) {
+                const uint8_t* phdr = bytes + phoff + i * phentsize;
+                if (read32(phdr) != PT_LOAD) continue;
+
+                const uint32_t offset = read32(phdr + 4);
+                const uint32_t file_size = read32(phdr + 16);
+                Segment segment;
+                segment.address = read32(phdr + 8);
+                segment.memory_size = read32(phdr + 20);
+                segment.flags = read32(phdr + 24);
+
+                if (file_size > segment.memory_size ||
+                    offset + uint64_t(file_size) > size)
+                    return ElfError::bad_segment;
+
+                segment.data.assign(bytes + offset, bytes + offset + file_size);
+                segments.push_back(std::move(segment));
+            }
+
+            // The section headers are only needed for the symbol table, so a
+            // stripped binary is fine
+            if (shoff == 0 || shnum == 0) return {};
+            if (shentsize < SHDR_SIZE ||
+                shoff + uint64_t(shnum) * shentsize > size)
+                return ElfError::truncated;
+
+            for (uint16_t i = 0; i < shnum; ++i) {
+                const uint8_t* shdr = bytes + shoff + i * shentsize;
+                if (read32(shdr + 4) != SHT_SYMTAB) continue;
+
+                const uint32_t offset = read32(shdr + 16);
+                const uint32_t table_size = read32(shdr + 20);
+                const uint32_t link = read32(shdr + 24);
+                if (link >= shnum || offset + uint64_t(table_size) > size)
+                    return ElfError::truncated;
+
+                const uint8_t* strtab_hdr = bytes + shoff + link * shentsize;
+                const uint32_t str_offset = read32(strtab_hdr + 16);
+                const uint32_t str_size = read32(strtab_hdr + 20);
+                if (str_offset + uint64_t(str_size) > size)
+                    return ElfError::truncated;
+
+                for (uint32_t sym = offset;
+                     sym + SYM_SIZE <= offset + table_size; sym += SYM_SIZE) {
+                    const uint32_t name = read32(bytes + sym);
+                    const uint8_t type = bytes[sym + 12] & 0xf;
+                    if (name == 0 || name >= str_size) continue;
+                    if (type != STT_FUNC && type != STT_OBJECT &&
+                        type != STT_NOTYPE)
+                        continue;
+
+                    // The name must end inside the string table
+                    const char* str = reinterpret_cast<const char*>(
+                        bytes + str_offset + name);
+                    const void* end = std::memchr(str, 0, str_size - name);
+                    if (!end) return ElfError::truncated;
+
+                    symbols.push_back({
+                        std::string(str, static_cast<const char*>(end)),
+                        read32(bytes + sym + 4),
+                        read32(bytes + sym + 8),
+                        type == STT_FUNC,
+                    });
+                }
+            }
+
+            return {};
+        }
+
+        uint32_t get_entry() const noexcept { return entry; }
+        const std::vector<Segment>& get_segments() const noexcept {
+            return segments;
+        }
+        const std::vector<Symbol>& get_symbols() const noexcept {
+            return symbols;
+        }
+
+        const Symbol* find_symbol(const std::string& name) const noexcept {
+            for (const auto& symbol : symbols) {
+                if (symbol.name == name) return &symbol;
+            }
+            return nullptr;
+        }
+
+        // Returns the function symbol containing address
+        const Symbol* find_function(const uint32_t address) const noexcept {
+            for (const auto& symbol : symbols) {
+                if (symbol.is_function &&
+                    address - symbol.address < symbol.size)
+                    return &symbol;
+            }
+            return nullptr;
+        }
+
+        // Reads an instruction word from an executable segment
+        Result<uint32_t, void> read_code(const uint32_t address) const {
+            for (const auto& segment : segments) {
+                if (!segment.is_executable()) continue;
+
+                const uint32_t offset = address - segment.address;
+                if (offset >= segment.data.size() ||
+                    segment.data.size() - offset < 4)
+                    continue;
+
+                return read32(segment.data.data() + offset);
+            }
+            return {};
+        }
+
+        // Copies every segment into memory and zero fills the remainder of
+        // each segment (.bss)
+        template <typename Memory>
+        [[nodiscard]] bool load_into(Memory& memory) const {
+            for (const auto& segment : segments) {
+                for (uint32_t i = 0; i < segment.memory_size; ++i) {
+                    const uint8_t byte =
+                        i < segment.data.size() ? segment.data[i] : 0;
+                    const auto result = memory.template store<uint8_t>(
+                        segment.address + i, byte);
+                    if (result.is_error()) return false;
+                }
+            }
+            return true;
+        }
+
+        static constexpr uint32_t PF_X = 1;
+        static constexpr uint32_t PF_W = 2;
+        static constexpr uint32_t PF_R = 4;
+
+    private:
+        static constexpr std::size_t EHDR_SIZE = 52;
+        static constexpr uint16_t PHDR_SIZE = 32;
+        static constexpr uint16_t SHDR_SIZE = 40;
+        static constexpr uint32_t SYM_SIZE = 16;
+        static constexpr uint8_t ELFCLASS32 = 1;
+        static constexpr uint8_t ELFDATA2LSB = 1;
+        static constexpr uint16_t EM_MIPS = 8;
+        static constexpr uint32_t PT_LOAD = 1;
+        static constexpr uint32_t SHT_SYMTAB = 2;
+        static constexpr uint8_t STT_NOTYPE = 0;
+        static constexpr uint8_t STT_OBJECT = 1;
+        static constexpr uint8_t STT_FUNC = 2;
+
+        static uint16_t read16(const uint8_t* p) {
+            return static_cast<uint16_t>(p[0] | (p[1] << 8));
+        }
+        static uint32_t read32(const uint8_t* p) {
+            return static_cast<uint32_t>(p[0]) |
+                   (static_cast<uint32_t>(p[1]) << 8) |
+                   (static_cast<uint32_t>(p[2]) << 16) |
+                   (static_cast<uint32_t>(p[3]) << 24);
+        }
+
+        uint32_t entry = 0;
+        std::vector<Segment> segments;
+        std::vector<Symbol> symbols;
+    };
+} // namespace mips_emulator
@@ -1,12 +1,24 @@
 #pragma once
+#include "mips-emulator/block_profile.hpp"
+#include "mips-emulator/code_cache.hpp"
+#include "mips-emulator/decode_cache.hpp"
 #include "mips-emulator/instruction.hpp"
 #include "mips-emulator/executor.hpp"
+#include "mips-emulator/hypercall.hpp"
+#include "mips-emulator/loop_detector.hpp"
+#include "mips-emulator/memcheck.hpp"
+#include "mips-emulator/memory_trace.hpp"
+#include "mips-emulator/metrics.hpp"
 #include "mips-emulator/register_file.hpp"
+#include "mips-emulator/run_result.hpp"
+#include "mips-emulator/telemetry.hpp"
 
+#include <algorithm>
+#include <cstdint>
 #include <utility>
 
 namespace mips_emulator {
-    template <typename Memory>
+    template <typename Memory, Isa isa = Isa::e_mips32r6>
     class Emulator {
     public:
         template <typename... Args>
@@ -16,13 +28,346 @@ namespace mips_emulator {
             return reg_file;
         }
         RegisterFile clone_register_file() const noexcept { return reg_file; }
+        void set_register_file(const RegisterFile& registers) noexcept {
+            reg_file = registers;
+        }
+
+        Memory& get_memory() noexcept { return memory; }
+
+        void set_pc(const uint32_t pc) noexcept { reg_file.set_pc(pc); }
+
+        // Instructions found in the cache are executed without being fetched
+        // and decoded. Stores to cached code drop the stored instructions
+        // from the cache. The cache must outlive the emulator or be reset
+        // with nullptr.
+        //
+        // NOTE: Memories with a Cp0, e.g. the Mmu, never use the cache. Its
+        // entries are keyed by virtual address, and every fetch has to be
+        // translated to raise TLB faults and follow mapping changes.
+        void set_decode_cache(DecodeCache<isa>* cache) noexcept {
+            decode_cache = cache;
+        }
+
+        // Blocks generated from guest code that SYNCI, CACHE or a snooped
+        // store invalidates are evicted from the cache. The cache must
+        // outlive the emulator or be reset with nullptr.
+        void set_code_cache(CodeCache* cache) noexcept { code_cache = cache; }
+
+        // Stores drop the code they overwrite from the decode and code
+        // caches unless snooping is turned off. Guests that issue SYNCI or
+        // CACHE after writing code, e.g. trusted loaders and JITs, don't
+        // need it, and their stores skip the check.
+        void set_store_snooping(const bool enabled) noexcept {
+            snoop_stores = enabled;
+        }
+
+        // Counters should belong to the thread that runs this emulator, see
+        // MetricsRegistry::thread_counters. Nothing is recorded without. The
+        // counters must outlive the emulator or be reset with nullptr.
+        void set_metrics(MetricCounters* counters) noexcept {
+            metrics = counters;
+        }
+
+        MetricCounters* get_metrics() const noexcept { return metrics; }
+
+        // Stops run when the program is stuck in a loop. The detector must
+        // outlive the emulator or be reset with nullptr.
+        void set_loop_detector(LoopDetector* detector) noexcept {
+            loop_detector = detector;
+        }
+
+        // Checks every load and store and lets the memcheck see calls to
+        // the guest allocator. Instruction fetches are checked too,
+        // including those served by the decode cache, so code must stay
+        // defined. The memcheck must outlive the emulator or be reset with
+        // nullptr.
+        void set_memcheck(Memcheck* checker) noexcept { memcheck = checker; }
+
+        // Records every instruction fetch, load and store that succeeds,
+        // including fetches served by the decode cache. The writer must
+        // outlive the emulator or be reset with nullptr.
+        void set_memory_trace(TraceWriter* writer) noexcept { trace = writer; }
+
+        // Counts every instruction that executes, for the recompiler's
+        // register allocation. The profile must outlive the emulator or be
+        // reset with nullptr.
+        void set_block_profile(BlockProfile* profile) noexcept {
+            block_profile = profile;
+        }
+
+        // SYSCALLs with HYPERCALL_CODE call the table's host functions. The
+        // table must outlive the emulator or be reset with nullptr.
+        void set_hypercalls(const HypercallTable* table) noexcept {
+            hypercalls = table;
+        }
+
+        // run publishes the state of the emulator to the writer every
+        // interval instructions and when it stops. The writer must outlive
+        // the emulator or be reset with nullptr.
+        void set_telemetry(TelemetryWriter* writer) noexcept {
+            telemetry = writer;
+        }
+
+        // Steps until an instruction fails, budget instructions have been
+        // executed or the loop detector fires
+        [[nodiscard]] RunResult run(const uint64_t budget) noexcept {
+            if (!telemetry) return run_slice(budget);
+
+            uint64_t steps = 0;
+            while (true) {
+                const uint64_t slice =
+                    std::min(budget - steps, telemetry->get_interval());
+                const RunResult result = run_slice(slice);
+                steps += result.steps;
+
+                const bool done =
+                    result.reason != StopReason::e_budget_exhausted ||
+                    steps == budget;
+                telemetry->publish(
+                    done ? RunState::e_stopped : RunState::e_running,
+                    result.reason, reg_file.get_pc(), result.steps, metrics);
+
+                if (done) return {result.reason, steps};
+            }
+        }
 
         [[nodiscard]] bool step() noexcept {
-            return Executor::step(reg_file, memory);
+            if (!step_at(retired)) return false;
+            ++retired;
+            return true;
         }
 
+        // Instructions executed over all calls to run and step. Also the
+        // cycle count behind CP0 Count and RDHWR CC.
+        uint64_t get_retired() const noexcept { return retired; }
+
     private:
+        // cycles is the retired count before this instruction
+        bool step_at(const uint64_t cycles) noexcept {
+            if (memcheck) memcheck->before_instruction(reg_file);
+
+            const uint32_t pc = reg_file.get_pc();
+            Bus bus(memory, metrics, decode_cache, code_cache, snoop_stores,
+                    loop_detector, memcheck, trace, hypercalls, cycles);
+            if (!execute(bus)) {
+                record_failure();
+                return false;
+            }
+
+            if (metrics) metrics->add_instructions();
+            if (block_profile) block_profile->record(pc);
+            return true;
+        }
+
+        RunResult run_slice(const uint64_t budget) noexcept {
+            const RunResult result = run_steps(budget);
+            retired += result.steps;
+            return result;
+        }
+
+        // NOTE: retired is only brought up to date once the slice ends,
+        // instructions see it through the step counter
+        RunResult run_steps(const uint64_t budget) noexcept {
+            for (uint64_t steps = 0; steps < budget; ++steps) {
+                const uint32_t pc = reg_file.get_pc();
+                if (!step_at(retired + steps))
+                    return {StopReason::e_fault, steps};
+
+                // Checked once the delay slot is done, so the state doesn't
+                // depend on a pending branch
+                if (loop_detector && reg_file.get_pc() <= pc &&
+                    !reg_file.is_branch_pending() &&
+                    loop_detector->check(reg_file))
+                    return {StopReason::e_infinite_loop, steps + 1};
+            }
+
+            return {StopReason::e_budget_exhausted, budget};
+        }
+
+        // Forwards the executor's memory accesses to the memory and records
+        // faults on the way back
+        class Bus {
+        public:
+            using Address = uint32_t;
+
+            Bus(Memory& memory, MetricCounters* metrics,
+                DecodeCache<isa>* decode_cache, CodeCache* code_cache,
+                const bool snoop_stores, LoopDetector* loop_detector,
+                Memcheck* memcheck, TraceWriter* trace,
+                const HypercallTable* hypercalls, const uint64_t cycles)
+                : memory(memory), metrics(metrics), decode_cache(decode_cache),
+                  code_cache(code_cache), snoop_stores(snoop_stores),
+                  loop_detector(loop_detector), memcheck(memcheck),
+                  trace(trace), hypercalls(hypercalls), cycles(cycles) {}
+
+            template <typename T>
+            Result<T, MemoryError> read(const Address address) {
+                if (memcheck && !memcheck->check_read(address, sizeof(T)))
+                    return fail(MemoryError::invalid_access);
+
+                const auto result = memory.template read<T>(address);
+                if (result.is_error()) {
+                    record_fault(result.get_error());
+                }
+                else if (trace) {
+                    // A step's first read is its instruction fetch
+                    trace->record(fetched ? AccessType::e_load
+                                          : AccessType::e_fetch,
+                                  address, sizeof(T));
+                }
+                fetched = true;
+
+                return result;
+            }
+
+            template <typename T>
+            Result<void, MemoryError> store(const Address address,
+                                            const T value) {
+                if (memcheck && !memcheck->check_write(address, sizeof(T)))
+                    return fail(MemoryError::invalid_access);
+
+                const auto result = memory.template store<T>(address, value);
+                if (result.is_error()) {
+                    record_fault(result.get_error());
+                    return result;
+                }
+
+                if (trace)
+                    trace->record(AccessType::e_store, address, sizeof(T));
+                if (snoop_stores) invalidate_code(address, sizeof(T));
+                if (loop_detector)
+                    loop_detector->record_store(
+                        address, static_cast<uint32_t>(value), sizeof(T));
+
+                return result;
+            }
+
+            // Only there if the memory has a Cp0, see Executor::has_cp0
+            template <typename M = Memory>
+            auto get_cp0() -> decltype(std::declval<M&>().get_cp0()) {
+                return memory.get_cp0();
+            }
+
+            // Only there if the memory has a Shadow, see Executor::has_shadow
+            template <typename M = Memory>
+            auto get_shadow() -> decltype(std::declval<M&>().get_shadow()) {
+                return memory.get_shadow();
+            }
+
+            // See Executor::has_cycle_counter
+            uint64_t get_cycle_count() const noexcept { return cycles; }
+
+            // See Executor::has_hypercalls
+            const HypercallTable* get_hypercalls() const noexcept {
+                return hypercalls;
+            }
+
+            // For hypercalls on guest buffers. Only handed out when nothing
+            // has to see the individual accesses, snooped stores drop the
+            // whole range from the code caches.
+            template <typename M = Memory>
+            auto get_host_pointer(const Address address, const uint32_t size,
+                                  const bool for_store)
+                -> decltype(std::declval<M&>().get_host_pointer(address, size,
+                                                                for_store)) {
+                if (memcheck || trace || (for_store && loop_detector))
+                    return nullptr;
+
+                auto* host = memory.get_host_pointer(address, size, for_store);
+                if (host && for_store && snoop_stores)
+                    invalidate_code(address, size);
+                return host;
+            }
+
+            // See Executor::has_code_invalidation
+            void invalidate_code(const Address address, const uint32_t size) {
+                if (decode_cache) decode_cache->invalidate(address, size);
+                if (code_cache) code_cache->invalidate(address, size);
+            }
+
+            void invalidate_all_code() {
+                if (decode_cache) decode_cache->invalidate_all();
+                if (code_cache) code_cache->invalidate_all();
+            }
+
+            // For an instruction that comes from the decode cache, which
+            // isn't read from memory. Returns false if the memcheck rejects
+            // the fetch.
+            [[nodiscard]] bool record_cached_fetch(const Address address) {
+                if (memcheck && !memcheck->check_read(address, 4)) {
+                    record_fault(MemoryError::invalid_access);
+                    return false;
+                }
+
+                if (trace) trace->record(AccessType::e_fetch, address, 4);
+                fetched = true;
+                return true;
+            }
+
+        private:
+            MemoryError fail(const MemoryError error) {
+                record_fault(error);
+                return error;
+            }
+
+            void record_fault(const MemoryError error) {
+                if (metrics) metrics->record_memory_fault(error);
+            }
+
+            Memory& memory;
+            MetricCounters* metrics;
+            DecodeCache<isa>* decode_cache;
+            CodeCache* code_cache;
+            bool snoop_stores;
+            LoopDetector* loop_detector;
+            Memcheck* memcheck;
+            TraceWriter* trace;
+            const HypercallTable* hypercalls;
+            uint64_t cycles;
+            bool fetched = false;
+        };
+
+        bool execute(Bus& bus) noexcept {
+            if constexpr (Executor::has_cp0<Memory>::value)
+                return Executor::step<Bus, isa>(reg_file, bus);
+
+            if (!decode_cache) return Executor::step<Bus, isa>(reg_file, bus);
+
+            const auto* entry = decode_cache->find(reg_file.get_pc());
+            if (!entry) {
+                if (metrics) metrics->record_cache_miss(CacheKind::e_decode);
+                return Executor::step<Bus, isa>(reg_file, bus);
+            }
+
+            if (metrics) metrics->record_cache_hit(CacheKind::e_decode);
+            if (!bus.record_cached_fetch(reg_file.get_pc())) return false;
+            reg_file.update_pc();
+            return Executor::execute_decoded<Bus, isa>(
+                entry->instr, entry->type, reg_file, bus);
+        }
+
+        void record_failure() noexcept {
+            if (!reg_file.has_pending_exception()) return;
+
+            if (metrics) {
+                metrics->record_exception(static_cast<RegisterFile::Exception>(
+                    reg_file.get_cause_register()));
+            }
+            reg_file.clear_pending_exception();
+        }
+
         RegisterFile reg_file;
         Memory memory;
+        MetricCounters* metrics = nullptr;
+        DecodeCache<isa>* decode_cache = nullptr;
+        CodeCache* code_cache = nullptr;
+        bool snoop_stores = true;
+        LoopDetector* loop_detector = nullptr;
+        Memcheck* memcheck = nullptr;
+        TraceWriter* trace = nullptr;
+        BlockProfile* block_profile = nullptr;
+        const HypercallTable* hypercalls = nullptr;
+        TelemetryWriter* telemetry = nullptr;
+        uint64_t retired = 0;
     };
 } // namespace mips_emulator
@@ -1,7 +1,14 @@
 #pragma once
+#include "mips-emulator/handler_profile.hpp"
+#include "mips-emulator/hypercall.hpp"
 #include "mips-emulator/instruction.hpp"
+#include "cp0.hpp"
 #include "memory.hpp"
 #include "register_file.hpp"
+#include "taint.hpp"
+
+#include <type_traits>
+#include <utility>
 
 namespace mips_emulator {
     namespace Executor {
@@ -13,8 +20,73 @@ namespace mips_emulator {
             return static_cast<small_t>((a64 * b64) >> 32);
         };
 
+        // Number of leading zero bits, 32 for zero
+        inline uint32_t count_leading_zeros(uint32_t x) {
+            uint32_t count = 32;
+            for (; x != 0; x >>= 1)
+                --count;
+            return count;
+        }
+
+        // Returns true if a + b doesn't fit in 32 bits, result is the sum
+        // modulo 2^32 either way
+        inline bool add_overflows(const int32_t a, const int32_t b,
+                                  int32_t& result) {
+            const int64_t sum = int64_t(a) + b;
+            result = static_cast<int32_t>(static_cast<uint32_t>(sum));
+            return sum != result;
+        }
+
+        // Hypercalls need a memory with a HypercallTable, e.g. the
+        // Emulator's bus
+        template <typename Memory, typename = void>
+        struct has_hypercalls : std::false_type {};
+
+        template <typename Memory>
+        struct has_hypercalls<
+            Memory,
+            std::void_t<decltype(std::declval<Memory&>().get_hypercalls())>>
+            : std::true_type {};
+
+        /*
+          syscall code
+
+          With code HYPERCALL_CODE, calls the host function numbered $v0 in
+          the memory's HypercallTable and sets $v0 to its result. Any other
+          SYSCALL, or a number without a function, raises a system call
+          exception.
+        */
+        template <typename Memory>
         [[nodiscard]] inline static bool
-        handle_rtype_instr(const Instruction instr, RegisterFile& reg_file) {
+        handle_syscall_instr(const Instruction instr, RegisterFile& reg_file,
+                             Memory& memory) {
+            if constexpr (has_hypercalls<Memory>::value) {
+                const HypercallTable* table = memory.get_hypercalls();
+                const uint32_t code = (instr.raw >> 6) & 0xFFFFF;
+                const uint8_t v0 = static_cast<uint8_t>(RegisterName::e_v0);
+
+                const Hypercall* hypercall =
+                    table && code == HYPERCALL_CODE
+                        ? table->find(reg_file.get(v0).u)
+                        : nullptr;
+                if (hypercall) {
+                    HypercallContext context(reg_file, GuestMemory(memory));
+                    if (!(*hypercall)(context)) return false;
+
+                    reg_file.set_unsigned(v0, context.get_result());
+                    return true;
+                }
+            }
+
+            reg_file.signal_exception(RegisterFile::Exception::e_sys,
+                                      instr.raw);
+            return false;
+        }
+
+        template <typename Memory>
+        [[nodiscard]] inline static bool
+        handle_rtype_instr(const Instruction instr, RegisterFile& reg_file,
+                           Memory& memory) {
 
             using Register = RegisterFile::Register;
             using Func = Instruction::Func;
@@ -222,12 +294,22 @@ namespace mips_emulator {
                 case Func::e_tltu: return trap_on_cond(rs.u < rt.u);
                 case Func::e_tne: return trap_on_cond(rs.u != rt.u);
 
+                case Func::e_syscall:
+                    return handle_syscall_instr(instr, reg_file, memory);
+
                 default: return false;
             }
 
             return true;
         }
 
+        // Without a memory SYSCALL always raises a system call exception
+        [[nodiscard]] inline static bool
+        handle_rtype_instr(const Instruction instr, RegisterFile& reg_file) {
+            struct NoHypercalls {} memory;
+            return handle_rtype_instr(instr, reg_file, memory);
+        }
+
         template <typename T>
         const uint32_t sign_ext_imm(const T imm) {
             const uint32_t ext = (~0U) << 16;
@@ -889,25 +971,503 @@ namespace mips_emulator {
             return true;
         }
 
+        // COP0 instructions need a memory with a Cp0, e.g. the Mmu
+        template <typename Memory, typename = void>
+        struct has_cp0 : std::false_type {};
+
         template <typename Memory>
-        [[nodiscard]] inline static bool step(RegisterFile& reg_file,
-                                              Memory& memory) {
-            using Type = Instruction::Type;
+        struct has_cp0<Memory,
+                       std::void_t<decltype(std::declval<Memory&>().get_cp0())>>
+            : std::true_type {};
 
-            auto read_result =
-                memory.template read<uint32_t>(reg_file.get_pc());
+        // Count, Compare and RDHWR CC need a memory that knows how many
+        // cycles have passed, e.g. the Emulator's bus
+        template <typename Memory, typename = void>
+        struct has_cycle_counter : std::false_type {};
 
-            if (read_result.is_error()) return false;
-            const auto instr = Instruction(read_result.get_value());
+        template <typename Memory>
+        struct has_cycle_counter<
+            Memory,
+            std::void_t<decltype(std::declval<Memory&>().get_cycle_count())>>
+            : std::true_type {};
 
-            reg_file.update_pc();
+        template <typename Memory>
+        [[nodiscard]] inline static bool
+        handle_cop0_instr(const Instruction instr, RegisterFile& reg_file,
+                          Memory& memory) {
+            if constexpr (!has_cp0<Memory>::value) {
+                return false;
+            }
+            else {
+                using Op = Instruction::COP0Op;
+                using Func = Instruction::COP0Func;
+
+                auto& cp0 = memory.get_cp0();
+                const auto& cop0 = instr.cop0_type;
+                if constexpr (has_cycle_counter<Memory>::value)
+                    cp0.set_cycles(memory.get_cycle_count());
+
+                if (cop0.op & static_cast<uint8_t>(Op::e_co)) {
+                    switch (static_cast<Func>(instr.rtype.func)) {
+                        case Func::e_tlbr: cp0.tlb_read(); break;
+                        case Func::e_tlbwi: cp0.tlb_write_indexed(); break;
+                        case Func::e_tlbwr: cp0.tlb_write_random(); break;
+                        case Func::e_tlbp: cp0.tlb_probe(); break;
+                        default: return false;
+                    }
+                    return true;
+                }
 
-            const auto instr_type = instr.get_type();
+                switch (static_cast<Op>(cop0.op)) {
+                    case Op::e_mf: {
+                        reg_file.set_unsigned(
+                            cop0.rt, cp0.read_register(cop0.rd, cop0.sel));
+                        break;
+                    }
+                    case Op::e_mt: {
+                        cp0.write_register(cop0.rd, cop0.sel,
+                                           reg_file.get(cop0.rt).u);
+                        break;
+                    }
+                    default: return false;
+                }
+                return true;
+            }
+        }
 
-            if (instr_type.is_error()) return false;
+        // Memories that know about code derived from guest memory, e.g. the
+        // Emulator's bus with its decode cache, are told when SYNCI or CACHE
+        // discard it, a range with invalidate_code or all of it with
+        // invalidate_all_code
+        template <typename Memory, typename = void>
+        struct has_code_invalidation : std::false_type {};
+
+        template <typename Memory>
+        struct has_code_invalidation<
+            Memory,
+            std::void_t<decltype(std::declval<Memory&>().invalidate_code(
+                            uint32_t(0), uint32_t(0))),
+                        decltype(std::declval<Memory&>()
+                                     .invalidate_all_code())>>
+            : std::true_type {};
+
+        // Line size SYNCI and CACHE work on, read by RDHWR SYNCI_Step
+        constexpr uint32_t SYNCI_STEP = 64;
+
+        template <typename Memory>
+        inline static void
+        invalidate_code_line([[maybe_unused]] Memory& memory,
+                             [[maybe_unused]] const uint32_t address) {
+            if constexpr (has_code_invalidation<Memory>::value)
+                memory.invalidate_code(address & ~(SYNCI_STEP - 1), SYNCI_STEP);
+        }
+
+        /*
+          cache op, offset(base)
+
+          Only instruction cache operations matter, they drop cached code.
+          Hit Invalidate drops the line at the address. Index Invalidate and
+          Index Store Tag name a cache slot rather than an address, so they
+          drop all of it, as do implementation dependent operations. Data,
+          secondary and tertiary cache operations do nothing.
+          NOTE: CACHE is privileged, that isn't checked
+        */
+        template <typename Memory>
+        inline static void cache_operation(Memory& memory, const uint8_t op,
+                                           const uint32_t address) {
+            constexpr uint8_t INSTRUCTION_CACHE = 0;
+            if ((op & 3) != INSTRUCTION_CACHE) return;
+
+            switch (op >> 2) {
+                case 0: // Index Invalidate
+                case 2: // Index Store Tag
+                case 3: // Implementation dependent
+                    if constexpr (has_code_invalidation<Memory>::value)
+                        memory.invalidate_all_code();
+                    break;
+                case 4: invalidate_code_line(memory, address); break;
+                default: break;
+            }
+        }
+
+        // r6 encoding, see handle_legacy_instr for r2
+        template <typename Memory>
+        [[nodiscard]] inline static bool
+        handle_special3_type_cache_instr(const Instruction instr,
+                                         RegisterFile& reg_file,
+                                         Memory& memory) {
+            const auto offset = static_cast<uint32_t>(
+                static_cast<int32_t>(instr.raw << 16) >> 23);
+            const uint32_t address =
+                reg_file.get(instr.special3_type.rs).u + offset;
+
+            cache_operation(memory, instr.special3_type.rt, address);
+            return true;
+        }
+
+        // SYNCI makes stores to the line at the address visible to
+        // instruction fetches
+        template <typename Memory>
+        [[nodiscard]] inline static bool
+        handle_regimm_itype_instr(const Instruction instr,
+                                  RegisterFile& reg_file, Memory& memory) {
+            using IOp = Instruction::RegimmITypeOp;
+
+            if (static_cast<IOp>(instr.regimm_itype.op) != IOp::e_synci)
+                return handle_regimm_itype_instr(instr, reg_file);
+
+            invalidate_code_line(memory,
+                                 reg_file.get(instr.regimm_itype.rs).u +
+                                     sign_ext_imm(instr.regimm_itype.imm));
+            return true;
+        }
+
+        /*
+          rdhwr rt, rd, sel
+
+          Reads hardware register rd into GPR rt. CC is CP0 Count when the
+          memory has a Cp0, otherwise the low bits of the cycle count. Count
+          advances once per cycle, so CCRes is 1.
+          NOTE: HWREna isn't checked, every register is always readable
+        */
+        template <typename Memory>
+        [[nodiscard]] inline static bool
+        handle_special3_type_rdhwr_instr(const Instruction instr,
+                                         RegisterFile& reg_file,
+                                         Memory& memory) {
+            using HwReg = Instruction::HardwareRegister;
+
+            const uint8_t rt = instr.special3_type.rt;
+            switch (static_cast<HwReg>(instr.special3_type.rd)) {
+                case HwReg::e_cc: {
+                    if constexpr (!has_cycle_counter<Memory>::value) {
+                        return false;
+                    }
+                    else {
+                        const uint64_t cycles = memory.get_cycle_count();
+                        if constexpr (has_cp0<Memory>::value) {
+                            auto& cp0 = memory.get_cp0();
+                            cp0.set_cycles(cycles);
+                            reg_file.set_unsigned(
+                                rt, cp0.read_register(
+                                        uint8_t(Cp0Register::e_count), 0));
+                        }
+                        else {
+                            reg_file.set_unsigned(
+                                rt, static_cast<uint32_t>(cycles));
+                        }
+                        return true;
+                    }
+                }
+                case HwReg::e_synci_step:
+                    reg_file.set_unsigned(rt, SYNCI_STEP);
+                    return true;
+                case HwReg::e_cc_res: reg_file.set_unsigned(rt, 1); return true;
+                case HwReg::e_ulr:
+                    reg_file.set_unsigned(rt, reg_file.get_user_local());
+                    return true;
+                default: return false;
+            }
+        }
+
+        // Reads count bytes at address as a little endian value, with the
+        // widest aligned accesses that stay inside them. Bytes outside are
+        // never accessed, unlike a read of the whole word.
+        template <typename Memory>
+        [[nodiscard]] inline static bool read_bytes(Memory& memory,
+                                                    const uint32_t address,
+                                                    const uint32_t count,
+                                                    uint32_t& value) {
+            value = 0;
+            for (uint32_t i = 0; i < count;) {
+                const uint32_t at = address + i;
+                if ((at & 3) == 0 && count - i >= 4) {
+                    const auto result = memory.template read<uint32_t>(at);
+                    if (result.is_error()) return false;
+                    value = result.get_value();
+                    i += 4;
+                }
+                else if ((at & 1) == 0 && count - i >= 2) {
+                    const auto result = memory.template read<uint16_t>(at);
+                    if (result.is_error()) return false;
+                    value |= uint32_t(result.get_value()) << (i * 8);
+                    i += 2;
+                }
+                else {
+                    const auto result = memory.template read<uint8_t>(at);
+                    if (result.is_error()) return false;
+                    value |= uint32_t(result.get_value()) << (i * 8);
+                    i += 1;
+                }
+            }
+            return true;
+        }
+
+        // Stores the count least significant bytes of value at address, see
+        // read_bytes
+        template <typename Memory>
+        [[nodiscard]] inline static bool store_bytes(Memory& memory,
+                                                     const uint32_t address,
+                                                     const uint32_t count,
+                                                     const uint32_t value) {
+            for (uint32_t i = 0; i < count;) {
+                const uint32_t at = address + i;
+                const uint32_t part = value >> (i * 8);
+                if ((at & 3) == 0 && count - i >= 4) {
+                    if (memory.template store<uint32_t>(at, part).is_error())
+                        return false;
+                    i += 4;
+                }
+                else if ((at & 1) == 0 && count - i >= 2) {
+                    if (memory.template store<uint16_t>(at, uint16_t(part))
+                            .is_error())
+                        return false;
+                    i += 2;
+                }
+                else {
+                    if (memory.template store<uint8_t>(at, uint8_t(part))
+                            .is_error())
+                        return false;
+                    i += 1;
+                }
+            }
+            return true;
+        }
+
+        // MIPS32r2 instructions that r6 removed or reassigned, only reachable
+        // when executing with Isa::e_mips32r2
+        template <typename Memory>
+        [[nodiscard]] inline static bool
+        handle_legacy_instr(const Instruction instr, RegisterFile& reg_file,
+                            Memory& memory) {
+            using Register = RegisterFile::Register;
+            using Func = Instruction::LegacyFunc;
+            using Special2Func = Instruction::Special2Func;
+            using IOp = Instruction::LegacyITypeOpcode;
+            using RegimmOp = Instruction::LegacyRegimmOp;
+
+            const Register rs = reg_file.get(instr.rtype.rs);
+            const Register rt = reg_file.get(instr.rtype.rt);
+            const uint8_t rd = instr.rtype.rd;
+
+            const auto set_hi_lo = [&](const uint64_t value) {
+                reg_file.set_hi(static_cast<uint32_t>(value >> 32));
+                reg_file.set_lo(static_cast<uint32_t>(value));
+            };
+            const auto get_hi_lo = [&]() {
+                return (static_cast<uint64_t>(reg_file.get_hi()) << 32) |
+                       reg_file.get_lo();
+            };
+
+            // Branch likely instructions skip the delay slot when not taken
+            const uint32_t branch_target =
+                reg_file.get_pc() + (sign_ext_imm(instr.itype.imm) * 4);
+            const auto branch_likely = [&](const bool condition) {
+                if (condition)
+                    reg_file.delayed_branch(branch_target);
+                else
+                    reg_file.inc_pc();
+                return true;
+            };
+
+            const uint32_t address = rs.u + sign_ext_imm(instr.itype.imm);
+            const uint32_t byte = address & 3;
+            const uint32_t word_address = address & ~3U;
+
+            switch (instr.general.op) {
+                case Instruction::RTYPE_OPCODE: {
+                    switch (static_cast<Func>(instr.rtype.func)) {
+                        case Func::e_movz: {
+                            if (rt.u == 0) reg_file.set_unsigned(rd, rs.u);
+                            return true;
+                        }
+                        case Func::e_movn: {
+                            if (rt.u != 0) reg_file.set_unsigned(rd, rs.u);
+                            return true;
+                        }
+                        case Func::e_mfhi: {
+                            reg_file.set_unsigned(rd, reg_file.get_hi());
+                            return true;
+                        }
+                        case Func::e_mflo: {
+                            reg_file.set_unsigned(rd, reg_file.get_lo());
+                            return true;
+                        }
+                        case Func::e_mthi: {
+                            reg_file.set_hi(rs.u);
+                            return true;
+                        }
+                        case Func::e_mtlo: {
+                            reg_file.set_lo(rs.u);
+                            return true;
+                        }
+                        case Func::e_mult: {
+                            set_hi_lo(static_cast<uint64_t>(
+                                static_cast<int64_t>(rs.s) * rt.s));
+                            return true;
+                        }
+                        case Func::e_multu: {
+                            set_hi_lo(static_cast<uint64_t>(rs.u) * rt.u);
+                            return true;
+                        }
+                        // NOTE: HI and LO are unpredictable when dividing by
+                        // zero, they're left unchanged
+                        case Func::e_div: {
+                            if (rt.s == 0) return true;
+                            if (rs.s == INT32_MIN && rt.s == -1) {
+                                reg_file.set_lo(rs.u);
+                                reg_file.set_hi(0);
+                                return true;
+                            }
+                            reg_file.set_lo(static_cast<uint32_t>(rs.s / rt.s));
+                            reg_file.set_hi(static_cast<uint32_t>(rs.s % rt.s));
+                            return true;
+                        }
+                        case Func::e_divu: {
+                            if (rt.u == 0) return true;
+                            reg_file.set_lo(rs.u / rt.u);
+                            reg_file.set_hi(rs.u % rt.u);
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                case Instruction::SPECIAL2_OPCODE: {
+                    const int64_t product = static_cast<int64_t>(rs.s) * rt.s;
+                    const uint64_t product_unsigned =
+                        static_cast<uint64_t>(rs.u) * rt.u;
+
+                    switch (static_cast<Special2Func>(instr.rtype.func)) {
+                        case Special2Func::e_madd: {
+                            set_hi_lo(get_hi_lo() +
+                                      static_cast<uint64_t>(product));
+                            return true;
+                        }
+                        case Special2Func::e_maddu: {
+                            set_hi_lo(get_hi_lo() + product_unsigned);
+                            return true;
+                        }
+                        case Special2Func::e_msub: {
+                            set_hi_lo(get_hi_lo() -
+                                      static_cast<uint64_t>(product));
+                            return true;
+                        }
+                        case Special2Func::e_msubu: {
+                            set_hi_lo(get_hi_lo() - product_unsigned);
+                            return true;
+                        }
+                        case Special2Func::e_mul: {
+                            reg_file.set_unsigned(
+                                rd, static_cast<uint32_t>(product));
+                            return true;
+                        }
+                        case Special2Func::e_clz: {
+                            reg_file.set_unsigned(rd,
+                                                  count_leading_zeros(rs.u));
+                            return true;
+                        }
+                        case Special2Func::e_clo: {
+                            reg_file.set_unsigned(rd,
+                                                  count_leading_zeros(~rs.u));
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                case Instruction::REGIMM_OPCODE: {
+                    switch (static_cast<RegimmOp>(instr.regimm_itype.op)) {
+                        case RegimmOp::e_bltzl: return branch_likely(rs.s < 0);
+                        case RegimmOp::e_bgezl: return branch_likely(rs.s >= 0);
+                        case RegimmOp::e_bltzal: {
+                            reg_file.set_unsigned(31, reg_file.get_pc());
+                            if (rs.s < 0)
+                                reg_file.delayed_branch(branch_target);
+                            return true;
+                        }
+                        case RegimmOp::e_bgezal: {
+                            reg_file.set_unsigned(31, reg_file.get_pc());
+                            if (rs.s >= 0)
+                                reg_file.delayed_branch(branch_target);
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+            }
 
-            switch (instr_type.get_value()) {
-                case Type::e_rtype: return handle_rtype_instr(instr, reg_file);
+            switch (static_cast<IOp>(instr.itype.op)) {
+                case IOp::e_addi: {
+                    int32_t result;
+                    if (add_overflows(rs.s,
+                                      static_cast<int32_t>(
+                                          sign_ext_imm(instr.itype.imm)),
+                                      result)) {
+                        reg_file.signal_exception(RegisterFile::Exception::e_ov,
+                                                  instr.raw);
+                        return false;
+                    }
+                    reg_file.set_signed(instr.itype.rt, result);
+                    return true;
+                }
+
+                case IOp::e_cache: {
+                    cache_operation(memory, instr.itype.rt, address);
+                    return true;
+                }
+
+                case IOp::e_beql: return branch_likely(rs.u == rt.u);
+                case IOp::e_bnel: return branch_likely(rs.u != rt.u);
+                case IOp::e_blezl: return branch_likely(rs.s <= 0);
+                case IOp::e_bgtzl: return branch_likely(rs.s > 0);
+
+                // Unaligned accesses, little endian. LWL/SWL handle the most
+                // significant bytes of the register and the bytes from the
+                // word start up to address, LWR/SWR the least significant
+                // ones and the bytes from address to the word end. Only
+                // those bytes are accessed, so memchecks and MMIO never see
+                // the rest of the word.
+                case IOp::e_lwl: {
+                    uint32_t bytes;
+                    if (!read_bytes(memory, word_address, byte + 1, bytes))
+                        return false;
+                    reg_file.set_unsigned(
+                        instr.itype.rt, (rt.u & (0x00FFFFFFU >> (byte * 8))) |
+                                            (bytes << ((3 - byte) * 8)));
+                    return true;
+                }
+                case IOp::e_lwr: {
+                    uint32_t bytes;
+                    if (!read_bytes(memory, address, 4 - byte, bytes))
+                        return false;
+                    reg_file.set_unsigned(
+                        instr.itype.rt,
+                        (rt.u & (0xFFFFFF00U << ((3 - byte) * 8))) | bytes);
+                    return true;
+                }
+                case IOp::e_swl:
+                    return store_bytes(memory, word_address, byte + 1,
+                                       rt.u >> ((3 - byte) * 8));
+                case IOp::e_swr:
+                    return store_bytes(memory, address, 4 - byte, rt.u);
+            }
+
+            return false;
+        }
+
+        // Taint is propagated for memories with a Shadow, see ShadowMemory
+        using mips_emulator::has_shadow;
+
+        template <typename Memory, Isa isa = Isa::e_mips32r6>
+        [[nodiscard]] inline static bool
+        dispatch_handler(const Instruction instr, const Instruction::Type type,
+                         RegisterFile& reg_file, Memory& memory) {
+            using Type = Instruction::Type;
+
+            switch (type) {
+                case Type::e_rtype:
+                    return handle_rtype_instr(instr, reg_file, memory);
                 case Type::e_itype:
                 case Type::e_longimm_itype:
                     return handle_itype_instr(instr, reg_file, memory);
@@ -932,10 +1492,16 @@ namespace mips_emulator {
                     return handle_special3_type_ext_instr(instr, reg_file);
                 case Type::e_special3_type_ins:
                     return handle_special3_type_ins_instr(instr, reg_file);
+                case Type::e_special3_type_rdhwr:
+                    return handle_special3_type_rdhwr_instr(instr, reg_file,
+                                                            memory);
+                case Type::e_special3_type_cache:
+                    return handle_special3_type_cache_instr(instr, reg_file,
+                                                            memory);
 
                     // Regimm
                 case Type::e_regimm_itype:
-                    return handle_regimm_itype_instr(instr, reg_file);
+                    return handle_regimm_itype_instr(instr, reg_file, memory);
 
                     // PC relative
                 case Type::e_pcrel_type1:
@@ -943,8 +1509,90 @@ namespace mips_emulator {
                 case Type::e_pcrel_type2:
                     return handle_pcrel_type2_instr(instr, reg_file);
 
+                    // Coprocessor 0
+                case Type::e_cop0_type:
+                    return handle_cop0_instr(instr, reg_file, memory);
+
+                case Type::e_legacy: {
+                    if constexpr (isa == Isa::e_mips32r2)
+                        return handle_legacy_instr(instr, reg_file, memory);
+                    else
+                        return false;
+                }
+
                 default: return false;
             }
         }
+
+        // Times sampled handler calls when profiling is compiled in, see
+        // HandlerProfile
+        template <typename Memory, Isa isa = Isa::e_mips32r6>
+        [[nodiscard]] inline static bool
+        dispatch_decoded(const Instruction instr, const Instruction::Type type,
+                         RegisterFile& reg_file, Memory& memory) {
+#if defined(MIPS_EMULATOR_PROFILE_HANDLERS)
+            HandlerProfile& profile = HandlerProfile::thread_profile();
+            if (profile.should_sample()) {
+                const uint64_t start = HandlerProfile::timestamp();
+                const bool ok = dispatch_handler<Memory, isa>(instr, type,
+                                                              reg_file, memory);
+                profile.record(type, HandlerProfile::op_of(instr),
+                               HandlerProfile::timestamp() - start);
+                return ok;
+            }
+#endif
+            return dispatch_handler<Memory, isa>(instr, type, reg_file, memory);
+        }
+
+        // Executes an instruction that has already been fetched and
+        // decoded, the PC must already have been updated
+        template <typename Memory, Isa isa = Isa::e_mips32r6>
+        [[nodiscard]] inline static bool
+        execute_decoded(const Instruction instr, const Instruction::Type type,
+                        RegisterFile& reg_file, Memory& memory) {
+            if constexpr (!has_shadow<Memory>::value) {
+                return dispatch_decoded<Memory, isa>(instr, type, reg_file,
+                                                     memory);
+            }
+            else {
+                auto& shadow = memory.get_shadow();
+                const TaintUpdate update =
+                    Taint::analyze<isa>(instr, type, reg_file, shadow);
+                if (!dispatch_decoded<Memory, isa>(instr, type, reg_file,
+                                                   memory))
+                    return false;
+
+                shadow.apply(update);
+                return true;
+            }
+        }
+
+        // Executes an already fetched instruction, the PC must already have
+        // been updated
+        template <typename Memory, Isa isa = Isa::e_mips32r6>
+        [[nodiscard]] inline static bool execute(const Instruction instr,
+                                                 RegisterFile& reg_file,
+                                                 Memory& memory) {
+            const auto instr_type = instr.template get_type<isa>();
+
+            if (instr_type.is_error()) return false;
+
+            return execute_decoded<Memory, isa>(instr, instr_type.get_value(),
+                                                reg_file, memory);
+        }
+
+        template <typename Memory, Isa isa = Isa::e_mips32r6>
+        [[nodiscard]] inline static bool step(RegisterFile& reg_file,
+                                              Memory& memory) {
+            auto read_result =
+                memory.template read<uint32_t>(reg_file.get_pc());
+
+            if (read_result.is_error()) return false;
+            const auto instr = Instruction(read_result.get_value());
+
+            reg_file.update_pc();
+
+            return execute<Memory, isa>(instr, reg_file, memory);
+        }
     }; // namespace Executor
 } // namespace mips_emulator
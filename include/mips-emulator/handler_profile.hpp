@@ -0,0 +1,203 @@
+#pragma once
+#include "mips-emulator/instruction.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#if defined(MIPS_EMULATOR_PROFILE_HANDLERS) && \
+    (defined(__x86_64__) || defined(__i386__))
+#    include <x86intrin.h>
+#endif
+
+namespace mips_emulator {
+    // Latency histograms of the executor's handlers per handler and op, to
+    // find out which handler a regression comes from. The executor only
+    // times handlers when built with MIPS_EMULATOR_PROFILE_HANDLERS defined
+    // (the CMake option of the same name), and then only every
+    // sample_interval instructions of each thread.
+    //
+    // Times are in timestamp counter ticks on x86 when profiling is built
+    // in and nanoseconds otherwise. Bucket i holds times in [2^(i-1), 2^i),
+    // bucket 0 is zero.
+    class HandlerProfile {
+    public:
+        static constexpr std::size_t HANDLER_COUNT =
+            static_cast<std::size_t>(Instruction::Type::e_count);
+        static constexpr std::size_t OP_COUNT = 64;
+        static constexpr std::size_t BUCKET_COUNT = 40;
+        static constexpr uint32_t DEFAULT_SAMPLE_INTERVAL = 64;
+
+        struct Row {
+            uint64_t samples = 0;
+            uint64_t total = 0; // Sum of the sampled times
+            uint64_t buckets[BUCKET_COUNT] = {};
+        };
+
+        HandlerProfile() : rows(HANDLER_COUNT * OP_COUNT) {}
+
+        // The calling thread's profile, which the executor records into.
+        // Use merge to combine the profiles of several threads.
+        static HandlerProfile& thread_profile() {
+            static thread_local HandlerProfile profile;
+            return profile;
+        }
+
+        // Times one in interval handler calls, 1 times all of them
+        void set_sample_interval(const uint32_t interval) noexcept {
+            sample_interval = std::max<uint32_t>(interval, 1);
+            countdown = sample_interval;
+        }
+
+        uint32_t get_sample_interval() const noexcept {
+            return sample_interval;
+        }
+
+        bool should_sample() noexcept {
+            if (--countdown != 0) return false;
+            countdown = sample_interval;
+            return true;
+        }
+
+        static uint64_t timestamp() noexcept {
+#if defined(MIPS_EMULATOR_PROFILE_HANDLERS) && \
+    (defined(__x86_64__) || defined(__i386__))
+            // RDTSCP waits for earlier instructions to finish
+            unsigned int aux;
+            return __rdtscp(&aux);
+#else
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
+#endif
+        }
+
+        // The function field of SPECIAL, the rt field of REGIMM and the
+        // primary opcode of everything else
+        static uint8_t op_of(const Instruction instr) noexcept {
+            switch (instr.general.op) {
+                case Instruction::RTYPE_OPCODE:
+                    return static_cast<uint8_t>(instr.rtype.func);
+                case Instruction::REGIMM_OPCODE:
+                    return static_cast<uint8_t>(instr.rtype.rt);
+                default: return static_cast<uint8_t>(instr.general.op);
+            }
+        }
+
+        void record(const Instruction::Type type, const uint8_t op,
+                    const uint64_t ticks) noexcept {
+            Row& row = rows[index(static_cast<std::size_t>(type), op)];
+            ++row.samples;
+            row.total += ticks;
+            ++row.buckets[bucket_of(ticks)];
+        }
+
+        const Row& get_row(const Instruction::Type type,
+                           const uint8_t op) const noexcept {
+            return rows[index(static_cast<std::size_t>(type), op)];
+        }
+
+        void merge(const HandlerProfile& other) noexcept {
+            for (std::size_t i = 0; i < rows.size(); ++i) {
+                rows[i].samples += other.rows[i].samples;
+                rows[i].total += other.rows[i].total;
+                for (std::size_t b = 0; b < BUCKET_COUNT; ++b)
+                    rows[i].buckets[b] += other.rows[i].buckets[b];
+            }
+        }
+
+        void reset() noexcept { std::fill(rows.begin(), rows.end(), Row{}); }
+
+        static std::size_t bucket_of(const uint64_t ticks) noexcept {
+            std::size_t bucket = 0;
+            for (uint64_t rest = ticks; rest != 0; rest >>= 1)
+                ++bucket;
+            return std::min(bucket, BUCKET_COUNT - 1);
+        }
+
+        // One line per handler and op that was sampled, the most total
+        // time first, with the median and 99th percentile as the upper
+        // bound of their bucket and the non-empty buckets as upper
+        // bound:count
+        void write_report(std::ostream& out) const {
+            std::vector<std::size_t> order;
+            for (std::size_t i = 0; i < rows.size(); ++i) {
+                if (rows[i].samples != 0) order.push_back(i);
+            }
+            std::sort(order.begin(), order.end(),
+                      [this](const std::size_t a, const std::size_t b) {
+                          return rows[a].total > rows[b].total;
+                      });
+
+            out << "handler op samples mean p50 p99 histogram\n";
+            for (const std::size_t i : order) {
+                const Row& row = rows[i];
+                out << handler_name(i / OP_COUNT) << " 0x" << std::hex
+                    << i % OP_COUNT << std::dec << ' ' << row.samples << ' '
+                    << row.total / row.samples << ' '
+                    << bucket_limit(percentile(row, 50)) << ' '
+                    << bucket_limit(percentile(row, 99));
+
+                for (std::size_t b = 0; b < BUCKET_COUNT; ++b) {
+                    if (row.buckets[b] != 0)
+                        out << ' ' << bucket_limit(b) << ':' << row.buckets[b];
+                }
+                out << '\n';
+            }
+        }
+
+    private:
+        static std::size_t index(const std::size_t handler,
+                                 const uint8_t op) noexcept {
+            return (handler % HANDLER_COUNT) * OP_COUNT + op % OP_COUNT;
+        }
+
+        // Exclusive upper bound of the bucket's times
+        static uint64_t bucket_limit(const std::size_t bucket) noexcept {
+            return uint64_t(1) << bucket;
+        }
+
+        static std::size_t percentile(const Row& row, const uint64_t percent) {
+            const uint64_t rank = (row.samples * percent + 99) / 100;
+            uint64_t seen = 0;
+            for (std::size_t b = 0; b < BUCKET_COUNT; ++b) {
+                seen += row.buckets[b];
+                if (seen >= rank) return b;
+            }
+            return BUCKET_COUNT - 1;
+        }
+
+        static const char* handler_name(const std::size_t handler) {
+            using Type = Instruction::Type;
+            switch (static_cast<Type>(handler)) {
+                case Type::e_rtype: return "rtype";
+                case Type::e_itype: return "itype";
+                case Type::e_jtype: return "jtype";
+                case Type::e_fpu_rtype: return "fpu_rtype";
+                case Type::e_fpu_btype: return "fpu_btype";
+                case Type::e_fpu_ttype: return "fpu_ttype";
+                case Type::e_special3_type_bshfl: return "special3_bshfl";
+                case Type::e_special3_type_ext: return "special3_ext";
+                case Type::e_special3_type_ins: return "special3_ins";
+                case Type::e_special3_type_rdhwr: return "special3_rdhwr";
+                case Type::e_special3_type_cache: return "special3_cache";
+                case Type::e_regimm_itype: return "regimm";
+                case Type::e_pcrel_type1: return "pcrel1";
+                case Type::e_pcrel_type2: return "pcrel2";
+                case Type::e_longimm_itype: return "longimm_itype";
+                case Type::e_cop0_type: return "cop0";
+                case Type::e_legacy: return "legacy";
+                case Type::e_count: break;
+            }
+            return "unknown";
+        }
+
+        std::vector<Row> rows;
+        uint32_t sample_interval = DEFAULT_SAMPLE_INTERVAL;
+        uint32_t countdown = DEFAULT_SAMPLE_INTERVAL;
+    };
+} // namespace mips_emulator
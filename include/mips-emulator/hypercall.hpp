@@ -0,0 +1,301 @@
+#pragma once
+#include "mips-emulator/memory.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/shadow_memory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+namespace mips_emulator {
+    // Code field of a SYSCALL that calls a host function instead of raising
+    // a system call exception. The function number is in $v0, arguments in
+    // $a0 to $a3 and the result is returned in $v0.
+    constexpr uint32_t HYPERCALL_CODE = 0xCA11;
+
+    // Type erased access to guest memory for host functions. Ranges that are
+    // plain memory are accessed through host pointers in one go, anything
+    // else (MMIO, memcheck, page crossings) a byte at a time through the
+    // memory's read and store.
+    //
+    // On a memory with a Shadow, write and fill clear the labels of the
+    // bytes they write and copy moves them along with the data, so host
+    // functions neither launder nor invent taint. Stores through
+    // get_host_pointer bypass the shadow.
+    class GuestMemory {
+    public:
+        template <typename Memory,
+                  typename = std::enable_if_t<
+                      !std::is_same_v<std::decay_t<Memory>, GuestMemory>>>
+        explicit GuestMemory(Memory& memory)
+            : memory(&memory), host_pointer(&host_pointer_of<Memory>),
+              read_byte(&read_byte_of<Memory>),
+              store_byte(&store_byte_of<Memory>), shadow(shadow_of(memory)) {}
+
+        // Host pointer to size bytes at address, nullptr if they can't be
+        // accessed directly
+        uint8_t* get_host_pointer(const uint32_t address, const uint32_t size,
+                                  const bool for_store) const {
+            return host_pointer(memory, address, size, for_store);
+        }
+
+        // read and write stop at the first byte that faults, what was
+        // written up to there stays written
+        [[nodiscard]] bool read(const uint32_t address, void* data,
+                                const uint32_t size) const {
+            if (size == 0) return true;
+            if (const uint8_t* host = get_host_pointer(address, size, false)) {
+                std::memcpy(data, host, size);
+                return true;
+            }
+
+            auto* bytes = static_cast<uint8_t*>(data);
+            for (uint32_t i = 0; i < size; ++i) {
+                if (!read_byte(memory, address + i, bytes[i])) return false;
+            }
+            return true;
+        }
+
+        // Labels of a partial write are left alone, which can only
+        // overtaint
+        [[nodiscard]] bool write(const uint32_t address, const void* data,
+                                 const uint32_t size) const {
+            if (!store(address, data, size)) return false;
+            if (shadow) shadow->untaint(address, size);
+            return true;
+        }
+
+        // Like memset within the guest
+        [[nodiscard]] bool fill(const uint32_t address, const uint8_t value,
+                                const uint32_t size) const {
+            if (uint8_t* host = get_host_pointer(address, size, true)) {
+                std::memset(host, value, size);
+                if (shadow) shadow->untaint(address, size);
+                return true;
+            }
+
+            uint8_t chunk[256];
+            std::memset(chunk, value, sizeof(chunk));
+            for (uint32_t done = 0; done < size;) {
+                const uint32_t length =
+                    std::min<uint32_t>(sizeof(chunk), size - done);
+                if (!write(address + done, chunk, length)) return false;
+                done += length;
+            }
+            return true;
+        }
+
+        // Like memmove within the guest
+        [[nodiscard]] bool copy(const uint32_t destination,
+                                const uint32_t source,
+                                const uint32_t size) const {
+            if (size == 0) return true;
+
+            const uint8_t* from = get_host_pointer(source, size, false);
+            uint8_t* to = get_host_pointer(destination, size, true);
+            if (from && to) {
+                std::memmove(to, from, size);
+                if (shadow) shadow->copy(destination, source, size);
+                return true;
+            }
+
+            // Backwards if the destination overlaps the end of the source
+            const bool backwards =
+                destination > source && destination - source < size;
+
+            uint8_t chunk[256];
+            for (uint32_t done = 0; done < size;) {
+                const uint32_t length =
+                    std::min<uint32_t>(sizeof(chunk), size - done);
+                const uint32_t offset =
+                    backwards ? size - done - length : done;
+                if (!read(source + offset, chunk, length)) return false;
+
+                // Labels move even if the write failed part way, which can
+                // only overtaint
+                const bool written = store(destination + offset, chunk, length);
+                if (shadow)
+                    shadow->copy(destination + offset, source + offset, length);
+                if (!written) return false;
+                done += length;
+            }
+            return true;
+        }
+
+    private:
+        bool store(const uint32_t address, const void* data,
+                   const uint32_t size) const {
+            if (size == 0) return true;
+            if (uint8_t* host = get_host_pointer(address, size, true)) {
+                std::memcpy(host, data, size);
+                return true;
+            }
+
+            const auto* bytes = static_cast<const uint8_t*>(data);
+            for (uint32_t i = 0; i < size; ++i) {
+                if (!store_byte(memory, address + i, bytes[i])) return false;
+            }
+            return true;
+        }
+
+        template <typename Memory>
+        static Shadow* shadow_of(Memory& memory) {
+            if constexpr (has_shadow<Memory>::value) {
+                return &memory.get_shadow();
+            }
+            else {
+                (void)memory;
+                return nullptr;
+            }
+        }
+
+        template <typename Memory>
+        static uint8_t* host_pointer_of(void* memory, const uint32_t address,
+                                        const uint32_t size,
+                                        const bool for_store) {
+            if constexpr (has_host_pointer<Memory>::value) {
+                return static_cast<Memory*>(memory)->get_host_pointer(
+                    address, size, for_store);
+            }
+            else {
+                return nullptr;
+            }
+        }
+
+        template <typename Memory>
+        static bool read_byte_of(void* memory, const uint32_t address,
+                                 uint8_t& value) {
+            const auto result =
+                static_cast<Memory*>(memory)->template read<uint8_t>(address);
+            if (result.is_error()) return false;
+            value = result.get_value();
+            return true;
+        }
+
+        template <typename Memory>
+        static bool store_byte_of(void* memory, const uint32_t address,
+                                  const uint8_t value) {
+            return !static_cast<Memory*>(memory)
+                        ->template store<uint8_t>(address, value)
+                        .is_error();
+        }
+
+        void* memory;
+        uint8_t* (*host_pointer)(void*, uint32_t, uint32_t, bool);
+        bool (*read_byte)(void*, uint32_t, uint8_t&);
+        bool (*store_byte)(void*, uint32_t, uint8_t);
+        Shadow* shadow;
+    };
+
+    // What a host function sees of the guest
+    class HypercallContext {
+    public:
+        HypercallContext(const RegisterFile& reg_file, GuestMemory memory)
+            : reg_file(reg_file), memory(memory) {}
+
+        // $a0 to $a3
+        uint32_t get_argument(const uint8_t index) const noexcept {
+            return reg_file.get(static_cast<uint8_t>(4 + (index & 3))).u;
+        }
+
+        GuestMemory& get_memory() noexcept { return memory; }
+
+        // Written to $v0 if the call succeeds
+        void set_result(const uint32_t value) noexcept { result = value; }
+        uint32_t get_result() const noexcept { return result; }
+
+    private:
+        const RegisterFile& reg_file;
+        GuestMemory memory;
+        uint32_t result = 0;
+    };
+
+    // Returns false if the call failed, e.g. on a bad guest buffer. The
+    // SYSCALL then fails like an instruction whose access faulted.
+    using Hypercall = std::function<bool(HypercallContext&)>;
+
+    // Numbers of the functions added by HypercallTable::add_builtins
+    enum class BuiltinHypercall : uint32_t {
+        e_memmove = 0, // (destination, source, size) -> destination
+        e_memset = 1,  // (destination, byte, size) -> destination
+        e_fnv1a = 2,   // (buffer, size) -> 32-bit FNV-1a hash
+    };
+
+    // Host functions the guest can call by number, see HYPERCALL_CODE and
+    // Emulator::set_hypercalls. Numbers index a vector, so keep them small.
+    class HypercallTable {
+    public:
+        void add(const uint32_t number, Hypercall function) {
+            if (number >= functions.size()) functions.resize(number + 1);
+            functions[number] = std::move(function);
+        }
+
+        void add(const BuiltinHypercall number, Hypercall function) {
+            add(static_cast<uint32_t>(number), std::move(function));
+        }
+
+        // nullptr if nothing was added as number
+        const Hypercall* find(const uint32_t number) const noexcept {
+            if (number >= functions.size() || !functions[number])
+                return nullptr;
+            return &functions[number];
+        }
+
+        void add_builtins() {
+            add(BuiltinHypercall::e_memmove, [](HypercallContext& context) {
+                const uint32_t destination = context.get_argument(0);
+                context.set_result(destination);
+                return context.get_memory().copy(destination,
+                                                 context.get_argument(1),
+                                                 context.get_argument(2));
+            });
+
+            add(BuiltinHypercall::e_memset, [](HypercallContext& context) {
+                const uint32_t destination = context.get_argument(0);
+                const auto value =
+                    static_cast<uint8_t>(context.get_argument(1));
+                context.set_result(destination);
+                return context.get_memory().fill(destination, value,
+                                                 context.get_argument(2));
+            });
+
+            add(BuiltinHypercall::e_fnv1a, [](HypercallContext& context) {
+                const uint32_t buffer = context.get_argument(0);
+                const uint32_t size = context.get_argument(1);
+
+                uint32_t hash = 2166136261;
+                const auto update = [&](const uint8_t* bytes,
+                                        const uint32_t length) {
+                    for (uint32_t i = 0; i < length; ++i)
+                        hash = (hash ^ bytes[i]) * 16777619;
+                };
+
+                auto& memory = context.get_memory();
+                if (const uint8_t* host =
+                        memory.get_host_pointer(buffer, size, false)) {
+                    update(host, size);
+                }
+                else {
+                    uint8_t chunk[256];
+                    for (uint32_t done = 0; done < size;) {
+                        const uint32_t length =
+                            std::min<uint32_t>(sizeof(chunk), size - done);
+                        if (!memory.read(buffer + done, chunk, length))
+                            return false;
+                        update(chunk, length);
+                        done += length;
+                    }
+                }
+
+                context.set_result(hash);
+                return true;
+            });
+        }
+
+    private:
+        std::vector<Hypercall> functions;
+    };
+} // namespace mips_emulator
@@ -23,6 +23,13 @@
 #endif
 
 namespace mips_emulator {
+    // ISA revision, selected at compile time by the decoder and Executor.
+    // MIPS32r6 removed or reassigned several MIPS32r2 encodings.
+    enum class Isa : uint8_t {
+        e_mips32r6,
+        e_mips32r2,
+    };
+
     union Instruction {
         enum class Type {
             e_rtype,
@@ -34,10 +41,15 @@ namespace mips_emulator {
             e_special3_type_bshfl,
             e_special3_type_ext,
             e_special3_type_ins,
+            e_special3_type_rdhwr,
+            e_special3_type_cache,
             e_regimm_itype,
             e_pcrel_type1,
             e_pcrel_type2,
             e_longimm_itype,
+            e_cop0_type,
+            e_legacy, // MIPS32r2 only, see LegacyFunc etc
+            e_count,  // Number of types, not a type
         };
 
         enum class Func : uint8_t {
@@ -73,6 +85,54 @@ namespace mips_emulator {
             e_tlt = 0b110010,
             e_tltu = 0b110011,
             e_tne = 0b110110,
+            e_syscall = 0b001100, // 20 bit code in rs, rt, rd and shamt
+        };
+
+        // MIPS32r2 R-Type instructions removed in r6. MULT to DIVU share
+        // their func with SOP30 to SOP33 and have shamt 0.
+        enum class LegacyFunc : uint8_t {
+            e_movz = 10,
+            e_movn = 11,
+            e_mfhi = 16,
+            e_mthi = 17,
+            e_mflo = 18,
+            e_mtlo = 19,
+            e_mult = 24,
+            e_multu = 25,
+            e_div = 26,
+            e_divu = 27,
+        };
+
+        // MIPS32r2 SPECIAL2 instructions, R-Type layout
+        enum class Special2Func : uint8_t {
+            e_madd = 0,
+            e_maddu = 1,
+            e_mul = 2,
+            e_msub = 4,
+            e_msubu = 5,
+            e_clz = 32,
+            e_clo = 33,
+        };
+
+        // MIPS32r2 I-Type instructions removed or reassigned in r6
+        enum class LegacyITypeOpcode : uint8_t {
+            e_addi = 8, // POP10 in r6
+            e_beql = 20,
+            e_bnel = 21,
+            e_blezl = 22, // POP26 in r6
+            e_bgtzl = 23, // POP27 in r6
+            e_lwl = 34,
+            e_lwr = 38,
+            e_swl = 42,
+            e_swr = 46,
+            e_cache = 47, // SPECIAL3 in r6, with a 9 bit offset
+        };
+
+        enum class LegacyRegimmOp : uint8_t {
+            e_bltzl = 2,
+            e_bgezl = 3,
+            e_bltzal = 16,
+            e_bgezal = 17,
         };
 
         // Enum for FPUR-type instructions
@@ -155,6 +215,20 @@ namespace mips_emulator {
             e_cop2 = 0b010010,
         };
 
+        // rs field of coprocessor 0 instructions
+        enum class COP0Op : uint8_t {
+            e_mf = 0,
+            e_mt = 4,
+            e_co = 16, // Any value with the top bit set, see COP0Func
+        };
+
+        enum class COP0Func : uint8_t {
+            e_tlbr = 1,
+            e_tlbwi = 2,
+            e_tlbwr = 6,
+            e_tlbp = 8,
+        };
+
         enum class FPUTTypeOp {
             e_mf = 0,
             e_cf = 2,
@@ -184,6 +258,16 @@ namespace mips_emulator {
             e_ext = 0,
             e_ins = 0b000100,
             e_bshfl = 0b100000,
+            e_rdhwr = 0b111011,
+            e_cache = 0b100101, // Operation in rt, 9 bit offset above func
+        };
+
+        // Hardware registers read by RDHWR (the rd field)
+        enum class HardwareRegister : uint8_t {
+            e_synci_step = 1, // Bytes SYNCI and CACHE lines cover
+            e_cc = 2,         // Cycle counter, the low bits of CP0 Count
+            e_cc_res = 3,     // Cycles per Count increment
+            e_ulr = 29,       // UserLocal, the thread pointer on Linux
         };
 
         // Opcode enum for special3 bshfl instructions
@@ -205,6 +289,7 @@ namespace mips_emulator {
         enum class RegimmITypeOp : uint8_t {
             e_bgez = 1,
             e_bltz = 0,
+            e_synci = 0b11111,
         };
 
         // PC-relative functions
@@ -275,6 +360,17 @@ namespace mips_emulator {
             uint32_t cop1 : 6;
         });
 
+        // Coprocessor 0 struct, for MFC0/MTC0. CO instructions only use
+        // the top bit of op and func (the RType func field)
+        PACKED(struct COP0Type {
+            uint32_t sel : 3;
+            uint32_t zero : 8;
+            uint32_t rd : 5;
+            uint32_t rt : 5;
+            uint32_t op : 5;
+            uint32_t cop0 : 6;
+        });
+
         // Special3 structs
         PACKED(struct Special3Type {
             uint32_t func : 6;
@@ -358,6 +454,8 @@ namespace mips_emulator {
                       "Instruction::FPUIType bitfield is not 4 bytes in size");
         static_assert(sizeof(FPUTType) == 4,
                       "Instruction::FPUTType bitfield is not 4 bytes in size");
+        static_assert(sizeof(COP0Type) == 4,
+                      "Instruction::COP0Type bitfield is not 4 bytes in size");
         static_assert(
             sizeof(Special3Type) == 4,
             "Instruction::Special3Type bitfield is not 4 bytes in size");
@@ -382,6 +480,7 @@ namespace mips_emulator {
 
         static constexpr uint8_t RTYPE_OPCODE = 0;
         static constexpr uint8_t REGIMM_OPCODE = 1;
+        static constexpr uint8_t SPECIAL2_OPCODE = 28;
         static constexpr uint8_t SPECIAL3_OPCODE = 31;
         static constexpr uint8_t PCREL_OPCODE = 59;
 
@@ -456,6 +555,65 @@ namespace mips_emulator {
             fpu_ttype.zero = 0;
         }
 
+        // COP0 move
+        Instruction(const COP0Op op, const RegisterName rt, const uint8_t rd,
+                    const uint8_t sel = 0) {
+            cop0_type.cop0 = static_cast<uint8_t>(COPOpcode::e_cop0);
+            cop0_type.op = static_cast<uint8_t>(op);
+            cop0_type.rt = static_cast<uint8_t>(rt);
+            cop0_type.rd = rd & 31;
+            cop0_type.zero = 0;
+            cop0_type.sel = sel & 7;
+        }
+
+        // COP0 CO
+        Instruction(const COP0Func func) {
+            raw = 0;
+            cop0_type.cop0 = static_cast<uint8_t>(COPOpcode::e_cop0);
+            cop0_type.op = static_cast<uint8_t>(COP0Op::e_co);
+            rtype.func = static_cast<uint8_t>(func);
+        }
+
+        // MIPS32r2 R-Type
+        Instruction(const LegacyFunc func, const RegisterName rd,
+                    const RegisterName rs, const RegisterName rt) {
+            rtype.zero = RTYPE_OPCODE;
+            rtype.func = static_cast<uint8_t>(func);
+            rtype.rd = static_cast<uint8_t>(rd);
+            rtype.rs = static_cast<uint8_t>(rs);
+            rtype.rt = static_cast<uint8_t>(rt);
+            rtype.shamt = 0;
+        }
+
+        // MIPS32r2 SPECIAL2
+        Instruction(const Special2Func func, const RegisterName rd,
+                    const RegisterName rs, const RegisterName rt) {
+            rtype.zero = SPECIAL2_OPCODE;
+            rtype.func = static_cast<uint8_t>(func);
+            rtype.rd = static_cast<uint8_t>(rd);
+            rtype.rs = static_cast<uint8_t>(rs);
+            rtype.rt = static_cast<uint8_t>(rt);
+            rtype.shamt = 0;
+        }
+
+        // MIPS32r2 I-Type
+        Instruction(const LegacyITypeOpcode opcode, const RegisterName rt,
+                    const RegisterName rs, const uint16_t immediate) {
+            itype.op = static_cast<uint8_t>(opcode);
+            itype.rt = static_cast<uint8_t>(rt);
+            itype.rs = static_cast<uint8_t>(rs);
+            itype.imm = immediate;
+        }
+
+        // MIPS32r2 Regimm I-Type
+        Instruction(const LegacyRegimmOp opcode, const RegisterName rs,
+                    const uint16_t immediate) {
+            regimm_itype.op = static_cast<uint8_t>(opcode);
+            regimm_itype.rs = static_cast<uint8_t>(rs);
+            regimm_itype.imm = immediate;
+            regimm_itype.regimm = REGIMM_OPCODE;
+        }
+
         // raw
         Instruction(const uint32_t value) { raw = value; }
 
@@ -518,7 +676,17 @@ namespace mips_emulator {
             pcrel_type2.imm = immediate;
         }
 
+        template <Isa isa = Isa::e_mips32r6>
         inline Result<Type, void> get_type() const {
+            // NOTE: Compiled out for r6, which keeps its decode path as is
+            if constexpr (isa == Isa::e_mips32r2) {
+                switch (get_legacy_decoding()) {
+                    case LegacyDecoding::e_legacy: return Type::e_legacy;
+                    case LegacyDecoding::e_reserved: return {};
+                    case LegacyDecoding::e_common: break;
+                }
+            }
+
             switch (general.op) {
                     // R-Type
                 case RTYPE_OPCODE:
@@ -570,6 +738,10 @@ namespace mips_emulator {
                             return Type::e_special3_type_ext;
                         case Special3Func::e_ins:
                             return Type::e_special3_type_ins;
+                        case Special3Func::e_rdhwr:
+                            return Type::e_special3_type_rdhwr;
+                        case Special3Func::e_cache:
+                            return Type::e_special3_type_cache;
                     }
                     break;
                 }
@@ -584,6 +756,9 @@ namespace mips_emulator {
                     }
                 }
 
+                    // Coprocessor 0
+                case 16: return Type::e_cop0_type;
+
                     // Coprocessor 1
                 case 17: {
                     if (fpu_rtype.fmt & 0b10000) return Type::e_fpu_rtype;
@@ -605,6 +780,91 @@ namespace mips_emulator {
             return Result<Type, void>();
         }
 
+        enum class LegacyDecoding : uint8_t {
+            e_common,   // Same meaning in r2 and r6
+            e_legacy,   // MIPS32r2 instruction
+            e_reserved, // r6 only, reserved in r2
+        };
+
+        // How a MIPS32r2 decoder treats the instruction
+        inline LegacyDecoding get_legacy_decoding() const {
+            switch (general.op) {
+                case RTYPE_OPCODE: {
+                    switch (static_cast<LegacyFunc>(rtype.func)) {
+                        case LegacyFunc::e_movz:
+                        case LegacyFunc::e_movn:
+                        case LegacyFunc::e_mfhi:
+                        case LegacyFunc::e_mthi:
+                        case LegacyFunc::e_mflo:
+                        case LegacyFunc::e_mtlo:
+                            return LegacyDecoding::e_legacy;
+
+                        case LegacyFunc::e_mult:
+                        case LegacyFunc::e_multu:
+                        case LegacyFunc::e_div:
+                        case LegacyFunc::e_divu:
+                            return rtype.shamt == 0
+                                       ? LegacyDecoding::e_legacy
+                                       : LegacyDecoding::e_reserved;
+                    }
+                    return LegacyDecoding::e_common;
+                }
+
+                case SPECIAL2_OPCODE: return LegacyDecoding::e_legacy;
+
+                // CACHE moved to SPECIAL3 in r6, r2 has it at opcode 47
+                case SPECIAL3_OPCODE:
+                    return static_cast<Special3Func>(special3_type.func) ==
+                                   Special3Func::e_cache
+                               ? LegacyDecoding::e_reserved
+                               : LegacyDecoding::e_common;
+
+                case REGIMM_OPCODE: {
+                    switch (static_cast<LegacyRegimmOp>(regimm_itype.op)) {
+                        case LegacyRegimmOp::e_bltzl:
+                        case LegacyRegimmOp::e_bgezl:
+                        case LegacyRegimmOp::e_bltzal:
+                        case LegacyRegimmOp::e_bgezal:
+                            return LegacyDecoding::e_legacy;
+                    }
+                    return LegacyDecoding::e_common;
+                }
+
+                case 8:  // ADDI
+                case 20: // BEQL
+                case 21: // BNEL
+                case 34: // LWL
+                case 38: // LWR
+                case 42: // SWL
+                case 46: // SWR
+                case 47: // CACHE
+                    return LegacyDecoding::e_legacy;
+
+                // BLEZL/BGTZL require rt to be zero, r6 reuses the others
+                // for compact branches
+                case 22:
+                case 23:
+                    return itype.rt == 0 ? LegacyDecoding::e_legacy
+                                         : LegacyDecoding::e_reserved;
+
+                // BLEZ/BGTZ are shared, the compact branches aren't
+                case 6:
+                case 7:
+                    return itype.rt == 0 ? LegacyDecoding::e_common
+                                         : LegacyDecoding::e_reserved;
+
+                case 24: // POP30
+                case 50: // BC, LWC2 in r2
+                case 54: // POP66, LDC2 in r2
+                case 58: // BALC, SWC2 in r2
+                case 59: // PC relative
+                case 62: // POP76, SDC2 in r2
+                    return LegacyDecoding::e_reserved;
+
+                default: return LegacyDecoding::e_common;
+            }
+        }
+
         uint32_t raw = 0;
         General general;
 
@@ -616,6 +876,8 @@ namespace mips_emulator {
         FPUTType fpu_ttype;
         FPUBType fpu_btype;
 
+        COP0Type cop0_type;
+
         Special3Type special3_type;
         Special3TypeBSHFL special3_type_bshfl;
         Special3TypeEXT special3_type_ext;
@@ -0,0 +1,73 @@
+#pragma once
+#include "mips-emulator/register_file.hpp"
+
+#include <cstdint>
+
+namespace mips_emulator {
+    // Detects programs that are stuck in a loop, see Emulator::run.
+    //
+    // Stores are folded into a rolling hash as they happen. Every
+    // check_interval backward branches the state (PC, registers and the hash
+    // of the stores since the last check) is hashed and compared to the
+    // state of the previous check. If they are equal the registers are the
+    // same and the stores since the last check wrote the same values to the
+    // same addresses as the ones before it, so memory is unchanged too and
+    // the program will repeat the same interval forever. Loops whose period
+    // divides check_interval backward branches are caught.
+    //
+    // NOTE: MMIO reads aren't part of the state, a program polling a device
+    // would be reported as stuck.
+    class LoopDetector {
+    public:
+        explicit LoopDetector(const uint32_t check_interval = 1)
+            : check_interval(check_interval ? check_interval : 1) {}
+
+        void record_store(const uint32_t address, const uint32_t value,
+                          const uint8_t size) noexcept {
+            write_hash = (write_hash ^ mix(address, value, size)) * PRIME;
+        }
+
+        // Called after a taken backward branch, returns true when the state
+        // repeats
+        [[nodiscard]] bool check(const RegisterFile& reg_file) noexcept {
+            if (++branches < check_interval) return false;
+            branches = 0;
+
+            uint64_t hash = (OFFSET ^ reg_file.get_pc()) * PRIME;
+            for (uint8_t i = 1; i < RegisterFile::REGISTER_COUNT; ++i)
+                hash = (hash ^ reg_file.get(i).u) * PRIME;
+            hash = (hash ^ reg_file.get_hi()) * PRIME;
+            hash = (hash ^ reg_file.get_lo()) * PRIME;
+            hash = (hash ^ write_hash) * PRIME;
+
+            const bool repeated = has_previous && hash == previous;
+            previous = hash;
+            has_previous = true;
+            write_hash = OFFSET;
+            return repeated;
+        }
+
+        void reset() noexcept {
+            write_hash = OFFSET;
+            branches = 0;
+            has_previous = false;
+        }
+
+    private:
+        // FNV-1a parameters, applied per word
+        static constexpr uint64_t OFFSET = 0xcbf29ce484222325ULL;
+        static constexpr uint64_t PRIME = 0x100000001b3ULL;
+
+        static uint64_t mix(const uint32_t address, const uint32_t value,
+                            const uint8_t size) noexcept {
+            return (uint64_t(address) << 32 | value) ^ (uint64_t(size) << 61);
+        }
+
+        uint32_t check_interval;
+        uint32_t branches = 0;
+
+        uint64_t write_hash = OFFSET;
+        uint64_t previous = 0;
+        bool has_previous = false;
+    };
+} // namespace mips_emulator
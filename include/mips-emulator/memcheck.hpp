@@ -0,0 +1,441 @@
+#pragma once
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/register_name.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mips_emulator {
+    // State of a guest byte, two bits: addressable and defined
+    enum class Validity : uint8_t {
+        e_no_access = 0, // Redzones, freed blocks
+        e_undefined = 1, // Addressable but never written
+        e_defined = 3,
+    };
+
+    struct MemcheckError {
+        enum class Kind : uint8_t {
+            e_invalid_read,
+            e_invalid_write,
+            e_uninitialised_read,
+            e_invalid_free,
+        };
+
+        Kind kind;
+        uint32_t pc;
+        uint32_t address;
+        uint32_t size;
+        // The heap block next to address, if any
+        uint32_t block = 0;
+        uint32_t block_size = 0;
+        bool freed = false;
+    };
+
+    // Finds reads of uninitialised memory and accesses outside of heap
+    // blocks, see Emulator::set_memcheck.
+    //
+    // Every guest byte has a Validity, kept as 2 bits in 64 KiB pages that
+    // are allocated on first change, so an aligned word is checked with one
+    // shadow byte. Pages that were never changed have the default validity.
+    //
+    // The guest's malloc and free are intercepted at their entry points:
+    // malloc is asked for redzone bytes more on both sides of the block,
+    // the block is marked undefined and the redzones inaccessible. Freed
+    // blocks stay inaccessible until malloc returns them again, and free of
+    // anything that isn't a live block is reported and turned into
+    // free(NULL). Accesses made by the allocator itself aren't checked.
+    //
+    // Like Valgrind, the stack follows $sp: when it moves down the bytes
+    // below the old $sp become undefined, when it moves up the bytes it
+    // leaves become inaccessible, so a new frame is undefined even if an
+    // earlier one wrote the same bytes. Moves larger than
+    // Options::stack_switch are taken as a switch to another stack and
+    // change nothing. A zero $sp means no stack has been set up yet.
+    //
+    // NOTE: Unlike Valgrind, a read of undefined bytes is reported when it
+    // happens, not when the value is used, so copying a partly initialised
+    // struct is reported too.
+    class Memcheck {
+    public:
+        struct Options {
+            uint32_t redzone = 16;
+            // Of memory that was never marked, e.g. loaded segments
+            Validity default_validity = Validity::e_defined;
+            // Accesses that are reported fail, which stops the emulator
+            bool stop_on_error = true;
+            bool track_stack = true;
+            uint32_t stack_switch = 2 * 1024 * 1024; // Bytes
+            // Freed blocks that are kept to describe errors, the oldest are
+            // forgotten first
+            std::size_t freed_history = 4096;
+        };
+
+        Memcheck() : Memcheck(Options{}) {}
+        explicit Memcheck(const Options& options)
+            : options(options), pages(PAGE_COUNT) {}
+
+        // Intercepts the functions with these names, returns false if the
+        // ELF has no such symbols
+        [[nodiscard]] bool intercept(const ElfFile& elf,
+                                     const std::string& malloc_name = "malloc",
+                                     const std::string& free_name = "free") {
+            const auto* malloc_symbol = elf.find_symbol(malloc_name);
+            const auto* free_symbol = elf.find_symbol(free_name);
+            if (!malloc_symbol || !free_symbol) return false;
+
+            set_allocator(malloc_symbol->address, free_symbol->address);
+            return true;
+        }
+
+        void set_allocator(const uint32_t malloc, const uint32_t free) {
+            malloc_address = malloc;
+            free_address = free;
+            intercepting = true;
+        }
+
+        // E.g. memory below the initial $sp as inaccessible
+        void set_validity(const uint32_t address, const uint32_t size,
+                          const Validity validity) {
+            for (uint32_t i = 0; i < size; ++i)
+                set(address + i, validity);
+        }
+
+        Validity get_validity(const uint32_t address) const {
+            const Page* page = pages[address >> PAGE_BITS].get();
+            if (!page) return options.default_validity;
+            return static_cast<Validity>(get_bits(*page, address));
+        }
+
+        // Called by the Emulator before every instruction, follows $sp and
+        // catches calls to and returns from the allocator
+        void before_instruction(RegisterFile& reg_file) {
+            pc = reg_file.get_pc();
+            if (options.track_stack)
+                track_stack(reg_file.get(RegisterName::e_sp).u);
+            if (!intercepting) return;
+
+            if (!calls.empty() && pc == calls.back().return_address) {
+                if (calls.back().is_malloc) finish_malloc(reg_file);
+                calls.pop_back();
+                return;
+            }
+
+            if (pc == malloc_address) {
+                const uint32_t size = reg_file.get(RegisterName::e_a0).u;
+                calls.push_back(
+                    {reg_file.get(RegisterName::e_ra).u, size, true});
+                reg_file.set_unsigned(RegisterName::e_a0,
+                                      size + 2 * options.redzone);
+            }
+            else if (pc == free_address) {
+                start_free(reg_file);
+                calls.push_back({reg_file.get(RegisterName::e_ra).u, 0, false});
+            }
+        }
+
+        // Returns false if the read should fail
+        [[nodiscard]] bool check_read(const uint32_t address,
+                                      const uint32_t size) {
+            if (!calls.empty()) return true;
+
+            uint8_t all = 3;
+            if (const uint8_t* bits = word_bits(address, size)) {
+                if (*bits == 0xFF) return true;
+                all = (*bits & 0x55) == 0x55 ? 1 : 0;
+            }
+            else {
+                for (uint32_t i = 0; i < size; ++i)
+                    all &= static_cast<uint8_t>(get_validity(address + i));
+                if (all == 3) return true;
+            }
+
+            return report(all == 0 ? MemcheckError::Kind::e_invalid_read
+                                   : MemcheckError::Kind::e_uninitialised_read,
+                          address, size);
+        }
+
+        // Returns false if the store should fail, otherwise the bytes are
+        // defined from now on
+        [[nodiscard]] bool check_write(const uint32_t address,
+                                       const uint32_t size) {
+            if (!calls.empty()) return true;
+
+            if (const uint8_t* bits = word_bits(address, size)) {
+                if (*bits == 0xFF) return true;
+                if ((*bits & 0x55) == 0x55) {
+                    set_validity(address, size, Validity::e_defined);
+                    return true;
+                }
+            }
+            else {
+                bool addressable = true;
+                for (uint32_t i = 0; i < size; ++i) {
+                    addressable &=
+                        get_validity(address + i) != Validity::e_no_access;
+                }
+                if (addressable) {
+                    set_validity(address, size, Validity::e_defined);
+                    return true;
+                }
+            }
+
+            return report(MemcheckError::Kind::e_invalid_write, address, size);
+        }
+
+        const std::vector<MemcheckError>& get_errors() const noexcept {
+            return errors;
+        }
+
+        // Live heap blocks, user address to size
+        const std::map<uint32_t, uint32_t>& get_blocks() const noexcept {
+            return blocks;
+        }
+
+        // Freed blocks that are still remembered
+        std::size_t get_freed_count() const noexcept { return freed.size(); }
+
+        void write_report(std::ostream& out) const {
+            for (const MemcheckError& error : errors) {
+                out << kind_name(error.kind);
+                if (error.kind != MemcheckError::Kind::e_invalid_free)
+                    out << " of size " << error.size;
+                out << " at 0x" << std::hex << error.address << " (pc 0x"
+                    << error.pc << ")\n";
+                describe(out, error);
+                out << std::dec;
+            }
+            out << errors.size() << " errors, " << blocks.size()
+                << " blocks in use\n";
+        }
+
+    private:
+        static constexpr uint32_t PAGE_BITS = 16;
+        static constexpr uint32_t PAGE_SIZE = 1U << PAGE_BITS;
+        static constexpr uint32_t PAGE_COUNT = 1U << (32 - PAGE_BITS);
+
+        // 4 bytes per shadow byte, byte i of a word in bits 2i and 2i+1
+        struct Page {
+            uint8_t bits[PAGE_SIZE / 4];
+        };
+
+        struct Call {
+            uint32_t return_address;
+            uint32_t size;
+            bool is_malloc;
+        };
+
+        struct FreedBlock {
+            uint32_t size;
+            uint64_t serial; // Tells repeated frees of an address apart
+        };
+
+        static uint32_t size_of(const uint32_t size) { return size; }
+        static uint32_t size_of(const FreedBlock& block) { return block.size; }
+
+        static uint8_t get_bits(const Page& page, const uint32_t address) {
+            const uint32_t offset = address & (PAGE_SIZE - 1);
+            return (page.bits[offset >> 2] >> ((offset & 3) * 2)) & 3;
+        }
+
+        // The shadow byte of an aligned word access, if its page exists
+        const uint8_t* word_bits(const uint32_t address,
+                                 const uint32_t size) const {
+            if (size != 4 || (address & 3) != 0) return nullptr;
+            const Page* page = pages[address >> PAGE_BITS].get();
+            if (!page) return nullptr;
+            return &page->bits[(address & (PAGE_SIZE - 1)) >> 2];
+        }
+
+        void set(const uint32_t address, const Validity validity) {
+            auto& page = pages[address >> PAGE_BITS];
+            if (!page) {
+                if (validity == options.default_validity) return;
+                page = std::make_unique<Page>();
+                const uint8_t fill =
+                    static_cast<uint8_t>(options.default_validity) * 0x55;
+                std::memset(page.get(), fill, sizeof(Page));
+            }
+
+            const uint32_t offset = address & (PAGE_SIZE - 1);
+            const uint32_t shift = (offset & 3) * 2;
+            uint8_t& bits = page->bits[offset >> 2];
+            bits = static_cast<uint8_t>((bits & ~(3U << shift)) |
+                                        (uint32_t(validity) << shift));
+        }
+
+        void track_stack(const uint32_t sp) {
+            if (stack_pointer == 0 || sp == 0) {
+                stack_pointer = sp;
+                return;
+            }
+            if (sp == stack_pointer) return;
+
+            const uint32_t low = std::min(sp, stack_pointer);
+            const uint32_t distance = std::max(sp, stack_pointer) - low;
+            if (distance <= options.stack_switch) {
+                set_validity(low, distance,
+                             sp < stack_pointer ? Validity::e_undefined
+                                                : Validity::e_no_access);
+            }
+            stack_pointer = sp;
+        }
+
+        void finish_malloc(RegisterFile& reg_file) {
+            const uint32_t base = reg_file.get(RegisterName::e_v0).u;
+            if (base == 0) return;
+
+            const uint32_t size = calls.back().size;
+            const uint32_t user = base + options.redzone;
+            set_validity(base, options.redzone, Validity::e_no_access);
+            set_validity(user, size, Validity::e_undefined);
+            set_validity(user + size, options.redzone, Validity::e_no_access);
+
+            blocks[user] = size;
+            forget_freed(base, uint64_t(size) + 2 * options.redzone);
+            reg_file.set_unsigned(RegisterName::e_v0, user);
+        }
+
+        // Freed blocks whose memory, redzones included, overlaps
+        // [base, base + size) were handed out again
+        void forget_freed(const uint32_t base, const uint64_t size) {
+            auto block = freed.upper_bound(base);
+            if (block != freed.begin()) {
+                const auto previous = std::prev(block);
+                if (uint64_t(previous->first) + previous->second.size +
+                        options.redzone >
+                    base)
+                    block = previous;
+            }
+            while (block != freed.end() &&
+                   block->first - options.redzone < base + size)
+                block = freed.erase(block);
+        }
+
+        void remember_freed(const uint32_t user, const uint32_t size) {
+            freed[user] = {size, ++freed_serial};
+            freed_order.emplace_back(user, freed_serial);
+
+            while (freed.size() > options.freed_history) {
+                const auto oldest = freed_order.front();
+                freed_order.pop_front();
+
+                // Skips entries of blocks that were forgotten, or freed
+                // again and queued further back
+                const auto block = freed.find(oldest.first);
+                if (block != freed.end() &&
+                    block->second.serial == oldest.second)
+                    freed.erase(block);
+            }
+
+            // Forgotten blocks leave entries behind, drop them once they
+            // outnumber the blocks
+            if (freed_order.size() > 2 * freed.size() + 64) {
+                std::deque<std::pair<uint32_t, uint64_t>> order;
+                for (const auto& entry : freed_order) {
+                    const auto block = freed.find(entry.first);
+                    if (block != freed.end() &&
+                        block->second.serial == entry.second)
+                        order.push_back(entry);
+                }
+                freed_order.swap(order);
+            }
+        }
+
+        void start_free(RegisterFile& reg_file) {
+            const uint32_t user = reg_file.get(RegisterName::e_a0).u;
+            if (user == 0) return;
+
+            const auto block = blocks.find(user);
+            if (block == blocks.end()) {
+                report(MemcheckError::Kind::e_invalid_free, user, 0);
+                reg_file.set_unsigned(RegisterName::e_a0, 0);
+                return;
+            }
+
+            set_validity(user - options.redzone,
+                         block->second + 2 * options.redzone,
+                         Validity::e_no_access);
+            remember_freed(user, block->second);
+            blocks.erase(block);
+            reg_file.set_unsigned(RegisterName::e_a0, user - options.redzone);
+        }
+
+        bool report(const MemcheckError::Kind kind, const uint32_t address,
+                    const uint32_t size) {
+            MemcheckError error{kind, pc, address, size};
+            if (!find_block(blocks, error)) {
+                error.freed = find_block(freed, error);
+            }
+            errors.push_back(error);
+            return !options.stop_on_error;
+        }
+
+        // The block whose user range or redzones contain the address
+        template <typename Map>
+        bool find_block(const Map& map, MemcheckError& error) const {
+            auto block = map.upper_bound(error.address + options.redzone);
+            if (block == map.begin()) return false;
+            --block;
+            const uint32_t size = size_of(block->second);
+            if (error.address >= block->first + size + options.redzone)
+                return false;
+
+            error.block = block->first;
+            error.block_size = size;
+            return true;
+        }
+
+        static void describe(std::ostream& out, const MemcheckError& error) {
+            if (error.block == 0) return;
+
+            out << "  " << std::dec;
+            if (error.address < error.block)
+                out << error.block - error.address << " bytes before";
+            else if (error.address >= error.block + error.block_size)
+                out << error.address - (error.block + error.block_size)
+                    << " bytes after";
+            else
+                out << error.address - error.block << " bytes inside";
+            out << (error.freed ? " a freed" : " a") << " block of size "
+                << error.block_size << " at 0x" << std::hex << error.block
+                << "\n";
+        }
+
+        static const char* kind_name(const MemcheckError::Kind kind) {
+            switch (kind) {
+                case MemcheckError::Kind::e_invalid_read: return "Invalid read";
+                case MemcheckError::Kind::e_invalid_write:
+                    return "Invalid write";
+                case MemcheckError::Kind::e_uninitialised_read:
+                    return "Uninitialised read";
+                case MemcheckError::Kind::e_invalid_free: return "Invalid free";
+            }
+            return "Unknown error";
+        }
+
+        Options options;
+        std::vector<std::unique_ptr<Page>> pages;
+
+        bool intercepting = false;
+        uint32_t malloc_address = 0;
+        uint32_t free_address = 0;
+        std::vector<Call> calls; // Allocator calls in progress
+
+        std::map<uint32_t, uint32_t> blocks;
+        std::map<uint32_t, FreedBlock> freed;
+        std::deque<std::pair<uint32_t, uint64_t>> freed_order; // Oldest first
+        uint64_t freed_serial = 0;
+        std::vector<MemcheckError> errors;
+        uint32_t pc = 0; // Of the current instruction
+        uint32_t stack_pointer = 0; // As of the last instruction
+    };
+} // namespace mips_emulator
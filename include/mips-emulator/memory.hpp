@@ -4,15 +4,32 @@
 
 #include <cstdint>
 #include <memory>
+#include <type_traits>
+#include <utility>
 
 namespace mips_emulator {
     enum class MemoryError : uint8_t {
         unaligned_access,
         out_of_bounds_access,
+        read_only_access,
+        tlb_miss,       // No TLB entry matches
+        tlb_invalid,    // The matching entry isn't valid
+        tlb_modified,   // Store to a page that isn't dirty
+        invalid_access, // Rejected by a Memcheck
     };
 
     struct NullMMIO {};
 
+    // True if the memory hands out host pointers for direct accesses (Memory,
+    // MemoryMap and Mmu)
+    template <typename Memory, typename = void>
+    struct has_host_pointer : std::false_type {};
+
+    template <typename Memory>
+    struct has_host_pointer<
+        Memory, std::void_t<decltype(std::declval<Memory&>().get_host_pointer(
+                    uint32_t(0), uint32_t(0), false))>> : std::true_type {};
+
     template <typename MemoryImplemantion, typename MMIOHandler = NullMMIO,
               bool aligned_access = false>
     class Memory {
@@ -138,6 +155,25 @@ namespace mips_emulator {
                    address - offset;
         }
 
+        // Host pointer to size bytes at address if they can be accessed
+        // directly, nullptr otherwise. Nothing is direct with an MMIO handler
+        // since it could claim any address.
+        uint8_t* get_host_pointer(const Address address, const uint32_t size,
+                                  [[maybe_unused]] const bool for_store) {
+            if constexpr (!std::is_same_v<MMIOHandler, NullMMIO>) {
+                return nullptr;
+            }
+
+            const uint32_t memory_size =
+                static_cast<MemoryImplemantion*>(this)->get_size();
+            if (address < offset || address - offset > memory_size ||
+                memory_size - (address - offset) < size)
+                return nullptr;
+
+            return static_cast<MemoryImplemantion*>(this)->get_memory() +
+                   address - offset;
+        }
+
         Span<uint8_t> get_memory() {
             return {
                 static_cast<MemoryImplemantion*>(this)->get_memory(),
@@ -151,11 +187,14 @@ namespace mips_emulator {
             return (address & (sizeof(T) - 1)) == 0;
         }
 
+        // NOTE: Must agree with get_host_pointer, recompiled code uses that
+        // for accesses that would succeed here
         template <typename T>
         inline bool is_in_bounds(const Address address) {
-            return (address - offset + sizeof(T)) <
-                       static_cast<MemoryImplemantion*>(this)->get_size() &&
-                   address >= offset;
+            const uint32_t size =
+                static_cast<MemoryImplemantion*>(this)->get_size();
+            return address >= offset && size >= sizeof(T) &&
+                   address - offset <= size - sizeof(T);
         }
 
     protected:
@@ -0,0 +1,243 @@
+#pragma once
+#include "mips-emulator/memory.hpp"
+#include "mips-emulator/result.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace mips_emulator {
+    enum class MemoryMapError : uint8_t {
+        unaligned_region,
+        overlapping_region,
+        too_many_regions,
+    };
+
+    // Physical address space made of typed regions (RAM, ROM, MMIO), for
+    // boards where memory isn't one contiguous buffer.
+    //
+    // Regions are mapped in PAGE_SIZE granules. Every page has an entry in
+    // a read table and a write table, so an access is one table load plus
+    // the fast path of the region it lands in. ROM pages point to a read
+    // only region in the write table, which rejects stores without any
+    // extra comparison on the RAM path.
+    //
+    // Has the same read/store interface as Memory and can be used with the
+    // Executor and Emulator.
+    template <typename MMIOHandler = NullMMIO, bool aligned_access = false>
+    class MemoryMap {
+    public:
+        using Address = uint32_t;
+
+        static constexpr uint32_t PAGE_BITS = 16;
+        static constexpr uint32_t PAGE_SIZE = 1U << PAGE_BITS;
+        static constexpr uint32_t PAGE_COUNT = 1U << (32 - PAGE_BITS);
+
+        enum class RegionKind : uint8_t {
+            e_unmapped,
+            e_read_only, // Stores to ROM
+            e_memory,
+            e_mmio,
+        };
+
+        MemoryMap()
+            : read_pages(new uint8_t[PAGE_COUNT]()),
+              write_pages(new uint8_t[PAGE_COUNT]()) {
+            regions.resize(FIRST_REGION);
+            regions[UNMAPPED].kind = RegionKind::e_unmapped;
+            regions[READ_ONLY].kind = RegionKind::e_read_only;
+        }
+
+        // Maps zero initialized RAM
+        [[nodiscard]] Result<void, MemoryMapError>
+        map_ram(const Address base, const uint32_t size) {
+            return map(base, size, RegionKind::e_memory, false,
+                       std::vector<uint8_t>(size), nullptr);
+        }
+
+        // Maps ROM with the given contents, padded with zeros to a multiple
+        // of PAGE_SIZE
+        [[nodiscard]] Result<void, MemoryMapError>
+        map_rom(const Address base, std::vector<uint8_t> image) {
+            const uint32_t size = align_up(image.size());
+            image.resize(size);
+            return map(base, size, RegionKind::e_memory, true, std::move(image),
+                       nullptr);
+        }
+
+        // Accesses to the region are forwarded to the handler with the full
+        // address, see Memory for the handler interface
+        [[nodiscard]] Result<void, MemoryMapError>
+        map_mmio(const Address base, const uint32_t size,
+                 std::shared_ptr<MMIOHandler> handler) {
+            static_assert(!std::is_same_v<MMIOHandler, NullMMIO>,
+                          "MemoryMap needs an MMIOHandler to map MMIO");
+            return map(base, size, RegionKind::e_mmio, false, {},
+                       std::move(handler));
+        }
+
+        RegionKind get_region_kind(const Address address) const noexcept {
+            return regions[read_pages[address >> PAGE_BITS]].kind;
+        }
+
+        template <typename T>
+        Result<T, MemoryError> read(const Address address) {
+            static_assert(sizeof(T) <= sizeof(Address),
+                          "Can't read larger than word size");
+
+            // NOTE: Types of size 1 are always aligned
+            if constexpr (sizeof(T) > 1 && aligned_access) {
+                if (!is_aligned<T>(address)) {
+                    return MemoryError::unaligned_access;
+                }
+            }
+
+            Region& region = regions[read_pages[address >> PAGE_BITS]];
+            if (region.kind == RegionKind::e_memory) {
+                const uint32_t offset = address - region.base;
+                if (offset + sizeof(T) > region.size)
+                    return MemoryError::out_of_bounds_access;
+
+                T value;
+                std::memcpy(&value, region.data.data() + offset, sizeof(T));
+                return value;
+            }
+
+            if constexpr (!std::is_same_v<MMIOHandler, NullMMIO>) {
+                if (region.kind == RegionKind::e_mmio) {
+                    const auto mmio_value =
+                        region.handler->template read<T>(address);
+                    if (mmio_value.has_value()) return mmio_value.value();
+                }
+            }
+
+            return MemoryError::out_of_bounds_access;
+        }
+
+        template <typename T>
+        Result<void, MemoryError> store(const Address address, const T value) {
+            static_assert(sizeof(T) <= sizeof(Address),
+                          "Can't store larger than word size");
+
+            // NOTE: Types of size 1 are always aligned
+            if constexpr (sizeof(T) > 1 && aligned_access) {
+                if (!is_aligned<T>(address)) {
+                    return MemoryError::unaligned_access;
+                }
+            }
+
+            Region& region = regions[write_pages[address >> PAGE_BITS]];
+            if (region.kind == RegionKind::e_memory) {
+                const uint32_t offset = address - region.base;
+                if (offset + sizeof(T) > region.size)
+                    return MemoryError::out_of_bounds_access;
+
+                std::memcpy(region.data.data() + offset, &value, sizeof(T));
+                return {};
+            }
+
+            if (region.kind == RegionKind::e_read_only)
+                return MemoryError::read_only_access;
+
+            if constexpr (!std::is_same_v<MMIOHandler, NullMMIO>) {
+                if (region.kind == RegionKind::e_mmio &&
+                    region.handler->template store<T>(address, value))
+                    return {};
+            }
+
+            return MemoryError::out_of_bounds_access;
+        }
+
+        // Host pointer to RAM or ROM, for loaders and DMA. Bypasses the
+        // ROM write protection.
+        Result<void*, MemoryError> ptr_from_address(const Address address) {
+            Region& region = regions[read_pages[address >> PAGE_BITS]];
+            if (region.kind != RegionKind::e_memory)
+                return MemoryError::out_of_bounds_access;
+
+            return region.data.data() + (address - region.base);
+        }
+
+        // Host pointer to size bytes at address if they are in a single RAM
+        // or ROM region (and writable for stores), nullptr otherwise
+        uint8_t* get_host_pointer(const Address address, const uint32_t size,
+                                  const bool for_store) {
+            const uint8_t index = for_store ? write_pages[address >> PAGE_BITS]
+                                            : read_pages[address >> PAGE_BITS];
+            Region& region = regions[index];
+            if (region.kind != RegionKind::e_memory) return nullptr;
+
+            const uint32_t offset = address - region.base;
+            if (region.size - offset < size) return nullptr;
+
+            return region.data.data() + offset;
+        }
+
+    private:
+        struct Region {
+            RegionKind kind = RegionKind::e_unmapped;
+            Address base = 0;
+            uint32_t size = 0;
+            std::vector<uint8_t> data;
+            std::shared_ptr<MMIOHandler> handler;
+        };
+
+        static constexpr uint8_t UNMAPPED = 0;
+        static constexpr uint8_t READ_ONLY = 1;
+        static constexpr uint8_t FIRST_REGION = 2;
+        static constexpr std::size_t MAX_REGIONS = 256;
+
+        Result<void, MemoryMapError> map(const Address base,
+                                         const uint32_t size,
+                                         const RegionKind kind,
+                                         const bool read_only,
+                                         std::vector<uint8_t> data,
+                                         std::shared_ptr<MMIOHandler> handler) {
+            if (base % PAGE_SIZE != 0 || size % PAGE_SIZE != 0 || size == 0)
+                return MemoryMapError::unaligned_region;
+            if (uint64_t(base) + size > (uint64_t(1) << 32))
+                return MemoryMapError::unaligned_region;
+            if (regions.size() == MAX_REGIONS)
+                return MemoryMapError::too_many_regions;
+
+            const uint32_t first = base >> PAGE_BITS;
+            const uint32_t count = size >> PAGE_BITS;
+            for (uint32_t page = first; page < first + count; ++page) {
+                if (read_pages[page] != UNMAPPED)
+                    return MemoryMapError::overlapping_region;
+            }
+
+            const auto index = static_cast<uint8_t>(regions.size());
+            Region region;
+            region.kind = kind;
+            region.base = base;
+            region.size = size;
+            region.data = std::move(data);
+            region.handler = std::move(handler);
+            regions.push_back(std::move(region));
+
+            for (uint32_t page = first; page < first + count; ++page) {
+                read_pages[page] = index;
+                write_pages[page] = read_only ? READ_ONLY : index;
+            }
+
+            return {};
+        }
+
+        static uint32_t align_up(const std::size_t size) {
+            return static_cast<uint32_t>((size + PAGE_SIZE - 1) &
+                                         ~std::size_t(PAGE_SIZE - 1));
+        }
+
+        template <typename T>
+        inline static bool is_aligned(const Address address) {
+            return (address & (sizeof(T) - 1)) == 0;
+        }
+
+        std::unique_ptr<uint8_t[]> read_pages;
+        std::unique_ptr<uint8_t[]> write_pages;
+        std::vector<Region> regions;
+    };
+} // namespace mips_emulator
@@ -0,0 +1,344 @@
+#pragma once
+#include "mips-emulator/cache_model.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mips_emulator {
+    enum class AccessType : uint8_t {
+        e_fetch,
+        e_load,
+        e_store,
+    };
+
+    struct MemoryAccess {
+        AccessType type;
+        uint32_t address;
+        uint32_t size; // 1, 2, 4 or 8 bytes
+    };
+
+    // Trace files start with TRACE_MAGIC followed by one record per access.
+    // A record is a byte with the type in bits 0-1, log2 of the size in
+    // bits 2-3 and bit 4 set if the address moved by the same amount as in
+    // the previous access of the same type. Otherwise the difference
+    // follows as a zigzag encoded LEB128 number, so sequential fetches take
+    // a byte each and nearby accesses two or three.
+    constexpr char TRACE_MAGIC[8] = {'M', 'I', 'P', 'S', 'T', 'R', 'C', 1};
+
+    namespace trace_detail {
+        constexpr std::size_t TYPES = 3;
+        constexpr uint8_t SAME_STRIDE = 1 << 4;
+        constexpr std::size_t MAX_RECORD = 6;
+
+        // Previous address and stride per access type, shared by the
+        // encoder and the decoder
+        struct State {
+            uint32_t address[TYPES] = {};
+            uint32_t stride[TYPES] = {};
+        };
+
+        inline uint8_t size_bits(const uint32_t size) noexcept {
+            switch (size) {
+                case 1: return 0;
+                case 2: return 1;
+                case 8: return 3;
+                default: return 2;
+            }
+        }
+    } // namespace trace_detail
+
+    // Writes a memory access trace, see Emulator::set_memory_trace.
+    //
+    // Records are encoded into a buffer by the emulator thread, full buffers
+    // are written to the file by a background thread. If the file can't keep
+    // up the emulator waits for a free buffer, so no records are lost.
+    class TraceWriter {
+    public:
+        struct Options {
+            std::size_t buffer_size = 1 << 20;
+            std::size_t buffers = 4;
+        };
+
+        explicit TraceWriter(const std::string& path)
+            : TraceWriter(path, Options{}) {}
+
+        TraceWriter(const std::string& path, const Options& options)
+            : buffer_size(std::max<std::size_t>(options.buffer_size, 64)) {
+            file = std::fopen(path.c_str(), "wb");
+            if (!file) return;
+
+            const auto buffers = std::max<std::size_t>(options.buffers, 2);
+            for (std::size_t i = 0; i < buffers; ++i)
+                free_buffers.emplace_back(buffer_size);
+            take_buffer();
+
+            std::memcpy(current.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC));
+            used = sizeof(TRACE_MAGIC);
+
+            writer = std::thread([this]() { write_buffers(); });
+        }
+
+        ~TraceWriter() { close(); }
+
+        TraceWriter(const TraceWriter&) = delete;
+        TraceWriter& operator=(const TraceWriter&) = delete;
+
+        bool is_open() const noexcept { return file != nullptr; }
+
+        void record(const AccessType type, const uint32_t address,
+                    const uint32_t size) {
+            if (!file) return;
+            if (buffer_size - used < trace_detail::MAX_RECORD) submit();
+
+            const auto index = static_cast<std::size_t>(type);
+            const uint32_t stride = address - state.address[index];
+            state.address[index] = address;
+
+            uint8_t header = static_cast<uint8_t>(
+                static_cast<uint8_t>(type) |
+                (trace_detail::size_bits(size) << 2));
+            if (stride == state.stride[index]) {
+                current[used++] = header | trace_detail::SAME_STRIDE;
+            }
+            else {
+                state.stride[index] = stride;
+                current[used++] = header;
+
+                const auto signed_stride = static_cast<int32_t>(stride);
+                uint32_t zigzag = (stride << 1) ^
+                                  static_cast<uint32_t>(signed_stride >> 31);
+                while (zigzag >= 0x80) {
+                    current[used++] = static_cast<uint8_t>(zigzag | 0x80);
+                    zigzag >>= 7;
+                }
+                current[used++] = static_cast<uint8_t>(zigzag);
+            }
+
+            ++records;
+        }
+
+        // Writes everything recorded so far and closes the file. Returns
+        // false if a write failed.
+        bool close() {
+            if (!file) return !failed;
+
+            submit();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closing = true;
+            }
+            condition.notify_all();
+            writer.join();
+
+            if (std::fclose(file) != 0) failed = true;
+            file = nullptr;
+            return !failed;
+        }
+
+        uint64_t get_records() const noexcept { return records; }
+
+        // Bytes handed to the background thread, including the header
+        uint64_t get_bytes() const noexcept { return bytes; }
+
+    private:
+        // Hands the current buffer to the background thread and takes a
+        // free one, waiting if there is none
+        void submit() {
+            current.resize(used);
+            bytes += used;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                full_buffers.push_back(std::move(current));
+            }
+            condition.notify_all();
+            take_buffer();
+        }
+
+        void take_buffer() {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !free_buffers.empty(); });
+            current = std::move(free_buffers.back());
+            free_buffers.pop_back();
+            current.resize(buffer_size);
+            used = 0;
+        }
+
+        void write_buffers() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                condition.wait(lock, [this]() {
+                    return closing || !full_buffers.empty();
+                });
+                if (full_buffers.empty()) return;
+
+                std::vector<uint8_t> buffer = std::move(full_buffers.front());
+                full_buffers.pop_front();
+
+                lock.unlock();
+                if (std::fwrite(buffer.data(), 1, buffer.size(), file) !=
+                    buffer.size())
+                    failed = true;
+                lock.lock();
+
+                free_buffers.push_back(std::move(buffer));
+                condition.notify_all();
+            }
+        }
+
+        std::size_t buffer_size;
+        std::FILE* file = nullptr;
+
+        // Only touched by the emulator thread
+        std::vector<uint8_t> current;
+        std::size_t used = 0;
+        trace_detail::State state;
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::vector<uint8_t>> full_buffers;
+        std::vector<std::vector<uint8_t>> free_buffers;
+        bool closing = false;
+        bool failed = false; // Background thread's until it's joined
+        std::thread writer;
+    };
+
+    // Reads a trace written by TraceWriter
+    class TraceReader {
+    public:
+        explicit TraceReader(const std::string& path) : buffer(1 << 16) {
+            file = std::fopen(path.c_str(), "rb");
+            if (!file) return;
+
+            char magic[sizeof(TRACE_MAGIC)];
+            if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+                std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+                std::fclose(file);
+                file = nullptr;
+            }
+        }
+
+        ~TraceReader() {
+            if (file) std::fclose(file);
+        }
+
+        TraceReader(const TraceReader&) = delete;
+        TraceReader& operator=(const TraceReader&) = delete;
+
+        // False if the file couldn't be opened or isn't a trace
+        bool is_open() const noexcept { return file != nullptr; }
+
+        // Returns false at the end of the trace. A truncated or invalid
+        // record also ends it, see is_corrupt.
+        bool next(MemoryAccess& access) {
+            uint8_t header;
+            if (!get(header)) return false;
+
+            const auto index = static_cast<std::size_t>(header & 3);
+            if (index >= trace_detail::TYPES) return corrupt();
+
+            if (!(header & trace_detail::SAME_STRIDE)) {
+                uint32_t zigzag = 0;
+                for (uint32_t shift = 0;; shift += 7) {
+                    uint8_t byte;
+                    if (shift > 28 || !get(byte)) return corrupt();
+                    zigzag |= uint32_t(byte & 0x7F) << shift;
+                    if (!(byte & 0x80)) break;
+                }
+                state.stride[index] = (zigzag >> 1) ^ (0U - (zigzag & 1));
+            }
+
+            state.address[index] += state.stride[index];
+            access.type = static_cast<AccessType>(index);
+            access.address = state.address[index];
+            access.size = 1U << ((header >> 2) & 3);
+            return true;
+        }
+
+        bool is_corrupt() const noexcept { return corrupted; }
+
+    private:
+        bool get(uint8_t& byte) {
+            if (position == end) {
+                if (!file) return false;
+                end = std::fread(buffer.data(), 1, buffer.size(), file);
+                position = 0;
+                if (end == 0) return false;
+            }
+            byte = buffer[position++];
+            return true;
+        }
+
+        bool corrupt() {
+            corrupted = true;
+            return false;
+        }
+
+        std::FILE* file = nullptr;
+        std::vector<uint8_t> buffer;
+        std::size_t position = 0;
+        std::size_t end = 0;
+        trace_detail::State state;
+        bool corrupted = false;
+    };
+
+    // Replays the trace at path through every cache. Each of the threads
+    // (0 uses every hardware thread) reads the trace on its own and feeds
+    // its share of the caches, so a sweep over many configurations scales
+    // with the cores. Returns false if the trace can't be read.
+    inline bool replay_trace(const std::string& path,
+                             std::vector<CacheModel>& caches,
+                             unsigned threads = 0) {
+        if (threads == 0)
+            threads = std::max(1U, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(
+            std::max<std::size_t>(1, std::min<std::size_t>(threads,
+                                                            caches.size())));
+
+        std::vector<uint8_t> ok(threads, 1);
+        const auto worker = [&](const unsigned index) {
+            TraceReader reader(path);
+            if (!reader.is_open()) {
+                ok[index] = 0;
+                return;
+            }
+
+            std::vector<CacheModel*> instruction;
+            std::vector<CacheModel*> data;
+            for (std::size_t i = index; i < caches.size(); i += threads) {
+                const auto stream = caches[i].get_config().stream;
+                if (stream != CacheModel::Stream::e_data)
+                    instruction.push_back(&caches[i]);
+                if (stream != CacheModel::Stream::e_instruction)
+                    data.push_back(&caches[i]);
+            }
+
+            MemoryAccess access;
+            while (reader.next(access)) {
+                const auto& targets =
+                    access.type == AccessType::e_fetch ? instruction : data;
+                for (CacheModel* cache : targets)
+                    cache->access(access.address, access.size);
+            }
+            if (reader.is_corrupt()) ok[index] = 0;
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads; ++i)
+            pool.emplace_back(worker, i);
+        worker(0);
+        for (auto& thread : pool)
+            thread.join();
+
+        return std::find(ok.begin(), ok.end(), 0) == ok.end();
+    }
+} // namespace mips_emulator
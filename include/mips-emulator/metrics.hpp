@@ -0,0 +1,260 @@
+#pragma once
+#include "mips-emulator/memory.hpp"
+#include "mips-emulator/register_file.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mips_emulator {
+    enum class CacheKind : uint8_t {
+        e_decode = 0,
+        e_translation = 1,
+    };
+
+    // Counters owned by a single thread. Each instance lives on its own
+    // cache line so that threads never write to a shared line.
+    class alignas(64) MetricCounters {
+    public:
+        static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+        static constexpr std::size_t MEMORY_ERROR_COUNT = 7;
+        static constexpr std::size_t EXCEPTION_COUNT = 32; // 5 bit ExcCode
+        static constexpr std::size_t CACHE_COUNT = 2;
+
+        // Layout of the counter array
+        static constexpr std::size_t INSTRUCTIONS_RETIRED = 0;
+        static constexpr std::size_t MEMORY_FAULTS = 1;
+        static constexpr std::size_t EXCEPTIONS =
+            MEMORY_FAULTS + MEMORY_ERROR_COUNT;
+        static constexpr std::size_t CACHE_HITS = EXCEPTIONS + EXCEPTION_COUNT;
+        static constexpr std::size_t CACHE_MISSES = CACHE_HITS + CACHE_COUNT;
+        static constexpr std::size_t COUNTER_COUNT = CACHE_MISSES + CACHE_COUNT;
+
+        void add_instructions(const uint64_t count = 1) noexcept {
+            add(INSTRUCTIONS_RETIRED, count);
+        }
+
+        void record_memory_fault(const MemoryError error) noexcept {
+            add(MEMORY_FAULTS + static_cast<uint8_t>(error), 1);
+        }
+
+        void record_exception(const RegisterFile::Exception cause) noexcept {
+            add(EXCEPTIONS + (static_cast<uint8_t>(cause) & 31), 1);
+        }
+
+        void record_cache_hit(const CacheKind cache) noexcept {
+            add(CACHE_HITS + static_cast<uint8_t>(cache), 1);
+        }
+
+        void record_cache_miss(const CacheKind cache) noexcept {
+            add(CACHE_MISSES + static_cast<uint8_t>(cache), 1);
+        }
+
+        uint64_t get(const std::size_t index) const noexcept {
+            return values[index].load(std::memory_order_relaxed);
+        }
+
+    private:
+        // NOTE:
+        // Only the owning thread writes to a counter, so a relaxed load and
+        // store is enough. This compiles to a plain increment while still
+        // letting readers on other threads aggregate without a data race.
+        void add(const std::size_t index, const uint64_t count) noexcept {
+            auto& value = values[index];
+            value.store(value.load(std::memory_order_relaxed) + count,
+                        std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<uint64_t>, COUNTER_COUNT> values = {};
+    };
+
+    static_assert(sizeof(MetricCounters) % MetricCounters::CACHE_LINE_SIZE ==
+                      0,
+                  "MetricCounters is not padded to a cache line");
+
+    class MetricsRegistry {
+    public:
+        enum class Format {
+            e_prometheus,
+            e_json,
+        };
+
+        using Snapshot = std::array<uint64_t, MetricCounters::COUNTER_COUNT>;
+
+        // Returns the counters of the calling thread, registering them on
+        // first use. Callers should keep the reference instead of calling
+        // this for every recorded event.
+        MetricCounters& thread_counters() {
+            const auto id = std::this_thread::get_id();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& entry : threads) {
+                if (entry.first == id) return *entry.second;
+            }
+
+            // std::deque never moves its elements on emplace_back
+            slots.emplace_back();
+            threads.emplace_back(id, &slots.back());
+            return slots.back();
+        }
+
+        // Sums the counters of every registered thread
+        Snapshot read() const {
+            Snapshot snapshot = {};
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& counters : slots) {
+                for (std::size_t i = 0; i < snapshot.size(); ++i)
+                    snapshot[i] += counters.get(i);
+            }
+
+            return snapshot;
+        }
+
+        void write_prometheus(std::ostream& out) const {
+            const Snapshot snapshot = read();
+
+            out << "# TYPE mips_emulator_instructions_retired_total counter\n"
+                << "mips_emulator_instructions_retired_total "
+                << snapshot[MetricCounters::INSTRUCTIONS_RETIRED] << '\n';
+
+            out << "# TYPE mips_emulator_memory_faults_total counter\n";
+            for (std::size_t i = 0; i < MetricCounters::MEMORY_ERROR_COUNT;
+                 ++i) {
+                out << "mips_emulator_memory_faults_total{kind=\""
+                    << memory_error_name(i) << "\"} "
+                    << snapshot[MetricCounters::MEMORY_FAULTS + i] << '\n';
+            }
+
+            out << "# TYPE mips_emulator_exceptions_total counter\n";
+            for (const auto& cause : exception_names()) {
+                out << "mips_emulator_exceptions_total{cause=\""
+                    << cause.second << "\"} "
+                    << snapshot[MetricCounters::EXCEPTIONS + cause.first]
+                    << '\n';
+            }
+
+            out << "# TYPE mips_emulator_cache_hits_total counter\n";
+            for (std::size_t i = 0; i < MetricCounters::CACHE_COUNT; ++i) {
+                out << "mips_emulator_cache_hits_total{cache=\""
+                    << cache_name(i) << "\"} "
+                    << snapshot[MetricCounters::CACHE_HITS + i] << '\n';
+            }
+
+            out << "# TYPE mips_emulator_cache_misses_total counter\n";
+            for (std::size_t i = 0; i < MetricCounters::CACHE_COUNT; ++i) {
+                out << "mips_emulator_cache_misses_total{cache=\""
+                    << cache_name(i) << "\"} "
+                    << snapshot[MetricCounters::CACHE_MISSES + i] << '\n';
+            }
+        }
+
+        void write_json(std::ostream& out) const {
+            const Snapshot snapshot = read();
+
+            out << "{\"instructions_retired\":"
+                << snapshot[MetricCounters::INSTRUCTIONS_RETIRED];
+
+            out << ",\"memory_faults\":{";
+            for (std::size_t i = 0; i < MetricCounters::MEMORY_ERROR_COUNT;
+                 ++i) {
+                if (i != 0) out << ',';
+                out << '"' << memory_error_name(i) << "\":"
+                    << snapshot[MetricCounters::MEMORY_FAULTS + i];
+            }
+
+            out << "},\"exceptions\":{";
+            bool first = true;
+            for (const auto& cause : exception_names()) {
+                if (!first) out << ',';
+                first = false;
+                out << '"' << cause.second << "\":"
+                    << snapshot[MetricCounters::EXCEPTIONS + cause.first];
+            }
+
+            out << "},\"cache_hits\":{";
+            for (std::size_t i = 0; i < MetricCounters::CACHE_COUNT; ++i) {
+                if (i != 0) out << ',';
+                out << '"' << cache_name(i) << "\":"
+                    << snapshot[MetricCounters::CACHE_HITS + i];
+            }
+
+            out << "},\"cache_misses\":{";
+            for (std::size_t i = 0; i < MetricCounters::CACHE_COUNT; ++i) {
+                if (i != 0) out << ',';
+                out << '"' << cache_name(i) << "\":"
+                    << snapshot[MetricCounters::CACHE_MISSES + i];
+            }
+
+            out << "}}\n";
+        }
+
+        [[nodiscard]] bool dump(const std::string& path,
+                                const Format format) const {
+            std::ofstream file(path, std::ios::trunc);
+            if (!file) return false;
+
+            if (format == Format::e_json)
+                write_json(file);
+            else
+                write_prometheus(file);
+
+            return static_cast<bool>(file);
+        }
+
+    private:
+        static const char* memory_error_name(const std::size_t index) {
+            switch (static_cast<MemoryError>(index)) {
+                case MemoryError::unaligned_access: return "unaligned_access";
+                case MemoryError::out_of_bounds_access:
+                    return "out_of_bounds_access";
+                case MemoryError::read_only_access: return "read_only_access";
+                case MemoryError::tlb_miss: return "tlb_miss";
+                case MemoryError::tlb_invalid: return "tlb_invalid";
+                case MemoryError::tlb_modified: return "tlb_modified";
+                case MemoryError::invalid_access: return "invalid_access";
+            }
+            return "unknown";
+        }
+
+        static const char* cache_name(const std::size_t index) {
+            switch (static_cast<CacheKind>(index)) {
+                case CacheKind::e_decode: return "decode";
+                case CacheKind::e_translation: return "translation";
+            }
+            return "unknown";
+        }
+
+        static const std::vector<std::pair<uint8_t, const char*>>&
+        exception_names() {
+            using Exception = RegisterFile::Exception;
+            static const std::vector<std::pair<uint8_t, const char*>> names =
+                {
+                    {static_cast<uint8_t>(Exception::e_int), "int"},
+                    {static_cast<uint8_t>(Exception::e_ad_el), "adel"},
+                    {static_cast<uint8_t>(Exception::e_ad_es), "ades"},
+                    {static_cast<uint8_t>(Exception::e_sys), "sys"},
+                    {static_cast<uint8_t>(Exception::e_bp), "bp"},
+                    {static_cast<uint8_t>(Exception::e_ri), "ri"},
+                    {static_cast<uint8_t>(Exception::e_cpu), "cpu"},
+                    {static_cast<uint8_t>(Exception::e_ov), "ov"},
+                    {static_cast<uint8_t>(Exception::e_tr), "tr"},
+                    {static_cast<uint8_t>(Exception::e_fpe), "fpe"},
+                };
+            return names;
+        }
+
+        mutable std::mutex mutex;
+        std::deque<MetricCounters> slots;
+        std::vector<std::pair<std::thread::id, MetricCounters*>> threads;
+    };
+} // namespace mips_emulator
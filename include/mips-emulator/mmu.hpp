@@ -0,0 +1,163 @@
+#pragma once
+#include "mips-emulator/cp0.hpp"
+#include "mips-emulator/memory.hpp"
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/result.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace mips_emulator {
+    // Virtual memory in front of a physical memory (Memory or MemoryMap).
+    //
+    // kseg0 and kseg1 map directly to the first 512 MiB of physical memory,
+    // kuseg, kseg2 and kseg3 go through the TLB in Cp0. TLB translations
+    // are cached per 4 KiB page together with host pointers, so a hit is a
+    // tag compare and a memcpy. Faults are returned as MemoryError with
+    // BadVAddr, Context and EntryHi set in Cp0. Lookups of the cached pages
+    // are recorded as CacheKind::e_translation hits and misses.
+    //
+    // NOTE: There is no kernel/user mode, every segment is accessible.
+    template <typename PhysicalMemory>
+    class Mmu {
+    public:
+        using Address = uint32_t;
+
+        template <typename... Args>
+        Mmu(Args&&... args) : physical(std::forward<Args>(args)...) {}
+
+        Cp0& get_cp0() noexcept { return cp0; }
+        PhysicalMemory& get_physical_memory() noexcept { return physical; }
+
+        // Must be called if the physical memory layout changes, the cached
+        // host pointers could be stale
+        void flush_translations() { cp0.flush_cache(); }
+
+        // Counters should belong to the thread that uses this Mmu, see
+        // MetricsRegistry::thread_counters. Nothing is recorded without. The
+        // counters must outlive the Mmu or be reset with nullptr.
+        void set_metrics(MetricCounters* counters) noexcept {
+            metrics = counters;
+        }
+
+        MetricCounters* get_metrics() const noexcept { return metrics; }
+
+        template <typename T>
+        Result<T, MemoryError> read(const Address address) {
+            if (!is_mapped(address))
+                return physical.template read<T>(address & UNMAPPED_MASK);
+
+            const auto& page = cp0.get_cached_page(address);
+            const uint32_t offset = address & (Cp0::PAGE_SIZE - 1);
+            if (page.vpn == (address >> Cp0::PAGE_BITS) && page.read_host &&
+                offset + sizeof(T) <= Cp0::PAGE_SIZE) {
+                T value;
+                std::memcpy(&value, page.read_host + offset, sizeof(T));
+                record_lookup(true);
+                return value;
+            }
+            record_lookup(false);
+
+            const auto physical_address = translate(address, false);
+            if (physical_address.is_error())
+                return physical_address.get_error();
+            return physical.template read<T>(physical_address.get_value());
+        }
+
+        template <typename T>
+        Result<void, MemoryError> store(const Address address, const T value) {
+            if (!is_mapped(address))
+                return physical.template store<T>(address & UNMAPPED_MASK,
+                                                  value);
+
+            const auto& page = cp0.get_cached_page(address);
+            const uint32_t offset = address & (Cp0::PAGE_SIZE - 1);
+            if (page.vpn == (address >> Cp0::PAGE_BITS) && page.write_host &&
+                offset + sizeof(T) <= Cp0::PAGE_SIZE) {
+                std::memcpy(page.write_host + offset, &value, sizeof(T));
+                record_lookup(true);
+                return {};
+            }
+            record_lookup(false);
+
+            const auto physical_address = translate(address, true);
+            if (physical_address.is_error())
+                return physical_address.get_error();
+            return physical.template store<T>(physical_address.get_value(),
+                                              value);
+        }
+
+        // Host pointer to size bytes at address if the access would be a
+        // cached translation, nullptr if it has to go through read or store.
+        // Never walks the TLB, so it doesn't touch Cp0. Only hits are
+        // recorded, the read or store that follows a miss records it.
+        uint8_t* get_host_pointer(const Address address, const uint32_t size,
+                                  const bool for_store) {
+            if (!is_mapped(address)) {
+                return physical.get_host_pointer(address & UNMAPPED_MASK, size,
+                                                 for_store);
+            }
+
+            const auto& page = cp0.get_cached_page(address);
+            const uint32_t offset = address & (Cp0::PAGE_SIZE - 1);
+            uint8_t* host = for_store ? page.write_host : page.read_host;
+            if (page.vpn != (address >> Cp0::PAGE_BITS) || !host ||
+                offset + size > Cp0::PAGE_SIZE)
+                return nullptr;
+
+            record_lookup(true);
+            return host + offset;
+        }
+
+    private:
+        // kuseg (0-3), kseg2 (6) and kseg3 (7) are mapped, kseg0 (4) and
+        // kseg1 (5) aren't. Both unmapped segments are translated by
+        // clearing the top three bits.
+        static constexpr uint8_t MAPPED_SEGMENTS = 0b11001111;
+        static constexpr uint32_t UNMAPPED_MASK = 0x1FFFFFFF;
+
+        static bool is_mapped(const Address address) noexcept {
+            return (MAPPED_SEGMENTS >> (address >> 29)) & 1;
+        }
+
+        void record_lookup(const bool hit) noexcept {
+            if (!metrics) return;
+            if (hit)
+                metrics->record_cache_hit(CacheKind::e_translation);
+            else
+                metrics->record_cache_miss(CacheKind::e_translation);
+        }
+
+        // Walks the TLB and caches the page
+        Result<uint32_t, MemoryError> translate(const Address address,
+                                                const bool store) {
+            const auto result = cp0.translate(address, store);
+            if (result.is_error()) return result;
+
+            const uint32_t page_base =
+                result.get_value() & ~(Cp0::PAGE_SIZE - 1);
+
+            auto& page = cp0.get_cached_page(address);
+            if (page.vpn != (address >> Cp0::PAGE_BITS)) {
+                page = {};
+                page.vpn = address >> Cp0::PAGE_BITS;
+                page.physical_page = page_base;
+                page.read_host =
+                    physical.get_host_pointer(page_base, Cp0::PAGE_SIZE, false);
+            }
+
+            // Only dirty pages are writable
+            if (store) {
+                page.write_host =
+                    physical.get_host_pointer(page_base, Cp0::PAGE_SIZE, true);
+            }
+
+            return result;
+        }
+
+        Cp0 cp0;
+        PhysicalMemory physical;
+        MetricCounters* metrics = nullptr;
+    };
+} // namespace mips_emulator
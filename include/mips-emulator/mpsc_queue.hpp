@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace mips_emulator {
+    // Bounded lock free queue for many producers and a single consumer.
+    //
+    // Every cell has a sequence number that tells whose turn it is: a
+    // producer claims the cell at the tail with a CAS once the consumer has
+    // freed it, and publishes it by bumping the sequence, the consumer
+    // takes the cell at the head once it has been published. Producers
+    // never wait for each other except on the CAS.
+    template <typename T>
+    class MpscQueue {
+    public:
+        // capacity is rounded up to a power of two
+        explicit MpscQueue(const std::size_t capacity)
+            : mask(round_up(capacity) - 1), cells(new Cell[mask + 1]) {
+            for (std::size_t i = 0; i <= mask; ++i)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        // Returns false if the queue is full, value is left untouched then
+        [[nodiscard]] bool try_push(T& value) {
+            std::size_t position = tail.load(std::memory_order_relaxed);
+            while (true) {
+                const std::size_t sequence =
+                    cells[position & mask].sequence.load(
+                        std::memory_order_acquire);
+                const auto difference =
+                    static_cast<std::ptrdiff_t>(sequence - position);
+
+                if (difference < 0) return false; // Full
+
+                if (difference > 0) {
+                    position = tail.load(std::memory_order_relaxed);
+                }
+                else if (tail.compare_exchange_weak(
+                             position, position + 1,
+                             std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+
+            Cell& cell = cells[position & mask];
+            cell.value = std::move(value);
+            cell.sequence.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Only called by the consumer
+        [[nodiscard]] bool try_pop(T& value) {
+            Cell& cell = cells[head & mask];
+            const std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+            if (sequence != head + 1) return false; // Empty
+
+            value = std::move(cell.value);
+            cell.sequence.store(head + mask + 1, std::memory_order_release);
+            ++head;
+            return true;
+        }
+
+        std::size_t capacity() const noexcept { return mask + 1; }
+
+    private:
+        struct alignas(64) Cell {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        static std::size_t round_up(const std::size_t capacity) {
+            std::size_t size = 1;
+            while (size < capacity)
+                size <<= 1;
+            return size;
+        }
+
+        const std::size_t mask;
+        std::unique_ptr<Cell[]> cells;
+
+        alignas(64) std::atomic<std::size_t> tail{0};
+        alignas(64) std::size_t head = 0;
+    };
+} // namespace mips_emulator
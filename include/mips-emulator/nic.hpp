@@ -0,0 +1,269 @@
+#pragma once
+#include "mips-emulator/mpsc_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace mips_emulator {
+    struct Packet {
+        uint32_t source = 0;
+        uint32_t destination = 0;
+        uint32_t sequence = 0; // Per source, orders delivery
+        uint64_t quantum = 0;  // When it was sent
+        std::vector<uint8_t> data;
+    };
+
+    // Connects the NICs of a cluster. Every port has an inbound queue that
+    // any board thread can send to and only the owning board reads.
+    //
+    // Nothing is dropped for lack of room: packets that don't fit in a
+    // port's lock free queue go to an overflow list under a mutex until the
+    // port is read. Whether a packet arrives therefore doesn't depend on
+    // how far the receiver got, and a cluster gives the same result for any
+    // number of threads. Ports that are never read keep what was sent to
+    // them.
+    class VirtualSwitch {
+    public:
+        static constexpr uint32_t BROADCAST = 0xFFFFFFFF;
+
+        // queue_capacity only sizes the lock free part of each queue
+        VirtualSwitch(const uint32_t port_count,
+                      const std::size_t queue_capacity = 256) {
+            for (uint32_t i = 0; i < port_count; ++i)
+                ports.push_back(std::make_unique<Port>(queue_capacity));
+        }
+
+        uint32_t get_port_count() const noexcept {
+            return static_cast<uint32_t>(ports.size());
+        }
+
+        // Returns false if the packet was dropped because the destination
+        // doesn't exist. Broadcasts go to every port but the source.
+        [[nodiscard]] bool send(Packet packet) {
+            if (packet.destination != BROADCAST) {
+                if (packet.destination >= ports.size()) return false;
+                ports[packet.destination]->push(packet);
+                return true;
+            }
+
+            for (uint32_t port = 0; port < ports.size(); ++port) {
+                if (port == packet.source) continue;
+
+                Packet copy = packet;
+                copy.destination = port;
+                ports[port]->push(copy);
+            }
+            return true;
+        }
+
+        // Moves the packets sent to port so far to the end of packets, in
+        // no particular order. Only called by the port's owner.
+        void receive(const uint32_t port, std::vector<Packet>& packets) {
+            ports[port]->pop_all(packets);
+        }
+
+    private:
+        struct Port {
+            explicit Port(const std::size_t capacity) : queue(capacity) {}
+
+            void push(Packet& packet) {
+                if (queue.try_push(packet)) return;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                overflow.push_back(std::move(packet));
+                has_overflow.store(true, std::memory_order_release);
+            }
+
+            void pop_all(std::vector<Packet>& packets) {
+                Packet packet;
+                while (queue.try_pop(packet))
+                    packets.push_back(std::move(packet));
+
+                if (!has_overflow.load(std::memory_order_acquire)) return;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                std::move(overflow.begin(), overflow.end(),
+                          std::back_inserter(packets));
+                overflow.clear();
+                has_overflow.store(false, std::memory_order_relaxed);
+            }
+
+            MpscQueue<Packet> queue;
+            std::mutex mutex;
+            std::vector<Packet> overflow;
+            std::atomic<bool> has_overflow{false};
+        };
+
+        std::vector<std::unique_ptr<Port>> ports;
+    };
+
+    // Memory mapped network interface on a VirtualSwitch port, used as the
+    // MMIO handler of a board's memory (or a region of a MemoryMap).
+    //
+    // Registers are words at offsets from the base address:
+    //   0x00 STATUS      read  bit 0: a packet is in the RX buffer
+    //   0x04 PORT        read  port of this NIC
+    //   0x08 TX_DEST     write destination port (or BROADCAST)
+    //   0x0C TX_LENGTH   write length of the packet in the TX buffer
+    //   0x10 TX_SEND     write sends the TX buffer, reads 1 if the last
+    //                          send was delivered
+    //   0x14 RX_LENGTH   read  length of the packet in the RX buffer
+    //   0x18 RX_SOURCE   read  port that sent it
+    //   0x1C RX_POP      write drops it and loads the next packet
+    // followed by the TX buffer (write only) at TX_BUFFER and the RX buffer
+    // (read only) at RX_BUFFER, MTU bytes each.
+    //
+    // Packets sent in a quantum are received at the start of the next one
+    // (see deliver), ordered by source port and send order, so runs are
+    // deterministic no matter how the board threads are scheduled.
+    class Nic {
+    public:
+        static constexpr uint32_t MTU = 2048;
+
+        static constexpr uint32_t STATUS = 0x00;
+        static constexpr uint32_t PORT = 0x04;
+        static constexpr uint32_t TX_DEST = 0x08;
+        static constexpr uint32_t TX_LENGTH = 0x0C;
+        static constexpr uint32_t TX_SEND = 0x10;
+        static constexpr uint32_t RX_LENGTH = 0x14;
+        static constexpr uint32_t RX_SOURCE = 0x18;
+        static constexpr uint32_t RX_POP = 0x1C;
+        static constexpr uint32_t TX_BUFFER = 0x1000;
+        static constexpr uint32_t RX_BUFFER = 0x2000;
+        static constexpr uint32_t SIZE = RX_BUFFER + MTU;
+
+        static constexpr uint32_t STATUS_RX_READY = 1 << 0;
+
+        Nic(VirtualSwitch& network, const uint32_t port, const uint32_t base)
+            : network(network), port(port), base(base) {}
+
+        uint32_t get_port() const noexcept { return port; }
+        uint64_t get_dropped() const noexcept { return dropped; }
+
+        // Starts a quantum: packets sent to this port in earlier quanta
+        // become readable, and packets sent from now on are stamped with
+        // the new quantum. Called by the owning board's thread.
+        void deliver(const uint64_t quantum) {
+            current_quantum = quantum;
+
+            network.receive(port, in_flight);
+
+            // Senders in other threads may already be in this quantum
+            const auto ready = std::stable_partition(
+                in_flight.begin(), in_flight.end(),
+                [quantum](const Packet& p) { return p.quantum < quantum; });
+            std::sort(in_flight.begin(), ready,
+                      [](const Packet& a, const Packet& b) {
+                          if (a.quantum != b.quantum)
+                              return a.quantum < b.quantum;
+                          if (a.source != b.source) return a.source < b.source;
+                          return a.sequence < b.sequence;
+                      });
+
+            std::move(in_flight.begin(), ready, std::back_inserter(pending));
+            in_flight.erase(in_flight.begin(), ready);
+        }
+
+        template <typename T>
+        std::optional<T> read(const uint32_t address) {
+            const uint32_t offset = address - base;
+            if (offset >= SIZE) return std::nullopt;
+
+            if (offset >= RX_BUFFER) {
+                if (offset + sizeof(T) > SIZE) return std::nullopt;
+
+                T value = 0;
+                if (!pending.empty()) {
+                    const auto& data = pending.front().data;
+                    const uint32_t index = offset - RX_BUFFER;
+                    if (index < data.size()) {
+                        std::memcpy(&value, data.data() + index,
+                                    std::min<std::size_t>(sizeof(T),
+                                                          data.size() - index));
+                    }
+                }
+                return value;
+            }
+
+            if (sizeof(T) != 4) return std::nullopt;
+
+            switch (offset) {
+                case STATUS:
+                    return static_cast<T>(pending.empty() ? 0
+                                                          : STATUS_RX_READY);
+                case PORT: return static_cast<T>(port);
+                case TX_SEND: return static_cast<T>(last_send_delivered);
+                case RX_LENGTH:
+                    return static_cast<T>(
+                        pending.empty() ? 0 : pending.front().data.size());
+                case RX_SOURCE:
+                    return static_cast<T>(
+                        pending.empty() ? 0 : pending.front().source);
+                default: return std::nullopt;
+            }
+        }
+
+        template <typename T>
+        bool store(const uint32_t address, const T value) {
+            const uint32_t offset = address - base;
+            if (offset >= SIZE) return false;
+
+            if (offset >= TX_BUFFER && offset < TX_BUFFER + MTU) {
+                if (offset + sizeof(T) > TX_BUFFER + MTU) return false;
+                std::memcpy(tx_buffer + (offset - TX_BUFFER), &value,
+                            sizeof(T));
+                return true;
+            }
+
+            if (sizeof(T) != 4) return false;
+
+            switch (offset) {
+                case TX_DEST: tx_destination = uint32_t(value); return true;
+                case TX_LENGTH:
+                    tx_length = std::min<uint32_t>(uint32_t(value), MTU);
+                    return true;
+                case TX_SEND: send(); return true;
+                case RX_POP:
+                    if (!pending.empty()) pending.pop_front();
+                    return true;
+                default: return false;
+            }
+        }
+
+    private:
+        void send() {
+            Packet packet;
+            packet.source = port;
+            packet.destination = tx_destination;
+            packet.sequence = tx_sequence++;
+            packet.quantum = current_quantum;
+            packet.data.assign(tx_buffer, tx_buffer + tx_length);
+
+            last_send_delivered = network.send(std::move(packet));
+            if (!last_send_delivered) ++dropped;
+        }
+
+        VirtualSwitch& network;
+        uint32_t port;
+        uint32_t base;
+
+        uint8_t tx_buffer[MTU] = {};
+        uint32_t tx_destination = 0;
+        uint32_t tx_length = 0;
+        uint32_t tx_sequence = 0;
+        bool last_send_delivered = false;
+        uint64_t dropped = 0;
+
+        uint64_t current_quantum = 0;
+        std::vector<Packet> in_flight; // Received but not deliverable yet
+        std::deque<Packet> pending;    // Deliverable, the front is in RX
+    };
+} // namespace mips_emulator
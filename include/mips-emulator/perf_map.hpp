@@ -0,0 +1,227 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#if defined(__linux__)
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <time.h>
+#    include <unistd.h>
+#endif
+
+namespace mips_emulator {
+    // Registry of host code generated for guest code. Every registered block
+    // is written to /tmp/perf-<pid>.map, and optionally to a jitdump file
+    // (/tmp/jit-<pid>.dump) for `perf inject --jit`, so that host profilers
+    // attribute time spent in generated code to guest functions.
+    //
+    // NOTE: Only Linux is supported, on other platforms this is a no-op.
+    class PerfMap {
+    public:
+        // Returns the guest symbol containing an address, or an empty
+        // string if it's unknown
+        using Symbolizer = std::function<std::string(uint32_t)>;
+
+        struct Options {
+            bool jitdump = false;
+            std::string directory = "/tmp";
+        };
+
+        PerfMap() : PerfMap(Options{}) {}
+
+        explicit PerfMap(const Options& options) {
+#if defined(__linux__)
+            const auto pid = std::to_string(getpid());
+
+            map_path = options.directory + "/perf-" + pid + ".map";
+            map_file = std::fopen(map_path.c_str(), "a");
+
+            if (options.jitdump) {
+                dump_path = options.directory + "/jit-" + pid + ".dump";
+                open_jitdump();
+            }
+#endif
+        }
+
+        ~PerfMap() {
+#if defined(__linux__)
+            if (dump_file) {
+                write_record_header(JIT_CODE_CLOSE, sizeof(RecordHeader));
+                std::fclose(dump_file);
+            }
+            if (marker) munmap(marker, sysconf(_SC_PAGESIZE));
+            if (map_file) std::fclose(map_file);
+#endif
+        }
+
+        PerfMap(const PerfMap&) = delete;
+        PerfMap& operator=(const PerfMap&) = delete;
+
+        void set_symbolizer(Symbolizer new_symbolizer) {
+            std::lock_guard<std::mutex> lock(mutex);
+            symbolizer = std::move(new_symbolizer);
+        }
+
+        // Registers host code generated for the guest range
+        // [guest_start, guest_end). If symbol is empty the symbolizer is
+        // asked for the name of guest_start.
+        void register_code(const void* code, const std::size_t size,
+                           const uint32_t guest_start, const uint32_t guest_end,
+                           std::string symbol = {}) {
+#if defined(__linux__)
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (symbol.empty() && symbolizer) symbol = symbolizer(guest_start);
+
+            const std::string name = make_label(guest_start, guest_end, symbol);
+
+            if (map_file) {
+                std::fprintf(map_file, "%lx %zx %s\n",
+                             reinterpret_cast<unsigned long>(code), size,
+                             name.c_str());
+                std::fflush(map_file);
+            }
+
+            if (dump_file) write_code_load(code, size, name);
+#endif
+        }
+
+        const std::string& get_map_path() const noexcept { return map_path; }
+        const std::string& get_jitdump_path() const noexcept {
+            return dump_path;
+        }
+
+        static std::string make_label(const uint32_t guest_start,
+                                      const uint32_t guest_end,
+                                      const std::string& symbol) {
+            char range[48];
+            std::snprintf(range, sizeof(range), "mips:0x%08x-0x%08x",
+                          guest_start, guest_end);
+
+            if (symbol.empty()) return range;
+            return std::string(range) + " " + symbol;
+        }
+
+    private:
+#if defined(__linux__)
+        // See tools/perf/Documentation/jitdump-specification.txt in the
+        // Linux kernel source tree
+        static constexpr uint32_t JITDUMP_MAGIC = 0x4A695444;
+        static constexpr uint32_t JITDUMP_VERSION = 1;
+        static constexpr uint32_t JIT_CODE_LOAD = 0;
+        static constexpr uint32_t JIT_CODE_CLOSE = 3;
+
+        struct FileHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t total_size;
+            uint32_t elf_mach;
+            uint32_t pad1;
+            uint32_t pid;
+            uint64_t timestamp;
+            uint64_t flags;
+        };
+
+        struct RecordHeader {
+            uint32_t id;
+            uint32_t total_size;
+            uint64_t timestamp;
+        };
+
+        struct CodeLoad {
+            uint32_t pid;
+            uint32_t tid;
+            uint64_t vma;
+            uint64_t code_addr;
+            uint64_t code_size;
+            uint64_t code_index;
+        };
+
+        static uint32_t host_elf_machine() {
+#    if defined(__x86_64__)
+            return 62; // EM_X86_64
+#    elif defined(__aarch64__)
+            return 183; // EM_AARCH64
+#    elif defined(__i386__)
+            return 3; // EM_386
+#    elif defined(__arm__)
+            return 40; // EM_ARM
+#    else
+            return 0;
+#    endif
+        }
+
+        // perf expects CLOCK_MONOTONIC timestamps (perf record -k 1)
+        static uint64_t timestamp() {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+                   static_cast<uint64_t>(ts.tv_nsec);
+        }
+
+        void open_jitdump() {
+            dump_file = std::fopen(dump_path.c_str(), "w+");
+            if (!dump_file) return;
+
+            // perf finds the dump through an executable mapping of the file
+            const long page_size = sysconf(_SC_PAGESIZE);
+            marker = mmap(nullptr, page_size, PROT_READ | PROT_EXEC,
+                          MAP_PRIVATE, fileno(dump_file), 0);
+            if (marker == MAP_FAILED) marker = nullptr;
+
+            FileHeader header = {};
+            header.magic = JITDUMP_MAGIC;
+            header.version = JITDUMP_VERSION;
+            header.total_size = sizeof(FileHeader);
+            header.elf_mach = host_elf_machine();
+            header.pid = static_cast<uint32_t>(getpid());
+            header.timestamp = timestamp();
+
+            std::fwrite(&header, sizeof(header), 1, dump_file);
+            std::fflush(dump_file);
+        }
+
+        void write_record_header(const uint32_t id, const uint32_t size) {
+            RecordHeader header = {};
+            header.id = id;
+            header.total_size = size;
+            header.timestamp = timestamp();
+            std::fwrite(&header, sizeof(header), 1, dump_file);
+        }
+
+        void write_code_load(const void* code, const std::size_t size,
+                             const std::string& name) {
+            const auto record_size = sizeof(RecordHeader) + sizeof(CodeLoad) +
+                                     name.size() + 1 + size;
+            write_record_header(JIT_CODE_LOAD,
+                                static_cast<uint32_t>(record_size));
+
+            CodeLoad load = {};
+            load.pid = static_cast<uint32_t>(getpid());
+            load.tid = static_cast<uint32_t>(syscall(SYS_gettid));
+            load.vma = reinterpret_cast<uint64_t>(code);
+            load.code_addr = load.vma;
+            load.code_size = size;
+            load.code_index = code_index++;
+
+            std::fwrite(&load, sizeof(load), 1, dump_file);
+            std::fwrite(name.c_str(), name.size() + 1, 1, dump_file);
+            std::fwrite(code, size, 1, dump_file);
+            std::fflush(dump_file);
+        }
+
+        std::FILE* map_file = nullptr;
+        std::FILE* dump_file = nullptr;
+        void* marker = nullptr;
+        uint64_t code_index = 0;
+#endif
+
+        std::mutex mutex;
+        Symbolizer symbolizer;
+        std::string map_path;
+        std::string dump_path;
+    };
+} // namespace mips_emulator
@@ -0,0 +1,112 @@
+#pragma once
+#include "mips-emulator/executor.hpp"
+#include "mips-emulator/register_file.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// Keeps the slow path of recompiled loads and stores out of the generated
+// functions
+#if defined(__GNUC__) || defined(__clang__)
+#    define MIPS_EMULATOR_NOINLINE __attribute__((noinline))
+#    define MIPS_EMULATOR_LIKELY(x) __builtin_expect(!!(x), 1)
+#elif defined(_MSC_VER)
+#    define MIPS_EMULATOR_NOINLINE __declspec(noinline)
+#    define MIPS_EMULATOR_LIKELY(x) (x)
+#else
+#    define MIPS_EMULATOR_NOINLINE
+#    define MIPS_EMULATOR_LIKELY(x) (x)
+#endif
+
+namespace mips_emulator {
+    // Returned by code generated by the Recompiler when it leaves a function
+    enum class RecompiledExit : uint8_t {
+        e_dispatch,  // The PC is set to the next guest address to run
+        e_interpret, // The PC is set to code that wasn't recompiled
+        e_fault,     // An instruction failed, same state as a failed step()
+    };
+
+    template <typename T, typename Memory>
+    MIPS_EMULATOR_NOINLINE bool recompiled_load_slow(Memory& memory,
+                                                     const uint32_t address,
+                                                     T& value) {
+        const auto result = memory.template read<T>(address);
+        if (result.is_error()) return false;
+
+        value = result.get_value();
+        return true;
+    }
+
+    template <typename T, typename Memory>
+    MIPS_EMULATOR_NOINLINE bool recompiled_store_slow(Memory& memory,
+                                                      const uint32_t address,
+                                                      const T value) {
+        return !memory.template store<T>(address, value).is_error();
+    }
+
+    // Loads and stores of recompiled code. An aligned access to plain memory
+    // is a host load or store, anything else (MMIO, TLB misses, unaligned
+    // accesses, faults) calls read or store out of line. Either way the
+    // result is the same as the Executor's: false leaves the state as it
+    // was.
+    template <typename T, typename Memory>
+    inline bool recompiled_load(Memory& memory, const uint32_t address,
+                                T& value) {
+        if constexpr (has_host_pointer<Memory>::value) {
+            const uint8_t* host =
+                (address & (sizeof(T) - 1)) == 0
+                    ? memory.get_host_pointer(address, sizeof(T), false)
+                    : nullptr;
+            if (MIPS_EMULATOR_LIKELY(host != nullptr)) {
+                std::memcpy(&value, host, sizeof(T));
+                return true;
+            }
+        }
+
+        return recompiled_load_slow(memory, address, value);
+    }
+
+    template <typename T, typename Memory>
+    inline bool recompiled_store(Memory& memory, const uint32_t address,
+                                 const T value) {
+        if constexpr (has_host_pointer<Memory>::value) {
+            uint8_t* host =
+                (address & (sizeof(T) - 1)) == 0
+                    ? memory.get_host_pointer(address, sizeof(T), true)
+                    : nullptr;
+            if (MIPS_EMULATOR_LIKELY(host != nullptr)) {
+                std::memcpy(host, &value, sizeof(T));
+                return true;
+            }
+        }
+
+        return recompiled_store_slow(memory, address, value);
+    }
+
+    // Runs a program generated by the Recompiler. Program::dispatch runs the
+    // recompiled function starting at the current PC, anything else is run by
+    // the interpreter one instruction at a time. Returns when an instruction
+    // fails, exactly like Executor::step would.
+    template <typename Program, typename Memory>
+    [[nodiscard]] bool run_recompiled(RegisterFile& reg_file, Memory& memory) {
+        while (true) {
+            // Recompiled code handles delay slots itself, so a pending branch
+            // left by the interpreter has to be finished by the interpreter
+            const RecompiledExit exit =
+                reg_file.is_branch_pending()
+                    ? RecompiledExit::e_interpret
+                    : Program::dispatch(reg_file, memory);
+
+            switch (exit) {
+                case RecompiledExit::e_dispatch: break;
+                case RecompiledExit::e_interpret: {
+                    if (!Executor::step(reg_file, memory)) return false;
+                    break;
+                }
+                case RecompiledExit::e_fault: return false;
+            }
+        }
+    }
+} // namespace mips_emulator
@@ -0,0 +1,747 @@
+#pragma once
+#include "mips-emulator/control_flow.hpp"
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/result.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mips_emulator {
+    // Ahead-of-time translator from MIPS code to C++ source.
+    //
+    // Every function reachable from the roots (the ELF entry point and
+    // function symbols) becomes a C++ function with one label per basic
+    // block. Common ALU, load/store and branch instructions are emitted as
+    // inline C++ with the same semantics as the Executor, everything else
+    // calls Executor::execute. Calls, returns and indirect jumps leave the
+    // function and go through a generated dispatch table, and code that
+    // wasn't found ahead of time is run by the interpreter, see
+    // run_recompiled in recompiled.hpp.
+    //
+    // The most used guest registers of each function are kept in locals,
+    // which the host compiler can put in host registers, and written back
+    // to the RegisterFile whenever the function returns or calls into the
+    // Executor.
+    class Recompiler {
+    public:
+        static constexpr unsigned DEFAULT_PINNED_REGISTERS = 8;
+
+        // Returns the instruction word at an address, or an error if the
+        // address doesn't contain code
+        using CodeReader = std::function<Result<uint32_t, void>(uint32_t)>;
+
+        struct Function {
+            uint32_t entry;
+            std::string name;
+            std::set<uint32_t> instructions;
+            bool explored = false;
+        };
+
+        explicit Recompiler(CodeReader code_reader)
+            : reader(std::move(code_reader)) {}
+
+        // NOTE: The ElfFile must outlive the Recompiler
+        explicit Recompiler(const ElfFile& elf)
+            : reader([&elf](uint32_t address) {
+                  return elf.read_code(address);
+              }) {
+            add_function(elf.get_entry());
+            for (const auto& symbol : elf.get_symbols()) {
+                if (symbol.is_function)
+                    add_function(symbol.address, symbol.name);
+            }
+        }
+
+        void add_function(const uint32_t entry, const std::string& name = {}) {
+            if (reader(entry).is_error()) return;
+
+            auto& function = functions[entry];
+            function.entry = entry;
+            if (function.name.empty()) function.name = name;
+        }
+
+        // Finds all code reachable from the added functions. Targets of
+        // direct calls become functions of their own.
+        void analyze() {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (auto& entry : functions) {
+                    if (entry.second.explored) continue;
+                    explore(entry.second);
+                    changed = true;
+                }
+            }
+        }
+
+        const std::map<uint32_t, Function>& get_functions() const noexcept {
+            return functions;
+        }
+
+        // Number of guest registers kept in locals per function, 0 keeps
+        // all of them in the RegisterFile
+        void set_pinned_registers(const unsigned count) noexcept {
+            pinned_registers = count;
+        }
+
+        // Execution counts of basic blocks by start address, e.g. from a
+        // profiling run. Registers are pinned by their uses weighted with
+        // the count of their block, without a profile every block counts
+        // once and blocks missing from a profile never ran.
+        void set_block_profile(std::map<uint32_t, uint64_t> counts) {
+            block_profile = std::move(counts);
+        }
+
+        // Generates a header defining `struct program_name` for use with
+        // run_recompiled
+        std::string generate(const std::string& program_name) const {
+            std::ostringstream out;
+            out << "// Generated by the mips-emulator Recompiler, do not "
+                   "edit.\n"
+                << "#pragma once\n"
+                << "#include \"mips-emulator/executor.hpp\"\n"
+                << "#include \"mips-emulator/instruction.hpp\"\n"
+                << "#include \"mips-emulator/recompiled.hpp\"\n"
+                << "#include \"mips-emulator/register_file.hpp\"\n\n"
+                << "#include <cstdint>\n\n"
+                << "namespace " << program_name << "_functions {\n"
+                << "    using namespace mips_emulator;\n";
+
+            for (const auto& entry : functions)
+                generate_function(out, entry.second);
+
+            out << "} // namespace " << program_name << "_functions\n\n"
+                << "struct " << program_name << " {\n"
+                << "    template <typename Memory>\n"
+                << "    static mips_emulator::RecompiledExit\n"
+                << "    dispatch(mips_emulator::RegisterFile& reg_file, "
+                   "Memory& memory) {\n"
+                << "        switch (reg_file.get_pc()) {\n";
+
+            std::set<uint32_t> cases;
+            const auto add_case = [&](const uint32_t address,
+                                      const uint32_t function) {
+                if (!cases.insert(address).second) return;
+                out << "            case " << hex(address) << ":\n"
+                    << "                return " << program_name
+                    << "_functions::" << function_name(function)
+                    << "(reg_file, memory);\n";
+            };
+
+            for (const auto& entry : functions)
+                add_case(entry.first, entry.first);
+            for (const auto& entry : functions) {
+                for (const uint32_t point : get_return_points(entry.second))
+                    add_case(point, entry.first);
+            }
+
+            out << "            default:\n"
+                << "                return "
+                   "mips_emulator::RecompiledExit::e_interpret;\n"
+                << "        }\n"
+                << "    }\n"
+                << "};\n";
+
+            return out.str();
+        }
+
+    private:
+        using Kind = ControlFlow::Kind;
+
+        void explore(Function& function) {
+            function.explored = true;
+
+            std::vector<uint32_t> blocks = {function.entry};
+            while (!blocks.empty()) {
+                uint32_t address = blocks.back();
+                blocks.pop_back();
+
+                while (function.instructions.count(address) == 0) {
+                    const auto word = reader(address);
+                    if (word.is_error()) break;
+
+                    function.instructions.insert(address);
+
+                    const Instruction instr(word.get_value());
+                    const ControlFlow flow =
+                        ControlFlow::analyze(instr, address);
+                    if (flow.kind == Kind::e_sequential) {
+                        address += 4;
+                        continue;
+                    }
+                    if (flow.kind == Kind::e_invalid) break;
+
+                    // The delay slot is part of the branch, execution never
+                    // falls through from it
+                    if (flow.delayed && !reader(address + 4).is_error())
+                        function.instructions.insert(address + 4);
+
+                    if (flow.kind == Kind::e_direct) {
+                        if (flow.link) {
+                            add_function(flow.target);
+                        }
+                        else if (flow.conditional ||
+                                 functions.count(flow.target) == 0 ||
+                                 flow.target == function.entry) {
+                            blocks.push_back(flow.target);
+                        }
+                        // Otherwise it's a tail call
+                    }
+
+                    if (!flow.conditional && !is_call(instr, flow)) break;
+                    address += flow.delayed ? 8 : 4;
+                }
+            }
+        }
+
+        // NOTE: JR is JALR $0, it links $ra in the Executor but doesn't
+        // come back
+        static bool is_call(const Instruction instr, const ControlFlow& flow) {
+            return flow.link && !(flow.kind == Kind::e_indirect &&
+                                  flow.delayed && instr.rtype.rd == 0);
+        }
+
+        // Addresses a callee returns to. For delayed calls the Executor links
+        // the address of the delay slot, so it's run again after the call.
+        std::set<uint32_t> get_return_points(const Function& function) const {
+            std::set<uint32_t> points;
+            for (const uint32_t address : function.instructions) {
+                const ControlFlow flow = analyze(address);
+                if (!is_call(Instruction(reader(address).get_value()), flow))
+                    continue;
+
+                if (function.instructions.count(address + 4))
+                    points.insert(address + 4);
+            }
+            return points;
+        }
+
+        // Per function state while generating code
+        struct Context {
+            const Function& function;
+            std::set<uint32_t> labels;
+            bool uses_dispatch = false;
+            uint32_t pinned = 0; // Guest registers kept in locals
+        };
+
+        void generate_function(std::ostream& out,
+                               const Function& function) const {
+            Context context{function, {function.entry}};
+
+            // Calls leave the function, the program dispatch comes back in
+            // through the return points
+            const auto return_points = get_return_points(function);
+            context.labels.insert(return_points.begin(), return_points.end());
+
+            // Every block start becomes a label
+            for (const uint32_t address : function.instructions) {
+                const ControlFlow flow = analyze(address);
+                if (!flow.is_block_end() || flow.kind == Kind::e_invalid)
+                    continue;
+
+                const uint32_t after = address + (flow.delayed ? 8 : 4);
+                if (function.instructions.count(after))
+                    context.labels.insert(after);
+                if (flow.kind == Kind::e_direct &&
+                    function.instructions.count(flow.target))
+                    context.labels.insert(flow.target);
+            }
+
+            context.pinned = choose_pinned(function, context.labels);
+
+            std::ostringstream body;
+            for (uint8_t i = 1; i < RegisterFile::REGISTER_COUNT; ++i) {
+                if (is_pinned(context, i))
+                    body << "        uint32_t " << local(i)
+                         << " = reg_file.get(" << unsigned(i) << ").u;\n";
+            }
+            if (!return_points.empty()) {
+                body << "        if (reg_file.get_pc() != "
+                     << hex(function.entry) << ") goto dispatch;\n";
+                context.uses_dispatch = true;
+            }
+
+            bool reachable = false;
+            for (const uint32_t address : function.instructions) {
+                if (context.labels.count(address)) {
+                    body << function_label(address) << ":\n";
+                    reachable = true;
+                }
+                if (!reachable) continue;
+
+                reachable = generate_instruction(body, context, address);
+                if (reachable &&
+                    function.instructions.count(address + 4) == 0) {
+                    jump_to(body, context, address + 4);
+                    reachable = false;
+                }
+            }
+
+            out << "\n";
+            if (!function.name.empty())
+                out << "    // " << function.name << "\n";
+            out << "    template <typename Memory>\n"
+                << "    RecompiledExit " << function_name(function.entry)
+                << "(RegisterFile& reg_file,\n"
+                << "        [[maybe_unused]] Memory& memory) {\n"
+                << body.str();
+
+            if (context.uses_dispatch) {
+                out << "    dispatch:\n"
+                    << "        switch (reg_file.get_pc()) {\n";
+                for (const uint32_t label : context.labels) {
+                    out << "            case " << hex(label) << ": goto "
+                        << function_label(label) << ";\n";
+                }
+                out << "            default:\n";
+                spill(out, context, "                ");
+                out << "                return RecompiledExit::e_dispatch;\n"
+                    << "        }\n";
+            }
+
+            out << "    }\n";
+        }
+
+        // Bit set of the registers with the most weighted uses
+        uint32_t choose_pinned(const Function& function,
+                               const std::set<uint32_t>& labels) const {
+            using Type = Instruction::Type;
+
+            uint64_t uses[RegisterFile::REGISTER_COUNT] = {};
+            uint64_t weight = 1;
+            for (const uint32_t address : function.instructions) {
+                if (!block_profile.empty() && labels.count(address)) {
+                    const auto count = block_profile.find(address);
+                    weight = count == block_profile.end() ? 0 : count->second;
+                }
+
+                const Instruction instr(reader(address).get_value());
+                const auto type = instr.get_type();
+                if (type.is_error()) continue;
+                if (type.get_value() == Type::e_rtype) {
+                    uses[instr.rtype.rd] += weight;
+                    uses[instr.rtype.rs] += weight;
+                    uses[instr.rtype.rt] += weight;
+                }
+                else if (type.get_value() == Type::e_itype) {
+                    uses[instr.itype.rs] += weight;
+                    uses[instr.itype.rt] += weight;
+                }
+            }
+
+            std::vector<uint8_t> order;
+            for (uint8_t i = 1; i < RegisterFile::REGISTER_COUNT; ++i) {
+                if (uses[i] > 0) order.push_back(i);
+            }
+            std::stable_sort(order.begin(), order.end(),
+                             [&uses](const uint8_t a, const uint8_t b) {
+                                 return uses[a] > uses[b];
+                             });
+            if (order.size() > pinned_registers) order.resize(pinned_registers);
+
+            uint32_t pinned = 0;
+            for (const uint8_t index : order) pinned |= 1U << index;
+            return pinned;
+        }
+
+        // Returns false if the generated code never falls through to the
+        // next instruction
+        bool generate_instruction(std::ostream& out, Context& context,
+                                  const uint32_t address) const {
+            const Instruction instr(reader(address).get_value());
+            const ControlFlow flow = analyze(address);
+
+            out << "        // " << hex(address) << ": " << hex(instr.raw)
+                << "\n";
+
+            if (flow.kind == Kind::e_invalid) {
+                interpret_from(out, context, address);
+                return false;
+            }
+
+            if (flow.delayed) {
+                generate_delayed_branch(out, context, address, instr, flow);
+                return false;
+            }
+
+            const std::string post_pc = hex(address + 4);
+            if (generate_operation(out, context, instr, post_pc, "        "))
+                return true;
+
+            generate_execute(out, context, instr, post_pc, "        ");
+            if (flow.kind == Kind::e_sequential) return true;
+
+            // Compact branches and jumps set the PC themselves
+            out << "        goto dispatch;\n";
+            context.uses_dispatch = true;
+            return false;
+        }
+
+        void generate_delayed_branch(std::ostream& out, Context& context,
+                                     const uint32_t address,
+                                     const Instruction instr,
+                                     const ControlFlow& flow) const {
+            using IOp = Instruction::ITypeOpcode;
+            using RegimmOp = Instruction::RegimmITypeOp;
+
+            // Branches in delay slots are left to the interpreter
+            const auto slot_word = reader(address + 4);
+            if (slot_word.is_error() ||
+                analyze(address + 4).kind != Kind::e_sequential) {
+                interpret_from(out, context, address);
+                return;
+            }
+            const Instruction slot(slot_word.get_value());
+
+            const std::string rs = reg(context, instr.itype.rs);
+            const std::string rt = reg(context, instr.itype.rt);
+
+            std::string condition = "true";
+            if (flow.conditional) {
+                switch (static_cast<IOp>(instr.itype.op)) {
+                    case IOp::e_beq: condition = rt + " == " + rs; break;
+                    case IOp::e_bne: condition = rt + " != " + rs; break;
+                    case IOp::e_pop06:
+                        condition =
+                            signed_reg(context, instr.itype.rs) + " <= 0";
+                        break;
+                    case IOp::e_pop07:
+                        condition =
+                            signed_reg(context, instr.itype.rs) + " > 0";
+                        break;
+                    default: {
+                        // REGIMM
+                        const auto op =
+                            static_cast<RegimmOp>(instr.regimm_itype.op);
+                        condition = signed_reg(context, instr.regimm_itype.rs) +
+                                    (op == RegimmOp::e_bgez ? " >= 0" : " < 0");
+                        break;
+                    }
+                }
+            }
+
+            out << "        {\n";
+            if (flow.kind == Kind::e_indirect) {
+                // Read before linking, rs may be $ra
+                out << "            const uint32_t target = "
+                    << reg(context, instr.rtype.rs) << ";\n";
+            }
+            else {
+                out << "            const uint32_t target = "
+                    << hex(flow.target) << ";\n";
+            }
+            out << "            const bool taken = " << condition << ";\n";
+
+            // The Executor links the address of the delay slot
+            if (flow.link)
+                assign(out, context, 31, hex(address + 4), "            ");
+
+            out << "            const uint32_t post_pc = taken ? target : "
+                << hex(address + 8) << ";\n"
+                << "            (void)post_pc;\n"
+                << "            // delay slot " << hex(slot.raw) << "\n";
+
+            if (!generate_operation(out, context, slot, "post_pc",
+                                    "            "))
+                generate_execute(out, context, slot, "post_pc", "            ");
+
+            const std::string indent =
+                flow.conditional ? "                " : "            ";
+            if (flow.conditional) out << "            if (taken) {\n";
+            if (flow.kind == Kind::e_indirect) {
+                out << indent << "reg_file.set_pc(target);\n"
+                    << indent << "goto dispatch;\n";
+                context.uses_dispatch = true;
+            }
+            else {
+                jump_to(out, context, flow.target, indent);
+            }
+            if (flow.conditional) out << "            }\n";
+            out << "        }\n";
+
+            if (flow.conditional) jump_to(out, context, address + 8);
+        }
+
+        // Emits instructions with inline code, returns false for instructions
+        // that have to go through the Executor
+        bool generate_operation(std::ostream& out, const Context& context,
+                                const Instruction instr,
+                                const std::string& post_pc,
+                                const std::string& indent) const {
+            using Type = Instruction::Type;
+            using Func = Instruction::Func;
+            using IOp = Instruction::ITypeOpcode;
+
+            const auto type = instr.get_type();
+            if (type.is_error()) return false;
+
+            const uint8_t rs = instr.rtype.rs;
+            const uint8_t rt = instr.rtype.rt;
+            const uint8_t rd = instr.rtype.rd;
+            const uint8_t shamt = instr.rtype.shamt;
+
+            const auto set = [&](const uint8_t index,
+                                 const std::string& value) {
+                assign(out, context, index, value, indent);
+                return true;
+            };
+
+            if (type.get_value() == Type::e_rtype) {
+                switch (static_cast<Func>(instr.rtype.func)) {
+                    case Func::e_addu:
+                        return set(rd,
+                                   reg(context, rs) + " + " + reg(context, rt));
+                    case Func::e_subu:
+                        return set(rd,
+                                   reg(context, rs) + " - " + reg(context, rt));
+                    case Func::e_and:
+                        return set(rd,
+                                   reg(context, rs) + " & " + reg(context, rt));
+                    case Func::e_or:
+                        return set(rd,
+                                   reg(context, rs) + " | " + reg(context, rt));
+                    case Func::e_xor:
+                        return set(rd,
+                                   reg(context, rs) + " ^ " + reg(context, rt));
+                    case Func::e_nor:
+                        return set(rd, "~(" + reg(context, rs) + " | " +
+                                           reg(context, rt) + ")");
+                    case Func::e_slt:
+                        return set(rd, "uint32_t(" + signed_reg(context, rs) +
+                                           " < " + signed_reg(context, rt) +
+                                           ")");
+                    case Func::e_sltu:
+                        return set(rd, "uint32_t(" + reg(context, rs) + " < " +
+                                           reg(context, rt) + ")");
+                    case Func::e_sll:
+                        return set(rd, reg(context, rt) + " << " +
+                                           std::to_string(shamt));
+                    case Func::e_sllv:
+                        return set(rd, reg(context, rt) + " << (" +
+                                           reg(context, rs) + " & 31)");
+                    case Func::e_srl: {
+                        if (rs & 1) return false; // ROTR
+                        return set(rd, reg(context, rt) + " >> " +
+                                           std::to_string(shamt));
+                    }
+                    case Func::e_srlv: {
+                        if (shamt & 1) return false; // ROTRV
+                        return set(rd, reg(context, rt) + " >> (" +
+                                           reg(context, rs) + " & 31)");
+                    }
+                    case Func::e_sop30: {
+                        if (shamt != 2) return false; // MUH
+                        return set(rd,
+                                   reg(context, rs) + " * " + reg(context, rt));
+                    }
+                    case Func::e_seleqz:
+                        return set(rd, reg(context, rt) + " ? 0u : " +
+                                           reg(context, rs));
+                    case Func::e_selnez:
+                        return set(rd, reg(context, rt) + " ? " +
+                                           reg(context, rs) + " : 0u");
+                    default: return false;
+                }
+            }
+
+            if (type.get_value() != Type::e_itype) return false;
+
+            const uint32_t imm = instr.itype.imm;
+            const uint32_t simm = (imm ^ 0x8000) - 0x8000;
+            const std::string address = reg(context, rs) + " + " + hex(simm);
+
+            // See recompiled_load and recompiled_store
+            const auto load = [&](const char* type, const bool is_signed) {
+                out << indent << "{\n"
+                    << indent << "    " << type << " value;\n";
+                fault_unless(out, context,
+                             "recompiled_load(memory, " + address + ", value)",
+                             post_pc, indent + "    ");
+                assign(out, context, rt,
+                       is_signed ? "static_cast<uint32_t>(int32_t(value))"
+                                 : "static_cast<uint32_t>(value)",
+                       indent + "    ");
+                out << indent << "}\n";
+                return true;
+            };
+
+            const auto store = [&](const char* type) {
+                fault_unless(out, context,
+                             "recompiled_store(memory, " + address +
+                                 ", static_cast<" + type + ">(" +
+                                 reg(context, rt) + "))",
+                             post_pc, indent);
+                return true;
+            };
+
+            switch (static_cast<IOp>(instr.itype.op)) {
+                case IOp::e_addiu:
+                    return set(rt, reg(context, rs) + " + " + hex(simm));
+                case IOp::e_aui:
+                    return set(rt, reg(context, rs) + " + " + hex(imm << 16));
+                case IOp::e_slti:
+                    return set(rt, "uint32_t(" + signed_reg(context, rs) +
+                                       " < " + std::to_string(int32_t(simm)) +
+                                       ")");
+                case IOp::e_sltiu:
+                    return set(rt, "uint32_t(" + reg(context, rs) + " < " +
+                                       hex(simm) + ")");
+                case IOp::e_andi:
+                    return set(rt, reg(context, rs) + " & " + hex(imm));
+                case IOp::e_ori:
+                    return set(rt, reg(context, rs) + " | " + hex(imm));
+                case IOp::e_xori:
+                    return set(rt, reg(context, rs) + " ^ " + hex(imm));
+
+                case IOp::e_lb: return load("int8_t", true);
+                case IOp::e_lh: return load("int16_t", true);
+                case IOp::e_lw: return load("int32_t", true);
+                case IOp::e_lbu: return load("uint8_t", false);
+                case IOp::e_lhu: return load("uint16_t", false);
+
+                case IOp::e_sb: return store("uint8_t");
+                case IOp::e_sh: return store("uint16_t");
+                case IOp::e_sw: return store("uint32_t");
+
+                default: return false;
+            }
+        }
+
+        static void generate_execute(std::ostream& out, const Context& context,
+                                     const Instruction instr,
+                                     const std::string& post_pc,
+                                     const std::string& indent) {
+            spill(out, context, indent);
+            out << indent << "reg_file.set_pc(" << post_pc << ");\n"
+                << indent << "if (!Executor::execute(Instruction("
+                << hex(instr.raw) << "), reg_file, memory))\n"
+                << indent << "    return RecompiledExit::e_fault;\n";
+            reload(out, context, indent);
+        }
+
+        static void fault_unless(std::ostream& out, const Context& context,
+                                 const std::string& success,
+                                 const std::string& post_pc,
+                                 const std::string& indent) {
+            out << indent << "if (!" << success << ") {\n";
+            spill(out, context, indent + "    ");
+            out << indent << "    reg_file.set_pc(" << post_pc << ");\n"
+                << indent << "    return RecompiledExit::e_fault;\n"
+                << indent << "}\n";
+        }
+
+        static void interpret_from(std::ostream& out, const Context& context,
+                                   const uint32_t address) {
+            spill(out, context, "        ");
+            out << "        reg_file.set_pc(" << hex(address) << ");\n"
+                << "        return RecompiledExit::e_interpret;\n";
+        }
+
+        static void jump_to(std::ostream& out, const Context& context,
+                            const uint32_t address,
+                            const std::string& indent = "        ") {
+            if (context.labels.count(address)) {
+                out << indent << "goto " << function_label(address) << ";\n";
+                return;
+            }
+
+            spill(out, context, indent);
+            out << indent << "reg_file.set_pc(" << hex(address) << ");\n"
+                << indent << "return RecompiledExit::e_dispatch;\n";
+        }
+
+        ControlFlow analyze(const uint32_t address) const {
+            const auto word = reader(address);
+            if (word.is_error()) return {ControlFlow::Kind::e_invalid};
+            return ControlFlow::analyze(Instruction(word.get_value()), address);
+        }
+
+        static bool is_pinned(const Context& context, const uint8_t index) {
+            return (context.pinned >> index) & 1;
+        }
+
+        static std::string local(const uint8_t index) {
+            return "r" + std::to_string(index);
+        }
+
+        static std::string reg(const Context& context, const uint8_t index) {
+            if (index == 0) return "0u";
+            if (is_pinned(context, index)) return local(index);
+            return "reg_file.get(" + std::to_string(index) + ").u";
+        }
+
+        static std::string signed_reg(const Context& context,
+                                      const uint8_t index) {
+            if (index == 0) return "0";
+            if (is_pinned(context, index))
+                return "int32_t(" + local(index) + ")";
+            return "reg_file.get(" + std::to_string(index) + ").s";
+        }
+
+        // Writes to $0 are discarded
+        static void assign(std::ostream& out, const Context& context,
+                           const uint8_t index, const std::string& value,
+                           const std::string& indent) {
+            if (index == 0) return;
+            if (is_pinned(context, index)) {
+                out << indent << local(index) << " = " << value << ";\n";
+                return;
+            }
+            out << indent << "reg_file.set_unsigned(" << unsigned(index) << ", "
+                << value << ");\n";
+        }
+
+        // Pinned registers live in locals inside a function and go back to
+        // the RegisterFile before anything else can see it: returns, faults
+        // and instructions run by the Executor
+        static void spill(std::ostream& out, const Context& context,
+                          const std::string& indent) {
+            for (uint8_t i = 1; i < RegisterFile::REGISTER_COUNT; ++i) {
+                if (is_pinned(context, i))
+                    out << indent << "reg_file.set_unsigned(" << unsigned(i)
+                        << ", " << local(i) << ");\n";
+            }
+        }
+
+        static void reload(std::ostream& out, const Context& context,
+                           const std::string& indent) {
+            for (uint8_t i = 1; i < RegisterFile::REGISTER_COUNT; ++i) {
+                if (is_pinned(context, i))
+                    out << indent << local(i) << " = reg_file.get("
+                        << unsigned(i) << ").u;\n";
+            }
+        }
+
+        static std::string hex(const uint32_t value) {
+            char buffer[16];
+            std::snprintf(buffer, sizeof(buffer), "0x%08xu", value);
+            return buffer;
+        }
+
+        static std::string function_name(const uint32_t address) {
+            char buffer[16];
+            std::snprintf(buffer, sizeof(buffer), "f_%08x", address);
+            return buffer;
+        }
+
+        static std::string function_label(const uint32_t address) {
+            char buffer[16];
+            std::snprintf(buffer, sizeof(buffer), "L_%08x", address);
+            return buffer;
+        }
+
+        CodeReader reader;
+        std::map<uint32_t, Function> functions;
+        unsigned pinned_registers = DEFAULT_PINNED_REGISTERS;
+        std::map<uint32_t, uint64_t> block_profile;
+    };
+} // namespace mips_emulator
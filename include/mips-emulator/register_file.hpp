@@ -80,6 +80,19 @@ namespace mips_emulator {
             regs[0].u = 0;
         }
 
+        // HI and LO only exist in MIPS32r2, r6 writes results to GPRs
+        Unsigned get_hi() const noexcept { return hi; }
+        Unsigned get_lo() const noexcept { return lo; }
+        void set_hi(const Unsigned value) noexcept { hi = value; }
+        void set_lo(const Unsigned value) noexcept { lo = value; }
+
+        // UserLocal, read with RDHWR $29. Set by the host, e.g. on
+        // set_thread_area.
+        Unsigned get_user_local() const noexcept { return user_local; }
+        void set_user_local(const Unsigned value) noexcept {
+            user_local = value;
+        }
+
         void zero_all() noexcept {
             for (int i = 0; i < REGISTER_COUNT; ++i)
                 regs[i].u = 0;
@@ -90,6 +103,9 @@ namespace mips_emulator {
             branch_target = target;
         }
 
+        // True between a delayed branch and its delay slot
+        bool is_branch_pending() const noexcept { return branch_flag; }
+
         void update_pc() noexcept {
             inc_pc();
             pc += branch_flag * (branch_target - pc);
@@ -102,7 +118,14 @@ namespace mips_emulator {
                               const uint32_t instr) noexcept {
             bad_instr = instr;
             cause_register = cause;
+            exception_pending = true;
+        }
+
+        // Set by signal_exception until the exception has been handled
+        bool has_pending_exception() const noexcept {
+            return exception_pending;
         }
+        void clear_pending_exception() noexcept { exception_pending = false; }
 
         uint32_t get_bad_instr() const noexcept { return bad_instr; }
         uint8_t get_cause_register() const noexcept {
@@ -119,8 +142,12 @@ namespace mips_emulator {
 
         // cause register contains the cause of a signaled exception
         Exception cause_register;
+        bool exception_pending = false;
 
         Unsigned pc = 0;
         Register regs[REGISTER_COUNT] = {};
+        Unsigned hi = 0;
+        Unsigned lo = 0;
+        Unsigned user_local = 0;
     };
 } // namespace mips_emulator
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+namespace mips_emulator {
+    enum class StopReason : uint8_t {
+        e_budget_exhausted,
+        e_fault, // An instruction couldn't be executed
+        e_infinite_loop,
+    };
+
+    struct RunResult {
+        StopReason reason;
+        uint64_t steps; // Instructions executed
+    };
+} // namespace mips_emulator
@@ -0,0 +1,237 @@
+#pragma once
+#include "mips-emulator/memory.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/result.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mips_emulator {
+    // Taint labels are bit sets, one byte per byte of guest data, so 8
+    // independent sources can be told apart. Registers keep the labels of
+    // their 4 bytes packed in a word in memory order (little endian), the
+    // same layout as 4 consecutive bytes of shadow memory.
+    using TaintLabel = uint8_t;
+
+    // Labels of the GPRs, HI and LO. $0 is never tainted.
+    class ShadowRegisterFile {
+    public:
+        uint32_t get(const RegisterName reg) const noexcept {
+            return get(static_cast<uint8_t>(reg));
+        }
+        uint32_t get(const uint8_t index) const noexcept {
+            return regs[index & RegisterFile::INDEX_MASK];
+        }
+
+        void set(const RegisterName reg, const uint32_t labels) noexcept {
+            set(static_cast<uint8_t>(reg), labels);
+        }
+        void set(const uint8_t index, const uint32_t labels) noexcept {
+            regs[index & RegisterFile::INDEX_MASK] = labels;
+            regs[0] = 0;
+        }
+
+        uint32_t get_hi() const noexcept { return hi; }
+        uint32_t get_lo() const noexcept { return lo; }
+        void set_hi(const uint32_t labels) noexcept { hi = labels; }
+        void set_lo(const uint32_t labels) noexcept { lo = labels; }
+
+        void clear() noexcept { *this = ShadowRegisterFile{}; }
+
+    private:
+        uint32_t regs[RegisterFile::REGISTER_COUNT] = {};
+        uint32_t hi = 0;
+        uint32_t lo = 0;
+    };
+
+    // Result of an instruction on the shadow state, computed by
+    // Taint::analyze before the instruction executes and applied once it
+    // has succeeded
+    struct TaintUpdate {
+        enum class Kind : uint8_t {
+            e_none,
+            e_register, // GPR reg gets labels
+            e_store,    // size bytes at address get the low bytes of labels
+            e_hi_lo,    // HI gets labels, LO gets lo
+        };
+
+        Kind kind = Kind::e_none;
+        uint8_t reg = 0;
+        uint8_t size = 0;
+        uint32_t address = 0;
+        uint32_t labels = 0;
+        uint32_t lo = 0;
+    };
+
+    // Labels of a range of guest addresses and of the registers.
+    //
+    // The labels of a range are one flat array indexed like the guest
+    // memory, so looking up the labels of an access is a bounds check and a
+    // load of the same size. Addresses outside the range are never
+    // tainted.
+    class Shadow {
+    public:
+        Shadow(const uint32_t base, const uint32_t size)
+            : base(base), labels(size, 0) {}
+
+        uint32_t get_base() const noexcept { return base; }
+        uint32_t get_size() const noexcept {
+            return static_cast<uint32_t>(labels.size());
+        }
+
+        ShadowRegisterFile& get_registers() noexcept { return registers; }
+        const ShadowRegisterFile& get_registers() const noexcept {
+            return registers;
+        }
+
+        // Adds label to size bytes at address, e.g. an input buffer
+        void taint(const uint32_t address, const uint32_t size,
+                   const TaintLabel label = 1) {
+            for (uint32_t i = 0; i < size; ++i) {
+                if (TaintLabel* byte = find(address + i)) *byte |= label;
+            }
+        }
+
+        void untaint(const uint32_t address, const uint32_t size) {
+            for (uint32_t i = 0; i < size; ++i) {
+                if (TaintLabel* byte = find(address + i)) *byte = 0;
+            }
+        }
+
+        // Moves the labels of size bytes like memmove, for copies the
+        // executor doesn't see (see GuestMemory::copy)
+        void copy(const uint32_t destination, const uint32_t source,
+                  const uint32_t size) {
+            const bool backwards =
+                destination > source && destination - source < size;
+            for (uint32_t done = 0; done < size; ++done) {
+                const uint32_t i = backwards ? size - done - 1 : done;
+                if (TaintLabel* byte = find(destination + i))
+                    *byte = get_label(source + i);
+            }
+        }
+
+        TaintLabel get_label(const uint32_t address) const {
+            const uint32_t index = address - base;
+            return index < labels.size() ? labels[index] : 0;
+        }
+
+        // Labels of size (1, 2 or 4) bytes at address, packed like a
+        // register
+        uint32_t load(const uint32_t address, const uint32_t size) const {
+            uint32_t packed = 0;
+            const uint32_t index = address - base;
+            if (index < labels.size() && labels.size() - index >= size) {
+                std::memcpy(&packed, &labels[index], size);
+                return packed;
+            }
+
+            // Partly outside the range
+            for (uint32_t i = 0; i < size; ++i)
+                packed |= uint32_t(get_label(address + i)) << (i * 8);
+            return packed;
+        }
+
+        void store(const uint32_t address, const uint32_t size,
+                   const uint32_t packed) {
+            const uint32_t index = address - base;
+            if (index < labels.size() && labels.size() - index >= size) {
+                std::memcpy(&labels[index], &packed, size);
+                return;
+            }
+
+            for (uint32_t i = 0; i < size; ++i) {
+                if (TaintLabel* byte = find(address + i))
+                    *byte = static_cast<TaintLabel>(packed >> (i * 8));
+            }
+        }
+
+        void apply(const TaintUpdate& update) {
+            using Kind = TaintUpdate::Kind;
+
+            switch (update.kind) {
+                case Kind::e_none: break;
+                case Kind::e_register:
+                    registers.set(update.reg, update.labels);
+                    break;
+                case Kind::e_store:
+                    store(update.address, update.size, update.labels);
+                    break;
+                case Kind::e_hi_lo:
+                    registers.set_hi(update.labels);
+                    registers.set_lo(update.lo);
+                    break;
+            }
+        }
+
+    private:
+        TaintLabel* find(const uint32_t address) {
+            const uint32_t index = address - base;
+            return index < labels.size() ? &labels[index] : nullptr;
+        }
+
+        uint32_t base;
+        std::vector<TaintLabel> labels;
+        ShadowRegisterFile registers;
+    };
+
+    // True if the memory has a Shadow (ShadowMemory, or an Emulator's bus
+    // on one)
+    template <typename Memory, typename = void>
+    struct has_shadow : std::false_type {};
+
+    template <typename Memory>
+    struct has_shadow<
+        Memory, std::void_t<decltype(std::declval<Memory&>().get_shadow())>>
+        : std::true_type {};
+
+    // A memory with a Shadow next to it. The Executor propagates taint for
+    // every instruction it executes on a memory with a shadow (see
+    // Executor::has_shadow), anything else compiles without it. Hypercalls
+    // keep the labels up to date through GuestMemory.
+    //
+    // Accesses are forwarded to the backend unchanged. The shadow is
+    // indexed by the addresses the executor sees, so put it in front of an
+    // Mmu to track virtual addresses.
+    template <typename Backend>
+    class ShadowMemory {
+    public:
+        using Address = uint32_t;
+
+        // The shadow covers shadow_size bytes from shadow_base, the rest of
+        // the arguments construct the backend
+        template <typename... Args>
+        ShadowMemory(const uint32_t shadow_base, const uint32_t shadow_size,
+                     Args&&... args)
+            : shadow(shadow_base, shadow_size),
+              backend(std::forward<Args>(args)...) {}
+
+        Shadow& get_shadow() noexcept { return shadow; }
+        Backend& get_backend() noexcept { return backend; }
+
+        template <typename T>
+        Result<T, MemoryError> read(const Address address) {
+            return backend.template read<T>(address);
+        }
+
+        template <typename T>
+        Result<void, MemoryError> store(const Address address,
+                                        const T value) {
+            return backend.template store<T>(address, value);
+        }
+
+        // Only there if the backend has a Cp0, see Executor::has_cp0
+        template <typename B = Backend>
+        auto get_cp0() -> decltype(std::declval<B&>().get_cp0()) {
+            return backend.get_cp0();
+        }
+
+    private:
+        Shadow shadow;
+        Backend backend;
+    };
+} // namespace mips_emulator
@@ -1,7 +1,48 @@
 #pragma once
 #include "mips-emulator/memory.hpp"
 
+#include <cstddef>
+#include <cstring>
+
 namespace mips_emulator {
+    // Initial contents of a StaticMemory, built at compile time. A static
+    // constexpr image lives in the executable's read-only data, so every
+    // memory created from it is a single copy instead of a run of stores.
+    template <uint32_t SIZE>
+    struct MemoryImage {
+        uint8_t bytes[SIZE] = {};
+
+        // In guest byte order, which is little endian
+        constexpr MemoryImage& store_word(const uint32_t address,
+                                          const uint32_t word) {
+            for (uint32_t i = 0; i < 4; ++i)
+                bytes[address + i] = static_cast<uint8_t>(word >> (i * 8));
+            return *this;
+        }
+    };
+
+    // Image starting with words, e.g. the raw encodings of a program
+    template <uint32_t SIZE, std::size_t WORDS>
+    constexpr MemoryImage<SIZE> make_image(const uint32_t (&words)[WORDS]) {
+        static_assert(WORDS * 4 <= SIZE, "Words don't fit in the image");
+
+        MemoryImage<SIZE> image;
+        for (std::size_t i = 0; i < WORDS; ++i)
+            image.store_word(static_cast<uint32_t>(i * 4), words[i]);
+        return image;
+    }
+
+    // Image starting with bytes, e.g. embedded data
+    template <uint32_t SIZE, std::size_t BYTES>
+    constexpr MemoryImage<SIZE> make_image(const uint8_t (&bytes)[BYTES]) {
+        static_assert(BYTES <= SIZE, "Bytes don't fit in the image");
+
+        MemoryImage<SIZE> image;
+        for (std::size_t i = 0; i < BYTES; ++i)
+            image.bytes[i] = bytes[i];
+        return image;
+    }
+
     template <uint32_t SIZE, typename MMIOHandler = NullMMIO>
     class StaticMemory
         : public Memory<StaticMemory<SIZE, MMIOHandler>, MMIOHandler> {
@@ -13,6 +54,21 @@ namespace mips_emulator {
             : Memory<StaticMemory<SIZE, MMIOHandler>, MMIOHandler>(
                   offset, mmio_handler) {}
 
+        // Starts with the contents of image, memory past it is zeroed
+        template <uint32_t IMAGE_SIZE>
+        StaticMemory(const MemoryImage<IMAGE_SIZE>& image,
+                     const uint32_t offset = 0,
+                     std::shared_ptr<MMIOHandler> mmio_handler = nullptr)
+            : Memory<StaticMemory<SIZE, MMIOHandler>, MMIOHandler>(
+                  offset, mmio_handler) {
+            static_assert(IMAGE_SIZE <= SIZE,
+                          "Image is larger than the StaticMemory");
+
+            std::memcpy(memory, image.bytes, IMAGE_SIZE);
+            if constexpr (IMAGE_SIZE < SIZE)
+                std::memset(memory + IMAGE_SIZE, 0, SIZE - IMAGE_SIZE);
+        }
+
         uint8_t* get_memory() { return &memory[0]; }
         uint32_t get_size() const { return SIZE; }
 
@@ -0,0 +1,385 @@
+#pragma once
+#include "mips-emulator/control_flow.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/shadow_memory.hpp"
+
+#include <cstdint>
+
+namespace mips_emulator {
+    // Propagation rules of the taint tracking, see ShadowMemory.
+    //
+    // Only explicit data flow is tracked: a result gets the labels of the
+    // operand bytes it was computed from. Branches, traps and the condition
+    // of a select don't taint anything. Byte moves (loads, stores, bitwise
+    // ops, shifts by constants, byte shuffles) are byte precise, carries
+    // taint every byte above, and anything else taints the whole result
+    // with the labels of every operand byte.
+    namespace Taint {
+        // Every byte gets the labels of every byte
+        inline uint32_t spread(uint32_t labels) {
+            labels |= labels >> 8;
+            labels |= labels >> 16;
+            return (labels & 0xFF) * 0x01010101U;
+        }
+
+        // Results that fit in a byte, e.g. SLT
+        inline uint32_t merge_low(uint32_t labels) {
+            labels |= labels >> 8;
+            labels |= labels >> 16;
+            return labels & 0xFF;
+        }
+
+        // Byte i gets the labels of bytes 0 to i, e.g. an addition
+        inline uint32_t carry(uint32_t labels) {
+            labels |= labels << 8;
+            labels |= labels << 16;
+            return labels;
+        }
+
+        inline uint32_t shift_left_bytes(const uint32_t labels,
+                                         const uint32_t bytes) {
+            return bytes >= 4 ? 0 : labels << (bytes * 8);
+        }
+
+        inline uint32_t shift_right_bytes(const uint32_t labels,
+                                          const uint32_t bytes) {
+            return bytes >= 4 ? 0 : labels >> (bytes * 8);
+        }
+
+        // A bit shift touches one or two bytes per result byte
+        inline uint32_t shift_left(const uint32_t labels, const uint32_t sa) {
+            const uint32_t bytes = sa / 8;
+            return shift_left_bytes(labels, bytes) |
+                   (sa % 8 ? shift_left_bytes(labels, bytes + 1) : 0);
+        }
+
+        inline uint32_t shift_right(const uint32_t labels, const uint32_t sa,
+                                    const bool arithmetic) {
+            const uint32_t bytes = sa / 8;
+            uint32_t result = shift_right_bytes(labels, bytes);
+            if (sa % 8) result |= shift_right_bytes(labels, bytes + 1);
+
+            // Bytes filled with the sign get the labels of the sign byte
+            if (arithmetic && sa != 0) {
+                const uint32_t sign = (labels >> 24) * 0x01010101U;
+                result |= shift_left_bytes(sign, 4 - (sa + 7) / 8);
+            }
+            return result;
+        }
+
+        inline uint32_t sign_extend(const uint32_t labels,
+                                    const uint32_t size) {
+            if (size == 1) return (labels & 0xFF) * 0x01010101U;
+            if (size == 2)
+                return (labels & 0xFFFF) | ((labels >> 8) & 0xFF) * 0x01010000U;
+            return labels;
+        }
+
+        inline TaintUpdate set_register(const uint8_t reg,
+                                        const uint32_t labels) {
+            TaintUpdate update;
+            update.kind = TaintUpdate::Kind::e_register;
+            update.reg = reg;
+            update.labels = labels;
+            return update;
+        }
+
+        inline TaintUpdate store(const uint32_t address, const uint8_t size,
+                                 const uint32_t labels) {
+            TaintUpdate update;
+            update.kind = TaintUpdate::Kind::e_store;
+            update.address = address;
+            update.size = size;
+            update.labels = labels;
+            return update;
+        }
+
+        inline TaintUpdate set_hi_lo(const uint32_t hi, const uint32_t lo) {
+            TaintUpdate update;
+            update.kind = TaintUpdate::Kind::e_hi_lo;
+            update.labels = hi;
+            update.lo = lo;
+            return update;
+        }
+
+        inline TaintUpdate analyze_rtype(const Instruction instr,
+                                         const Shadow& shadow) {
+            using Func = Instruction::Func;
+
+            const auto& regs = shadow.get_registers();
+            const uint32_t rs = regs.get(instr.rtype.rs);
+            const uint32_t rt = regs.get(instr.rtype.rt);
+            const uint8_t rd = instr.rtype.rd;
+            const uint32_t sa = instr.rtype.shamt;
+
+            switch (static_cast<Func>(instr.rtype.func)) {
+                case Func::e_add:
+                case Func::e_addu:
+                case Func::e_sub:
+                case Func::e_subu: return set_register(rd, carry(rs | rt));
+                case Func::e_sop30:
+                case Func::e_sop31:
+                case Func::e_sop32:
+                case Func::e_sop33: return set_register(rd, spread(rs | rt));
+                case Func::e_and:
+                case Func::e_nor:
+                case Func::e_or:
+                case Func::e_xor: return set_register(rd, rs | rt);
+                case Func::e_slt:
+                case Func::e_sltu: return set_register(rd, merge_low(rs | rt));
+                case Func::e_jalr: return set_register(rd, 0);
+                // Hypercall results come from the host
+                case Func::e_syscall: return set_register(2, 0);
+                case Func::e_sll: return set_register(rd, shift_left(rt, sa));
+                case Func::e_srl:
+                    return set_register(rd, shift_right(rt, sa, false));
+                case Func::e_sra:
+                    return set_register(rd, shift_right(rt, sa, true));
+                case Func::e_sllv:
+                case Func::e_srlv:
+                case Func::e_srav: return set_register(rd, spread(rs | rt));
+                // The condition in rt only selects
+                case Func::e_seleqz:
+                case Func::e_selnez: return set_register(rd, rs);
+                case Func::e_clz:
+                case Func::e_clo: return set_register(rd, merge_low(rs));
+                default: return {};
+            }
+        }
+
+        inline TaintUpdate analyze_itype(const Instruction instr,
+                                         const RegisterFile& reg_file,
+                                         const Shadow& shadow) {
+            using IOp = Instruction::ITypeOpcode;
+
+            const auto& regs = shadow.get_registers();
+            const uint32_t rs = regs.get(instr.itype.rs);
+            const uint32_t rt = regs.get(instr.itype.rt);
+            const uint8_t dest = instr.itype.rt;
+            const uint32_t address =
+                reg_file.get(instr.itype.rs).u +
+                static_cast<uint32_t>(static_cast<int16_t>(instr.itype.imm));
+
+            const auto load = [&](const uint8_t size, const bool sign) {
+                const uint32_t labels = shadow.load(address, size);
+                return set_register(dest,
+                                    sign ? sign_extend(labels, size) : labels);
+            };
+
+            switch (static_cast<IOp>(instr.itype.op)) {
+                case IOp::e_addiu:
+                case IOp::e_aui: return set_register(dest, carry(rs));
+                case IOp::e_slti:
+                case IOp::e_sltiu: return set_register(dest, merge_low(rs));
+                case IOp::e_andi: return set_register(dest, rs & 0xFFFF);
+                case IOp::e_ori:
+                case IOp::e_xori: return set_register(dest, rs);
+                case IOp::e_lb: return load(1, true);
+                case IOp::e_lbu: return load(1, false);
+                case IOp::e_lh: return load(2, true);
+                case IOp::e_lhu: return load(2, false);
+                case IOp::e_lw: return load(4, false);
+                case IOp::e_sb: return store(address, 1, rt);
+                case IOp::e_sh: return store(address, 2, rt);
+                case IOp::e_sw: return store(address, 4, rt);
+                default: break;
+            }
+
+            // NOTE: Compact branches that link clear $ra even when they
+            // aren't taken
+            if (ControlFlow::analyze(instr, 0).link)
+                return set_register(31, 0);
+            return {};
+        }
+
+        // MIPS32r2 only, see Executor::handle_legacy_instr
+        inline TaintUpdate analyze_legacy(const Instruction instr,
+                                          const RegisterFile& reg_file,
+                                          const Shadow& shadow) {
+            using Func = Instruction::LegacyFunc;
+            using Special2Func = Instruction::Special2Func;
+            using IOp = Instruction::LegacyITypeOpcode;
+            using RegimmOp = Instruction::LegacyRegimmOp;
+
+            const auto& regs = shadow.get_registers();
+            const uint32_t rs = regs.get(instr.rtype.rs);
+            const uint32_t rt = regs.get(instr.rtype.rt);
+            const uint8_t rd = instr.rtype.rd;
+            const uint32_t product = spread(rs | rt);
+
+            switch (instr.general.op) {
+                case Instruction::RTYPE_OPCODE: {
+                    switch (static_cast<Func>(instr.rtype.func)) {
+                        case Func::e_movz:
+                            if (reg_file.get(instr.rtype.rt).u != 0) return {};
+                            return set_register(rd, rs);
+                        case Func::e_movn:
+                            if (reg_file.get(instr.rtype.rt).u == 0) return {};
+                            return set_register(rd, rs);
+                        case Func::e_mfhi:
+                            return set_register(rd, regs.get_hi());
+                        case Func::e_mflo:
+                            return set_register(rd, regs.get_lo());
+                        case Func::e_mthi: return set_hi_lo(rs, regs.get_lo());
+                        case Func::e_mtlo: return set_hi_lo(regs.get_hi(), rs);
+                        case Func::e_mult:
+                        case Func::e_multu:
+                        case Func::e_div:
+                        case Func::e_divu: return set_hi_lo(product, product);
+                    }
+                    return {};
+                }
+
+                case Instruction::SPECIAL2_OPCODE: {
+                    const uint32_t accumulated =
+                        spread(product | regs.get_hi() | regs.get_lo());
+                    switch (static_cast<Special2Func>(instr.rtype.func)) {
+                        case Special2Func::e_madd:
+                        case Special2Func::e_maddu:
+                        case Special2Func::e_msub:
+                        case Special2Func::e_msubu:
+                            return set_hi_lo(accumulated, accumulated);
+                        case Special2Func::e_mul:
+                            return set_register(rd, product);
+                        case Special2Func::e_clz:
+                        case Special2Func::e_clo:
+                            return set_register(rd, merge_low(rs));
+                    }
+                    return {};
+                }
+
+                case Instruction::REGIMM_OPCODE: {
+                    switch (static_cast<RegimmOp>(instr.regimm_itype.op)) {
+                        case RegimmOp::e_bltzal:
+                        case RegimmOp::e_bgezal: return set_register(31, 0);
+                        default: return {};
+                    }
+                }
+            }
+
+            const uint32_t address =
+                reg_file.get(instr.itype.rs).u +
+                static_cast<uint32_t>(static_cast<int16_t>(instr.itype.imm));
+            const uint32_t byte = address & 3;
+            const uint32_t word = shadow.load(address & ~3U, 4);
+
+            // The same byte merges as the Executor, on labels
+            switch (static_cast<IOp>(instr.itype.op)) {
+                case IOp::e_addi:
+                    return set_register(instr.itype.rt, carry(rs));
+                case IOp::e_lwl:
+                    return set_register(instr.itype.rt,
+                                        (rt & (0x00FFFFFFU >> (byte * 8))) |
+                                            (word << ((3 - byte) * 8)));
+                case IOp::e_lwr:
+                    return set_register(
+                        instr.itype.rt,
+                        (rt & (0xFFFFFF00U << ((3 - byte) * 8))) |
+                            (word >> (byte * 8)));
+                case IOp::e_swl:
+                    return store(address & ~3U, 4,
+                                 (word & (0xFFFFFF00U << (byte * 8))) |
+                                     (rt >> ((3 - byte) * 8)));
+                case IOp::e_swr:
+                    return store(address & ~3U, 4,
+                                 (word & (0x00FFFFFFU >> ((3 - byte) * 8))) |
+                                     (rt << (byte * 8)));
+                default: return {};
+            }
+        }
+
+        // What instr will do to the shadow state, must be called before
+        // instr executes since its operands may be overwritten
+        template <Isa isa = Isa::e_mips32r6>
+        inline TaintUpdate analyze(const Instruction instr,
+                                   const Instruction::Type type,
+                                   const RegisterFile& reg_file,
+                                   const Shadow& shadow) {
+            using Type = Instruction::Type;
+            using BSHFLFunc = Instruction::Special3BSHFLFunc;
+            using PCRelFunc1 = Instruction::PCRelFunc1;
+            using COP0Op = Instruction::COP0Op;
+
+            const auto& regs = shadow.get_registers();
+
+            switch (type) {
+                case Type::e_rtype: return analyze_rtype(instr, shadow);
+                case Type::e_itype:
+                case Type::e_longimm_itype:
+                    return analyze_itype(instr, reg_file, shadow);
+                case Type::e_jtype:
+                    if (ControlFlow::analyze(instr, 0).link)
+                        return set_register(31, 0);
+                    return {};
+
+                case Type::e_special3_type_bshfl: {
+                    const auto& bshfl = instr.special3_type_bshfl;
+                    const uint32_t rt = regs.get(bshfl.rt);
+                    const uint32_t rs = regs.get(bshfl.rs);
+                    const uint8_t bp = bshfl.func & 0x3;
+
+                    switch (static_cast<BSHFLFunc>(bshfl.func)) {
+                        case BSHFLFunc::e_bitswap:
+                            return set_register(bshfl.rd, rt);
+                        case BSHFLFunc::e_wsbh:
+                            return set_register(bshfl.rd,
+                                                ((rt & 0x00FF00FF) << 8) |
+                                                    ((rt & 0xFF00FF00) >> 8));
+                        case BSHFLFunc::e_align_0:
+                        case BSHFLFunc::e_align_1:
+                        case BSHFLFunc::e_align_2:
+                        case BSHFLFunc::e_align_3:
+                            return set_register(
+                                bshfl.rd, shift_left_bytes(rt, bp) |
+                                              shift_right_bytes(rs, 4 - bp));
+                        case BSHFLFunc::e_seb:
+                            return set_register(bshfl.rd, sign_extend(rt, 1));
+                        case BSHFLFunc::e_seh:
+                            return set_register(bshfl.rd, sign_extend(rt, 2));
+                        default: return {};
+                    }
+                }
+                case Type::e_special3_type_ext:
+                    return set_register(
+                        instr.special3_type.rt,
+                        spread(regs.get(instr.special3_type.rs)));
+                case Type::e_special3_type_ins:
+                    return set_register(
+                        instr.special3_type.rt,
+                        spread(regs.get(instr.special3_type.rs)) |
+                            regs.get(instr.special3_type.rt));
+                case Type::e_special3_type_rdhwr:
+                    return set_register(instr.special3_type.rt, 0);
+
+                case Type::e_pcrel_type1: {
+                    const auto& pcrel = instr.pcrel_type1;
+                    if (static_cast<PCRelFunc1>(pcrel.func) !=
+                        PCRelFunc1::e_lwpc)
+                        return set_register(pcrel.rs, 0);
+
+                    // Same address as the Executor
+                    uint32_t address = static_cast<uint32_t>(pcrel.imm) << 2;
+                    address |= 1023 * ((address >> 21) & 1);
+                    address += reg_file.get_pc();
+                    return set_register(pcrel.rs, shadow.load(address, 4));
+                }
+                case Type::e_pcrel_type2:
+                    return set_register(instr.pcrel_type2.rs, 0);
+
+                case Type::e_cop0_type:
+                    if (instr.cop0_type.op == uint8_t(COP0Op::e_mf))
+                        return set_register(instr.cop0_type.rt, 0);
+                    return {};
+
+                case Type::e_legacy:
+                    if constexpr (isa == Isa::e_mips32r2)
+                        return analyze_legacy(instr, reg_file, shadow);
+                    else
+                        return {};
+
+                default: return {};
+            }
+        }
+    } // namespace Taint
+} // namespace mips_emulator
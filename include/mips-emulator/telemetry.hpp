@@ -0,0 +1,301 @@
+#pragma once
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/run_result.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#if defined(__linux__)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace mips_emulator {
+    enum class RunState : uint8_t {
+        e_idle, // Nothing published yet
+        e_running,
+        e_stopped,
+    };
+
+    // State of an emulator as last published
+    struct TelemetrySnapshot {
+        RunState state = RunState::e_idle;
+        StopReason stop_reason = StopReason::e_budget_exhausted; // If stopped
+        uint32_t pc = 0;
+        uint64_t retired = 0;
+        uint64_t memory_faults = 0;
+        uint64_t exceptions = 0;
+        uint64_t decode_hits = 0;
+        uint64_t decode_misses = 0;
+    };
+
+    // Published state of one emulator, on its own cache line. Guarded by a
+    // seqlock: the writer makes the sequence odd while it updates the
+    // fields, readers retry until they see the same even sequence before
+    // and after reading.
+    //
+    // NOTE: The fields are relaxed atomics, which are plain loads and
+    // stores, so a torn read is detected by the sequence instead of being a
+    // data race.
+    struct alignas(64) TelemetrySlot {
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint32_t> state; // RunState | StopReason << 8
+        std::atomic<uint32_t> pc;
+        std::atomic<uint64_t> retired;
+        std::atomic<uint64_t> memory_faults;
+        std::atomic<uint64_t> exceptions;
+        std::atomic<uint64_t> decode_hits;
+        std::atomic<uint64_t> decode_misses;
+
+        void write(const TelemetrySnapshot& snapshot) noexcept {
+            const uint32_t start = sequence.load(std::memory_order_relaxed);
+            sequence.store(start + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            state.store(static_cast<uint32_t>(snapshot.state) |
+                            static_cast<uint32_t>(snapshot.stop_reason) << 8,
+                        std::memory_order_relaxed);
+            pc.store(snapshot.pc, std::memory_order_relaxed);
+            retired.store(snapshot.retired, std::memory_order_relaxed);
+            memory_faults.store(snapshot.memory_faults,
+                                std::memory_order_relaxed);
+            exceptions.store(snapshot.exceptions, std::memory_order_relaxed);
+            decode_hits.store(snapshot.decode_hits, std::memory_order_relaxed);
+            decode_misses.store(snapshot.decode_misses,
+                                std::memory_order_relaxed);
+
+            sequence.store(start + 2, std::memory_order_release);
+        }
+
+        TelemetrySnapshot read() const noexcept {
+            TelemetrySnapshot snapshot;
+            uint32_t start;
+            do {
+                start = sequence.load(std::memory_order_acquire);
+                if (start & 1) continue;
+
+                const uint32_t packed = state.load(std::memory_order_relaxed);
+                snapshot.state = static_cast<RunState>(packed & 0xFF);
+                snapshot.stop_reason = static_cast<StopReason>(packed >> 8);
+                snapshot.pc = pc.load(std::memory_order_relaxed);
+                snapshot.retired = retired.load(std::memory_order_relaxed);
+                snapshot.memory_faults =
+                    memory_faults.load(std::memory_order_relaxed);
+                snapshot.exceptions =
+                    exceptions.load(std::memory_order_relaxed);
+                snapshot.decode_hits =
+                    decode_hits.load(std::memory_order_relaxed);
+                snapshot.decode_misses =
+                    decode_misses.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while ((start & 1) ||
+                     sequence.load(std::memory_order_relaxed) != start);
+
+            return snapshot;
+        }
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "Telemetry needs lock free atomics in shared memory");
+
+    // Publishes the state of one emulator into a slot, see
+    // Emulator::set_telemetry
+    class TelemetryWriter {
+    public:
+        static constexpr uint64_t DEFAULT_INTERVAL = 1 << 20;
+
+        // interval is the number of instructions between updates of a
+        // running emulator
+        explicit TelemetryWriter(TelemetrySlot& slot,
+                                 const uint64_t interval = DEFAULT_INTERVAL)
+            : slot(&slot), interval(interval ? interval : 1) {}
+
+        uint64_t get_interval() const noexcept { return interval; }
+
+        // Counters are taken from the emulator's metrics and stay zero if
+        // it has none
+        void publish(const RunState state, const StopReason reason,
+                     const uint32_t pc, const uint64_t steps,
+                     const MetricCounters* metrics) noexcept {
+            TelemetrySnapshot snapshot;
+            snapshot.state = state;
+            snapshot.stop_reason = reason;
+            snapshot.pc = pc;
+            snapshot.retired = retired += steps;
+
+            if (metrics) {
+                for (std::size_t i = 0; i < MetricCounters::MEMORY_ERROR_COUNT;
+                     ++i)
+                    snapshot.memory_faults +=
+                        metrics->get(MetricCounters::MEMORY_FAULTS + i);
+                for (std::size_t i = 0; i < MetricCounters::EXCEPTION_COUNT;
+                     ++i)
+                    snapshot.exceptions +=
+                        metrics->get(MetricCounters::EXCEPTIONS + i);
+
+                const auto decode = static_cast<uint8_t>(CacheKind::e_decode);
+                snapshot.decode_hits =
+                    metrics->get(MetricCounters::CACHE_HITS + decode);
+                snapshot.decode_misses =
+                    metrics->get(MetricCounters::CACHE_MISSES + decode);
+            }
+
+            slot->write(snapshot);
+        }
+
+    private:
+        TelemetrySlot* slot;
+        uint64_t interval;
+        uint64_t retired = 0;
+    };
+
+    // Array of telemetry slots in memory shared between processes. The
+    // emulator process creates a named segment (/dev/shm/<name>) and
+    // monitors open it by name, or a segment created without a name is
+    // shared with processes forked after its creation.
+    //
+    // NOTE: Only Linux is supported, create and open fail on other
+    // platforms.
+    class TelemetrySegment {
+    public:
+        static constexpr uint32_t MAGIC = 0x4D545053; // "SPTM"
+        static constexpr uint32_t VERSION = 1;
+
+        TelemetrySegment() = default;
+        ~TelemetrySegment() { close(); }
+
+        TelemetrySegment(const TelemetrySegment&) = delete;
+        TelemetrySegment& operator=(const TelemetrySegment&) = delete;
+
+        // Creates (or replaces) the segment with zeroed slots. The name
+        // must start with a slash, see shm_open.
+        [[nodiscard]] bool create(const std::string& name,
+                                  const uint32_t slot_count) {
+            close();
+            if (slot_count == 0) return false;
+#if defined(__linux__)
+            const std::size_t size = segment_size(slot_count);
+            void* memory = nullptr;
+
+            if (name.empty()) {
+                memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            }
+            else {
+                const int fd =
+                    shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+                if (fd < 0) return false;
+
+                if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+                    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0);
+                }
+                ::close(fd);
+            }
+            if (memory == MAP_FAILED || !memory) return false;
+
+            map(memory, size, slot_count);
+            for (uint32_t i = 0; i < slot_count; ++i)
+                new (&slots[i]) TelemetrySlot{};
+
+            header->slot_count = slot_count;
+            header->version = VERSION;
+            std::atomic_thread_fence(std::memory_order_release);
+            header->magic = MAGIC;
+            owner_name = name;
+            return true;
+#else
+            (void)name;
+            return false;
+#endif
+        }
+
+        // Maps an existing segment read only. The header is only trusted
+        // as far as the segment is large enough for the slots it claims.
+        [[nodiscard]] bool open(const std::string& name) {
+            close();
+#if defined(__linux__)
+            const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0) return false;
+
+            void* memory = nullptr;
+            Header copy;
+            struct stat info;
+            if (pread(fd, &copy, sizeof(copy), 0) == sizeof(copy) &&
+                copy.magic == MAGIC && copy.version == VERSION &&
+                copy.slot_count != 0 && fstat(fd, &info) == 0 &&
+                static_cast<uint64_t>(info.st_size) >=
+                    segment_size(copy.slot_count)) {
+                const std::size_t size = segment_size(copy.slot_count);
+                memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                if (memory == MAP_FAILED) memory = nullptr;
+                if (memory) map(memory, size, copy.slot_count);
+            }
+            ::close(fd);
+            return memory != nullptr;
+#else
+            (void)name;
+            return false;
+#endif
+        }
+
+        // Unmaps the segment, and removes it if this side created it
+        void close() {
+#if defined(__linux__)
+            if (header) munmap(header, mapped_size);
+            if (!owner_name.empty()) shm_unlink(owner_name.c_str());
+#endif
+            header = nullptr;
+            slots = nullptr;
+            slot_count = 0;
+            mapped_size = 0;
+            owner_name.clear();
+        }
+
+        bool is_open() const noexcept { return header != nullptr; }
+        // As mapped, another process rewriting the header doesn't change it
+        uint32_t get_slot_count() const noexcept { return slot_count; }
+
+        // Only valid on the creating side
+        TelemetrySlot& get_slot(const uint32_t index) noexcept {
+            return slots[index];
+        }
+
+        // An idle snapshot for slots that don't exist
+        TelemetrySnapshot read(const uint32_t index) const noexcept {
+            if (index >= slot_count) return {};
+            return slots[index].read();
+        }
+
+    private:
+        struct alignas(64) Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t slot_count;
+        };
+
+        static std::size_t segment_size(const uint32_t count) {
+            return sizeof(Header) + std::size_t(count) * sizeof(TelemetrySlot);
+        }
+
+        void map(void* memory, const std::size_t size, const uint32_t count) {
+            header = static_cast<Header*>(memory);
+            slots = reinterpret_cast<TelemetrySlot*>(
+                static_cast<uint8_t*>(memory) + sizeof(Header));
+            slot_count = count;
+            mapped_size = size;
+        }
+
+        Header* header = nullptr;
+        TelemetrySlot* slots = nullptr;
+        uint32_t slot_count = 0;
+        std::size_t mapped_size = 0;
+        std::string owner_name;
+    };
+} // namespace mips_emulator
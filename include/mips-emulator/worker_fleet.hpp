@@ -0,0 +1,240 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#    include <sys/mman.h>
+#    include <sys/types.h>
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif
+
+namespace mips_emulator {
+    enum class JobStatus : uint32_t {
+        e_pending,
+        e_running,
+        e_done,
+        e_crashed, // The worker running it died
+    };
+
+    template <typename Result>
+    struct JobOutcome {
+        JobStatus status = JobStatus::e_pending;
+        int signal = 0; // That killed the worker, if it crashed
+        Result result{};
+    };
+
+    // Runs a batch of jobs in forked worker processes.
+    //
+    // Everything the parent set up before run, like loaded guest images and
+    // decode caches, is inherited copy on write, so workers start without
+    // copying it. Jobs and results are exchanged through a table in a
+    // shared anonymous mapping: workers claim the next job with an atomic
+    // counter and write the result in place. A worker that dies takes only
+    // the job it was running with it; that job is reported as crashed and
+    // a new worker is forked for the rest of the batch.
+    //
+    // Job and Result must be trivially copyable since they cross process
+    // boundaries. The job function runs in a child of the calling thread
+    // only, it must not depend on locks or threads of the parent. Without
+    // fork the jobs run in the calling process.
+    template <typename Job, typename Result>
+    class WorkerFleet {
+        static_assert(std::is_trivially_copyable_v<Job>,
+                      "Job must be trivially copyable");
+        static_assert(std::is_trivially_copyable_v<Result>,
+                      "Result must be trivially copyable");
+
+    public:
+        struct Options {
+            unsigned workers = 0; // 0 uses every hardware thread
+        };
+
+        WorkerFleet() : WorkerFleet(Options{}) {}
+        explicit WorkerFleet(const Options& options)
+            : workers(options.workers != 0
+                          ? options.workers
+                          : std::max(1U, std::thread::hardware_concurrency())) {
+        }
+
+        // Runs function(job) for every job, returns the outcomes in job
+        // order. Outcomes stay e_pending if the shared table couldn't be
+        // mapped or no worker could be forked.
+        template <typename Function>
+        std::vector<JobOutcome<Result>> run(const std::vector<Job>& jobs,
+                                            Function&& function) {
+            std::vector<JobOutcome<Result>> outcomes(jobs.size());
+            if (jobs.empty()) return outcomes;
+#if defined(__linux__)
+            const std::size_t size = table_size(jobs.size());
+            void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) return outcomes;
+
+            Table table = map(memory, jobs);
+            supervise(table, function);
+
+            for (std::size_t i = 0; i < jobs.size(); ++i) {
+                Slot& slot = table.slots[i];
+                outcomes[i].status = slot.status.load();
+                outcomes[i].signal = slot.signal;
+                outcomes[i].result = slot.result;
+                slot.~Slot();
+            }
+            table.header->~Header();
+            munmap(memory, size);
+#else
+            for (std::size_t i = 0; i < jobs.size(); ++i) {
+                outcomes[i].result = function(jobs[i]);
+                outcomes[i].status = JobStatus::e_done;
+            }
+#endif
+            return outcomes;
+        }
+
+        // Workers that died, over all calls to run
+        uint64_t get_crashes() const noexcept { return crashes; }
+
+    private:
+#if defined(__linux__)
+        struct alignas(64) Header {
+            std::atomic<std::size_t> next{0};
+            std::size_t count = 0;
+        };
+
+        struct alignas(64) Slot {
+            std::atomic<JobStatus> status{JobStatus::e_pending};
+            pid_t worker = 0; // Set before the status becomes e_running
+            int32_t signal = 0;
+            Job job{};
+            Result result{};
+        };
+
+        struct Table {
+            Header* header;
+            Slot* slots;
+        };
+
+        static std::size_t table_size(const std::size_t count) {
+            return sizeof(Header) + count * sizeof(Slot);
+        }
+
+        static Table map(void* memory, const std::vector<Job>& jobs) {
+            Table table;
+            table.header = new (memory) Header{};
+            table.header->count = jobs.size();
+            table.slots = reinterpret_cast<Slot*>(
+                static_cast<uint8_t*>(memory) + sizeof(Header));
+            for (std::size_t i = 0; i < jobs.size(); ++i) {
+                Slot* slot = new (&table.slots[i]) Slot{};
+                slot->job = jobs[i];
+            }
+            return table;
+        }
+
+        template <typename Function>
+        void supervise(Table& table, Function& function) {
+            std::vector<pid_t> pids;
+            const std::size_t count = table.header->count;
+            const unsigned initial =
+                static_cast<unsigned>(std::min<std::size_t>(workers, count));
+            for (unsigned i = 0; i < initial; ++i) {
+                const pid_t pid = spawn(table, function);
+                if (pid > 0) pids.push_back(pid);
+            }
+
+            while (!pids.empty()) {
+                int status = 0;
+                const pid_t pid = wait_for_worker(pids, status);
+
+                if (WIFEXITED(status) && WEXITSTATUS(status) == 0) continue;
+
+                // A worker runs one job at a time, so at most one slot is
+                // still marked as running by it
+                ++crashes;
+                const int signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+                for (std::size_t i = 0; i < count; ++i) {
+                    Slot& slot = table.slots[i];
+                    if (slot.status.load() == JobStatus::e_running &&
+                        slot.worker == pid) {
+                        slot.signal = signal;
+                        slot.status.store(JobStatus::e_crashed);
+                    }
+                }
+
+                if (table.header->next.load() < count) {
+                    const pid_t replacement = spawn(table, function);
+                    if (replacement > 0) pids.push_back(replacement);
+                }
+            }
+
+            // Claimed by a worker that died before marking it as running
+            for (std::size_t i = 0; i < count; ++i) {
+                if (table.slots[i].status.load() != JobStatus::e_done &&
+                    i < table.header->next.load())
+                    table.slots[i].status.store(JobStatus::e_crashed);
+            }
+        }
+
+        // Reaps one of pids and removes it from them.
+        //
+        // NOTE: Only the fleet's own workers are waited for, waitpid(-1)
+        // would reap other children of the host and lose their status.
+        // There is no portable way to block on a set of pids, so the
+        // workers are polled, which costs at most a millisecond per worker
+        // that exits.
+        static pid_t wait_for_worker(std::vector<pid_t>& pids, int& status) {
+            while (true) {
+                for (auto it = pids.begin(); it != pids.end(); ++it) {
+                    const pid_t pid = *it;
+                    const pid_t result = waitpid(pid, &status, WNOHANG);
+                    if (result == 0) continue;
+
+                    // Reaped by someone else, its status is lost and it
+                    // counts as a crash
+                    if (result < 0) status = -1;
+                    pids.erase(it);
+                    return pid;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        template <typename Function>
+        static pid_t spawn(Table& table, Function& function) {
+            const pid_t pid = fork();
+            if (pid != 0) return pid;
+
+            // Child: never returns into the caller's stack
+            try {
+                work(table, function);
+            } catch (...) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+
+        template <typename Function>
+        static void work(Table& table, Function& function) {
+            Header& header = *table.header;
+            for (std::size_t i = header.next.fetch_add(1); i < header.count;
+                 i = header.next.fetch_add(1)) {
+                Slot& slot = table.slots[i];
+                slot.worker = getpid();
+                slot.status.store(JobStatus::e_running);
+                slot.result = function(static_cast<const Job&>(slot.job));
+                slot.status.store(JobStatus::e_done);
+            }
+        }
+#endif
+
+        unsigned workers;
+        uint64_t crashes = 0;
+    };
+} // namespace mips_emulator
@@ -0,0 +1,212 @@
+#include "mips-emulator/c_api.h"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_name.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    constexpr uint32_t MEMORY_BASE = 0x00400000;
+    constexpr uint32_t MEMORY_SIZE = 0x2000;
+
+    std::vector<uint8_t> image(const std::vector<Instruction>& program) {
+        std::vector<uint8_t> bytes;
+        for (const Instruction instr : program) {
+            for (uint32_t i = 0; i < 4; ++i)
+                bytes.push_back(static_cast<uint8_t>(instr.raw >> (i * 8)));
+        }
+        return bytes;
+    }
+
+    // Sums the words in [$a0, $a0 + 4 * $a1) into $v0 and traps
+    const std::vector<uint8_t> SUM = image({
+        Instruction(IOp::e_addiu, Reg::e_v0, Reg::e_0, 0),
+        Instruction(IOp::e_beq, Reg::e_a1, Reg::e_0, 7),
+        Instruction(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0),
+        Instruction(IOp::e_lw, Reg::e_t0, Reg::e_a0, 0),
+        Instruction(Func::e_addu, Reg::e_v0, Reg::e_v0, Reg::e_t0),
+        Instruction(IOp::e_addiu, Reg::e_a0, Reg::e_a0, 4),
+        Instruction(IOp::e_addiu, Reg::e_a1, Reg::e_a1, 0xFFFF),
+        Instruction(IOp::e_beq, Reg::e_0, Reg::e_0, 0xFFF9),
+        Instruction(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0),
+        Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+    });
+
+    // Spins on itself
+    const std::vector<uint8_t> SPIN = image({
+        Instruction(IOp::e_beq, Reg::e_0, Reg::e_0, 0xFFFF),
+        Instruction(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0),
+    });
+
+    mips_instance* create(const std::vector<uint8_t>& program) {
+        return mips_create(program.data(),
+                           static_cast<uint32_t>(program.size()), MEMORY_BASE,
+                           MEMORY_SIZE, MEMORY_BASE);
+    }
+
+    void set_arguments(mips_instance* emulator, const uint32_t a0,
+                       const uint32_t a1) {
+        uint32_t regs[MIPS_REGISTER_ARRAY_SIZE];
+        REQUIRE(mips_read_registers(emulator, regs) == MIPS_OK);
+        regs[static_cast<uint8_t>(Reg::e_a0)] = a0;
+        regs[static_cast<uint8_t>(Reg::e_a1)] = a1;
+        REQUIRE(mips_write_registers(emulator, regs) == MIPS_OK);
+    }
+
+    uint32_t get_register(const mips_instance* emulator, const Reg reg) {
+        uint32_t regs[MIPS_REGISTER_ARRAY_SIZE];
+        REQUIRE(mips_read_registers(emulator, regs) == MIPS_OK);
+        return regs[static_cast<uint8_t>(reg)];
+    }
+} // namespace
+
+TEST_CASE("run a program through the C API", "[CApi]") {
+    REQUIRE(mips_api_version() == MIPS_API_VERSION);
+    REQUIRE(mips_create(nullptr, 4, MEMORY_BASE, MEMORY_SIZE, 0) == nullptr);
+
+    mips_instance* emulator = create(SUM);
+    REQUIRE(emulator != nullptr);
+
+    const uint32_t data[] = {1, 2, 3, 4, 5};
+    REQUIRE(mips_write_memory(emulator, MEMORY_BASE + 0x1000, data,
+                              sizeof(data)) == MIPS_OK);
+    set_arguments(emulator, MEMORY_BASE + 0x1000, 5);
+
+    mips_run_result result;
+    REQUIRE(mips_run(emulator, 10000, &result) == MIPS_OK);
+    REQUIRE(result.reason == MIPS_STOP_FAULT);
+    REQUIRE(result.pc == MEMORY_BASE + 10 * 4);
+    REQUIRE(get_register(emulator, Reg::e_v0) == 15);
+
+    uint32_t read_back[5] = {};
+    REQUIRE(mips_read_memory(emulator, MEMORY_BASE + 0x1000, read_back,
+                             sizeof(read_back)) == MIPS_OK);
+    REQUIRE(read_back[4] == 5);
+
+    // Accesses outside of RAM are rejected as a whole
+    REQUIRE(mips_read_memory(emulator, MEMORY_BASE + MEMORY_SIZE - 4,
+                             read_back, 8) == MIPS_ERROR_OUT_OF_BOUNDS);
+    REQUIRE(mips_write_memory(emulator, MEMORY_BASE - 4, data, 8) ==
+            MIPS_ERROR_OUT_OF_BOUNDS);
+
+    mips_destroy(emulator);
+}
+
+TEST_CASE("create from an ELF executable", "[CApi]") {
+    std::ifstream file(std::string(MIPS_EMULATOR_TEST_DATA_DIR) +
+                           "/recompiler.elf",
+                       std::ios::binary);
+    REQUIRE(file);
+    const std::vector<uint8_t> elf((std::istreambuf_iterator<char>(file)),
+                                   std::istreambuf_iterator<char>());
+
+    mips_status status = MIPS_OK;
+    REQUIRE(mips_create_from_elf(elf.data(), 16, MEMORY_BASE, MEMORY_SIZE,
+                                 &status) == nullptr);
+    REQUIRE(status == MIPS_ERROR_BAD_IMAGE);
+
+    mips_instance* emulator = mips_create_from_elf(
+        elf.data(), elf.size(), MEMORY_BASE, MEMORY_SIZE, &status);
+    REQUIRE(emulator != nullptr);
+    REQUIRE(status == MIPS_OK);
+
+    mips_run_result result;
+    REQUIRE(mips_run(emulator, 100000, &result) == MIPS_OK);
+    REQUIRE(result.reason == MIPS_STOP_FAULT);
+    REQUIRE(get_register(emulator, Reg::e_s2) == 14);
+    REQUIRE(get_register(emulator, Reg::e_s4) == 25);
+
+    mips_destroy(emulator);
+}
+
+TEST_CASE("snapshot and restore", "[CApi]") {
+    mips_instance* emulator = create(SUM);
+    const uint32_t data[] = {10, 20, 30};
+    REQUIRE(mips_write_memory(emulator, MEMORY_BASE + 0x1000, data,
+                              sizeof(data)) == MIPS_OK);
+    set_arguments(emulator, MEMORY_BASE + 0x1000, 3);
+
+    mips_snapshot* snapshot = mips_snapshot_create(emulator);
+    REQUIRE(snapshot != nullptr);
+
+    mips_run_result result;
+    REQUIRE(mips_run(emulator, 10000, &result) == MIPS_OK);
+    REQUIRE(get_register(emulator, Reg::e_v0) == 60);
+
+    // Replays from the snapshot with different data
+    REQUIRE(mips_snapshot_restore(emulator, snapshot) == MIPS_OK);
+    REQUIRE(get_register(emulator, Reg::e_v0) == 0);
+    const uint32_t value = 100;
+    REQUIRE(mips_write_memory(emulator, MEMORY_BASE + 0x1000, &value,
+                              sizeof(value)) == MIPS_OK);
+    REQUIRE(mips_run(emulator, 10000, &result) == MIPS_OK);
+    REQUIRE(get_register(emulator, Reg::e_v0) == 150);
+
+    // Snapshots only fit instances with the same memory layout
+    mips_instance* other = mips_create(nullptr, 0, MEMORY_BASE, 0x1000, 0);
+    REQUIRE(mips_snapshot_restore(other, snapshot) ==
+            MIPS_ERROR_OUT_OF_BOUNDS);
+
+    mips_destroy(other);
+    mips_snapshot_destroy(snapshot);
+    mips_destroy(emulator);
+}
+
+TEST_CASE("loops are detected across runs", "[CApi]") {
+    mips_instance* emulator = create(SPIN);
+    REQUIRE(mips_set_loop_detection(emulator, 1) == MIPS_OK);
+
+    // One instruction at a time
+    mips_run_result result = {};
+    for (uint32_t i = 0; i < 100; ++i) {
+        REQUIRE(mips_run(emulator, 1, &result) == MIPS_OK);
+        if (result.reason != MIPS_STOP_BUDGET_EXHAUSTED) break;
+    }
+    REQUIRE(result.reason == MIPS_STOP_INFINITE_LOOP);
+
+    mips_destroy(emulator);
+}
+
+TEST_CASE("batch run", "[CApi]") {
+    constexpr size_t COUNT = 16;
+
+    std::vector<mips_instance*> emulators;
+    for (size_t i = 0; i < COUNT; ++i) {
+        // Every fourth instance never finishes
+        mips_instance* emulator = create(i % 4 == 3 ? SPIN : SUM);
+        REQUIRE(mips_set_loop_detection(emulator, 1) == MIPS_OK);
+
+        const uint32_t value = static_cast<uint32_t>(i);
+        REQUIRE(mips_write_memory(emulator, MEMORY_BASE + 0x1000, &value,
+                                  sizeof(value)) == MIPS_OK);
+        set_arguments(emulator, MEMORY_BASE + 0x1000, 1);
+        emulators.push_back(emulator);
+    }
+
+    std::vector<mips_run_result> results(COUNT);
+    REQUIRE(mips_run_batch(emulators.data(), COUNT, 10000, results.data(),
+                           4) == MIPS_OK);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        if (i % 4 == 3) {
+            REQUIRE(results[i].reason == MIPS_STOP_INFINITE_LOOP);
+        }
+        else {
+            REQUIRE(results[i].reason == MIPS_STOP_FAULT);
+            REQUIRE(get_register(emulators[i], Reg::e_v0) == i);
+        }
+        mips_destroy(emulators[i]);
+    }
+
+    REQUIRE(mips_run_batch(nullptr, 0, 100, nullptr, 0) == MIPS_OK);
+}
@@ -0,0 +1,295 @@
+#include "mips-emulator/cluster.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/mpsc_queue.hpp"
+#include "mips-emulator/nic.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    constexpr uint32_t MEMORY_SIZE = 0x1000;
+    constexpr uint32_t NIC_BASE = 0x10000;
+
+    using BoardMemory = RuntimeStaticMemory<Nic>;
+    using Board = Emulator<BoardMemory>;
+
+    const Instruction NOP(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0);
+
+    // Passes a token around a ring: receives a word, sends it plus one to
+    // the next port $s1, $s3 times, then traps with the last received
+    // word in $s0. The board with $s4 set sends the first token.
+    const std::vector<Instruction> RING = {
+        Instruction(IOp::e_beq, Reg::e_0, Reg::e_s4, 6),
+        NOP,
+        Instruction(IOp::e_sw, Reg::e_0, Reg::e_t9, Nic::TX_BUFFER),
+        Instruction(IOp::e_sw, Reg::e_s1, Reg::e_t9, Nic::TX_DEST),
+        Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_0, 4),
+        Instruction(IOp::e_sw, Reg::e_t0, Reg::e_t9, Nic::TX_LENGTH),
+        Instruction(IOp::e_sw, Reg::e_0, Reg::e_t9, Nic::TX_SEND),
+        // Wait for a packet
+        Instruction(IOp::e_lw, Reg::e_t1, Reg::e_t9, Nic::STATUS),
+        Instruction(IOp::e_beq, Reg::e_0, Reg::e_t1, 0xFFFE),
+        NOP,
+        Instruction(IOp::e_lw, Reg::e_s0, Reg::e_t9, Nic::RX_BUFFER),
+        Instruction(IOp::e_sw, Reg::e_0, Reg::e_t9, Nic::RX_POP),
+        // Forward it
+        Instruction(IOp::e_addiu, Reg::e_t2, Reg::e_s0, 1),
+        Instruction(IOp::e_sw, Reg::e_t2, Reg::e_t9, Nic::TX_BUFFER),
+        Instruction(IOp::e_sw, Reg::e_s1, Reg::e_t9, Nic::TX_DEST),
+        Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_0, 4),
+        Instruction(IOp::e_sw, Reg::e_t0, Reg::e_t9, Nic::TX_LENGTH),
+        Instruction(IOp::e_sw, Reg::e_0, Reg::e_t9, Nic::TX_SEND),
+        Instruction(IOp::e_addiu, Reg::e_s3, Reg::e_s3, 0xFFFF),
+        Instruction(IOp::e_bne, Reg::e_0, Reg::e_s3, 0xFFF3),
+        NOP,
+        Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+    };
+
+    struct Ring {
+        Ring(const uint32_t size, const uint32_t rounds) : network(size) {
+            for (uint32_t port = 0; port < size; ++port) {
+                nics.push_back(
+                    std::make_shared<Nic>(network, port, NIC_BASE));
+                boards.push_back(std::make_unique<Board>(MEMORY_SIZE, 0,
+                                                         nics.back()));
+
+                auto& memory = boards.back()->get_memory();
+                for (uint32_t i = 0; i < RING.size(); ++i)
+                    REQUIRE_FALSE(memory.store(i * 4, RING[i].raw).is_error());
+
+                RegisterFile regs;
+                regs.set_unsigned(Reg::e_t9, NIC_BASE);
+                regs.set_unsigned(Reg::e_s1, (port + 1) % size);
+                regs.set_unsigned(Reg::e_s3, rounds);
+                regs.set_unsigned(Reg::e_s4, port == 0);
+                boards.back()->set_register_file(regs);
+            }
+        }
+
+        std::vector<RunResult> run(const Cluster<BoardMemory>::Options& options,
+                                   const uint64_t budget) {
+            Cluster<BoardMemory> cluster(options);
+            for (uint32_t i = 0; i < boards.size(); ++i)
+                cluster.add_board(*boards[i], *nics[i]);
+            return cluster.run(budget);
+        }
+
+        uint32_t result(const uint32_t port) const {
+            return boards[port]->get_register_file().get(Reg::e_s0).u;
+        }
+
+        VirtualSwitch network;
+        std::vector<std::shared_ptr<Nic>> nics;
+        std::vector<std::unique_ptr<Board>> boards;
+    };
+} // namespace
+
+TEST_CASE("mpsc queue", "[Cluster]") {
+    constexpr uint32_t PRODUCERS = 4;
+    constexpr uint32_t COUNT = 20000;
+
+    MpscQueue<uint32_t> queue(64);
+    REQUIRE(queue.capacity() == 64);
+
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (uint32_t i = 0; i < COUNT; ++i) {
+                uint32_t value = p << 24 | i;
+                while (!queue.try_push(value))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    // Every producer's values arrive in order
+    std::vector<uint32_t> next(PRODUCERS, 0);
+    bool ordered = true;
+    for (uint32_t received = 0; received < PRODUCERS * COUNT;) {
+        uint32_t value;
+        if (!queue.try_pop(value)) continue;
+
+        const uint32_t producer = value >> 24;
+        ordered &= (value & 0xFFFFFF) == next[producer]++;
+        ++received;
+    }
+    for (auto& producer : producers)
+        producer.join();
+
+    REQUIRE(ordered);
+    uint32_t value;
+    REQUIRE_FALSE(queue.try_pop(value));
+}
+
+TEST_CASE("packets arrive in the next quantum", "[Cluster]") {
+    VirtualSwitch network(3);
+    Nic a(network, 0, NIC_BASE);
+    Nic b(network, 1, NIC_BASE);
+    Nic c(network, 2, NIC_BASE);
+
+    const auto send = [](Nic& nic, const uint32_t destination,
+                         const uint32_t value) {
+        REQUIRE(nic.store<uint32_t>(NIC_BASE + Nic::TX_BUFFER, value));
+        REQUIRE(nic.store<uint32_t>(NIC_BASE + Nic::TX_DEST, destination));
+        REQUIRE(nic.store<uint32_t>(NIC_BASE + Nic::TX_LENGTH, 4));
+        REQUIRE(nic.store<uint32_t>(NIC_BASE + Nic::TX_SEND, 0));
+        REQUIRE(nic.read<uint32_t>(NIC_BASE + Nic::TX_SEND) == 1U);
+    };
+
+    a.deliver(0);
+    b.deliver(0);
+    c.deliver(0);
+    send(c, 1, 30);
+    send(a, 1, 10);
+    send(a, 1, 11);
+    send(b, VirtualSwitch::BROADCAST, 20);
+
+    // Not before the quantum ends
+    b.deliver(0);
+    REQUIRE(b.read<uint32_t>(NIC_BASE + Nic::STATUS) == 0U);
+
+    // Ordered by source and send order
+    b.deliver(1);
+    for (const uint32_t expected : {10, 11, 30}) {
+        REQUIRE(b.read<uint32_t>(NIC_BASE + Nic::STATUS) ==
+                Nic::STATUS_RX_READY);
+        REQUIRE(b.read<uint32_t>(NIC_BASE + Nic::RX_LENGTH) == 4U);
+        REQUIRE(b.read<uint32_t>(NIC_BASE + Nic::RX_BUFFER) == expected);
+        REQUIRE(b.store<uint32_t>(NIC_BASE + Nic::RX_POP, 0));
+    }
+    REQUIRE(b.read<uint32_t>(NIC_BASE + Nic::STATUS) == 0U);
+
+    a.deliver(1);
+    REQUIRE(a.read<uint32_t>(NIC_BASE + Nic::RX_SOURCE) == 1U);
+    REQUIRE(a.read<uint8_t>(NIC_BASE + Nic::RX_BUFFER) == uint8_t(20));
+
+    // Unknown ports drop the packet
+    REQUIRE(a.store<uint32_t>(NIC_BASE + Nic::TX_DEST, 7));
+    REQUIRE(a.store<uint32_t>(NIC_BASE + Nic::TX_SEND, 0));
+    REQUIRE(a.read<uint32_t>(NIC_BASE + Nic::TX_SEND) == 0U);
+    REQUIRE(a.get_dropped() == 1);
+}
+
+TEST_CASE("full queues don't drop packets", "[Cluster]") {
+    // Queues of two packets
+    VirtualSwitch network(3, 2);
+    Nic a(network, 0, NIC_BASE);
+    Nic b(network, 1, NIC_BASE);
+    Nic c(network, 2, NIC_BASE);
+
+    const auto send = [](Nic& nic, const uint32_t destination,
+                         const uint32_t value) {
+        REQUIRE(nic.store<uint32_t>(NIC_BASE + Nic::TX_BUFFER, value));
+        REQUIRE(nic.store<uint32_t>(NIC_BASE + Nic::TX_DEST, destination));
+        REQUIRE(nic.store<uint32_t>(NIC_BASE + Nic::TX_LENGTH, 4));
+        REQUIRE(nic.store<uint32_t>(NIC_BASE + Nic::TX_SEND, 0));
+        REQUIRE(nic.read<uint32_t>(NIC_BASE + Nic::TX_SEND) == 1U);
+    };
+
+    for (uint32_t i = 0; i < 5; ++i)
+        send(c, 1, 30 + i);
+    for (uint32_t i = 0; i < 3; ++i)
+        send(a, VirtualSwitch::BROADCAST, 10 + i);
+
+    b.deliver(1);
+    for (const uint32_t expected : {10, 11, 12, 30, 31, 32, 33, 34}) {
+        REQUIRE(b.read<uint32_t>(NIC_BASE + Nic::RX_BUFFER) == expected);
+        REQUIRE(b.store<uint32_t>(NIC_BASE + Nic::RX_POP, 0));
+    }
+    REQUIRE(b.read<uint32_t>(NIC_BASE + Nic::STATUS) == 0U);
+
+    // Every port of the broadcast got it
+    c.deliver(1);
+    for (const uint32_t expected : {10, 11, 12}) {
+        REQUIRE(c.read<uint32_t>(NIC_BASE + Nic::RX_BUFFER) == expected);
+        REQUIRE(c.store<uint32_t>(NIC_BASE + Nic::RX_POP, 0));
+    }
+    REQUIRE(c.read<uint32_t>(NIC_BASE + Nic::STATUS) == 0U);
+    REQUIRE(a.get_dropped() == 0);
+    REQUIRE(c.get_dropped() == 0);
+}
+
+TEST_CASE("ring of boards", "[Cluster]") {
+    constexpr uint32_t SIZE = 16;
+    constexpr uint32_t ROUNDS = 4;
+
+    Ring single(SIZE, ROUNDS);
+    const auto single_results = single.run({500, 1}, 1000000);
+
+    Ring parallel(SIZE, ROUNDS);
+    const auto parallel_results = parallel.run({500, 4}, 1000000);
+
+    for (uint32_t port = 0; port < SIZE; ++port) {
+        // Every board stops on the final trap
+        REQUIRE(single_results[port].reason == StopReason::e_fault);
+
+        const uint32_t expected =
+            port == 0 ? ROUNDS * SIZE - 1 : (ROUNDS - 1) * SIZE + port - 1;
+        REQUIRE(single.result(port) == expected);
+
+        // Threads don't change the simulation
+        REQUIRE(parallel.result(port) == expected);
+        REQUIRE(parallel_results[port].reason == single_results[port].reason);
+        REQUIRE(parallel_results[port].steps == single_results[port].steps);
+    }
+}
+
+TEST_CASE("budget ends the cluster run", "[Cluster]") {
+    // Nobody starts the token, every board waits forever
+    Ring ring(4, 1);
+    ring.boards[0]->set_register_file([&]() {
+        RegisterFile regs = ring.boards[0]->clone_register_file();
+        regs.set_unsigned(Reg::e_s4, 0);
+        return regs;
+    }());
+
+    const auto results = ring.run({100, 2}, 1050);
+    for (const auto& result : results) {
+        REQUIRE(result.reason == StopReason::e_budget_exhausted);
+        REQUIRE(result.steps == 1050);
+    }
+}
+
+TEST_CASE("boards get counters of their own", "[Cluster]") {
+    Ring ring(3, 2);
+    MetricCounters shared;
+    ring.boards[2]->set_metrics(&shared);
+
+    {
+        Cluster<BoardMemory> cluster({100, 2});
+        for (uint32_t i = 0; i < ring.boards.size(); ++i)
+            cluster.add_board(*ring.boards[i], *ring.nics[i]);
+
+        const MetricCounters* first = ring.boards[0]->get_metrics();
+        const MetricCounters* second = ring.boards[1]->get_metrics();
+        REQUIRE(first);
+        REQUIRE(second);
+        REQUIRE(first != second);
+        REQUIRE(ring.boards[2]->get_metrics() == &shared);
+
+        const auto results = cluster.run(100000);
+        REQUIRE(first->get(MetricCounters::INSTRUCTIONS_RETIRED) ==
+                results[0].steps);
+        REQUIRE(second->get(MetricCounters::INSTRUCTIONS_RETIRED) ==
+                results[1].steps);
+        REQUIRE(shared.get(MetricCounters::INSTRUCTIONS_RETIRED) ==
+                results[2].steps);
+    }
+
+    // Handed back when the cluster goes away
+    REQUIRE(ring.boards[0]->get_metrics() == nullptr);
+    REQUIRE(ring.boards[2]->get_metrics() == &shared);
+}
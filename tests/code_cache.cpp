@@ -0,0 +1,153 @@
+#include "mips-emulator/code_cache.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <vector>
+
+#if defined(__linux__)
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+using namespace mips_emulator;
+
+#if defined(__linux__)
+namespace {
+    std::vector<uint8_t> filler(const std::size_t size) {
+        return std::vector<uint8_t>(size, 0xCC);
+    }
+} // namespace
+
+TEST_CASE("code cache stays within its capacity", "[CodeCache]") {
+    CodeCache::Options options;
+    options.arena_size = 4096;
+    options.capacity = 2 * 4096;
+    CodeCache cache(options);
+
+    std::vector<uint32_t> evicted;
+    cache.set_eviction_handler([&evicted](const CodeCache::Block& block) {
+        evicted.push_back(block.guest_start);
+    });
+
+    const auto code = filler(1000);
+    for (uint32_t i = 0; i < 8; ++i) {
+        const auto* block =
+            cache.add(i * 0x10, i * 0x10 + 0x10, code.data(), code.size());
+        REQUIRE(block != nullptr);
+        REQUIRE(std::memcmp(block->code, code.data(), code.size()) == 0);
+    }
+
+    // 4 blocks per arena, so the 9th reuses the first arena
+    REQUIRE(evicted.empty());
+    REQUIRE(cache.add(0x80, 0x90, code.data(), code.size()) != nullptr);
+    REQUIRE(evicted == std::vector<uint32_t>{0x00, 0x10, 0x20, 0x30});
+    REQUIRE(cache.find(0x00) == nullptr);
+    REQUIRE(cache.find(0x40) != nullptr);
+
+    const auto stats = cache.get_stats();
+    REQUIRE(stats.blocks == 5);
+    REQUIRE(stats.mapped_bytes == 2 * 4096);
+    REQUIRE(stats.flushes == 1);
+    REQUIRE(stats.evictions == 4);
+
+    // Larger than an arena
+    const auto huge = filler(8192);
+    REQUIRE(cache.add(0x100, 0x200, huge.data(), huge.size()) == nullptr);
+}
+
+TEST_CASE("code cache invalidates guest ranges", "[CodeCache]") {
+    CodeCache cache;
+    const auto code = filler(16);
+    REQUIRE(cache.add(0x1000, 0x1100, code.data(), code.size()));
+    REQUIRE(cache.add(0x1100, 0x1104, code.data(), code.size()));
+    REQUIRE(cache.add(0x2000, 0x2010, code.data(), code.size()));
+
+    REQUIRE(cache.invalidate(0x1200, 0x100) == 0);
+    REQUIRE(cache.invalidate(0x10FC, 8) == 2);
+    REQUIRE(cache.find(0x1000) == nullptr);
+    REQUIRE(cache.find(0x1100) == nullptr);
+    REQUIRE(cache.find(0x2000) != nullptr);
+    REQUIRE_FALSE(cache.evict(0x1000));
+    REQUIRE(cache.evict(0x2000));
+}
+
+TEST_CASE("code cache flushes arenas it can't make executable",
+          "[CodeCache]") {
+    const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    CodeCache::Options options;
+    options.arena_size = 2 * page;
+    options.capacity = 2 * page;
+    CodeCache cache(options);
+
+    std::vector<uint32_t> evicted;
+    cache.set_eviction_handler([&evicted](const CodeCache::Block& block) {
+        evicted.push_back(block.guest_start);
+    });
+
+    const auto code = filler(16);
+    const auto* first = cache.add(0x100, 0x110, code.data(), code.size());
+    REQUIRE(first != nullptr);
+
+    // mprotect fails on a range with a hole in it, so making the arena
+    // executable again after the copy fails
+    uint8_t* hole =
+        static_cast<uint8_t*>(const_cast<void*>(first->code)) + page;
+    const auto* second = cache.add(
+        0x200, 0x210, code.size(), [&](uint8_t* write, const void*) {
+            std::memcpy(write, code.data(), code.size());
+            REQUIRE(munmap(hole, page) == 0);
+        });
+
+    REQUIRE(second == nullptr);
+    REQUIRE(cache.find(0x100) == nullptr);
+    REQUIRE(cache.find(0x200) == nullptr);
+    REQUIRE(evicted == std::vector<uint32_t>{0x100});
+    REQUIRE(cache.get_stats().blocks == 0);
+
+    // The arena is usable again once its protection can be changed
+    REQUIRE(mmap(hole, page, PROT_READ | PROT_EXEC,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1,
+                 0) == hole);
+    REQUIRE(cache.add(0x300, 0x310, code.data(), code.size()) != nullptr);
+}
+
+#    if defined(__x86_64__)
+namespace {
+    int unlinked_exit() { return -1; }
+
+    using Entry = int (*)();
+
+    Entry entry_of(const CodeCache::Block* block) {
+        return reinterpret_cast<Entry>(const_cast<void*>(block->code));
+    }
+} // namespace
+
+TEST_CASE("code cache links and unlinks blocks", "[CodeCache]") {
+    CodeCache cache;
+    const auto unlinked = reinterpret_cast<uintptr_t>(&unlinked_exit);
+
+    // jmp [rip + 0] followed by the link slot
+    uint8_t jump[14] = {0xFF, 0x25, 0, 0, 0, 0};
+    std::memcpy(jump + 6, &unlinked, sizeof(unlinked));
+    // mov eax, 42; ret
+    const uint8_t answer[] = {0xB8, 42, 0, 0, 0, 0xC3};
+
+    const auto* from = cache.add(0x100, 0x104, jump, sizeof(jump));
+    const auto* to = cache.add(0x200, 0x204, answer, sizeof(answer));
+    REQUIRE(from != nullptr);
+    REQUIRE(to != nullptr);
+    REQUIRE(entry_of(to)() == 42);
+    REQUIRE(entry_of(from)() == -1);
+
+    void* slot = static_cast<uint8_t*>(const_cast<void*>(from->code)) + 6;
+    REQUIRE_FALSE(cache.link(0x100, slot, 0x300, unlinked));
+    REQUIRE(cache.link(0x100, slot, 0x200, unlinked));
+    REQUIRE(entry_of(from)() == 42);
+
+    // Evicting the target sends the jump back to its exit
+    REQUIRE(cache.evict(0x200));
+    REQUIRE(entry_of(from)() == -1);
+}
+#    endif
+#endif
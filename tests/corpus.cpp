@@ -0,0 +1,74 @@
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace mips_emulator;
+
+namespace {
+    constexpr uint32_t MEMORY_BASE = 0x00400000;
+    constexpr uint32_t MEMORY_SIZE = 0x10000;
+
+    std::string read_file(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    // Runs bench/corpus/<name>.elf for a number of iterations and returns
+    // its output
+    std::string run_corpus(const std::string& name,
+                           const uint32_t iterations) {
+        const std::string path =
+            std::string(MIPS_EMULATOR_BENCH_CORPUS_DIR) + "/" + name;
+
+        ElfFile elf;
+        REQUIRE_FALSE(elf.load_file(path + ".elf").is_error());
+
+        Emulator<RuntimeStaticMemory<>> emulator(MEMORY_SIZE, MEMORY_BASE);
+        auto& memory = emulator.get_memory();
+        REQUIRE(elf.load_into(memory));
+
+        const auto* symbol = elf.find_symbol("iterations");
+        REQUIRE(symbol != nullptr);
+        REQUIRE_FALSE(
+            memory.store<uint32_t>(symbol->address, iterations).is_error());
+
+        // main returns to a trap
+        emulator.set_pc(elf.get_entry());
+        const auto result = emulator.run(100'000'000);
+        REQUIRE(result.reason == StopReason::e_fault);
+
+        const auto* output = elf.find_symbol("output");
+        const auto* length = elf.find_symbol("output_length");
+        REQUIRE(output != nullptr);
+        REQUIRE(length != nullptr);
+
+        const uint32_t size =
+            memory.read<uint32_t>(length->address).get_value();
+        std::string text;
+        for (uint32_t i = 0; i < size; ++i)
+            text.push_back(static_cast<char>(
+                memory.read<uint8_t>(output->address + i).get_value()));
+        return text;
+    }
+} // namespace
+
+TEST_CASE("corpus programs produce the expected output", "[Corpus]") {
+    const std::string dir = MIPS_EMULATOR_BENCH_CORPUS_DIR;
+    for (const char* name :
+         {"coremark", "dhrystone", "compress", "sort", "json"}) {
+        INFO(name);
+        const std::string expected = read_file(dir + "/" + name + ".expected");
+        REQUIRE_FALSE(expected.empty());
+        REQUIRE(run_corpus(name, 1) == expected);
+        // The output doesn't depend on the iteration count
+        REQUIRE(run_corpus(name, 3) == expected);
+    }
+}
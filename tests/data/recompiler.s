@@ -0,0 +1,158 @@
+# Test program for the Recompiler, see tools/link_mips.py for how to build
+# recompiler.elf from it. Results are left in $s0-$s7 and the program ends
+# with a trap.
+    .set noreorder
+    .text
+
+    .globl __start
+    .ent __start
+__start:
+    lui     $sp, %hi(stack_top)
+    addiu   $sp, $sp, %lo(stack_top)
+
+    lui     $a0, %hi(array)
+    addiu   $a0, $a0, %lo(array)
+    addiu   $a1, $zero, 32
+    jal     fill
+    nop
+
+    lui     $a0, %hi(array)
+    addiu   $a0, $a0, %lo(array)
+    addiu   $a1, $zero, 32
+    jal     sum
+    nop
+    move    $s0, $v0
+
+    # Indirect calls through a table of function pointers
+    lui     $s1, %hi(table)
+    addiu   $s1, $s1, %lo(table)
+    lw      $t9, 0($s1)
+    jalr    $t9
+    addiu   $a0, $zero, 7
+    move    $s2, $v0
+    lw      $t9, 4($s1)
+    jalr    $t9
+    addiu   $a0, $zero, -7
+    move    $s3, $v0
+
+    # Compact branches and calls
+    addiu   $a0, $zero, 5
+    balc    square
+    move    $s4, $v0
+
+    addiu   $t0, $zero, 0
+    addiu   $t1, $zero, 10
+1:
+    addiu   $t0, $t0, 3
+    bltc    $t0, $t1, 1b
+    nop
+    move    $s5, $t0
+
+    # Byte and halfword accesses, sign extension
+    lui     $t2, %hi(bytes)
+    addiu   $t2, $t2, %lo(bytes)
+    lb      $t3, 0($t2)
+    lbu     $t4, 0($t2)
+    lh      $t5, 2($t2)
+    lhu     $t6, 2($t2)
+    addu    $s6, $t3, $t4
+    xor     $s6, $s6, $t5
+    subu    $s6, $s6, $t6
+    sb      $s6, 4($t2)
+    sh      $s6, 6($t2)
+    lw      $s7, 4($t2)
+
+    # Branches on sign
+    addiu   $t0, $zero, -3
+    addiu   $t1, $zero, 0
+2:
+    addiu   $t1, $t1, 1
+    bltz    $t0, 2b
+    addiu   $t0, $t0, 1
+    blez    $t1, 3f
+    nop
+    sra     $t1, $t1, 1
+    sll     $t1, $t1, 4
+3:
+    addu    $s5, $s5, $t1
+
+    teq     $zero, $zero
+    .end __start
+
+    # fill(a0 = array, a1 = count): array[i] = i * 3 - 20
+    .globl fill
+    .ent fill
+fill:
+    addiu   $t0, $zero, 0
+    addiu   $t1, $zero, -20
+1:
+    sw      $t1, 0($a0)
+    addiu   $t1, $t1, 3
+    addiu   $a0, $a0, 4
+    addiu   $t0, $t0, 1
+    bne     $t0, $a1, 1b
+    nop
+    jr      $ra
+    nop
+    .end fill
+
+    # sum(a0 = array, a1 = count) of the positive elements, squared
+    .globl sum
+    .ent sum
+sum:
+    addiu   $sp, $sp, -8
+    sw      $ra, 4($sp)
+    sw      $s0, 0($sp)
+    addiu   $s0, $zero, 0
+1:
+    lw      $t0, 0($a0)
+    slt     $t1, $zero, $t0
+    beqz    $t1, 2f
+    nop
+    mul     $t0, $t0, $t0
+    addu    $s0, $s0, $t0
+2:
+    addiu   $a1, $a1, -1
+    bgtz    $a1, 1b
+    addiu   $a0, $a0, 4
+    move    $v0, $s0
+    lw      $s0, 0($sp)
+    lw      $ra, 4($sp)
+    jr      $ra
+    addiu   $sp, $sp, 8
+    .end sum
+
+    .globl double_it
+    .ent double_it
+double_it:
+    jr      $ra
+    sll     $v0, $a0, 1
+    .end double_it
+
+    .globl negate
+    .ent negate
+negate:
+    jr      $ra
+    subu    $v0, $zero, $a0
+    .end negate
+
+    .globl square
+    .ent square
+square:
+    mul     $v0, $a0, $a0
+    jrc     $ra
+    .end square
+
+    .data
+table:
+    .word double_it
+    .word negate
+bytes:
+    .byte 0x80, 0x01, 0xfe, 0xff
+    .word 0
+    .align 4
+array:
+    .space 128
+stack:
+    .space 256
+stack_top:
@@ -0,0 +1,321 @@
+#include "mips-emulator/control_flow.hpp"
+#include "mips-emulator/decode_cache.hpp"
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace mips_emulator;
+
+namespace {
+    const std::string FIXTURE =
+        std::string(MIPS_EMULATOR_TEST_DATA_DIR) + "/recompiler.elf";
+
+    constexpr uint32_t MEMORY_BASE = 0x00400000;
+    constexpr uint32_t MEMORY_SIZE = 0x2000;
+
+    using TestEmulator = Emulator<RuntimeStaticMemory<>>;
+
+    const ElfFile::Segment& code_segment(const ElfFile& elf) {
+        for (const auto& segment : elf.get_segments()) {
+            if (segment.is_executable()) return segment;
+        }
+        FAIL("No executable segment");
+        return elf.get_segments().front();
+    }
+
+    uint32_t run(TestEmulator& emulator) {
+        uint32_t steps = 0;
+        while (emulator.step())
+            ++steps;
+        return steps;
+    }
+} // namespace
+
+TEST_CASE("predecoding matches the decoder", "[DecodeCache]") {
+    ElfFile elf;
+    REQUIRE_FALSE(elf.load_file(FIXTURE).is_error());
+    const auto& segment = code_segment(elf);
+
+    // Small chunks so every thread gets several, and block ends fall on
+    // chunk boundaries
+    DecodeCache<> cache;
+    cache.add_elf(elf, {4, 3});
+
+    for (uint32_t offset = 0; offset + 4 <= segment.data.size(); offset += 4) {
+        const uint32_t address = segment.address + offset;
+        const auto word = elf.read_code(address);
+        REQUIRE_FALSE(word.is_error());
+
+        const auto instr = Instruction(word.get_value());
+        const auto type = instr.get_type();
+        const auto* entry = cache.find(address);
+        if (type.is_error()) {
+            REQUIRE(entry == nullptr);
+            continue;
+        }
+
+        REQUIRE(entry != nullptr);
+        REQUIRE(entry->instr.raw == instr.raw);
+        REQUIRE(entry->type == type.get_value());
+    }
+
+    REQUIRE(cache.find(segment.address + 2) == nullptr);
+    REQUIRE(cache.find(segment.address + segment.data.size()) == nullptr);
+}
+
+TEST_CASE("block starts and branch targets", "[DecodeCache]") {
+    ElfFile elf;
+    REQUIRE_FALSE(elf.load_file(FIXTURE).is_error());
+    const auto& segment = code_segment(elf);
+
+    DecodeCache<> single_thread;
+    single_thread.add_elf(elf, {1, 1024});
+    DecodeCache<> multi_thread;
+    multi_thread.add_elf(elf, {4, 5});
+
+    using Flags = DecodeCache<>::Flags;
+
+    // Called functions start blocks
+    for (const char* name : {"fill", "sum", "square"}) {
+        const auto* symbol = elf.find_symbol(name);
+        REQUIRE(symbol != nullptr);
+        const auto* entry = multi_thread.find(symbol->address);
+        REQUIRE(entry != nullptr);
+        REQUIRE((entry->flags & Flags::e_block_start) != 0);
+        REQUIRE((entry->flags & Flags::e_branch_target) != 0);
+    }
+
+    for (uint32_t offset = 0; offset + 4 <= segment.data.size(); offset += 4) {
+        const uint32_t address = segment.address + offset;
+        const auto* single = single_thread.find(address);
+        const auto* multi = multi_thread.find(address);
+        REQUIRE((single == nullptr) == (multi == nullptr));
+        if (!single) continue;
+
+        // The chunking doesn't change the result
+        REQUIRE(single->flags == multi->flags);
+
+        const auto flow = ControlFlow::analyze(single->instr, address);
+        if (flow.kind != ControlFlow::Kind::e_direct) continue;
+
+        const auto* target = multi_thread.find(flow.target);
+        if (target)
+            REQUIRE((target->flags & Flags::e_branch_target) != 0);
+    }
+}
+
+TEST_CASE("emulator with a decode cache", "[DecodeCache]") {
+    ElfFile elf;
+    REQUIRE_FALSE(elf.load_file(FIXTURE).is_error());
+
+    TestEmulator reference(MEMORY_SIZE, MEMORY_BASE);
+    REQUIRE(elf.load_into(reference.get_memory()));
+    reference.set_pc(elf.get_entry());
+    const uint32_t reference_steps = run(reference);
+    REQUIRE(reference_steps > 100);
+
+    DecodeCache<> cache;
+    cache.add_elf(elf);
+
+    MetricCounters metrics;
+    TestEmulator emulator(MEMORY_SIZE, MEMORY_BASE);
+    REQUIRE(elf.load_into(emulator.get_memory()));
+    emulator.set_pc(elf.get_entry());
+    emulator.set_metrics(&metrics);
+    emulator.set_decode_cache(&cache);
+    REQUIRE(run(emulator) == reference_steps);
+
+    const auto& regs = emulator.get_register_file();
+    const auto& reference_regs = reference.get_register_file();
+    REQUIRE(regs.get_pc() == reference_regs.get_pc());
+    for (uint8_t i = 0; i < RegisterFile::REGISTER_COUNT; ++i)
+        REQUIRE(regs.get(i).u == reference_regs.get(i).u);
+
+    const auto decode = static_cast<uint8_t>(CacheKind::e_decode);
+    REQUIRE(metrics.get(MetricCounters::CACHE_HITS + decode) >=
+            reference_steps);
+    REQUIRE(metrics.get(MetricCounters::CACHE_MISSES + decode) == 0);
+}
+
+TEST_CASE("stores invalidate cached code", "[DecodeCache]") {
+    // Overwrites the instruction at 0x10 with addiu $v0, $zero, 2
+    const std::vector<uint32_t> program = {
+        0x3C082402, // lui   $t0, 0x2402
+        0x35080002, // ori   $t0, $t0, 2
+        0x3C090040, // lui   $t1, 0x40
+        0xAD280010, // sw    $t0, 16($t1)
+        0x24020001, // addiu $v0, $zero, 1
+    };
+
+    std::vector<uint8_t> bytes(program.size() * 4);
+    std::memcpy(bytes.data(), program.data(), bytes.size());
+
+    DecodeCache<> cache;
+    cache.add_range(MEMORY_BASE, bytes.data(),
+                    static_cast<uint32_t>(bytes.size()));
+    REQUIRE(cache.find(MEMORY_BASE + 0x10) != nullptr);
+
+    TestEmulator emulator(MEMORY_SIZE, MEMORY_BASE);
+    auto& memory = emulator.get_memory();
+    for (uint32_t i = 0; i < program.size(); ++i)
+        REQUIRE_FALSE(memory.store(MEMORY_BASE + i * 4, program[i]).is_error());
+
+    emulator.set_pc(MEMORY_BASE);
+    emulator.set_decode_cache(&cache);
+    for (uint32_t i = 0; i < program.size(); ++i)
+        REQUIRE(emulator.step());
+
+    REQUIRE(cache.find(MEMORY_BASE + 0x10) == nullptr);
+    REQUIRE(cache.find(MEMORY_BASE + 0x0C) != nullptr);
+    REQUIRE(emulator.get_register_file().get(RegisterName::e_v0).u == 2);
+}
+
+TEST_CASE("invalidation at the top of the address space", "[DecodeCache]") {
+    const std::vector<uint8_t> bytes(64, 0);
+
+    DecodeCache<> cache;
+    cache.add_range(0xFFFFFFC0, bytes.data(),
+                    static_cast<uint32_t>(bytes.size()));
+    REQUIRE(cache.find(0xFFFFFFC0) != nullptr);
+    REQUIRE(cache.find(0xFFFFFFFC) != nullptr);
+
+    // The last word, then the whole range, both end at 2^32
+    cache.invalidate(0xFFFFFFFC, 4);
+    REQUIRE(cache.find(0xFFFFFFFC) == nullptr);
+    REQUIRE(cache.find(0xFFFFFFF8) != nullptr);
+
+    cache.invalidate(0xFFFFFFC0, 64);
+    REQUIRE(cache.find(0xFFFFFFC0) == nullptr);
+    REQUIRE(cache.find(0xFFFFFFF8) == nullptr);
+}
+
+TEST_CASE("synci and cache invalidate code without snooping",
+          "[DecodeCache]") {
+    // Overwrites the instruction at 0x18 with addiu $v0, $zero, 2, then
+    // runs the instruction at 0x10
+    const uint32_t SYNCI = 0x053F0018; // synci 0x18($t1)
+    const uint32_t CACHE = 0x7D300C25; // cache 0x10, 0x18($t1)
+    const uint32_t NOP = 0x00000000;   // sll $zero, $zero, 0
+    const uint32_t RDHWR = 0x7C03083B; // rdhwr $v1, $1
+
+    for (const uint32_t sync : {NOP, SYNCI, CACHE}) {
+        const std::vector<uint32_t> program = {
+            0x3C082402, // lui   $t0, 0x2402
+            0x35080002, // ori   $t0, $t0, 2
+            0x3C090040, // lui   $t1, 0x40
+            0xAD280018, // sw    $t0, 24($t1)
+            sync,
+            RDHWR,
+            0x24020001, // addiu $v0, $zero, 1
+        };
+
+        std::vector<uint8_t> bytes(program.size() * 4);
+        std::memcpy(bytes.data(), program.data(), bytes.size());
+
+        DecodeCache<> cache;
+        cache.add_range(MEMORY_BASE, bytes.data(),
+                        static_cast<uint32_t>(bytes.size()));
+
+        TestEmulator emulator(MEMORY_SIZE, MEMORY_BASE);
+        auto& memory = emulator.get_memory();
+        for (uint32_t i = 0; i < program.size(); ++i) {
+            REQUIRE_FALSE(
+                memory.store(MEMORY_BASE + i * 4, program[i]).is_error());
+        }
+
+#if defined(__linux__)
+        CodeCache code_cache;
+        const std::vector<uint8_t> code(16, 0xCC);
+        REQUIRE(code_cache.add(MEMORY_BASE + 0x18, MEMORY_BASE + 0x1C,
+                               code.data(), code.size()));
+        REQUIRE(code_cache.add(MEMORY_BASE + 0x40, MEMORY_BASE + 0x44,
+                               code.data(), code.size()));
+        emulator.set_code_cache(&code_cache);
+#endif
+
+        emulator.set_pc(MEMORY_BASE);
+        emulator.set_decode_cache(&cache);
+        emulator.set_store_snooping(false);
+        for (uint32_t i = 0; i < program.size(); ++i)
+            REQUIRE(emulator.step());
+
+        const auto& registers = emulator.get_register_file();
+        REQUIRE(registers.get(RegisterName::e_v1).u == Executor::SYNCI_STEP);
+
+        // Without a SYNCI or CACHE the stale instruction runs
+        const bool synced = sync != NOP;
+        REQUIRE((cache.find(MEMORY_BASE + 0x18) == nullptr) == synced);
+        REQUIRE(registers.get(RegisterName::e_v0).u == (synced ? 2 : 1));
+
+#if defined(__linux__)
+        // Only the line that was named
+        REQUIRE((code_cache.find(MEMORY_BASE + 0x18) == nullptr) == synced);
+        REQUIRE(code_cache.find(MEMORY_BASE + 0x40) != nullptr);
+#endif
+    }
+}
+
+TEST_CASE("synci and index invalidate at the top of the address space",
+          "[DecodeCache]") {
+    const uint32_t SYNCI = 0x053F0000;      // synci 0($t1)
+    const uint32_t INVALIDATE = 0x7D200025; // cache 0x00, 0($t1)
+
+    for (const uint32_t sync : {SYNCI, INVALIDATE}) {
+        const std::vector<uint32_t> program = {
+            0x2409FFC0, // addiu $t1, $zero, -64
+            sync,
+            0x24020001, // addiu $v0, $zero, 1
+        };
+
+        std::vector<uint8_t> bytes(program.size() * 4);
+        std::memcpy(bytes.data(), program.data(), bytes.size());
+        const std::vector<uint8_t> top(64, 0);
+
+        DecodeCache<> cache;
+        cache.add_range(MEMORY_BASE, bytes.data(),
+                        static_cast<uint32_t>(bytes.size()));
+        cache.add_range(0xFFFFFFC0, top.data(),
+                        static_cast<uint32_t>(top.size()));
+
+        TestEmulator emulator(MEMORY_SIZE, MEMORY_BASE);
+        auto& memory = emulator.get_memory();
+        for (uint32_t i = 0; i < program.size(); ++i) {
+            REQUIRE_FALSE(
+                memory.store(MEMORY_BASE + i * 4, program[i]).is_error());
+        }
+
+#if defined(__linux__)
+        CodeCache code_cache;
+        const std::vector<uint8_t> code(16, 0xCC);
+        REQUIRE(code_cache.add(MEMORY_BASE, MEMORY_BASE + 4, code.data(),
+                               code.size()));
+        REQUIRE(code_cache.add(0xFFFFFFF8, 0xFFFFFFFC, code.data(),
+                               code.size()));
+        emulator.set_code_cache(&code_cache);
+#endif
+
+        emulator.set_pc(MEMORY_BASE);
+        emulator.set_decode_cache(&cache);
+        for (uint32_t i = 0; i < program.size(); ++i)
+            REQUIRE(emulator.step());
+
+        // Both drop the last line, including its last word, and only Index
+        // Invalidate drops the rest
+        const bool all = sync == INVALIDATE;
+        REQUIRE(cache.find(0xFFFFFFC0) == nullptr);
+        REQUIRE(cache.find(0xFFFFFFFC) == nullptr);
+        REQUIRE((cache.find(MEMORY_BASE) == nullptr) == all);
+
+#if defined(__linux__)
+        REQUIRE(code_cache.find(0xFFFFFFF8) == nullptr);
+        REQUIRE((code_cache.find(MEMORY_BASE) == nullptr) == all);
+#endif
+    }
+}
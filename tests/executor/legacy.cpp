@@ -0,0 +1,301 @@
+#include "mips-emulator/executor.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <utility>
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::LegacyFunc;
+using Special2Func = Instruction::Special2Func;
+using IOp = Instruction::LegacyITypeOpcode;
+using RegimmOp = Instruction::LegacyRegimmOp;
+using Type = Instruction::Type;
+using R = RegisterName;
+
+namespace {
+    using TestMemory = StaticMemory<64>;
+
+    bool execute_r2(const Instruction instr, RegisterFile& reg_file,
+                    TestMemory& memory) {
+        return Executor::execute<TestMemory, Isa::e_mips32r2>(instr, reg_file,
+                                                          memory);
+    }
+
+    // Records the address and size of every access
+    struct RecordingMemory : TestMemory {
+        using Access = std::pair<uint32_t, uint32_t>;
+        std::vector<Access> accesses;
+
+        template <typename T>
+        Result<T, MemoryError> read(const uint32_t address) {
+            accesses.emplace_back(address, uint32_t(sizeof(T)));
+            return TestMemory::read<T>(address);
+        }
+
+        template <typename T>
+        Result<void, MemoryError> store(const uint32_t address, const T value) {
+            accesses.emplace_back(address, uint32_t(sizeof(T)));
+            return TestMemory::store<T>(address, value);
+        }
+    };
+} // namespace
+
+TEST_CASE("isa decoding", "[Executor]") {
+    // ADDI in r2, POP10 (BEQC etc) in r6
+    const Instruction addi(IOp::e_addi, R::e_t0, R::e_t1, 1);
+    REQUIRE(addi.get_type().get_value() == Type::e_itype);
+    REQUIRE(addi.get_type<Isa::e_mips32r2>().get_value() == Type::e_legacy);
+
+    // MULT in r2 has shamt 0, which is reserved for SOP30 in r6
+    const Instruction mult(Func::e_mult, R::e_0, R::e_t0, R::e_t1);
+    REQUIRE(mult.get_type<Isa::e_mips32r2>().get_value() == Type::e_legacy);
+    const Instruction mul(Instruction::Func::e_sop30, R::e_t2, R::e_t0,
+                          R::e_t1, 2);
+    REQUIRE(mul.get_type<Isa::e_mips32r2>().is_error());
+    REQUIRE(mul.get_type().get_value() == Type::e_rtype);
+
+    // r2 has CACHE at opcode 47, not in SPECIAL3
+    const Instruction cache(Instruction::Special3Func::e_cache, 0, 0,
+                            R::e_t0, R::e_0);
+    REQUIRE(cache.get_type<Isa::e_mips32r2>().is_error());
+    REQUIRE(cache.get_type().get_value() == Type::e_special3_type_cache);
+
+    // BLEZL/BGTZL need rt to be zero
+    const Instruction blezl(IOp::e_blezl, R::e_0, R::e_t0, 3);
+    REQUIRE(blezl.get_type<Isa::e_mips32r2>().get_value() == Type::e_legacy);
+    const Instruction bgtzl(IOp::e_bgtzl, R::e_t1, R::e_t0, 3);
+    REQUIRE(bgtzl.get_type<Isa::e_mips32r2>().is_error());
+
+    // Compact branches don't exist in r2
+    const Instruction bc(Instruction::JTypeOpcode::e_bc, 4);
+    REQUIRE(bc.get_type<Isa::e_mips32r2>().is_error());
+
+    // Shared encodings decode the same
+    const Instruction addiu(Instruction::ITypeOpcode::e_addiu, R::e_t0,
+                            R::e_t1, 1);
+    REQUIRE(addiu.get_type<Isa::e_mips32r2>().get_value() == Type::e_itype);
+
+    // r6 never executes legacy instructions
+    TestMemory memory;
+    RegisterFile reg_file;
+    const Instruction mflo(Func::e_mflo, R::e_t0, R::e_0, R::e_0);
+    REQUIRE_FALSE(Executor::execute(mflo, reg_file, memory));
+}
+
+TEST_CASE("hi lo", "[Executor]") {
+    TestMemory memory;
+    RegisterFile reg_file;
+    reg_file.set_signed(R::e_t0, -3);
+    reg_file.set_signed(R::e_t1, 7);
+
+    const auto mfhi = Instruction(Func::e_mfhi, R::e_t2, R::e_0, R::e_0);
+    const auto mflo = Instruction(Func::e_mflo, R::e_t3, R::e_0, R::e_0);
+    const auto read_hi_lo = [&]() {
+        REQUIRE(execute_r2(mfhi, reg_file, memory));
+        REQUIRE(execute_r2(mflo, reg_file, memory));
+        return (uint64_t(reg_file.get(R::e_t2).u) << 32) |
+               reg_file.get(R::e_t3).u;
+    };
+
+    SECTION("mult") {
+        REQUIRE(execute_r2(Instruction(Func::e_mult, R::e_0, R::e_t0, R::e_t1),
+                           reg_file, memory));
+        REQUIRE(int64_t(read_hi_lo()) == -21);
+    }
+
+    SECTION("multu") {
+        REQUIRE(execute_r2(Instruction(Func::e_multu, R::e_0, R::e_t0, R::e_t1),
+                           reg_file, memory));
+        REQUIRE(read_hi_lo() == uint64_t(uint32_t(-3)) * 7);
+    }
+
+    SECTION("div") {
+        REQUIRE(execute_r2(Instruction(Func::e_div, R::e_0, R::e_t1, R::e_t0),
+                           reg_file, memory));
+        REQUIRE(execute_r2(mfhi, reg_file, memory));
+        REQUIRE(execute_r2(mflo, reg_file, memory));
+        REQUIRE(reg_file.get(R::e_t3).s == -2);
+        REQUIRE(reg_file.get(R::e_t2).s == 1);
+    }
+
+    SECTION("madd and msub") {
+        REQUIRE(execute_r2(Instruction(Func::e_mthi, R::e_0, R::e_t1, R::e_0),
+                           reg_file, memory));
+        REQUIRE(execute_r2(Instruction(Func::e_mtlo, R::e_0, R::e_t1, R::e_0),
+                           reg_file, memory));
+        const uint64_t start = (uint64_t(7) << 32) | 7;
+
+        REQUIRE(execute_r2(
+            Instruction(Special2Func::e_madd, R::e_0, R::e_t0, R::e_t1),
+            reg_file, memory));
+        REQUIRE(read_hi_lo() == start - 21);
+
+        REQUIRE(execute_r2(
+            Instruction(Special2Func::e_msub, R::e_0, R::e_t0, R::e_t1),
+            reg_file, memory));
+        REQUIRE(read_hi_lo() == start);
+    }
+}
+
+TEST_CASE("movn movz", "[Executor]") {
+    TestMemory memory;
+    RegisterFile reg_file;
+    reg_file.set_unsigned(R::e_t0, 5);
+    reg_file.set_unsigned(R::e_t2, 9);
+
+    REQUIRE(execute_r2(Instruction(Func::e_movn, R::e_t2, R::e_t0, R::e_t1),
+                       reg_file, memory));
+    REQUIRE(reg_file.get(R::e_t2).u == 9);
+
+    REQUIRE(execute_r2(Instruction(Func::e_movz, R::e_t2, R::e_t0, R::e_t1),
+                       reg_file, memory));
+    REQUIRE(reg_file.get(R::e_t2).u == 5);
+}
+
+TEST_CASE("special2", "[Executor]") {
+    TestMemory memory;
+    RegisterFile reg_file;
+    reg_file.set_signed(R::e_t0, -6);
+    reg_file.set_unsigned(R::e_t1, 0x00F00000);
+
+    REQUIRE(execute_r2(Instruction(Special2Func::e_mul, R::e_t2, R::e_t0,
+                                   R::e_t0),
+                       reg_file, memory));
+    REQUIRE(reg_file.get(R::e_t2).u == 36);
+
+    REQUIRE(execute_r2(Instruction(Special2Func::e_clz, R::e_t2, R::e_t1,
+                                   R::e_0),
+                       reg_file, memory));
+    REQUIRE(reg_file.get(R::e_t2).u == 8);
+
+    REQUIRE(execute_r2(Instruction(Special2Func::e_clo, R::e_t2, R::e_t0,
+                                   R::e_0),
+                       reg_file, memory));
+    REQUIRE(reg_file.get(R::e_t2).u == 29);
+
+    // All zeros and all ones
+    reg_file.set_signed(R::e_t0, -1);
+    REQUIRE(execute_r2(Instruction(Special2Func::e_clz, R::e_t2, R::e_0,
+                                   R::e_0),
+                       reg_file, memory));
+    REQUIRE(reg_file.get(R::e_t2).u == 32);
+    REQUIRE(execute_r2(Instruction(Special2Func::e_clo, R::e_t2, R::e_t0,
+                                   R::e_0),
+                       reg_file, memory));
+    REQUIRE(reg_file.get(R::e_t2).u == 32);
+}
+
+TEST_CASE("addi", "[Executor]") {
+    TestMemory memory;
+    RegisterFile reg_file;
+    reg_file.set_signed(R::e_t0, INT32_MAX - 1);
+
+    REQUIRE(execute_r2(Instruction(IOp::e_addi, R::e_t1, R::e_t0, 1),
+                       reg_file, memory));
+    REQUIRE(reg_file.get(R::e_t1).s == INT32_MAX);
+
+    REQUIRE_FALSE(execute_r2(Instruction(IOp::e_addi, R::e_t1, R::e_t1, 1),
+                             reg_file, memory));
+    REQUIRE(reg_file.get_cause_register() ==
+            static_cast<uint8_t>(RegisterFile::Exception::e_ov));
+
+    // Negative overflow
+    reg_file.set_signed(R::e_t0, INT32_MIN);
+    REQUIRE_FALSE(execute_r2(Instruction(IOp::e_addi, R::e_t1, R::e_t0,
+                                         0xFFFF),
+                             reg_file, memory));
+}
+
+TEST_CASE("branch likely", "[Executor]") {
+    TestMemory memory;
+    RegisterFile reg_file;
+    reg_file.set_unsigned(R::e_t0, 1);
+
+    // Executed at 0, the PC has been moved past it
+    const auto branch = [&](const Instruction instr) {
+        reg_file.set_pc(4);
+        REQUIRE(execute_r2(instr, reg_file, memory));
+        reg_file.update_pc();
+        return reg_file.get_pc();
+    };
+
+    // Taken: the delay slot runs, then the branch is taken
+    REQUIRE(branch(Instruction(IOp::e_bnel, R::e_t0, R::e_0, 3)) == 16);
+    REQUIRE(branch(Instruction(RegimmOp::e_bgezl, R::e_t0, 3)) == 16);
+
+    // Not taken: the delay slot is skipped
+    REQUIRE(branch(Instruction(IOp::e_beql, R::e_t0, R::e_0, 3)) == 12);
+    REQUIRE(branch(Instruction(IOp::e_blezl, R::e_0, R::e_t0, 3)) == 12);
+
+    // Linking branches always link
+    REQUIRE(branch(Instruction(RegimmOp::e_bltzal, R::e_t0, 3)) == 8);
+    REQUIRE(reg_file.get(R::e_ra).u == 4);
+}
+
+TEST_CASE("unaligned load and store", "[Executor]") {
+    TestMemory memory;
+    RegisterFile reg_file;
+    REQUIRE_FALSE(memory.store<uint32_t>(0, 0x44332211).is_error());
+    REQUIRE_FALSE(memory.store<uint32_t>(4, 0x88776655).is_error());
+
+    // Unaligned word at address 1 with LWR 1 + LWL 4
+    reg_file.set_unsigned(R::e_t0, 1);
+    REQUIRE(execute_r2(Instruction(IOp::e_lwr, R::e_t1, R::e_t0, 0), reg_file,
+                       memory));
+    REQUIRE(execute_r2(Instruction(IOp::e_lwl, R::e_t1, R::e_t0, 3), reg_file,
+                       memory));
+    REQUIRE(reg_file.get(R::e_t1).u == 0x55443322);
+
+    // And back to address 2
+    reg_file.set_unsigned(R::e_t0, 2);
+    REQUIRE(execute_r2(Instruction(IOp::e_swr, R::e_t1, R::e_t0, 0), reg_file,
+                       memory));
+    REQUIRE(execute_r2(Instruction(IOp::e_swl, R::e_t1, R::e_t0, 3), reg_file,
+                       memory));
+    REQUIRE(memory.read<uint32_t>(0).get_value() == 0x33222211);
+    REQUIRE(memory.read<uint32_t>(4).get_value() == 0x88775544);
+}
+
+TEST_CASE("unaligned load and store only access their bytes", "[Executor]") {
+    using Access = RecordingMemory::Access;
+
+    RecordingMemory memory;
+    RegisterFile reg_file;
+    REQUIRE_FALSE(memory.store<uint32_t>(0, 0x44332211).is_error());
+    REQUIRE_FALSE(memory.store<uint32_t>(4, 0x88776655).is_error());
+
+    const auto execute = [&](const Instruction instr) {
+        memory.accesses.clear();
+        REQUIRE(Executor::execute<RecordingMemory, Isa::e_mips32r2>(
+            instr, reg_file, memory));
+        return memory.accesses;
+    };
+
+    reg_file.set_unsigned(R::e_t0, 1);
+    REQUIRE(execute(Instruction(IOp::e_lwr, R::e_t1, R::e_t0, 0)) ==
+            std::vector<Access>{{1, 1}, {2, 2}});
+    REQUIRE(execute(Instruction(IOp::e_lwl, R::e_t1, R::e_t0, 3)) ==
+            std::vector<Access>{{4, 1}});
+    REQUIRE(reg_file.get(R::e_t1).u == 0x55443322);
+
+    reg_file.set_unsigned(R::e_t0, 2);
+    REQUIRE(execute(Instruction(IOp::e_swr, R::e_t1, R::e_t0, 0)) ==
+            std::vector<Access>{{2, 2}});
+    REQUIRE(execute(Instruction(IOp::e_swl, R::e_t1, R::e_t0, 3)) ==
+            std::vector<Access>{{4, 2}});
+    REQUIRE(memory.read<uint32_t>(0).get_value() == 0x33222211);
+    REQUIRE(memory.read<uint32_t>(4).get_value() == 0x88775544);
+
+    // Aligned words are a single access
+    reg_file.set_unsigned(R::e_t0, 4);
+    REQUIRE(execute(Instruction(IOp::e_lwr, R::e_t1, R::e_t0, 0)) ==
+            std::vector<Access>{{4, 4}});
+    REQUIRE(execute(Instruction(IOp::e_swl, R::e_t1, R::e_t0, 3)) ==
+            std::vector<Access>{{4, 4}});
+}
@@ -253,3 +253,62 @@ TEST_CASE("seb", "[Executor]") {
         REQUIRE(reg_file.get(RegisterName::e_t0).u == 0x0000007F);
     }
 }
+
+namespace {
+    // Only counts cycles, see Executor::has_cycle_counter
+    struct CycleCounter {
+        uint64_t get_cycle_count() const { return cycles; }
+        uint64_t cycles;
+    };
+
+    struct NoCycleCounter {};
+} // namespace
+
+TEST_CASE("rdhwr", "[Executor]") {
+    using R = Instruction::Special3Func;
+    using HwReg = Instruction::HardwareRegister;
+
+    const auto rdhwr = [](const uint8_t reg) {
+        return Instruction(R::e_rdhwr, 0, reg, RegisterName::e_0,
+                           RegisterName::e_t0);
+    };
+    const Instruction cc = rdhwr(uint8_t(HwReg::e_cc));
+    const Instruction cc_res = rdhwr(uint8_t(HwReg::e_cc_res));
+    const Instruction ulr = rdhwr(uint8_t(HwReg::e_ulr));
+
+    REQUIRE(cc.get_type().get_value() ==
+            Instruction::Type::e_special3_type_rdhwr);
+
+    RegisterFile reg_file;
+    reg_file.set_user_local(0x7FFF7000);
+
+    SECTION("with a cycle counter") {
+        CycleCounter memory{0x123456789};
+
+        REQUIRE(Executor::handle_special3_type_rdhwr_instr(cc, reg_file,
+                                                           memory));
+        REQUIRE(reg_file.get(RegisterName::e_t0).u == 0x23456789);
+
+        REQUIRE(Executor::handle_special3_type_rdhwr_instr(cc_res, reg_file,
+                                                           memory));
+        REQUIRE(reg_file.get(RegisterName::e_t0).u == 1);
+
+        REQUIRE(Executor::handle_special3_type_rdhwr_instr(ulr, reg_file,
+                                                           memory));
+        REQUIRE(reg_file.get(RegisterName::e_t0).u == 0x7FFF7000);
+
+        // CPUNum isn't implemented
+        REQUIRE_FALSE(Executor::handle_special3_type_rdhwr_instr(
+            rdhwr(0), reg_file, memory));
+    }
+
+    SECTION("without a cycle counter") {
+        NoCycleCounter memory;
+
+        REQUIRE_FALSE(
+            Executor::handle_special3_type_rdhwr_instr(cc, reg_file, memory));
+        REQUIRE(
+            Executor::handle_special3_type_rdhwr_instr(ulr, reg_file, memory));
+        REQUIRE(reg_file.get(RegisterName::e_t0).u == 0x7FFF7000);
+    }
+}
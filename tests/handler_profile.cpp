@@ -0,0 +1,76 @@
+#include "mips-emulator/handler_profile.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_name.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+using Type = Instruction::Type;
+
+TEST_CASE("times are bucketed by their log", "[HandlerProfile]") {
+    REQUIRE(HandlerProfile::bucket_of(0) == 0);
+    REQUIRE(HandlerProfile::bucket_of(1) == 1);
+    REQUIRE(HandlerProfile::bucket_of(2) == 2);
+    REQUIRE(HandlerProfile::bucket_of(3) == 2);
+    REQUIRE(HandlerProfile::bucket_of(64) == 7);
+    REQUIRE(HandlerProfile::bucket_of(UINT64_MAX) ==
+            HandlerProfile::BUCKET_COUNT - 1);
+}
+
+TEST_CASE("one in interval calls is sampled", "[HandlerProfile]") {
+    HandlerProfile profile;
+    profile.set_sample_interval(4);
+
+    int sampled = 0;
+    for (int i = 0; i < 40; ++i)
+        sampled += profile.should_sample();
+    REQUIRE(sampled == 10);
+
+    profile.set_sample_interval(0);
+    REQUIRE(profile.get_sample_interval() == 1);
+    REQUIRE(profile.should_sample());
+}
+
+TEST_CASE("samples are kept per handler and op", "[HandlerProfile]") {
+    const uint8_t addu = HandlerProfile::op_of(
+        Instruction(Func::e_addu, Reg::e_t0, Reg::e_t1, Reg::e_t2));
+    const uint8_t lw = HandlerProfile::op_of(
+        Instruction(IOp::e_lw, Reg::e_t0, Reg::e_sp, 4));
+    REQUIRE(addu == static_cast<uint8_t>(Func::e_addu));
+    REQUIRE(lw == static_cast<uint8_t>(IOp::e_lw));
+
+    HandlerProfile profile;
+    profile.record(Type::e_rtype, addu, 10);
+    profile.record(Type::e_rtype, addu, 30);
+    profile.record(Type::e_itype, lw, 200);
+
+    HandlerProfile other;
+    other.record(Type::e_itype, lw, 300);
+    profile.merge(other);
+
+    const auto& rtype = profile.get_row(Type::e_rtype, addu);
+    REQUIRE(rtype.samples == 2);
+    REQUIRE(rtype.total == 40);
+    REQUIRE(rtype.buckets[4] == 1);
+    REQUIRE(rtype.buckets[5] == 1);
+
+    const auto& itype = profile.get_row(Type::e_itype, lw);
+    REQUIRE(itype.samples == 2);
+    REQUIRE(itype.buckets[8] == 1);
+    REQUIRE(itype.buckets[9] == 1);
+
+    std::ostringstream report;
+    profile.write_report(report);
+    REQUIRE(report.str() == "handler op samples mean p50 p99 histogram\n"
+                            "itype 0x23 2 250 256 512 256:1 512:1\n"
+                            "rtype 0x21 2 20 16 32 16:1 32:1\n");
+
+    profile.reset();
+    REQUIRE(profile.get_row(Type::e_itype, lw).samples == 0);
+}
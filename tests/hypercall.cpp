@@ -0,0 +1,209 @@
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/executor.hpp"
+#include "mips-emulator/hypercall.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/shadow_memory.hpp"
+#include "mips-emulator/static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    using TestEmulator = Emulator<StaticMemory<1024>>;
+    using TaintedEmulator = Emulator<ShadowMemory<StaticMemory<1024>>>;
+
+    const Instruction HYPERCALL((HYPERCALL_CODE << 6) |
+                                static_cast<uint32_t>(Func::e_syscall));
+
+    Instruction li(const Reg reg, const uint16_t value) {
+        return Instruction(IOp::e_addiu, reg, Reg::e_0, value);
+    }
+
+    template <typename Emulator>
+    void load_program(Emulator& emulator,
+                      const std::vector<Instruction>& program) {
+        for (uint32_t i = 0; i < program.size(); ++i) {
+            REQUIRE_FALSE(emulator.get_memory()
+                              .template store<uint32_t>(i * 4, program[i].raw)
+                              .is_error());
+        }
+    }
+
+    // Plain memory without host pointers, so every access is a read or
+    // store
+    class IndirectMemory {
+    public:
+        template <typename T>
+        Result<T, MemoryError> read(const uint32_t address) {
+            return memory.read<T>(address);
+        }
+
+        template <typename T>
+        Result<void, MemoryError> store(const uint32_t address,
+                                        const T value) {
+            return memory.store<T>(address, value);
+        }
+
+        StaticMemory<64> memory;
+    };
+} // namespace
+
+TEST_CASE("hypercalls call host functions", "[Hypercall]") {
+    HypercallTable table;
+    table.add(7, [](HypercallContext& context) {
+        context.set_result(context.get_argument(0) + context.get_argument(1) +
+                           context.get_argument(2) + context.get_argument(3));
+        return true;
+    });
+
+    TestEmulator emulator;
+    emulator.set_hypercalls(&table);
+    load_program(emulator, {
+                               li(Reg::e_v0, 7),
+                               li(Reg::e_a0, 1),
+                               li(Reg::e_a1, 20),
+                               li(Reg::e_a2, 300),
+                               li(Reg::e_a3, 4000),
+                               HYPERCALL,
+                               Instruction(Func::e_teq, Reg::e_0, Reg::e_0,
+                                           Reg::e_0),
+                           });
+
+    REQUIRE(emulator.run(100).steps == 6);
+    REQUIRE(emulator.get_register_file().get(Reg::e_v0).u == 4321);
+}
+
+TEST_CASE("builtins work on guest buffers", "[Hypercall]") {
+    HypercallTable table;
+    table.add_builtins();
+
+    TestEmulator emulator;
+    emulator.set_hypercalls(&table);
+    load_program(
+        emulator,
+        {
+            // memset(0x200, 'a', 3)
+            li(Reg::e_v0, uint16_t(BuiltinHypercall::e_memset)),
+            li(Reg::e_a0, 0x200),
+            li(Reg::e_a1, 'a'),
+            li(Reg::e_a2, 3),
+            HYPERCALL,
+            // memmove(0x201, 0x200, 3)
+            li(Reg::e_v0, uint16_t(BuiltinHypercall::e_memmove)),
+            li(Reg::e_a0, 0x201),
+            li(Reg::e_a1, 0x200),
+            HYPERCALL,
+            // fnv1a(0x200, 4)
+            li(Reg::e_v0, uint16_t(BuiltinHypercall::e_fnv1a)),
+            li(Reg::e_a0, 0x200),
+            li(Reg::e_a1, 4),
+            HYPERCALL,
+            Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+        });
+
+    REQUIRE(emulator.run(100).steps == 13);
+    REQUIRE(emulator.get_memory().read<uint32_t>(0x200).get_value() ==
+            0x61616161);
+    REQUIRE(emulator.get_register_file().get(Reg::e_v0).u == 0x4CEB2DB9);
+}
+
+TEST_CASE("other syscalls raise an exception", "[Hypercall]") {
+    HypercallTable table;
+    table.add_builtins();
+
+    const Instruction plain(static_cast<uint32_t>(Func::e_syscall));
+    for (const Instruction instr : {plain, HYPERCALL}) {
+        RegisterFile reg_file;
+        StaticMemory<64> memory;
+        REQUIRE_FALSE(memory.store<uint32_t>(0, instr.raw).is_error());
+
+        // Without a table even hypercalls are plain syscalls
+        REQUIRE_FALSE(Executor::step(reg_file, memory));
+        REQUIRE(reg_file.has_pending_exception());
+        REQUIRE(reg_file.get_cause_register() ==
+                uint8_t(RegisterFile::Exception::e_sys));
+
+        // Same for the R-type handler without a memory
+        RegisterFile bare;
+        REQUIRE_FALSE(Executor::handle_rtype_instr(instr, bare));
+        REQUIRE(bare.get_cause_register() ==
+                uint8_t(RegisterFile::Exception::e_sys));
+    }
+
+    // Numbers without a function too
+    TestEmulator emulator;
+    emulator.set_hypercalls(&table);
+    load_program(emulator, {li(Reg::e_v0, 100), HYPERCALL});
+    REQUIRE(emulator.run(100).steps == 1);
+    REQUIRE(emulator.get_register_file().get(Reg::e_v0).u == 100);
+}
+
+TEST_CASE("builtins keep taint labels", "[Hypercall]") {
+    HypercallTable table;
+    table.add_builtins();
+
+    TaintedEmulator emulator(0, 1024);
+    emulator.set_hypercalls(&table);
+    load_program(
+        emulator,
+        {
+            // memmove(0x204, 0x200, 8)
+            li(Reg::e_v0, uint16_t(BuiltinHypercall::e_memmove)),
+            li(Reg::e_a0, 0x204),
+            li(Reg::e_a1, 0x200),
+            li(Reg::e_a2, 8),
+            HYPERCALL,
+            // memset(0x300, 0, 2)
+            li(Reg::e_v0, uint16_t(BuiltinHypercall::e_memset)),
+            li(Reg::e_a0, 0x300),
+            li(Reg::e_a1, 0),
+            li(Reg::e_a2, 2),
+            HYPERCALL,
+            Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+        });
+
+    Shadow& shadow = emulator.get_memory().get_shadow();
+    shadow.taint(0x200, 2, 0x01);
+    shadow.taint(0x206, 2, 0x02);
+    shadow.taint(0x300, 4, 0x04);
+
+    REQUIRE(emulator.run(100).steps == 10);
+
+    // The overlapping copy moves the labels with the bytes
+    const TaintLabel expected[] = {1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 2, 2};
+    for (uint32_t i = 0; i < 12; ++i)
+        REQUIRE(shadow.get_label(0x200 + i) == expected[i]);
+
+    // Bytes written by the host are clean
+    REQUIRE(shadow.load(0x300, 4) == 0x04040000);
+}
+
+TEST_CASE("guest memory falls back to single bytes", "[Hypercall]") {
+    IndirectMemory indirect;
+    GuestMemory memory(indirect);
+    REQUIRE(memory.get_host_pointer(0, 4, false) == nullptr);
+
+    const uint8_t bytes[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    REQUIRE(memory.write(0x10, bytes, sizeof(bytes)));
+
+    // Overlapping both ways
+    REQUIRE(memory.copy(0x12, 0x10, 8));
+    REQUIRE(memory.copy(0x11, 0x12, 8));
+
+    uint8_t copy[9];
+    REQUIRE(memory.read(0x10, copy, sizeof(copy)));
+    const uint8_t expected[] = {1, 1, 2, 3, 4, 5, 6, 7, 8};
+    REQUIRE(std::memcmp(copy, expected, sizeof(copy)) == 0);
+
+    // Stops at the end of the memory
+    REQUIRE_FALSE(memory.write(60, bytes, sizeof(bytes)));
+}
@@ -293,6 +293,12 @@ TEST_CASE("Special3 Type", "[Instruction]") {
                       RegisterName::e_t1, RegisterName::e_t2);
         REQUIRE(t.raw == 0x7d2a4260);
     }
+
+    SECTION("get_type cache") {
+        // cache 0x10, 0x18($t1)
+        REQUIRE(instr_type_matches(Instruction(0x7D300C25),
+                                   Type::e_special3_type_cache));
+    }
 }
 
 TEST_CASE("Regimm I Type", "[Instruction]") {
@@ -317,6 +323,12 @@ TEST_CASE("Regimm I Type", "[Instruction]") {
         Instruction t(IOp::e_bltz, RegisterName::e_t1, 8);
         REQUIRE(t.raw == 0x5200008);
     }
+
+    SECTION("synci - register and immediate") {
+        Instruction t(IOp::e_synci, RegisterName::e_t1, 0x18);
+        REQUIRE(t.raw == 0x53F0018);
+        REQUIRE(instr_type_matches(t, Type::e_regimm_itype));
+    }
 }
 
 TEST_CASE("PCrel Type 1", "[Instruction]") {
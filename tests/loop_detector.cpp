@@ -0,0 +1,146 @@
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/loop_detector.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    using TestEmulator = Emulator<StaticMemory<256>>;
+
+    void load_program(TestEmulator& emulator,
+                      const std::vector<Instruction>& program) {
+        for (uint32_t i = 0; i < program.size(); ++i) {
+            const auto result = emulator.get_memory().template store<uint32_t>(
+                i * 4, program[i].raw);
+            REQUIRE_FALSE(result.is_error());
+        }
+    }
+
+    // Branch offset from the instruction at from to to
+    uint16_t offset(const uint32_t from, const uint32_t to) {
+        return static_cast<uint16_t>((int32_t(to) - int32_t(from + 4)) / 4);
+    }
+
+    const Instruction NOP(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0);
+} // namespace
+
+TEST_CASE("spinning program is stopped", "[LoopDetector]") {
+    TestEmulator emulator;
+    load_program(emulator,
+                 {
+                     Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_0, 1),
+                     Instruction(IOp::e_beq, Reg::e_0, Reg::e_0, offset(4, 4)),
+                     NOP,
+                 });
+
+    LoopDetector detector;
+    emulator.set_loop_detector(&detector);
+
+    const auto result = emulator.run(1000);
+    REQUIRE(result.reason == StopReason::e_infinite_loop);
+    REQUIRE(result.steps < 10);
+    REQUIRE(emulator.get_register_file().get_pc() == 4);
+
+    // Without a detector the budget runs out
+    emulator.set_loop_detector(nullptr);
+    const auto budget = emulator.run(1000);
+    REQUIRE(budget.reason == StopReason::e_budget_exhausted);
+    REQUIRE(budget.steps == 1000);
+}
+
+TEST_CASE("terminating loop isn't reported", "[LoopDetector]") {
+    TestEmulator emulator;
+    load_program(emulator,
+                 {
+                     Instruction(IOp::e_addiu, Reg::e_t1, Reg::e_0, 100),
+                     Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_t0, 1),
+                     Instruction(IOp::e_bne, Reg::e_t1, Reg::e_t0,
+                                 offset(8, 4)),
+                     NOP,
+                     Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+                 });
+
+    LoopDetector detector;
+    emulator.set_loop_detector(&detector);
+
+    const auto result = emulator.run(10000);
+    REQUIRE(result.reason == StopReason::e_fault);
+    REQUIRE(result.steps == 1 + 100 * 3);
+    REQUIRE(emulator.get_register_file().get(Reg::e_t0).u == 100);
+}
+
+TEST_CASE("stores are part of the state", "[LoopDetector]") {
+    // The registers are the same at every backward branch, only the stored
+    // value changes unless the increment is dropped
+    const auto program = [](const uint16_t increment) {
+        return std::vector<Instruction>{
+            Instruction(IOp::e_lw, Reg::e_t0, Reg::e_0, 0x80),
+            Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_t0, increment),
+            Instruction(IOp::e_sw, Reg::e_t0, Reg::e_0, 0x80),
+            Instruction(IOp::e_beq, Reg::e_0, Reg::e_0, offset(12, 0)),
+            Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_0, 0),
+        };
+    };
+
+    SECTION("changing memory") {
+        TestEmulator emulator;
+        load_program(emulator, program(1));
+        REQUIRE_FALSE(emulator.get_memory()
+                          .template store<uint32_t>(0x80, 0)
+                          .is_error());
+
+        LoopDetector detector;
+        emulator.set_loop_detector(&detector);
+
+        const auto result = emulator.run(5000);
+        REQUIRE(result.reason == StopReason::e_budget_exhausted);
+        const auto counter =
+            emulator.get_memory().template read<uint32_t>(0x80);
+        REQUIRE(counter.get_value() == 1000);
+    }
+
+    SECTION("same stores") {
+        TestEmulator emulator;
+        load_program(emulator, program(0));
+
+        LoopDetector detector;
+        emulator.set_loop_detector(&detector);
+
+        const auto result = emulator.run(5000);
+        REQUIRE(result.reason == StopReason::e_infinite_loop);
+        REQUIRE(result.steps < 20);
+    }
+}
+
+TEST_CASE("check interval catches longer periods", "[LoopDetector]") {
+    // Toggles $t0 between 0 and 1, so the state repeats every two branches
+    const std::vector<Instruction> program = {
+        Instruction(IOp::e_addiu, Reg::e_t1, Reg::e_0, 1),
+        Instruction(Func::e_xor, Reg::e_t0, Reg::e_t0, Reg::e_t1),
+        Instruction(IOp::e_beq, Reg::e_0, Reg::e_0, offset(8, 4)),
+        NOP,
+    };
+
+    TestEmulator every_branch;
+    load_program(every_branch, program);
+    LoopDetector detector(1);
+    every_branch.set_loop_detector(&detector);
+    REQUIRE(every_branch.run(1000).reason == StopReason::e_budget_exhausted);
+
+    TestEmulator every_other_branch;
+    load_program(every_other_branch, program);
+    LoopDetector interval_detector(2);
+    every_other_branch.set_loop_detector(&interval_detector);
+    REQUIRE(every_other_branch.run(1000).reason ==
+            StopReason::e_infinite_loop);
+}
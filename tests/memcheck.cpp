@@ -0,0 +1,322 @@
+#include "mips-emulator/decode_cache.hpp"
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/memcheck.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using JOp = Instruction::JTypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    constexpr uint32_t MEMORY_SIZE = 0x1000;
+    constexpr uint32_t MALLOC = 0x100;
+    constexpr uint32_t FREE = 0x120;
+    constexpr uint32_t HEAP_POINTER = 0x7FC;
+    constexpr uint32_t HEAP = 0x800;
+    constexpr uint32_t BLOCK = HEAP + 16; // After the default redzone
+
+    using Board = Emulator<RuntimeStaticMemory<>>;
+
+    void store_program(Board& board, const uint32_t address,
+                       const std::vector<Instruction>& program) {
+        for (uint32_t i = 0; i < program.size(); ++i) {
+            REQUIRE_FALSE(board.get_memory()
+                              .store<uint32_t>(address + i * 4, program[i].raw)
+                              .is_error());
+        }
+    }
+
+    // A bump allocator whose free does nothing, behind the main program
+    void load_program(Board& board, const std::vector<Instruction>& program) {
+        store_program(board, 0, program);
+        store_program(board, MALLOC,
+                      {
+                          Instruction(IOp::e_lw, Reg::e_v0, Reg::e_0,
+                                      HEAP_POINTER),
+                          Instruction(Func::e_addu, Reg::e_t9, Reg::e_v0,
+                                      Reg::e_a0),
+                          Instruction(IOp::e_sw, Reg::e_t9, Reg::e_0,
+                                      HEAP_POINTER),
+                          Instruction(Func::e_jr, Reg::e_0, Reg::e_ra,
+                                      Reg::e_0),
+                          Instruction(Func::e_sll, Reg::e_0, Reg::e_0,
+                                      Reg::e_0),
+                      });
+        store_program(board, FREE,
+                      {
+                          Instruction(Func::e_jr, Reg::e_0, Reg::e_ra,
+                                      Reg::e_0),
+                          Instruction(Func::e_sll, Reg::e_0, Reg::e_0,
+                                      Reg::e_0),
+                      });
+        REQUIRE_FALSE(
+            board.get_memory().store<uint32_t>(HEAP_POINTER, HEAP).is_error());
+    }
+
+    Instruction call(const uint32_t function) {
+        return Instruction(JOp::e_jal, function >> 2);
+    }
+
+    const Instruction NOP(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0);
+} // namespace
+
+TEST_CASE("memcheck stops on the first invalid load", "[Memcheck]") {
+    Board board(MEMORY_SIZE);
+    load_program(board, {
+                            Instruction(IOp::e_addiu, Reg::e_a0, Reg::e_0, 8),
+                            call(MALLOC),
+                            NOP,
+                            Instruction(IOp::e_lw, Reg::e_t0, Reg::e_v0, 0),
+                        });
+
+    Memcheck memcheck;
+    memcheck.set_allocator(MALLOC, FREE);
+    board.set_memcheck(&memcheck);
+
+    REQUIRE(board.run(100).reason == StopReason::e_fault);
+    REQUIRE(board.get_register_file().get_pc() == 0x10);
+    REQUIRE(board.get_register_file().get(Reg::e_v0).u == BLOCK);
+
+    // The allocator was asked for the redzones too
+    REQUIRE(board.get_memory().read<uint32_t>(HEAP_POINTER).get_value() ==
+            HEAP + 8 + 2 * 16);
+
+    REQUIRE(memcheck.get_errors().size() == 1);
+    const MemcheckError& error = memcheck.get_errors()[0];
+    REQUIRE(error.kind == MemcheckError::Kind::e_uninitialised_read);
+    REQUIRE(error.pc == 0x0C);
+    REQUIRE(error.address == BLOCK);
+    REQUIRE(error.size == 4);
+}
+
+TEST_CASE("memcheck finds heap errors", "[Memcheck]") {
+    Board board(MEMORY_SIZE);
+    load_program(
+        board,
+        {
+            Instruction(IOp::e_addiu, Reg::e_a0, Reg::e_0, 8),
+            call(MALLOC),
+            NOP,
+            Instruction(IOp::e_sw, Reg::e_t0, Reg::e_v0, 8), // Overrun
+            Instruction(IOp::e_sw, Reg::e_t0, Reg::e_v0, 0),
+            Instruction(IOp::e_lw, Reg::e_t1, Reg::e_v0, 0),
+            Instruction(IOp::e_lbu, Reg::e_t2, Reg::e_v0, 4), // Undefined
+            Instruction(Func::e_or, Reg::e_a0, Reg::e_v0, Reg::e_0),
+            call(FREE),
+            NOP,
+            Instruction(IOp::e_lw, Reg::e_t3, Reg::e_v0, 0), // Freed
+            Instruction(Func::e_or, Reg::e_a0, Reg::e_v0, Reg::e_0),
+            call(FREE), // Double free
+            NOP,
+            Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+        });
+
+    Memcheck::Options options;
+    options.stop_on_error = false;
+    Memcheck memcheck(options);
+    memcheck.set_allocator(MALLOC, FREE);
+    board.set_memcheck(&memcheck);
+
+    REQUIRE(board.run(100).reason == StopReason::e_fault);
+    REQUIRE(board.get_register_file().get_pc() == 0x3C);
+
+    using Kind = MemcheckError::Kind;
+    const auto& errors = memcheck.get_errors();
+    REQUIRE(errors.size() == 4);
+    REQUIRE(errors[0].kind == Kind::e_invalid_write);
+    REQUIRE(errors[0].address == BLOCK + 8);
+    REQUIRE(errors[1].kind == Kind::e_uninitialised_read);
+    REQUIRE(errors[1].address == BLOCK + 4);
+    REQUIRE(errors[1].size == 1);
+    REQUIRE(errors[2].kind == Kind::e_invalid_read);
+    REQUIRE(errors[2].address == BLOCK);
+    REQUIRE(errors[3].kind == Kind::e_invalid_free);
+    REQUIRE(errors[3].pc == FREE);
+    REQUIRE(memcheck.get_blocks().empty());
+
+    std::ostringstream report;
+    memcheck.write_report(report);
+    REQUIRE(report.str() ==
+            "Invalid write of size 4 at 0x818 (pc 0xc)\n"
+            "  0 bytes after a block of size 8 at 0x810\n"
+            "Uninitialised read of size 1 at 0x814 (pc 0x18)\n"
+            "  4 bytes inside a block of size 8 at 0x810\n"
+            "Invalid read of size 4 at 0x810 (pc 0x28)\n"
+            "  0 bytes inside a freed block of size 8 at 0x810\n"
+            "Invalid free at 0x810 (pc 0x120)\n"
+            "  0 bytes inside a freed block of size 8 at 0x810\n"
+            "4 errors, 0 blocks in use\n");
+}
+
+TEST_CASE("memcheck follows the stack pointer", "[Memcheck]") {
+    constexpr uint32_t STACK = 0xF00;
+
+    Board board(MEMORY_SIZE);
+    load_program(
+        board,
+        {
+            // A frame that writes a word and returns
+            Instruction(IOp::e_addiu, Reg::e_sp, Reg::e_sp, 0xFFF0),
+            Instruction(IOp::e_sw, Reg::e_t0, Reg::e_sp, 0),
+            Instruction(IOp::e_addiu, Reg::e_sp, Reg::e_sp, 16),
+            // The next frame at the same place starts undefined
+            Instruction(IOp::e_addiu, Reg::e_sp, Reg::e_sp, 0xFFF0),
+            Instruction(IOp::e_lw, Reg::e_t1, Reg::e_sp, 4),
+            Instruction(IOp::e_lw, Reg::e_t2, Reg::e_sp, 0),
+            Instruction(IOp::e_addiu, Reg::e_sp, Reg::e_sp, 16),
+            // Below $sp
+            Instruction(IOp::e_lw, Reg::e_t3, Reg::e_sp, 0xFFF0),
+            Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+        });
+
+    RegisterFile regs;
+    regs.set_unsigned(Reg::e_sp, STACK);
+    board.set_register_file(regs);
+
+    Memcheck::Options options;
+    options.stop_on_error = false;
+    Memcheck memcheck(options);
+    board.set_memcheck(&memcheck);
+    REQUIRE(board.run(100).reason == StopReason::e_fault);
+
+    using Kind = MemcheckError::Kind;
+    const auto& errors = memcheck.get_errors();
+    REQUIRE(errors.size() == 3);
+    REQUIRE(errors[0].kind == Kind::e_uninitialised_read);
+    REQUIRE(errors[0].address == STACK - 12);
+    REQUIRE(errors[1].kind == Kind::e_uninitialised_read);
+    REQUIRE(errors[1].address == STACK - 16);
+    REQUIRE(errors[2].kind == Kind::e_invalid_read);
+    REQUIRE(errors[2].address == STACK - 16);
+
+    // Switching stacks changes nothing
+    memcheck.before_instruction(regs);
+    regs.set_unsigned(Reg::e_sp, 0x10000000);
+    memcheck.before_instruction(regs);
+    REQUIRE(memcheck.get_validity(STACK) == Validity::e_defined);
+}
+
+TEST_CASE("memcheck forgets old freed blocks", "[Memcheck]") {
+    constexpr uint32_t ROUNDS = 10;
+    constexpr uint32_t BLOCK_STRIDE = 8 + 2 * 16;
+
+    Board board(MEMORY_SIZE);
+    load_program(
+        board,
+        {
+            Instruction(IOp::e_addiu, Reg::e_s0, Reg::e_0, ROUNDS),
+            Instruction(IOp::e_addiu, Reg::e_a0, Reg::e_0, 8),
+            call(MALLOC),
+            NOP,
+            Instruction(Func::e_or, Reg::e_a0, Reg::e_v0, Reg::e_0),
+            call(FREE),
+            NOP,
+            Instruction(IOp::e_addiu, Reg::e_s0, Reg::e_s0, 0xFFFF),
+            Instruction(IOp::e_bne, Reg::e_0, Reg::e_s0, 0xFFF8),
+            NOP,
+            Instruction(IOp::e_lw, Reg::e_t0, Reg::e_0, BLOCK),
+            Instruction(IOp::e_lw, Reg::e_t1, Reg::e_v0, 0),
+            // Hand out the memory of the last block again
+            Instruction(IOp::e_addiu, Reg::e_t2, Reg::e_0,
+                        HEAP + (ROUNDS - 1) * BLOCK_STRIDE),
+            Instruction(IOp::e_sw, Reg::e_t2, Reg::e_0, HEAP_POINTER),
+            Instruction(IOp::e_addiu, Reg::e_a0, Reg::e_0, 8),
+            call(MALLOC),
+            NOP,
+            Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+        });
+
+    Memcheck::Options options;
+    options.stop_on_error = false;
+    options.freed_history = 4;
+    Memcheck memcheck(options);
+    memcheck.set_allocator(MALLOC, FREE);
+    board.set_memcheck(&memcheck);
+    REQUIRE(board.run(1000).reason == StopReason::e_fault);
+
+    // The first block is forgotten, the last one is still described
+    const auto& errors = memcheck.get_errors();
+    REQUIRE(errors.size() == 2);
+    REQUIRE(errors[0].address == BLOCK);
+    REQUIRE(errors[0].block == 0);
+    REQUIRE(errors[1].address == BLOCK + (ROUNDS - 1) * BLOCK_STRIDE);
+    REQUIRE(errors[1].freed);
+
+    // Reusing its memory forgets the last block too
+    REQUIRE(memcheck.get_blocks().size() == 1);
+    REQUIRE(memcheck.get_freed_count() == 3);
+}
+
+TEST_CASE("memcheck validity bits", "[Memcheck]") {
+    Memcheck::Options options;
+    options.default_validity = Validity::e_no_access;
+    Memcheck memcheck(options);
+
+    REQUIRE(memcheck.get_validity(0x12345678) == Validity::e_no_access);
+    REQUIRE_FALSE(memcheck.check_write(0x1000, 4));
+
+    memcheck.set_validity(0x1001, 6, Validity::e_undefined);
+    REQUIRE(memcheck.get_validity(0x1000) == Validity::e_no_access);
+    REQUIRE(memcheck.get_validity(0x1001) == Validity::e_undefined);
+    REQUIRE(memcheck.get_validity(0x1006) == Validity::e_undefined);
+    REQUIRE(memcheck.get_validity(0x1007) == Validity::e_no_access);
+
+    // Stores define what they write
+    REQUIRE(memcheck.check_write(0x1004, 2));
+    REQUIRE(memcheck.get_validity(0x1005) == Validity::e_defined);
+    REQUIRE(memcheck.check_read(0x1004, 2));
+    REQUIRE_FALSE(memcheck.check_read(0x1003, 2));
+    REQUIRE(memcheck.get_errors().back().kind ==
+            MemcheckError::Kind::e_uninitialised_read);
+}
+
+TEST_CASE("memcheck finds the allocator in the ELF", "[Memcheck]") {
+    ElfFile elf;
+    REQUIRE_FALSE(
+        elf.load_file(MIPS_EMULATOR_TEST_DATA_DIR "/recompiler.elf")
+            .is_error());
+
+    Memcheck memcheck;
+    REQUIRE_FALSE(memcheck.intercept(elf));
+    REQUIRE(memcheck.intercept(elf, "fill", "sum"));
+}
+
+TEST_CASE("memcheck checks fetches from the decode cache", "[Memcheck]") {
+    constexpr uint32_t CODE = 0x200;
+
+    Board board(MEMORY_SIZE);
+    const Instruction addiu(IOp::e_addiu, Reg::e_t0, Reg::e_t0, 1);
+    store_program(board, CODE, {addiu, addiu});
+
+    DecodeCache<> cache;
+    const uint32_t words[] = {addiu.raw, addiu.raw};
+    cache.add_range(CODE, reinterpret_cast<const uint8_t*>(words),
+                    sizeof(words));
+
+    Memcheck memcheck;
+    memcheck.set_validity(CODE + 4, 4, Validity::e_no_access);
+    board.set_memcheck(&memcheck);
+    board.set_decode_cache(&cache);
+    board.set_pc(CODE);
+
+    REQUIRE(board.step());
+    REQUIRE_FALSE(board.step());
+    REQUIRE(board.get_register_file().get(Reg::e_t0).u == 1);
+
+    REQUIRE(memcheck.get_errors().size() == 1);
+    const MemcheckError& error = memcheck.get_errors()[0];
+    REQUIRE(error.kind == MemcheckError::Kind::e_invalid_read);
+    REQUIRE(error.pc == CODE + 4);
+    REQUIRE(error.address == CODE + 4);
+}
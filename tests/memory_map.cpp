@@ -0,0 +1,128 @@
+#include "mips-emulator/executor.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/memory_map.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/register_name.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <optional>
+
+using namespace mips_emulator;
+
+using IOp = Instruction::ITypeOpcode;
+
+namespace {
+    // Returns the address as the value for every word read and records the
+    // last store
+    struct TestDevice {
+        template <typename T>
+        std::optional<T> read(const uint32_t address) {
+            return static_cast<T>(address);
+        }
+
+        template <typename T>
+        bool store(const uint32_t address, const T value) {
+            last_address = address;
+            last_value = value;
+            return true;
+        }
+
+        uint32_t last_address = 0;
+        uint32_t last_value = 0;
+    };
+
+    constexpr uint32_t ROM_BASE = 0x1FC00000;
+    constexpr uint32_t DEVICE_BASE = 0x1F000000;
+} // namespace
+
+TEST_CASE("regions", "[MemoryMap]") {
+    using Map = MemoryMap<TestDevice>;
+    using Kind = Map::RegionKind;
+
+    Map map;
+    auto device = std::make_shared<TestDevice>();
+
+    REQUIRE_FALSE(map.map_ram(0, 0x20000).is_error());
+    REQUIRE_FALSE(map.map_rom(ROM_BASE, {0x78, 0x56, 0x34, 0x12}).is_error());
+    REQUIRE_FALSE(map.map_mmio(DEVICE_BASE, Map::PAGE_SIZE, device).is_error());
+
+    REQUIRE(map.get_region_kind(0x1FFFF) == Kind::e_memory);
+    REQUIRE(map.get_region_kind(0x20000) == Kind::e_unmapped);
+    REQUIRE(map.get_region_kind(ROM_BASE) == Kind::e_memory);
+    REQUIRE(map.get_region_kind(DEVICE_BASE) == Kind::e_mmio);
+
+    SECTION("ram") {
+        REQUIRE_FALSE(map.store<uint32_t>(0x1000, 0xCAFEBABE).is_error());
+        REQUIRE(map.read<uint32_t>(0x1000).get_value() == 0xCAFEBABE);
+        REQUIRE(map.read<uint16_t>(0x1002).get_value() == 0xCAFE);
+
+        // Across a page boundary inside the region
+        REQUIRE_FALSE(map.store<uint32_t>(0xFFFE, 0x11223344).is_error());
+        REQUIRE(map.read<uint32_t>(0xFFFE).get_value() == 0x11223344);
+    }
+
+    SECTION("rom") {
+        REQUIRE(map.read<uint32_t>(ROM_BASE).get_value() == 0x12345678);
+
+        const auto result = map.store<uint8_t>(ROM_BASE, 0);
+        REQUIRE(result.is_error());
+        REQUIRE(result.get_error() == MemoryError::read_only_access);
+        REQUIRE(map.read<uint32_t>(ROM_BASE).get_value() == 0x12345678);
+    }
+
+    SECTION("mmio") {
+        REQUIRE(map.read<uint32_t>(DEVICE_BASE + 8).get_value() ==
+                DEVICE_BASE + 8);
+
+        REQUIRE_FALSE(map.store<uint32_t>(DEVICE_BASE + 4, 42).is_error());
+        REQUIRE(device->last_address == DEVICE_BASE + 4);
+        REQUIRE(device->last_value == 42);
+    }
+
+    SECTION("unmapped") {
+        REQUIRE(map.read<uint8_t>(0x20000).get_error() ==
+                MemoryError::out_of_bounds_access);
+        REQUIRE(map.store<uint8_t>(0x80000000, 0).get_error() ==
+                MemoryError::out_of_bounds_access);
+
+        // Straddling the end of RAM
+        REQUIRE(map.read<uint32_t>(0x1FFFE).get_error() ==
+                MemoryError::out_of_bounds_access);
+    }
+
+    SECTION("mapping errors") {
+        REQUIRE(map.map_ram(0x1000, Map::PAGE_SIZE).get_error() ==
+                MemoryMapError::unaligned_region);
+        REQUIRE(map.map_ram(0x30000, 0x1000).get_error() ==
+                MemoryMapError::unaligned_region);
+        REQUIRE(map.map_ram(0x10000, Map::PAGE_SIZE).get_error() ==
+                MemoryMapError::overlapping_region);
+    }
+}
+
+TEST_CASE("boot from rom", "[MemoryMap]") {
+    MemoryMap<> map;
+
+    const Instruction store(IOp::e_sw, RegisterName::e_t0, RegisterName::e_0,
+                            0x100);
+    const Instruction rom_store(IOp::e_sw, RegisterName::e_t0,
+                                RegisterName::e_t1, 0);
+
+    std::vector<uint8_t> image(8);
+    std::memcpy(image.data(), &store.raw, 4);
+    std::memcpy(image.data() + 4, &rom_store.raw, 4);
+
+    REQUIRE_FALSE(map.map_ram(0, MemoryMap<>::PAGE_SIZE).is_error());
+    REQUIRE_FALSE(map.map_rom(ROM_BASE, image).is_error());
+
+    RegisterFile reg_file;
+    reg_file.set_pc(ROM_BASE);
+    reg_file.set_unsigned(RegisterName::e_t0, 7);
+    reg_file.set_unsigned(RegisterName::e_t1, ROM_BASE);
+
+    REQUIRE(Executor::step(reg_file, map));
+    REQUIRE(map.read<uint32_t>(0x100).get_value() == 7);
+
+    REQUIRE_FALSE(Executor::step(reg_file, map));
+}
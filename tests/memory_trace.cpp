@@ -0,0 +1,194 @@
+#include "mips-emulator/cache_model.hpp"
+#include "mips-emulator/decode_cache.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/memory_trace.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    std::string temp_path(const char* name) {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    std::vector<MemoryAccess> read_trace(const std::string& path) {
+        TraceReader reader(path);
+        REQUIRE(reader.is_open());
+
+        std::vector<MemoryAccess> accesses;
+        MemoryAccess access;
+        while (reader.next(access))
+            accesses.push_back(access);
+        REQUIRE_FALSE(reader.is_corrupt());
+        return accesses;
+    }
+
+    void require_equal(const std::vector<MemoryAccess>& accesses,
+                       const std::vector<MemoryAccess>& expected) {
+        REQUIRE(accesses.size() == expected.size());
+        for (std::size_t i = 0; i < accesses.size(); ++i) {
+            REQUIRE(accesses[i].type == expected[i].type);
+            REQUIRE(accesses[i].address == expected[i].address);
+            REQUIRE(accesses[i].size == expected[i].size);
+        }
+    }
+} // namespace
+
+TEST_CASE("memory traces round trip", "[MemoryTrace]") {
+    const std::string path = temp_path("mips_emulator_round_trip.trace");
+
+    std::vector<MemoryAccess> expected;
+    for (uint32_t i = 0; i < 10000; ++i) {
+        expected.push_back({AccessType::e_fetch, 0x400000 + i * 4, 4});
+        if (i % 3 == 0)
+            expected.push_back({AccessType::e_load, 0x7FFFF000 - i * 8, 8});
+        if (i % 7 == 0)
+            expected.push_back(
+                {AccessType::e_store, i * 0x9E3779B1, 1U << (i % 3)});
+    }
+
+    TraceWriter::Options options;
+    options.buffer_size = 256;
+    options.buffers = 2;
+    {
+        TraceWriter writer(path, options);
+        REQUIRE(writer.is_open());
+        for (const MemoryAccess& access : expected)
+            writer.record(access.type, access.address, access.size);
+        REQUIRE(writer.close());
+        REQUIRE(writer.get_records() == expected.size());
+
+        // Sequential fetches and strided loads take a byte each
+        REQUIRE(writer.get_bytes() < expected.size() + 10000 / 7 * 6);
+    }
+
+    require_equal(read_trace(path), expected);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("emulator traces fetches, loads and stores", "[MemoryTrace]") {
+    const std::string path = temp_path("mips_emulator_emulator.trace");
+    const std::vector<Instruction> program = {
+        Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_0, 0x80),
+        Instruction(IOp::e_lw, Reg::e_t1, Reg::e_t0, 0),
+        Instruction(IOp::e_sb, Reg::e_t1, Reg::e_t0, 5),
+        Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+    };
+
+    for (const bool cached : {false, true}) {
+        Emulator<StaticMemory<256>> emulator;
+        auto& memory = emulator.get_memory();
+        for (uint32_t i = 0; i < program.size(); ++i)
+            REQUIRE_FALSE(memory.store(i * 4, program[i]).is_error());
+
+        DecodeCache<> cache;
+        if (cached) {
+            std::vector<uint8_t> bytes(program.size() * 4);
+            std::memcpy(bytes.data(), program.data(), bytes.size());
+            cache.add_range(0, bytes.data(),
+                            static_cast<uint32_t>(bytes.size()));
+            emulator.set_decode_cache(&cache);
+        }
+
+        {
+            TraceWriter writer(path);
+            emulator.set_memory_trace(&writer);
+            REQUIRE(emulator.run(100).reason == StopReason::e_fault);
+            emulator.set_memory_trace(nullptr);
+        }
+
+        const std::vector<MemoryAccess> expected = {
+            {AccessType::e_fetch, 0x0, 4},  {AccessType::e_fetch, 0x4, 4},
+            {AccessType::e_load, 0x80, 4},  {AccessType::e_fetch, 0x8, 4},
+            {AccessType::e_store, 0x85, 1}, {AccessType::e_fetch, 0xC, 4},
+        };
+        require_equal(read_trace(path), expected);
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("cache model replaces the least recently used line",
+          "[MemoryTrace]") {
+    CacheModel::Config config;
+    config.size = 256;
+    config.ways = 2;
+    config.line = 64;
+    REQUIRE(CacheModel::is_valid(config));
+    CacheModel cache(config);
+
+    // Two sets of two ways, 0x000, 0x080 and 0x100 share set 0
+    REQUIRE_FALSE(cache.access(0x000, 4));
+    REQUIRE_FALSE(cache.access(0x080, 4));
+    REQUIRE(cache.access(0x004, 4));
+    REQUIRE_FALSE(cache.access(0x100, 4)); // Evicts 0x080
+    REQUIRE(cache.access(0x000, 4));
+    REQUIRE_FALSE(cache.access(0x080, 4));
+
+    // Spanning two lines misses if either does
+    REQUIRE_FALSE(cache.access(0x03E, 4));
+    REQUIRE(cache.get_stats().accesses == 7);
+    REQUIRE(cache.get_stats().misses == 5);
+
+    config.ways = 3;
+    REQUIRE_FALSE(CacheModel::is_valid(config));
+    config.ways = 0;
+    REQUIRE(CacheModel::is_valid(config));
+}
+
+TEST_CASE("replay splits caches over threads", "[MemoryTrace]") {
+    const std::string path = temp_path("mips_emulator_replay.trace");
+    {
+        TraceWriter writer(path);
+        uint32_t x = 12345;
+        for (uint32_t i = 0; i < 20000; ++i) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            writer.record(AccessType::e_fetch, 0x400000 + (i % 3000) * 4, 4);
+            writer.record(AccessType::e_load, 0x10000000 + (x & 0xFFFF), 4);
+        }
+    }
+
+    std::vector<CacheModel::Config> configs = {
+        {"i", CacheModel::Stream::e_instruction, 8192, 2, 64},
+        {"d", CacheModel::Stream::e_data, 16384, 4, 32},
+        {"u", CacheModel::Stream::e_unified, 32768, 8, 64},
+        {"tlb", CacheModel::Stream::e_unified, 16 * 4096, 0, 4096},
+    };
+
+    std::vector<CacheModel> single(configs.begin(), configs.end());
+    std::vector<CacheModel> parallel(configs.begin(), configs.end());
+    REQUIRE(replay_trace(path, single, 1));
+    REQUIRE(replay_trace(path, parallel, 3));
+
+    REQUIRE(single[0].get_stats().accesses == 20000);
+    REQUIRE(single[1].get_stats().accesses == 20000);
+    REQUIRE(single[2].get_stats().accesses == 40000);
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        REQUIRE(parallel[i].get_stats().accesses ==
+                single[i].get_stats().accesses);
+        REQUIRE(parallel[i].get_stats().misses ==
+                single[i].get_stats().misses);
+    }
+
+    std::vector<CacheModel> missing(configs.begin(), configs.end());
+    REQUIRE_FALSE(replay_trace(path + ".missing", missing));
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,120 @@
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <thread>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+
+TEST_CASE("per-thread counters are aggregated on read", "[Metrics]") {
+    MetricsRegistry registry;
+
+    MetricCounters& main_counters = registry.thread_counters();
+    REQUIRE(&main_counters == &registry.thread_counters());
+
+    main_counters.add_instructions(10);
+    main_counters.record_memory_fault(MemoryError::out_of_bounds_access);
+
+    std::thread worker([&] {
+        MetricCounters& counters = registry.thread_counters();
+        REQUIRE(&counters != &main_counters);
+
+        counters.add_instructions(5);
+        counters.record_exception(RegisterFile::Exception::e_tr);
+    });
+    worker.join();
+
+    const auto snapshot = registry.read();
+    REQUIRE(snapshot[MetricCounters::INSTRUCTIONS_RETIRED] == 15);
+    REQUIRE(snapshot[MetricCounters::MEMORY_FAULTS +
+                     static_cast<uint8_t>(
+                         MemoryError::out_of_bounds_access)] == 1);
+    REQUIRE(snapshot[MetricCounters::EXCEPTIONS +
+                     static_cast<uint8_t>(RegisterFile::Exception::e_tr)] ==
+            1);
+}
+
+TEST_CASE("metrics output formats", "[Metrics]") {
+    MetricsRegistry registry;
+    MetricCounters& counters = registry.thread_counters();
+    counters.add_instructions(3);
+    counters.record_cache_hit(CacheKind::e_decode);
+
+    SECTION("prometheus") {
+        std::ostringstream out;
+        registry.write_prometheus(out);
+
+        const std::string text = out.str();
+        REQUIRE(text.find("mips_emulator_instructions_retired_total 3\n") !=
+                std::string::npos);
+        REQUIRE(text.find("mips_emulator_cache_hits_total{cache=\"decode\"} "
+                          "1\n") != std::string::npos);
+        REQUIRE(text.find("mips_emulator_exceptions_total{cause=\"tr\"} 0\n") !=
+                std::string::npos);
+    }
+
+    SECTION("json") {
+        std::ostringstream out;
+        registry.write_json(out);
+
+        const std::string text = out.str();
+        REQUIRE(text.find("\"instructions_retired\":3") != std::string::npos);
+        REQUIRE(text.find("\"cache_hits\":{\"decode\":1") !=
+                std::string::npos);
+    }
+}
+
+static void store_instruction(Emulator<StaticMemory<256>>& emulator,
+                              const uint32_t address,
+                              const Instruction instr) {
+    const auto result =
+        emulator.get_memory().template store<uint32_t>(address, instr.raw);
+    REQUIRE_FALSE(result.is_error());
+}
+
+TEST_CASE("emulator records metrics", "[Metrics]") {
+    MetricsRegistry registry;
+
+    const Instruction addiu(IOp::e_addiu, RegisterName::e_t0,
+                            RegisterName::e_0, 1);
+    const Instruction teq(Func::e_teq, RegisterName::e_0, RegisterName::e_0,
+                          RegisterName::e_0);
+    const Instruction lw(IOp::e_lw, RegisterName::e_t1, RegisterName::e_0,
+                         0x1000);
+
+    Emulator<StaticMemory<256>> emulator;
+    emulator.set_metrics(&registry.thread_counters());
+
+    SECTION("retired instructions and traps") {
+        store_instruction(emulator, 0, addiu);
+        store_instruction(emulator, 4, teq);
+
+        REQUIRE(emulator.step());
+        REQUIRE_FALSE(emulator.step());
+
+        const auto snapshot = registry.read();
+        REQUIRE(snapshot[MetricCounters::INSTRUCTIONS_RETIRED] == 1);
+        REQUIRE(snapshot[MetricCounters::EXCEPTIONS +
+                         static_cast<uint8_t>(
+                             RegisterFile::Exception::e_tr)] == 1);
+    }
+
+    SECTION("memory faults") {
+        store_instruction(emulator, 0, lw);
+        REQUIRE_FALSE(emulator.step());
+
+        const auto snapshot = registry.read();
+        REQUIRE(snapshot[MetricCounters::INSTRUCTIONS_RETIRED] == 0);
+        REQUIRE(snapshot[MetricCounters::MEMORY_FAULTS +
+                         static_cast<uint8_t>(
+                             MemoryError::out_of_bounds_access)] == 1);
+    }
+}
@@ -0,0 +1,319 @@
+#include "mips-emulator/decode_cache.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/executor.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/memory_map.hpp"
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/mmu.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+using namespace mips_emulator;
+
+using COP0Op = Instruction::COP0Op;
+using COP0Func = Instruction::COP0Func;
+using R = RegisterName;
+
+namespace {
+    constexpr uint32_t RAM_SIZE = 0x100000;
+
+    constexpr uint32_t lo(const uint32_t physical, const bool dirty,
+                          const bool global = false) {
+        return ((physical >> 12) << 6) | (dirty ? Cp0::ENTRY_LO_D : 0) |
+               Cp0::ENTRY_LO_V | (global ? Cp0::ENTRY_LO_G : 0);
+    }
+
+    // Maps the 8 KiB virtual page pair at virt to physical with ASID asid
+    void write_entry(Cp0& cp0, const uint32_t index, const uint32_t virt,
+                     const uint32_t physical, const uint8_t asid,
+                     const bool dirty = true, const bool global = false) {
+        using Reg = Cp0Register;
+        cp0.write_register(uint8_t(Reg::e_index), 0, index);
+        cp0.write_register(uint8_t(Reg::e_page_mask), 0, 0);
+        cp0.write_register(uint8_t(Reg::e_entry_hi), 0, virt | asid);
+        cp0.write_register(uint8_t(Reg::e_entry_lo0), 0,
+                           lo(physical, dirty, global));
+        cp0.write_register(uint8_t(Reg::e_entry_lo1), 0,
+                           lo(physical + 0x1000, dirty, global));
+        cp0.tlb_write_indexed();
+    }
+
+    void set_asid(Cp0& cp0, const uint8_t asid) {
+        cp0.write_register(uint8_t(Cp0Register::e_entry_hi), 0, asid);
+    }
+} // namespace
+
+TEST_CASE("unmapped segments", "[Mmu]") {
+    Mmu<RuntimeStaticMemory<>> mmu(RAM_SIZE);
+
+    REQUIRE_FALSE(mmu.store<uint32_t>(0x80001000, 0xDEADBEEF).is_error());
+    REQUIRE(mmu.read<uint32_t>(0xA0001000).get_value() == 0xDEADBEEF);
+    REQUIRE(mmu.get_physical_memory().read<uint32_t>(0x1000).get_value() ==
+            0xDEADBEEF);
+}
+
+TEST_CASE("tlb translation", "[Mmu]") {
+    Mmu<RuntimeStaticMemory<>> mmu(RAM_SIZE);
+    Cp0& cp0 = mmu.get_cp0();
+
+    SECTION("miss") {
+        const auto result = mmu.read<uint32_t>(0x00400010);
+        REQUIRE(result.get_error() == MemoryError::tlb_miss);
+        REQUIRE(cp0.read_register(uint8_t(Cp0Register::e_bad_vaddr), 0) ==
+                0x00400010);
+        REQUIRE((cp0.read_register(uint8_t(Cp0Register::e_entry_hi), 0) &
+                 ~Cp0::ASID_MASK) == 0x00400000);
+    }
+
+    SECTION("even and odd pages") {
+        write_entry(cp0, 1, 0x00400000, 0x20000, 0);
+
+        REQUIRE_FALSE(mmu.store<uint32_t>(0x00400004, 1).is_error());
+        REQUIRE_FALSE(mmu.store<uint32_t>(0x00401004, 2).is_error());
+        REQUIRE(mmu.read<uint32_t>(0x80020004).get_value() == 1);
+        REQUIRE(mmu.read<uint32_t>(0x80021004).get_value() == 2);
+
+        // Cached translation
+        REQUIRE(mmu.read<uint32_t>(0x00400004).get_value() == 1);
+    }
+
+    SECTION("clean pages can't be written") {
+        write_entry(cp0, 0, 0x00400000, 0x20000, 0, false);
+
+        REQUIRE_FALSE(mmu.read<uint32_t>(0x00400000).is_error());
+        REQUIRE(mmu.store<uint32_t>(0x00400000, 1).get_error() ==
+                MemoryError::tlb_modified);
+    }
+
+    SECTION("asid") {
+        write_entry(cp0, 0, 0x00400000, 0x20000, 1);
+        write_entry(cp0, 1, 0x00400000, 0x30000, 2);
+        write_entry(cp0, 2, 0x10000000, 0x40000, 1, true, true);
+        REQUIRE_FALSE(mmu.store<uint32_t>(0x80020000, 1).is_error());
+        REQUIRE_FALSE(mmu.store<uint32_t>(0x80030000, 2).is_error());
+        REQUIRE_FALSE(mmu.store<uint32_t>(0x80040000, 3).is_error());
+
+        set_asid(cp0, 1);
+        REQUIRE(mmu.read<uint32_t>(0x00400000).get_value() == 1);
+        REQUIRE(mmu.read<uint32_t>(0x10000000).get_value() == 3);
+
+        set_asid(cp0, 2);
+        REQUIRE(mmu.read<uint32_t>(0x00400000).get_value() == 2);
+        REQUIRE(mmu.read<uint32_t>(0x10000000).get_value() == 3);
+
+        set_asid(cp0, 3);
+        REQUIRE(mmu.read<uint32_t>(0x00400000).get_error() ==
+                MemoryError::tlb_miss);
+        REQUIRE(mmu.read<uint32_t>(0x10000000).get_value() == 3);
+    }
+
+    SECTION("rewriting an entry flushes its cached pages") {
+        REQUIRE_FALSE(mmu.store<uint32_t>(0x80020000, 1).is_error());
+        REQUIRE_FALSE(mmu.store<uint32_t>(0x80030000, 2).is_error());
+
+        write_entry(cp0, 3, 0x00400000, 0x20000, 0);
+        REQUIRE(mmu.read<uint32_t>(0x00400000).get_value() == 1);
+
+        write_entry(cp0, 3, 0x00400000, 0x30000, 0);
+        REQUIRE(mmu.read<uint32_t>(0x00400000).get_value() == 2);
+    }
+
+    SECTION("rom through a dirty page") {
+        Mmu<MemoryMap<>> mapped;
+        REQUIRE_FALSE(mapped.get_physical_memory()
+                          .map_rom(0x10000, {1, 2, 3, 4})
+                          .is_error());
+        write_entry(mapped.get_cp0(), 0, 0x00400000, 0x10000, 0);
+
+        REQUIRE(mapped.read<uint32_t>(0x00400000).get_value() == 0x04030201);
+        REQUIRE(mapped.store<uint32_t>(0x00400000, 0).get_error() ==
+                MemoryError::read_only_access);
+    }
+
+    SECTION("cached page lookups are recorded") {
+        constexpr auto TRANSLATION =
+            static_cast<uint8_t>(CacheKind::e_translation);
+
+        MetricsRegistry registry;
+        mmu.set_metrics(&registry.thread_counters());
+        write_entry(cp0, 0, 0x00400000, 0x20000, 0);
+
+        REQUIRE_FALSE(mmu.store<uint32_t>(0x00400000, 1).is_error());
+        REQUIRE(mmu.read<uint32_t>(0x00400000).get_value() == 1);
+        REQUIRE(mmu.read<uint32_t>(0x00401000).get_value() == 0);
+        REQUIRE(mmu.get_host_pointer(0x00400000, 4, true) != nullptr);
+        REQUIRE(mmu.get_host_pointer(0x00402000, 4, false) == nullptr);
+
+        // Unmapped segments don't go through the cache
+        REQUIRE(mmu.read<uint32_t>(0x80020000).get_value() == 1);
+
+        const auto snapshot = registry.read();
+        REQUIRE(snapshot[MetricCounters::CACHE_HITS + TRANSLATION] == 2);
+        REQUIRE(snapshot[MetricCounters::CACHE_MISSES + TRANSLATION] == 2);
+    }
+}
+
+TEST_CASE("fetches are translated with a decode cache", "[Mmu]") {
+    const Instruction addiu(Instruction::ITypeOpcode::e_addiu, R::e_t0,
+                            R::e_t0, 1);
+    DecodeCache<> cache;
+    cache.add_range(0x00400000, reinterpret_cast<const uint8_t*>(&addiu.raw),
+                    4);
+
+    Emulator<Mmu<RuntimeStaticMemory<>>> emulator(RAM_SIZE);
+    auto& mmu = emulator.get_memory();
+    REQUIRE_FALSE(mmu.store<uint32_t>(0x80020000, addiu.raw).is_error());
+    emulator.set_decode_cache(&cache);
+    emulator.set_pc(0x00400000);
+
+    // Nothing maps the page yet, the cached instruction must not run
+    REQUIRE_FALSE(emulator.step());
+    REQUIRE(mmu.get_cp0().read_register(uint8_t(Cp0Register::e_bad_vaddr),
+                                        0) == 0x00400000);
+
+    write_entry(mmu.get_cp0(), 0, 0x00400000, 0x20000, 0);
+    emulator.set_pc(0x00400000);
+    REQUIRE(emulator.step());
+    REQUIRE(emulator.get_register_file().get(R::e_t0).u == 1);
+}
+
+TEST_CASE("cop0 instructions", "[Mmu]") {
+    using Reg = Cp0Register;
+
+    Mmu<RuntimeStaticMemory<>> mmu(RAM_SIZE);
+    RegisterFile reg_file;
+
+    const auto execute = [&](const Instruction instr) {
+        return Executor::execute(instr, reg_file, mmu);
+    };
+    const auto mtc0 = [&](const Reg reg, const uint32_t value) {
+        reg_file.set_unsigned(R::e_t0, value);
+        return execute(Instruction(COP0Op::e_mt, R::e_t0, uint8_t(reg)));
+    };
+    const auto mfc0 = [&](const Reg reg) {
+        REQUIRE(execute(Instruction(COP0Op::e_mf, R::e_t1, uint8_t(reg))));
+        return reg_file.get(R::e_t1).u;
+    };
+
+    // Write entry 5 with tlbwi
+    REQUIRE(mtc0(Reg::e_index, 5));
+    REQUIRE(mtc0(Reg::e_entry_hi, 0x7FFFE000 | 7));
+    REQUIRE(mtc0(Reg::e_entry_lo0, lo(0x50000, true)));
+    REQUIRE(mtc0(Reg::e_entry_lo1, lo(0x51000, true)));
+    REQUIRE(execute(Instruction(COP0Func::e_tlbwi)));
+
+    REQUIRE_FALSE(mmu.store<uint32_t>(0x7FFFF000, 42).is_error());
+    REQUIRE(mmu.read<uint32_t>(0x80051000).get_value() == 42);
+
+    // tlbp finds it, and fails for other addresses
+    REQUIRE(mtc0(Reg::e_entry_hi, 0x7FFFF000 | 7));
+    REQUIRE(execute(Instruction(COP0Func::e_tlbp)));
+    REQUIRE(mfc0(Reg::e_index) == 5);
+
+    REQUIRE(mtc0(Reg::e_entry_hi, 0x00002000 | 7));
+    REQUIRE(execute(Instruction(COP0Func::e_tlbp)));
+    REQUIRE(mfc0(Reg::e_index) & Cp0::PROBE_FAILURE);
+
+    // tlbr reads it back
+    REQUIRE(mtc0(Reg::e_index, 5));
+    REQUIRE(execute(Instruction(COP0Func::e_tlbr)));
+    REQUIRE(mfc0(Reg::e_entry_hi) == (0x7FFFE000 | 7));
+    REQUIRE(mfc0(Reg::e_entry_lo1) == lo(0x51000, true));
+
+    // tlbwr uses Random, which skips wired entries
+    REQUIRE(mtc0(Reg::e_wired, 14));
+    REQUIRE(mfc0(Reg::e_random) == Cp0::TLB_SIZE - 1);
+    REQUIRE(execute(Instruction(COP0Func::e_tlbwr)));
+    REQUIRE(mfc0(Reg::e_random) == 14);
+    REQUIRE(execute(Instruction(COP0Func::e_tlbwr)));
+    REQUIRE(mfc0(Reg::e_random) == Cp0::TLB_SIZE - 1);
+}
+
+TEST_CASE("cop0 needs a cp0", "[Mmu]") {
+    Emulator<RuntimeStaticMemory<>> plain(0x100);
+    const Instruction tlbwi(COP0Func::e_tlbwi);
+    REQUIRE_FALSE(plain.get_memory().store<uint32_t>(0, tlbwi.raw).is_error());
+    REQUIRE_FALSE(plain.step());
+
+    // The emulator forwards the Cp0 of an Mmu
+    Emulator<Mmu<RuntimeStaticMemory<>>> mapped(0x2000);
+    auto& mmu = mapped.get_memory();
+    write_entry(mmu.get_cp0(), 0, 0, 0, 0);
+    REQUIRE_FALSE(mmu.store<uint32_t>(0, tlbwi.raw).is_error());
+    REQUIRE(mapped.step());
+}
+
+TEST_CASE("count and compare", "[Mmu]") {
+    using Reg = Cp0Register;
+
+    SECTION("count follows the cycles") {
+        Cp0 cp0;
+        const auto read = [&](const Reg reg) {
+            return cp0.read_register(uint8_t(reg), 0);
+        };
+
+        cp0.set_cycles(100);
+        REQUIRE(read(Reg::e_count) == 100);
+
+        cp0.write_register(uint8_t(Reg::e_count), 0, 0);
+        cp0.write_register(uint8_t(Reg::e_compare), 0, 60);
+        cp0.set_cycles(150);
+        REQUIRE(read(Reg::e_count) == 50);
+        REQUIRE((read(Reg::e_cause) & Cp0::CAUSE_TI) == 0);
+
+        // Raised once Count passes Compare, cleared by writing Compare
+        cp0.set_cycles(205);
+        REQUIRE(read(Reg::e_cause) & Cp0::CAUSE_TI);
+        cp0.write_register(uint8_t(Reg::e_compare), 0, 60);
+        REQUIRE((read(Reg::e_cause) & Cp0::CAUSE_TI) == 0);
+        cp0.set_cycles(300);
+        REQUIRE((read(Reg::e_cause) & Cp0::CAUSE_TI) == 0);
+    }
+
+    SECTION("backed by the retired instructions") {
+        using IOp = Instruction::ITypeOpcode;
+        using Func = Instruction::Func;
+        using S3Func = Instruction::Special3Func;
+        using HwReg = Instruction::HardwareRegister;
+
+        // Sets Compare to 20, loops 30 times and reads Count, Cause and CC
+        const Instruction program[] = {
+            Instruction(COP0Op::e_mt, R::e_t0, uint8_t(Reg::e_compare)),
+            Instruction(IOp::e_addiu, R::e_t1, R::e_t1, 1),
+            Instruction(IOp::e_bne, R::e_t2, R::e_t1, 0xFFFE),
+            Instruction(Func::e_sll, R::e_0, R::e_0, R::e_0),
+            Instruction(COP0Op::e_mf, R::e_t3, uint8_t(Reg::e_count)),
+            Instruction(COP0Op::e_mf, R::e_t4, uint8_t(Reg::e_cause)),
+            Instruction(S3Func::e_rdhwr, 0, uint8_t(HwReg::e_cc), R::e_0,
+                        R::e_t5),
+            Instruction(Func::e_teq, R::e_0, R::e_0, R::e_0),
+        };
+
+        Emulator<Mmu<RuntimeStaticMemory<>>> emulator(0x2000);
+        auto& mmu = emulator.get_memory();
+        write_entry(mmu.get_cp0(), 0, 0, 0, 0);
+        for (uint32_t i = 0; i < 8; ++i) {
+            REQUIRE_FALSE(
+                mmu.store<uint32_t>(i * 4, program[i].raw).is_error());
+        }
+
+        RegisterFile regs;
+        regs.set_unsigned(R::e_t0, 20);
+        regs.set_unsigned(R::e_t2, 30);
+        emulator.set_register_file(regs);
+
+        // Split over runs, the count carries over
+        REQUIRE(emulator.run(50).steps == 50);
+        const auto result = emulator.run(1000);
+        REQUIRE(result.reason == StopReason::e_fault);
+        REQUIRE(emulator.get_retired() == 94);
+
+        const auto& reg_file = emulator.get_register_file();
+        REQUIRE(reg_file.get(R::e_t3).u == 91);
+        REQUIRE(reg_file.get(R::e_t4).u & Cp0::CAUSE_TI);
+        REQUIRE(reg_file.get(R::e_t5).u == 93);
+    }
+}
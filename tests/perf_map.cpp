@@ -0,0 +1,117 @@
+#include "mips-emulator/perf_map.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+using namespace mips_emulator;
+
+#if defined(__linux__)
+#    include <unistd.h>
+
+namespace {
+    template <typename T>
+    T get(const std::vector<uint8_t>& bytes, const std::size_t offset) {
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        return value;
+    }
+} // namespace
+
+TEST_CASE("perf map entries", "[PerfMap]") {
+    const uint8_t code[16] = {};
+
+    std::string map_path;
+    {
+        PerfMap perf_map;
+        perf_map.set_symbolizer([](uint32_t address) {
+            return address == 0x400000 ? std::string("main") : std::string();
+        });
+
+        perf_map.register_code(code, sizeof(code), 0x400000, 0x400010);
+        perf_map.register_code(code, sizeof(code), 0x400010, 0x400020,
+                               "helper");
+        map_path = perf_map.get_map_path();
+    }
+
+    std::ifstream file(map_path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::remove(map_path.c_str());
+
+    REQUIRE(contents.str().find(" 10 mips:0x00400000-0x00400010 main\n") !=
+            std::string::npos);
+    REQUIRE(contents.str().find(" 10 mips:0x00400010-0x00400020 helper\n") !=
+            std::string::npos);
+}
+
+TEST_CASE("jitdump records", "[PerfMap]") {
+    const uint8_t code[4] = {0xc3, 0, 0, 0};
+
+    PerfMap::Options options;
+    options.jitdump = true;
+
+    std::string map_path;
+    std::string dump_path;
+    {
+        PerfMap perf_map(options);
+        perf_map.register_code(code, sizeof(code), 0, 4, "main");
+        map_path = perf_map.get_map_path();
+        dump_path = perf_map.get_jitdump_path();
+    }
+
+    std::ifstream file(dump_path, std::ios::binary);
+    const std::vector<uint8_t> bytes(std::istreambuf_iterator<char>(file),
+                                     {});
+
+    std::remove(map_path.c_str());
+    std::remove(dump_path.c_str());
+
+    // File header
+    REQUIRE(bytes.size() >= 40);
+    REQUIRE(get<uint32_t>(bytes, 0) == 0x4A695444);
+    REQUIRE(get<uint32_t>(bytes, 4) == 1);
+    const uint32_t header_size = get<uint32_t>(bytes, 8);
+    REQUIRE(header_size == 40);
+    REQUIRE(get<uint32_t>(bytes, 20) == static_cast<uint32_t>(getpid()));
+
+    // Records are an id, a total size and a timestamp followed by the body
+    std::size_t loads = 0;
+    std::size_t offset = header_size;
+    while (offset + 16 <= bytes.size()) {
+        const uint32_t id = get<uint32_t>(bytes, offset);
+        const uint32_t size = get<uint32_t>(bytes, offset + 4);
+        REQUIRE(size >= 16);
+        REQUIRE(offset + size <= bytes.size());
+
+        if (id == 0) { // JIT_CODE_LOAD
+            const std::size_t body = offset + 16;
+            REQUIRE(get<uint64_t>(bytes, body + 8) ==
+                    reinterpret_cast<uint64_t>(code));
+            REQUIRE(get<uint64_t>(bytes, body + 16) ==
+                    reinterpret_cast<uint64_t>(code));
+            REQUIRE(get<uint64_t>(bytes, body + 24) == sizeof(code));
+
+            const char* name =
+                reinterpret_cast<const char*>(bytes.data() + body + 40);
+            const std::string expected = "mips:0x00000000-0x00000004 main";
+            REQUIRE(std::string(name) == expected);
+
+            const std::size_t copy = body + 40 + expected.size() + 1;
+            REQUIRE(copy + sizeof(code) == offset + size);
+            REQUIRE(std::memcmp(bytes.data() + copy, code, sizeof(code)) ==
+                    0);
+            ++loads;
+        }
+        offset += size;
+    }
+
+    REQUIRE(offset == bytes.size());
+    REQUIRE(loads == 1);
+}
+#endif
@@ -0,0 +1,327 @@
+#include "mips-emulator/block_profile.hpp"
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/executor.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/mmu.hpp"
+#include "mips-emulator/recompiled.hpp"
+#include "mips-emulator/recompiler.hpp"
+#include "mips-emulator/register_file.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+#include "mips-emulator/shadow_memory.hpp"
+
+// Generated from data/recompiler.elf at build time
+#include "recompiled_fixture.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace mips_emulator;
+
+namespace {
+    const std::string FIXTURE =
+        std::string(MIPS_EMULATOR_TEST_DATA_DIR) + "/recompiler.elf";
+
+    constexpr uint32_t MEMORY_BASE = 0x00400000;
+    constexpr uint32_t MEMORY_SIZE = 0x2000;
+
+    void load_fixture(const ElfFile& elf, RegisterFile& reg_file,
+                      RuntimeStaticMemory<>& memory) {
+        REQUIRE(elf.load_into(memory));
+        reg_file.set_pc(elf.get_entry());
+    }
+
+    std::vector<uint8_t> read_fixture() {
+        std::ifstream file(FIXTURE, std::ios::binary);
+        REQUIRE(file);
+        return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)),
+                                    std::istreambuf_iterator<char>());
+    }
+
+    uint32_t get32(const std::vector<uint8_t>& bytes, const uint32_t at) {
+        uint32_t value;
+        std::memcpy(&value, bytes.data() + at, 4);
+        return value;
+    }
+
+    void put16(std::vector<uint8_t>& bytes, const uint32_t at,
+               const uint16_t value) {
+        std::memcpy(bytes.data() + at, &value, 2);
+    }
+
+    constexpr uint32_t PROFILED_BASE = 0x1000;
+
+    // A branch over a cold block into a hot one that returns
+    std::vector<Instruction> profiled_program() {
+        using Func = Instruction::Func;
+        using IOp = Instruction::ITypeOpcode;
+        using Reg = RegisterName;
+
+        return {
+            Instruction(IOp::e_beq, Reg::e_0, Reg::e_0, 3),
+            Instruction(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0),
+            // Cold block
+            Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_t0, 1),
+            Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_t0, 1),
+            // Hot block
+            Instruction(IOp::e_addiu, Reg::e_t1, Reg::e_t1, 1),
+            Instruction(Func::e_jr, Reg::e_0, Reg::e_ra, Reg::e_0),
+            Instruction(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0),
+        };
+    }
+
+    Result<uint32_t, void> read_program(const std::vector<Instruction>& program,
+                                        const uint32_t address) {
+        const uint32_t index = (address - PROFILED_BASE) / 4;
+        if (address < PROFILED_BASE || index >= program.size())
+            return Result<uint32_t, void>();
+        return Result<uint32_t, void>(program[index].raw);
+    }
+} // namespace
+
+TEST_CASE("elf loading", "[Recompiler]") {
+    ElfFile elf;
+    REQUIRE_FALSE(elf.load_file(FIXTURE).is_error());
+
+    REQUIRE(elf.get_entry() == 0x00400000);
+    REQUIRE(elf.get_segments().size() == 2);
+    REQUIRE(elf.get_segments()[0].is_executable());
+    REQUIRE_FALSE(elf.get_segments()[1].is_executable());
+
+    const auto* sum = elf.find_symbol("sum");
+    REQUIRE(sum != nullptr);
+    REQUIRE(sum->is_function);
+    REQUIRE(elf.find_function(sum->address + 4) == sum);
+
+    REQUIRE_FALSE(elf.read_code(elf.get_entry()).is_error());
+    REQUIRE(elf.read_code(0x00401000).is_error());
+}
+
+TEST_CASE("malformed elf headers are rejected", "[Recompiler]") {
+    const std::vector<uint8_t> fixture = read_fixture();
+
+    const auto parse = [](const std::vector<uint8_t>& bytes) {
+        ElfFile elf;
+        return elf.parse(bytes.data(), bytes.size());
+    };
+    REQUIRE_FALSE(parse(fixture).is_error());
+
+    SECTION("zero sized program headers") {
+        std::vector<uint8_t> bytes = fixture;
+        put16(bytes, 42, 0);
+        REQUIRE(parse(bytes).get_error() == ElfError::truncated);
+    }
+
+    SECTION("zero sized section headers") {
+        std::vector<uint8_t> bytes = fixture;
+        put16(bytes, 46, 0);
+        REQUIRE(parse(bytes).get_error() == ElfError::truncated);
+    }
+
+    SECTION("symbol name running past the string table") {
+        // Drop the NUL that ends the last name in the string table
+        std::vector<uint8_t> bytes = fixture;
+        const uint32_t shoff = get32(bytes, 32);
+        const uint16_t shnum = bytes[48] | bytes[49] << 8;
+        bool found = false;
+        for (uint32_t i = 0; i < shnum; ++i) {
+            const uint32_t shdr = shoff + i * 40;
+            if (get32(bytes, shdr + 4) != 2) continue; // SHT_SYMTAB
+
+            const uint32_t strtab = shoff + get32(bytes, shdr + 24) * 40;
+            const uint32_t size = get32(bytes, strtab + 20);
+            REQUIRE(bytes[get32(bytes, strtab + 16) + size - 1] == 0);
+            const uint32_t shorter = size - 1;
+            std::memcpy(bytes.data() + strtab + 20, &shorter, 4);
+            found = true;
+        }
+        REQUIRE(found);
+        REQUIRE(parse(bytes).get_error() == ElfError::truncated);
+    }
+
+    SECTION("random header bytes") {
+        // Must not read outside the buffer, run under a sanitizer to check
+        uint32_t x = 0x2545F491;
+        for (uint32_t round = 0; round < 2000; ++round) {
+            std::vector<uint8_t> bytes = fixture;
+            for (uint32_t i = 0; i < 4; ++i) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                bytes[24 + x % 28] = static_cast<uint8_t>(x >> 8);
+            }
+            (void)parse(bytes);
+        }
+    }
+}
+
+TEST_CASE("function discovery", "[Recompiler]") {
+    ElfFile elf;
+    REQUIRE_FALSE(elf.load_file(FIXTURE).is_error());
+
+    Recompiler recompiler(elf);
+    recompiler.analyze();
+
+    const auto& functions = recompiler.get_functions();
+    for (const char* name :
+         {"__start", "fill", "sum", "double_it", "negate", "square"}) {
+        const auto* symbol = elf.find_symbol(name);
+        REQUIRE(symbol != nullptr);
+        REQUIRE(functions.count(symbol->address) == 1);
+    }
+
+    // The loop in fill is part of the function
+    const auto* fill = elf.find_symbol("fill");
+    REQUIRE(functions.at(fill->address).instructions.size() == 10);
+
+    const auto* square = elf.find_symbol("square");
+    REQUIRE(functions.at(square->address).instructions.size() == 2);
+}
+
+TEST_CASE("recompiled code matches the interpreter", "[Recompiler]") {
+    ElfFile elf;
+    REQUIRE_FALSE(elf.load_file(FIXTURE).is_error());
+
+    RegisterFile interpreted;
+    RuntimeStaticMemory<> interpreted_memory(MEMORY_SIZE, MEMORY_BASE);
+    load_fixture(elf, interpreted, interpreted_memory);
+
+    uint32_t steps = 0;
+    while (Executor::step(interpreted, interpreted_memory))
+        ++steps;
+    REQUIRE(steps > 100);
+
+    RegisterFile recompiled;
+    RuntimeStaticMemory<> recompiled_memory(MEMORY_SIZE, MEMORY_BASE);
+    load_fixture(elf, recompiled, recompiled_memory);
+
+    REQUIRE_FALSE(run_recompiled<RecompiledFixture>(recompiled,
+                                                    recompiled_memory));
+
+    // Program results
+    REQUIRE(recompiled.get(RegisterName::e_s2).s == 14);
+    REQUIRE(recompiled.get(RegisterName::e_s3).s == 7);
+    REQUIRE(recompiled.get(RegisterName::e_s4).s == 25);
+
+    // Both end on the final trap in the same state
+    REQUIRE(recompiled.get_pc() == interpreted.get_pc());
+    REQUIRE(recompiled.get_cause_register() ==
+            interpreted.get_cause_register());
+    for (uint8_t i = 0; i < RegisterFile::REGISTER_COUNT; ++i)
+        REQUIRE(recompiled.get(i).u == interpreted.get(i).u);
+
+    for (uint32_t i = 0; i < MEMORY_SIZE; ++i)
+        REQUIRE(recompiled_memory.get_memory()[i] ==
+                interpreted_memory.get_memory()[i]);
+}
+
+TEST_CASE("inline loads and stores match the memory", "[Recompiler]") {
+    RuntimeStaticMemory<> memory(0x100, 0x1000);
+
+    // The last word is direct, past it the slow path reports the fault
+    REQUIRE(recompiled_store<uint32_t>(memory, 0x10FC, 0xDEADBEEF));
+    REQUIRE_FALSE(recompiled_store<uint32_t>(memory, 0x10FE, 0));
+    REQUIRE_FALSE(recompiled_store<uint8_t>(memory, 0x0FFF, 0));
+
+    uint32_t word = 0;
+    REQUIRE(recompiled_load(memory, 0x10FC, word));
+    REQUIRE(word == 0xDEADBEEF);
+
+    // Unaligned accesses take the slow path, which allows them here
+    uint16_t half = 0;
+    REQUIRE(recompiled_load(memory, 0x10FD, half));
+    REQUIRE(half == 0xADBE);
+
+    // A TLB miss faults like read does
+    Mmu<RuntimeStaticMemory<>> mmu(0x10000);
+    REQUIRE(recompiled_store<uint32_t>(mmu, 0x80000010, 7));
+    REQUIRE(recompiled_load(mmu, 0xA0000010, word));
+    REQUIRE(word == 7);
+    REQUIRE_FALSE(recompiled_load(mmu, 0x00400010, word));
+    REQUIRE(mmu.get_cp0().read_register(uint8_t(Cp0Register::e_bad_vaddr),
+                                        0) == 0x00400010);
+
+    REQUIRE(has_host_pointer<Mmu<RuntimeStaticMemory<>>>::value);
+    REQUIRE_FALSE(
+        has_host_pointer<ShadowMemory<RuntimeStaticMemory<>>>::value);
+}
+
+TEST_CASE("profile picks the pinned registers", "[Recompiler]") {
+    const std::vector<Instruction> program = profiled_program();
+    Recompiler recompiler([&program](const uint32_t address) {
+        return read_program(program, address);
+    });
+    recompiler.add_function(PROFILED_BASE);
+    recompiler.analyze();
+    recompiler.set_pinned_registers(1);
+
+    // Without a profile every use counts the same
+    std::string code = recompiler.generate("Program");
+    REQUIRE(code.find("uint32_t r8 = reg_file.get(8).u;") != std::string::npos);
+    REQUIRE(code.find("uint32_t r9 =") == std::string::npos);
+
+    recompiler.set_block_profile({{0x1000, 1}, {0x1010, 100}});
+    code = recompiler.generate("Program");
+    REQUIRE(code.find("uint32_t r8 =") == std::string::npos);
+    REQUIRE(code.find("uint32_t r9 = reg_file.get(9).u;") != std::string::npos);
+    REQUIRE(code.find("r9 = r9 + 0x00000001u;") != std::string::npos);
+
+    recompiler.set_pinned_registers(0);
+    REQUIRE(recompiler.generate("Program").find("uint32_t r") ==
+            std::string::npos);
+}
+
+TEST_CASE("block profile round trip", "[Recompiler]") {
+    const std::vector<Instruction> program = profiled_program();
+
+    Emulator<RuntimeStaticMemory<>> emulator(0x100, PROFILED_BASE);
+    for (uint32_t i = 0; i < program.size(); ++i) {
+        REQUIRE_FALSE(emulator.get_memory()
+                          .store<uint32_t>(PROFILED_BASE + i * 4,
+                                           program[i].raw)
+                          .is_error());
+    }
+    emulator.set_pc(PROFILED_BASE);
+
+    // Returns to address 0, outside the memory
+    BlockProfile profile;
+    emulator.set_block_profile(&profile);
+    REQUIRE(emulator.run(100).reason == StopReason::e_fault);
+    emulator.set_block_profile(nullptr);
+
+    const std::map<uint32_t, uint64_t> counts = profile.get_counts();
+    REQUIRE(counts.size() == 5);
+    REQUIRE(counts.count(0x1008) == 0);
+    REQUIRE(counts.at(0x1010) == 1);
+
+    std::stringstream file;
+    REQUIRE(profile.write(file));
+    REQUIRE(file.str().find("1010 1\n") != std::string::npos);
+
+    BlockProfile read;
+    REQUIRE(read.read(file));
+    REQUIRE(read.get_counts() == counts);
+
+    std::stringstream garbage("1000 1\nnot a profile\n");
+    REQUIRE_FALSE(BlockProfile().read(garbage));
+
+    // The cold block never ran, the hot block's register is pinned
+    Recompiler recompiler([&program](const uint32_t address) {
+        return read_program(program, address);
+    });
+    recompiler.add_function(PROFILED_BASE);
+    recompiler.analyze();
+    recompiler.set_pinned_registers(1);
+    recompiler.set_block_profile(read.get_counts());
+
+    const std::string code = recompiler.generate("Program");
+    REQUIRE(code.find("uint32_t r8 =") == std::string::npos);
+    REQUIRE(code.find("uint32_t r9 = reg_file.get(9).u;") != std::string::npos);
+}
@@ -0,0 +1,61 @@
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/static_memory.hpp"
+
+#include <catch2/catch.hpp>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    constexpr uint32_t PROGRAM[] = {
+        0x24080005, // addiu $t0, $zero, 5
+        0x25090007, // addiu $t1, $t0, 7
+        0xAC090040, // sw $t1, 0x40($zero)
+        0x00000034, // teq $zero, $zero
+    };
+
+    constexpr MemoryImage<128> IMAGE = make_image<128>(PROGRAM);
+    static_assert(IMAGE.bytes[0] == 0x05 && IMAGE.bytes[3] == 0x24,
+                  "Words are stored little endian");
+
+    constexpr uint8_t DATA[] = {1, 2, 3, 4, 5};
+} // namespace
+
+TEST_CASE("image encodes the program", "[StaticMemory]") {
+    const Instruction program[] = {
+        Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_0, 5),
+        Instruction(IOp::e_addiu, Reg::e_t1, Reg::e_t0, 7),
+        Instruction(IOp::e_sw, Reg::e_t1, Reg::e_0, 0x40),
+        Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+    };
+
+    StaticMemory<128> memory(IMAGE);
+    for (uint32_t i = 0; i < 4; ++i)
+        REQUIRE(memory.read<uint32_t>(i * 4).get_value() == program[i].raw);
+}
+
+TEST_CASE("emulators start from an image", "[StaticMemory]") {
+    for (int i = 0; i < 2; ++i) {
+        Emulator<StaticMemory<256>> emulator(IMAGE);
+        REQUIRE(emulator.run(100).reason == StopReason::e_fault);
+        REQUIRE(emulator.get_register_file().get(Reg::e_t1).u == 12);
+        REQUIRE(emulator.get_memory().read<uint32_t>(0x40).get_value() == 12);
+
+        // Past the image the memory is zeroed
+        REQUIRE(emulator.get_memory().read<uint32_t>(0xFC).get_value() == 0);
+    }
+}
+
+TEST_CASE("image from bytes at an offset", "[StaticMemory]") {
+    constexpr auto image = make_image<8>(DATA);
+    StaticMemory<8> memory(image, 0x1000);
+
+    REQUIRE(memory.read<uint32_t>(0x1000).get_value() == 0x04030201);
+    REQUIRE(memory.read<uint32_t>(0x1004).get_value() == 0x00000005);
+    REQUIRE(memory.read<uint8_t>(0x1008).is_error());
+}
@@ -0,0 +1,121 @@
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/executor.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+#include "mips-emulator/shadow_memory.hpp"
+#include "mips-emulator/taint.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    constexpr uint32_t MEMORY_SIZE = 0x1000;
+    constexpr uint32_t INPUT = 0x100;
+    constexpr uint32_t OUTPUT = 0x200;
+
+    using TaintedMemory = ShadowMemory<RuntimeStaticMemory<>>;
+
+    void load_program(Emulator<TaintedMemory>& emulator,
+                      const std::vector<Instruction>& program) {
+        auto& memory = emulator.get_memory();
+        for (uint32_t i = 0; i < program.size(); ++i) {
+            REQUIRE_FALSE(
+                memory.store<uint32_t>(i * 4, program[i].raw).is_error());
+        }
+    }
+} // namespace
+
+TEST_CASE("taint propagates through loads, stores and alu ops", "[Taint]") {
+    Emulator<TaintedMemory> emulator(0, MEMORY_SIZE, MEMORY_SIZE);
+    load_program(
+        emulator,
+        {
+            Instruction(IOp::e_lbu, Reg::e_t0, Reg::e_0, INPUT),
+            Instruction(IOp::e_lw, Reg::e_t1, Reg::e_0, INPUT + 4),
+            Instruction(Func::e_addu, Reg::e_t2, Reg::e_t0, Reg::e_t1),
+            Instruction(IOp::e_sb, Reg::e_t0, Reg::e_0, OUTPUT),
+            Instruction(IOp::e_andi, Reg::e_t3, Reg::e_t2, 0xFF00),
+            Instruction(Func::e_sll, Reg::e_t4, Reg::e_0, Reg::e_t0, 8),
+            Instruction(IOp::e_lw, Reg::e_t5, Reg::e_0, INPUT),
+            Instruction(Func::e_or, Reg::e_t6, Reg::e_t5, Reg::e_t1),
+            Instruction(IOp::e_lb, Reg::e_t7, Reg::e_0, INPUT + 2),
+            // Overwritten with a constant
+            Instruction(IOp::e_lbu, Reg::e_s0, Reg::e_0, INPUT),
+            Instruction(IOp::e_addiu, Reg::e_s0, Reg::e_0, 5),
+            Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+        });
+
+    Shadow& shadow = emulator.get_memory().get_shadow();
+    shadow.taint(INPUT, 1, 0x01);
+    shadow.taint(INPUT + 2, 1, 0x02);
+
+    REQUIRE(emulator.run(100).reason == StopReason::e_fault);
+
+    const ShadowRegisterFile& regs = shadow.get_registers();
+    REQUIRE(regs.get(Reg::e_t0) == 0x01);
+    REQUIRE(regs.get(Reg::e_t1) == 0);
+    REQUIRE(regs.get(Reg::e_t2) == 0x01010101); // Carries
+    REQUIRE(shadow.get_label(OUTPUT) == 0x01);
+    REQUIRE(shadow.get_label(OUTPUT + 1) == 0);
+    REQUIRE(regs.get(Reg::e_t3) == 0x0101);
+    REQUIRE(regs.get(Reg::e_t4) == 0x0100);
+    REQUIRE(regs.get(Reg::e_t5) == 0x00020001);
+    REQUIRE(regs.get(Reg::e_t6) == 0x00020001);
+    REQUIRE(regs.get(Reg::e_t7) == 0x02020202); // Sign extension
+    REQUIRE(regs.get(Reg::e_s0) == 0);
+}
+
+TEST_CASE("failed instructions don't propagate", "[Taint]") {
+    Emulator<TaintedMemory> emulator(0, MEMORY_SIZE, MEMORY_SIZE);
+    load_program(emulator,
+                 {
+                     Instruction(IOp::e_sw, Reg::e_t0, Reg::e_0, 0x7FF0),
+                 });
+
+    Shadow& shadow = emulator.get_memory().get_shadow();
+    shadow.get_registers().set(Reg::e_t0, 0x01010101);
+    shadow.get_registers().set(Reg::e_0, 0x01010101);
+    REQUIRE(shadow.get_registers().get(Reg::e_0) == 0);
+
+    REQUIRE_FALSE(emulator.step());
+    REQUIRE(shadow.get_label(0x7FF0) == 0);
+    REQUIRE(shadow.get_registers().get(Reg::e_t0) == 0x01010101);
+}
+
+TEST_CASE("shadow range", "[Taint]") {
+    Shadow shadow(0x1000, 0x100);
+
+    // Outside the range nothing is tainted
+    shadow.taint(0x0FFE, 4, 0x04);
+    REQUIRE(shadow.load(0x0FFE, 4) == 0x04040000);
+    REQUIRE(shadow.load(0x10FE, 4) == 0);
+    shadow.store(0x10FE, 4, 0x08080808);
+    REQUIRE(shadow.load(0x10FC, 4) == 0x08080000);
+
+    shadow.untaint(0x1000, 2);
+    REQUIRE(shadow.load(0x1000, 2) == 0);
+}
+
+TEST_CASE("propagation rules", "[Taint]") {
+    REQUIRE(Taint::spread(0x00000100) == 0x01010101);
+    REQUIRE(Taint::carry(0x00000100) == 0x01010100);
+    REQUIRE(Taint::merge_low(0x02000100) == 0x03);
+
+    // Bit shifts touch neighbouring bytes, byte shifts don't
+    REQUIRE(Taint::shift_left(0x00000001, 8) == 0x00000100);
+    REQUIRE(Taint::shift_left(0x00000001, 12) == 0x00010100);
+    REQUIRE(Taint::shift_right(0x01000000, 4, false) == 0x01010000);
+    REQUIRE(Taint::shift_right(0x01000000, 9, true) == 0x01010100);
+    REQUIRE(Taint::shift_right(0x01000000, 0, true) == 0x01000000);
+
+    REQUIRE_FALSE(Executor::has_shadow<RuntimeStaticMemory<>>::value);
+    REQUIRE(Executor::has_shadow<TaintedMemory>::value);
+}
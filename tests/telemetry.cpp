@@ -0,0 +1,174 @@
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/metrics.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/static_memory.hpp"
+#include "mips-emulator/telemetry.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+#if defined(__linux__)
+TEST_CASE("emulator publishes telemetry", "[Telemetry]") {
+    TelemetrySegment segment;
+    REQUIRE(segment.create("", 2));
+    REQUIRE(segment.get_slot_count() == 2);
+    REQUIRE(segment.read(0).state == RunState::e_idle);
+
+    // Counts to 100 in $t0 and traps
+    Emulator<StaticMemory<256>> emulator;
+    const Instruction program[] = {
+        Instruction(IOp::e_addiu, Reg::e_t1, Reg::e_0, 100),
+        Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_t0, 1),
+        Instruction(IOp::e_bne, Reg::e_t1, Reg::e_t0, 0xFFFE),
+        Instruction(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0),
+        Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+    };
+    for (uint32_t i = 0; i < 5; ++i) {
+        REQUIRE_FALSE(emulator.get_memory()
+                          .template store<uint32_t>(i * 4, program[i].raw)
+                          .is_error());
+    }
+
+    MetricCounters metrics;
+    TelemetryWriter writer(segment.get_slot(1), 16);
+    emulator.set_metrics(&metrics);
+    emulator.set_telemetry(&writer);
+
+    SECTION("running") {
+        REQUIRE(emulator.run(40).reason == StopReason::e_budget_exhausted);
+
+        const auto snapshot = segment.read(1);
+        REQUIRE(snapshot.state == RunState::e_stopped);
+        REQUIRE(snapshot.stop_reason == StopReason::e_budget_exhausted);
+        REQUIRE(snapshot.retired == 40);
+        REQUIRE(snapshot.pc == emulator.get_register_file().get_pc());
+
+        // The retired count carries over between runs
+        REQUIRE(emulator.run(10).steps == 10);
+        REQUIRE(segment.read(1).retired == 50);
+    }
+
+    SECTION("stopped") {
+        const auto result = emulator.run(10000);
+        REQUIRE(result.reason == StopReason::e_fault);
+        REQUIRE(result.steps == 301);
+
+        const auto snapshot = segment.read(1);
+        REQUIRE(snapshot.state == RunState::e_stopped);
+        REQUIRE(snapshot.stop_reason == StopReason::e_fault);
+        REQUIRE(snapshot.retired == 301);
+        REQUIRE(snapshot.exceptions == 1);
+        REQUIRE(snapshot.pc == 5 * 4);
+    }
+
+    REQUIRE(segment.read(0).state == RunState::e_idle);
+}
+
+TEST_CASE("readers never see torn snapshots", "[Telemetry]") {
+    TelemetrySegment segment;
+    REQUIRE(segment.create("", 1));
+
+    constexpr uint64_t WRITES = 200000;
+    std::atomic<bool> done{false};
+
+    std::thread writer([&]() {
+        TelemetrySnapshot snapshot;
+        snapshot.state = RunState::e_running;
+        for (uint64_t i = 1; i <= WRITES; ++i) {
+            snapshot.pc = static_cast<uint32_t>(i);
+            snapshot.retired = i;
+            snapshot.memory_faults = i;
+            snapshot.exceptions = i;
+            snapshot.decode_hits = i;
+            snapshot.decode_misses = i;
+            segment.get_slot(0).write(snapshot);
+        }
+        done = true;
+    });
+
+    uint64_t last = 0;
+    bool consistent = true;
+    while (!done) {
+        const auto snapshot = segment.read(0);
+        consistent &= snapshot.pc == uint32_t(snapshot.retired) &&
+                      snapshot.memory_faults == snapshot.retired &&
+                      snapshot.exceptions == snapshot.retired &&
+                      snapshot.decode_hits == snapshot.retired &&
+                      snapshot.decode_misses == snapshot.retired &&
+                      snapshot.retired >= last;
+        last = snapshot.retired;
+    }
+    writer.join();
+
+    REQUIRE(consistent);
+    REQUIRE(segment.read(0).retired == WRITES);
+}
+
+TEST_CASE("named segments are shared", "[Telemetry]") {
+    const std::string name =
+        "/mips_emulator_telemetry_" + std::to_string(getpid());
+
+    TelemetrySegment monitor;
+    REQUIRE_FALSE(monitor.open(name));
+
+    TelemetrySegment segment;
+    REQUIRE(segment.create(name, 4));
+
+    TelemetrySnapshot snapshot;
+    snapshot.state = RunState::e_stopped;
+    snapshot.stop_reason = StopReason::e_infinite_loop;
+    snapshot.pc = 0x400000;
+    snapshot.retired = 1234;
+    segment.get_slot(3).write(snapshot);
+
+    REQUIRE(monitor.open(name));
+    REQUIRE(monitor.get_slot_count() == 4);
+    const auto read = monitor.read(3);
+    REQUIRE(read.state == RunState::e_stopped);
+    REQUIRE(read.stop_reason == StopReason::e_infinite_loop);
+    REQUIRE(read.pc == 0x400000);
+    REQUIRE(read.retired == 1234);
+    REQUIRE(monitor.read(4).state == RunState::e_idle);
+
+    // The creator removes the segment
+    monitor.close();
+    segment.close();
+    REQUIRE_FALSE(monitor.open(name));
+}
+TEST_CASE("truncated segments are rejected", "[Telemetry]") {
+    const std::string name =
+        "/mips_emulator_truncated_" + std::to_string(getpid());
+
+    // A valid header that claims more slots than the segment holds
+    const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+    REQUIRE(fd >= 0);
+    const uint32_t header[] = {TelemetrySegment::MAGIC,
+                               TelemetrySegment::VERSION, 1000};
+    REQUIRE(pwrite(fd, header, sizeof(header), 0) == sizeof(header));
+    REQUIRE(ftruncate(fd, 4096) == 0);
+    close(fd);
+
+    TelemetrySegment monitor;
+    REQUIRE_FALSE(monitor.open(name));
+    REQUIRE(monitor.get_slot_count() == 0);
+    REQUIRE(monitor.read(0).state == RunState::e_idle);
+
+    shm_unlink(name.c_str());
+}
+#endif
@@ -0,0 +1,131 @@
+#include "mips-emulator/decode_cache.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/instruction.hpp"
+#include "mips-emulator/register_name.hpp"
+#include "mips-emulator/static_memory.hpp"
+#include "mips-emulator/worker_fleet.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <csignal>
+#include <vector>
+
+using namespace mips_emulator;
+
+using Func = Instruction::Func;
+using IOp = Instruction::ITypeOpcode;
+using Reg = RegisterName;
+
+namespace {
+    using Board = Emulator<StaticMemory<256>>;
+
+    struct Job {
+        uint32_t count;
+        bool crash;
+    };
+
+    struct JobResult {
+        RunResult run;
+        uint32_t counted;
+    };
+
+    // Counts to $a0 in $t0 and traps
+    Board make_prototype(DecodeCache<Isa::e_mips32r6>& cache) {
+        const Instruction program[] = {
+            Instruction(IOp::e_addiu, Reg::e_t0, Reg::e_t0, 1),
+            Instruction(IOp::e_bne, Reg::e_a0, Reg::e_t0, 0xFFFE),
+            Instruction(Func::e_sll, Reg::e_0, Reg::e_0, Reg::e_0),
+            Instruction(Func::e_teq, Reg::e_0, Reg::e_0, Reg::e_0),
+        };
+
+        Board board;
+        for (uint32_t i = 0; i < 4; ++i) {
+            REQUIRE_FALSE(board.get_memory()
+                              .template store<uint32_t>(i * 4, program[i].raw)
+                              .is_error());
+        }
+        cache.add_range(0, board.get_memory().get_memory(), 16);
+        board.set_decode_cache(&cache);
+        return board;
+    }
+} // namespace
+
+#if defined(__linux__)
+TEST_CASE("fleet runs jobs in workers", "[WorkerFleet]") {
+    DecodeCache<Isa::e_mips32r6> cache;
+    const Board prototype = make_prototype(cache);
+
+    std::vector<Job> jobs;
+    for (uint32_t i = 1; i <= 40; ++i)
+        jobs.push_back({i * 10, i == 7 || i == 23});
+
+    // Every job starts from the inherited image and decode cache
+    const auto run_job = [&prototype](const Job& job) {
+        if (job.crash) std::raise(SIGKILL);
+
+        Board board = prototype;
+        RegisterFile regs;
+        regs.set_unsigned(Reg::e_a0, job.count);
+        board.set_register_file(regs);
+
+        JobResult result;
+        result.run = board.run(100000);
+        result.counted = board.get_register_file().get(Reg::e_t0).u;
+        return result;
+    };
+
+    WorkerFleet<Job, JobResult> fleet({4});
+    const auto outcomes = fleet.run(jobs, run_job);
+    REQUIRE(outcomes.size() == jobs.size());
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        if (jobs[i].crash) {
+            // A crash loses only its own job
+            REQUIRE(outcomes[i].status == JobStatus::e_crashed);
+            REQUIRE(outcomes[i].signal == SIGKILL);
+            continue;
+        }
+
+        REQUIRE(outcomes[i].status == JobStatus::e_done);
+        REQUIRE(outcomes[i].result.run.reason == StopReason::e_fault);
+        REQUIRE(outcomes[i].result.run.steps == 3 * jobs[i].count);
+        REQUIRE(outcomes[i].result.counted == jobs[i].count);
+    }
+    REQUIRE(fleet.get_crashes() == 2);
+}
+
+TEST_CASE("fleet leaves other children alone", "[WorkerFleet]") {
+    // A child of the host that exits while the fleet runs
+    const pid_t child = fork();
+    if (child == 0) _exit(42);
+    REQUIRE(child > 0);
+
+    WorkerFleet<uint32_t, uint32_t> fleet({2});
+    const auto outcomes = fleet.run({1, 2, 3, 4}, [](const uint32_t x) {
+        usleep(20000);
+        return x + 1;
+    });
+    for (std::size_t i = 0; i < outcomes.size(); ++i) {
+        REQUIRE(outcomes[i].status == JobStatus::e_done);
+        REQUIRE(outcomes[i].result == i + 2);
+    }
+
+    int status = 0;
+    REQUIRE(waitpid(child, &status, 0) == child);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 42);
+}
+#endif
+
+TEST_CASE("fleet with more workers than jobs", "[WorkerFleet]") {
+    WorkerFleet<uint32_t, uint32_t> fleet({8});
+    REQUIRE(fleet.run({}, [](uint32_t x) { return x; }).empty());
+
+    const auto outcomes =
+        fleet.run({3, 4}, [](const uint32_t x) { return x * x; });
+    REQUIRE(outcomes.size() == 2);
+    REQUIRE(outcomes[0].status == JobStatus::e_done);
+    REQUIRE(outcomes[0].result == 9);
+    REQUIRE(outcomes[1].result == 16);
+    REQUIRE(fleet.get_crashes() == 0);
+}
@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+"""Minimal static linker for little-endian MIPS32 objects.
+
+Used to build the checked-in guest binaries from the assembly sources next to
+them, since a MIPS cross toolchain usually isn't available:
+
+    llvm-mc -triple=mipsel-unknown-linux-gnu -mcpu=mips32r6 \\
+        -filetype=obj program.s -o program.o
+    tools/link_mips.py program.o -o program.elf
+
+.text (and .rodata) are placed at 0x00400000, .data and .bss start on the
+next page. Only the relocations emitted by llvm-mc for hand-written code are
+supported.
+"""
+
+import argparse
+import struct
+import sys
+
+TEXT_BASE = 0x00400000
+PAGE = 0x1000
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHT_REL = 9
+SHF_WRITE = 1
+SHF_ALLOC = 2
+SHF_EXECINSTR = 4
+
+R_MIPS_32 = 2
+R_MIPS_26 = 4
+R_MIPS_HI16 = 5
+R_MIPS_LO16 = 6
+R_MIPS_PC16 = 10
+R_MIPS_PC21_S2 = 60
+R_MIPS_PC26_S2 = 61
+R_MIPS_PC19_S2 = 63
+R_MIPS_PCHI16 = 64
+R_MIPS_PCLO16 = 65
+
+
+def align(value, alignment):
+    return (value + alignment - 1) & ~(alignment - 1)
+
+
+def sext(value, bits):
+    sign = 1 << (bits - 1)
+    return (value ^ sign) - sign
+
+
+class Object:
+    def __init__(self, path):
+        self.path = path
+        self.data = open(path, "rb").read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1 or self.data[5] != 1:
+            sys.exit(f"{path}: not a 32-bit little-endian ELF")
+
+        shoff, = struct.unpack_from("<I", self.data, 32)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 46)
+        self.sections = []
+        for i in range(shnum):
+            fields = struct.unpack_from("<IIIIIIIIII", self.data, shoff + i * shentsize)
+            self.sections.append(dict(zip(
+                ["name", "type", "flags", "addr", "offset", "size", "link", "info",
+                 "align", "entsize"], fields)))
+
+        names = self.sections[shstrndx]
+        for section in self.sections:
+            section["name"] = self.string(names, section["name"])
+
+        self.symbols = []
+        for section in self.sections:
+            if section["type"] != SHT_SYMTAB:
+                continue
+            strtab = self.sections[section["link"]]
+            for offset in range(section["offset"], section["offset"] + section["size"], 16):
+                name, value, size, info, _, shndx = struct.unpack_from("<IIIBBH", self.data, offset)
+                self.symbols.append({
+                    "name": self.string(strtab, name), "value": value, "size": size,
+                    "type": info & 0xf, "bind": info >> 4, "shndx": shndx,
+                })
+
+    def string(self, section, offset):
+        start = section["offset"] + offset
+        return self.data[start:self.data.index(b"\0", start)].decode()
+
+    def contents(self, section):
+        if section["type"] == SHT_NOBITS:
+            return bytearray(section["size"])
+        return bytearray(self.data[section["offset"]:section["offset"] + section["size"]])
+
+
+def kind(section):
+    if not section["flags"] & SHF_ALLOC or section["name"].startswith(".MIPS") \
+            or section["name"] in (".reginfo", ".pdr"):
+        return None
+    if section["flags"] & SHF_EXECINSTR:
+        return "text"
+    if section["type"] == SHT_NOBITS:
+        return "bss"
+    if section["flags"] & SHF_WRITE:
+        return "data"
+    return "rodata"
+
+
+def link(paths, entry_name):
+    objects = [Object(path) for path in paths]
+
+    # Lay out sections: text and rodata in the first segment, data and bss in
+    # the second one
+    placed = {}
+    chunks = {"text": [], "rodata": [], "data": [], "bss": []}
+    address = TEXT_BASE
+    for group in ("text", "rodata", None, "data", "bss"):
+        if group is None:
+            address = align(address, PAGE)
+            data_base = address
+            continue
+        for obj_index, obj in enumerate(objects):
+            for index, section in enumerate(obj.sections):
+                if kind(section) != group:
+                    continue
+                address = align(address, max(section["align"], 1))
+                placed[(obj_index, index)] = address
+                chunks[group].append((address, obj_index, index))
+                address += section["size"]
+        if group == "rodata":
+            text_end = address
+    end = address
+
+    # Resolve symbols
+    globals_ = {}
+    for obj_index, obj in enumerate(objects):
+        for symbol in obj.symbols:
+            if symbol["bind"] != 0 and 0 < symbol["shndx"] < 0xff00:
+                globals_[symbol["name"]] = placed.get((obj_index, symbol["shndx"]), 0) + symbol["value"]
+
+    def symbol_address(obj_index, symbol):
+        if symbol["shndx"] == 0:
+            if symbol["name"] not in globals_:
+                sys.exit(f"undefined symbol: {symbol['name']}")
+            return globals_[symbol["name"]]
+        return placed.get((obj_index, symbol["shndx"]), 0) + symbol["value"]
+
+    image = {}
+    for group in ("text", "rodata", "data"):
+        for address, obj_index, index in chunks[group]:
+            image[(obj_index, index)] = objects[obj_index].contents(objects[obj_index].sections[index])
+
+    # Apply relocations
+    for obj_index, obj in enumerate(objects):
+        for section in obj.sections:
+            if section["type"] != SHT_REL or (obj_index, section["info"]) not in image:
+                continue
+            target = image[(obj_index, section["info"])]
+            base = placed[(obj_index, section["info"])]
+            relocs = [struct.unpack_from("<II", obj.data, section["offset"] + i)
+                      for i in range(0, section["size"], 8)]
+            for i, (offset, info) in enumerate(relocs):
+                symbol = obj.symbols[info >> 8]
+                rtype = info & 0xff
+                s = symbol_address(obj_index, symbol)
+                p = base + offset
+                word, = struct.unpack_from("<I", target, offset)
+
+                if rtype == R_MIPS_32:
+                    word = (word + s) & 0xffffffff
+                elif rtype == R_MIPS_26:
+                    addend = (word & 0x3ffffff) << 2
+                    word = (word & ~0x3ffffff) | (((s + addend) >> 2) & 0x3ffffff)
+                elif rtype in (R_MIPS_HI16, R_MIPS_PCHI16):
+                    # The addend is split between this and the next LO16
+                    lo_type = R_MIPS_LO16 if rtype == R_MIPS_HI16 else R_MIPS_PCLO16
+                    lo = next((r for r in relocs[i + 1:] if r[1] & 0xff == lo_type
+                               and r[1] >> 8 == info >> 8), None)
+                    lo_addend = 0
+                    if lo is not None:
+                        lo_word, = struct.unpack_from("<I", target, lo[0])
+                        lo_addend = sext(lo_word & 0xffff, 16)
+                    value = s + ((word & 0xffff) << 16) + lo_addend
+                    if rtype == R_MIPS_PCHI16:
+                        value -= p
+                    word = (word & ~0xffff) | (((value + 0x8000) >> 16) & 0xffff)
+                elif rtype in (R_MIPS_LO16, R_MIPS_PCLO16):
+                    value = s + sext(word & 0xffff, 16)
+                    if rtype == R_MIPS_PCLO16:
+                        value -= p
+                    word = (word & ~0xffff) | (value & 0xffff)
+                elif rtype in (R_MIPS_PC16, R_MIPS_PC19_S2, R_MIPS_PC21_S2, R_MIPS_PC26_S2):
+                    bits = {R_MIPS_PC16: 16, R_MIPS_PC19_S2: 19,
+                            R_MIPS_PC21_S2: 21, R_MIPS_PC26_S2: 26}[rtype]
+                    mask = (1 << bits) - 1
+                    value = s + (sext(word & mask, bits) << 2) - p
+                    word = (word & ~mask) | ((value >> 2) & mask)
+                else:
+                    sys.exit(f"{obj.path}: unsupported relocation type {rtype}")
+                struct.pack_into("<I", target, offset, word & 0xffffffff)
+
+    def segment_bytes(groups, start, stop):
+        out = bytearray(stop - start)
+        for group in groups:
+            for address, obj_index, index in chunks[group]:
+                contents = image[(obj_index, index)]
+                out[address - start:address - start + len(contents)] = contents
+        return out
+
+    text = segment_bytes(("text", "rodata"), TEXT_BASE, text_end)
+    data_end = max((a + len(image[(o, i)]) for a, o, i in chunks["data"]), default=data_base)
+    data = segment_bytes(("data",), data_base, data_end)
+
+    if entry_name not in globals_:
+        sys.exit(f"entry symbol {entry_name} not found")
+
+    symbols = []
+    for obj_index, obj in enumerate(objects):
+        for symbol in obj.symbols:
+            if symbol["name"] and symbol["type"] in (0, 1, 2) and 0 < symbol["shndx"] < 0xff00 \
+                    and (obj_index, symbol["shndx"]) in placed:
+                symbols.append((symbol["name"], symbol_address(obj_index, symbol),
+                                symbol["size"], symbol["type"], symbol["bind"]))
+
+    return write_elf(globals_[entry_name], text, data, data_base, end, symbols)
+
+
+def write_elf(entry, text, data, data_base, end, symbols):
+    ehdr_size, phdr_size = 52, 32
+    text_offset = PAGE
+    data_offset = align(text_offset + len(text), PAGE)
+
+    strtab = bytearray(b"\0")
+    symtab = bytearray(16)
+    for name, value, size, stype, bind in sorted(symbols, key=lambda s: s[4]):
+        symtab += struct.pack("<IIIBBH", len(strtab), value, size, (bind << 4) | stype, 0, 1)
+        strtab += name.encode() + b"\0"
+    first_global = 1 + sum(1 for s in symbols if s[4] == 0)
+
+    shstrtab = b"\0.text\0.data\0.symtab\0.strtab\0.shstrtab\0"
+    symtab_offset = data_offset + len(data)
+    strtab_offset = symtab_offset + len(symtab)
+    shstrtab_offset = strtab_offset + len(strtab)
+    shoff = align(shstrtab_offset + len(shstrtab), 4)
+
+    out = bytearray(shoff + 6 * 40)
+    struct.pack_into("<4sBBBB8xHHIIIIIHHHHHH", out, 0, b"\x7fELF", 1, 1, 1, 0,
+                     2, 8, 1, entry, ehdr_size, shoff, 0x00000400,  # EF_MIPS_ARCH_32R6
+                     ehdr_size, phdr_size, 2, 40, 6, 5)
+    struct.pack_into("<IIIIIIII", out, ehdr_size, 1, text_offset, TEXT_BASE, TEXT_BASE,
+                     len(text), len(text), 5, PAGE)
+    struct.pack_into("<IIIIIIII", out, ehdr_size + phdr_size, 1, data_offset, data_base,
+                     data_base, len(data), end - data_base, 6, PAGE)
+    out[text_offset:text_offset + len(text)] = text
+    out[data_offset:data_offset + len(data)] = data
+    out[symtab_offset:symtab_offset + len(symtab)] = symtab
+    out[strtab_offset:strtab_offset + len(strtab)] = strtab
+    out[shstrtab_offset:shstrtab_offset + len(shstrtab)] = shstrtab
+
+    sections = [
+        (0, 0, 0, 0, 0, 0, 0, 0, 0, 0),
+        (1, 1, SHF_ALLOC | SHF_EXECINSTR, TEXT_BASE, text_offset, len(text), 0, 0, 16, 0),
+        (7, 1, SHF_ALLOC | SHF_WRITE, data_base, data_offset, len(data), 0, 0, 16, 0),
+        (13, SHT_SYMTAB, 0, 0, symtab_offset, len(symtab), 4, first_global, 4, 16),
+        (21, 3, 0, 0, strtab_offset, len(strtab), 0, 0, 1, 0),
+        (29, 3, 0, 0, shstrtab_offset, len(shstrtab), 0, 0, 1, 0),
+    ]
+    for i, section in enumerate(sections):
+        struct.pack_into("<IIIIIIIIII", out, shoff + i * 40, *section)
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("objects", nargs="+")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("-e", "--entry", default="__start")
+    args = parser.parse_args()
+
+    with open(args.output, "wb") as f:
+        f.write(link(args.objects, args.entry))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+#include "mips-emulator/block_profile.hpp"
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/recompiler.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace mips_emulator;
+
+// Usage: mips_emulator_recompile <input.elf> <output.hpp> <struct name>
+//                                [profile]
+//
+// The profile picks the registers kept in locals from how often each basic
+// block ran. mips_emulator_trace profile writes one, see BlockProfile for
+// the format.
+int main(int argc, char** argv) {
+    if (argc != 4 && argc != 5) {
+        std::fprintf(stderr,
+                     "usage: %s <input.elf> <output.hpp> <struct name> "
+                     "[profile]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    ElfFile elf;
+    if (elf.load_file(argv[1]).is_error()) {
+        std::fprintf(stderr, "%s: not a 32-bit little-endian MIPS ELF\n",
+                     argv[1]);
+        return 1;
+    }
+
+    Recompiler recompiler(elf);
+    recompiler.analyze();
+
+    if (argc == 5) {
+        std::ifstream profile(argv[4]);
+        if (!profile) {
+            std::fprintf(stderr, "%s: failed to open\n", argv[4]);
+            return 1;
+        }
+
+        BlockProfile counts;
+        if (!counts.read(profile)) {
+            std::fprintf(stderr, "%s: not a valid profile\n", argv[4]);
+            return 1;
+        }
+        recompiler.set_block_profile(counts.get_counts());
+    }
+
+    std::ofstream out(argv[2], std::ios::trunc);
+    out << recompiler.generate(argv[3]);
+    if (!out) {
+        std::fprintf(stderr, "%s: failed to write\n", argv[2]);
+        return 1;
+    }
+
+    std::printf("%s: %zu functions\n", argv[2],
+                recompiler.get_functions().size());
+    return 0;
+}
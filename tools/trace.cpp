@@ -0,0 +1,279 @@
+#include "mips-emulator/block_profile.hpp"
+#include "mips-emulator/cache_model.hpp"
+#include "mips-emulator/elf.hpp"
+#include "mips-emulator/emulator.hpp"
+#include "mips-emulator/memory_trace.hpp"
+#include "mips-emulator/runtime_static_memory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace mips_emulator;
+
+namespace {
+    constexpr uint32_t EXTRA_MEMORY = 1 << 20; // Above the segments
+    constexpr uint32_t MEMORY_ALIGNMENT = 0x10000;
+
+    int usage(const char* program) {
+        std::fprintf(stderr,
+                     "usage: %s record <program.elf> <trace> [budget]\n"
+                     "       %s replay <trace> [-j threads] "
+                     "[name=stream:size:ways:line ...]\n"
+                     "       %s profile <program.elf> <profile> [budget]\n",
+                     program, program, program);
+        return 2;
+    }
+
+    // 32K, 4M or plain bytes
+    bool parse_size(const std::string& text, uint32_t& size) {
+        char* end = nullptr;
+        const unsigned long value = std::strtoul(text.c_str(), &end, 10);
+        if (end == text.c_str()) return false;
+
+        unsigned long scale = 1;
+        if (*end == 'K' || *end == 'k') scale = 1024, ++end;
+        else if (*end == 'M' || *end == 'm') scale = 1024 * 1024, ++end;
+        if (*end != '\0' || value * scale > UINT32_MAX) return false;
+
+        size = static_cast<uint32_t>(value * scale);
+        return true;
+    }
+
+    // name=stream:size:ways:line, e.g. l1d=d:32K:8:64 or dtlb=d:256K:0:4K
+    bool parse_config(const std::string& spec, CacheModel::Config& config) {
+        const auto equals = spec.find('=');
+        if (equals == std::string::npos || equals == 0) return false;
+        config.name = spec.substr(0, equals);
+
+        std::vector<std::string> fields;
+        std::size_t start = equals + 1;
+        while (true) {
+            const auto colon = spec.find(':', start);
+            fields.push_back(spec.substr(start, colon - start));
+            if (colon == std::string::npos) break;
+            start = colon + 1;
+        }
+        if (fields.size() != 4) return false;
+
+        using Stream = CacheModel::Stream;
+        if (fields[0] == "i") config.stream = Stream::e_instruction;
+        else if (fields[0] == "d") config.stream = Stream::e_data;
+        else if (fields[0] == "u") config.stream = Stream::e_unified;
+        else return false;
+
+        return parse_size(fields[1], config.size) &&
+               parse_size(fields[2], config.ways) &&
+               parse_size(fields[3], config.line) &&
+               CacheModel::is_valid(config);
+    }
+
+    // L1 caches from 4 KiB to 64 KiB and TLBs from 16 to 128 entries
+    std::vector<CacheModel::Config> default_sweep() {
+        std::vector<CacheModel::Config> configs;
+        for (const auto stream :
+             {CacheModel::Stream::e_instruction, CacheModel::Stream::e_data}) {
+            const char* prefix =
+                stream == CacheModel::Stream::e_instruction ? "i" : "d";
+
+            for (uint32_t kib = 4; kib <= 64; kib *= 2) {
+                for (const uint32_t ways : {1, 2, 4, 8}) {
+                    for (const uint32_t line : {32, 64}) {
+                        configs.push_back(
+                            {std::string("l1") + prefix + "-" +
+                                 std::to_string(kib) + "K-" +
+                                 std::to_string(ways) + "w-" +
+                                 std::to_string(line) + "B",
+                             stream, kib * 1024, ways, line});
+                    }
+                }
+            }
+
+            for (uint32_t entries = 16; entries <= 128; entries *= 2) {
+                for (const uint32_t ways : {0, 4}) {
+                    configs.push_back(
+                        {std::string(prefix) + "tlb-" +
+                             std::to_string(entries) + "e-" +
+                             (ways ? std::to_string(ways) + "w" : "full"),
+                         stream, entries * 4096, ways, 4096});
+                }
+            }
+        }
+        return configs;
+    }
+
+    using ProgramEmulator = Emulator<RuntimeStaticMemory<>>;
+
+    // Memory covers the segments and EXTRA_MEMORY above them. Returns
+    // nullptr if the program can't be loaded.
+    std::unique_ptr<ProgramEmulator> load_program(const char* elf_path) {
+        ElfFile elf;
+        if (elf.load_file(elf_path).is_error() || elf.get_segments().empty()) {
+            std::fprintf(stderr, "%s: not a 32-bit little-endian MIPS ELF\n",
+                         elf_path);
+            return nullptr;
+        }
+
+        uint32_t base = UINT32_MAX;
+        uint64_t end = 0;
+        for (const auto& segment : elf.get_segments()) {
+            base = std::min(base, segment.address);
+            end = std::max<uint64_t>(end, uint64_t(segment.address) +
+                                              segment.memory_size);
+        }
+        base &= ~(MEMORY_ALIGNMENT - 1);
+        const uint64_t size = (end - base + EXTRA_MEMORY +
+                               MEMORY_ALIGNMENT - 1) &
+                              ~uint64_t(MEMORY_ALIGNMENT - 1);
+
+        auto emulator = std::make_unique<ProgramEmulator>(
+            static_cast<uint32_t>(size), base);
+        if (!elf.load_into(emulator->get_memory())) {
+            std::fprintf(stderr, "%s: failed to load\n", elf_path);
+            return nullptr;
+        }
+        emulator->set_pc(elf.get_entry());
+        return emulator;
+    }
+
+    const char* describe(const StopReason reason) {
+        if (reason == StopReason::e_fault) return "fault";
+        if (reason == StopReason::e_budget_exhausted) return "budget";
+        return "loop";
+    }
+
+    int record(const char* elf_path, const char* trace_path,
+               const uint64_t budget) {
+        const auto emulator = load_program(elf_path);
+        if (!emulator) return 1;
+
+        TraceWriter trace(trace_path);
+        if (!trace.is_open()) {
+            std::fprintf(stderr, "%s: failed to open\n", trace_path);
+            return 1;
+        }
+
+        emulator->set_memory_trace(&trace);
+        const RunResult result = emulator->run(budget);
+        emulator->set_memory_trace(nullptr);
+
+        if (!trace.close()) {
+            std::fprintf(stderr, "%s: failed to write\n", trace_path);
+            return 1;
+        }
+
+        std::printf("%s: %llu instructions, %llu accesses in %llu bytes, "
+                    "stopped at 0x%08x (%s)\n",
+                    trace_path, static_cast<unsigned long long>(result.steps),
+                    static_cast<unsigned long long>(trace.get_records()),
+                    static_cast<unsigned long long>(trace.get_bytes()),
+                    emulator->get_register_file().get_pc(),
+                    describe(result.reason));
+        return 0;
+    }
+
+    int profile(const char* elf_path, const char* profile_path,
+                const uint64_t budget) {
+        const auto emulator = load_program(elf_path);
+        if (!emulator) return 1;
+
+        BlockProfile counts;
+        emulator->set_block_profile(&counts);
+        const RunResult result = emulator->run(budget);
+        emulator->set_block_profile(nullptr);
+
+        std::ofstream out(profile_path, std::ios::trunc);
+        if (!counts.write(out)) {
+            std::fprintf(stderr, "%s: failed to write\n", profile_path);
+            return 1;
+        }
+
+        std::printf("%s: %llu instructions, stopped at 0x%08x (%s)\n",
+                    profile_path, static_cast<unsigned long long>(result.steps),
+                    emulator->get_register_file().get_pc(),
+                    describe(result.reason));
+        return 0;
+    }
+
+    int replay(const char* trace_path, const std::vector<std::string>& args) {
+        unsigned threads = 0;
+        std::vector<CacheModel::Config> configs;
+        for (std::size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "-j" && i + 1 < args.size()) {
+                threads = static_cast<unsigned>(std::atoi(args[++i].c_str()));
+                continue;
+            }
+
+            CacheModel::Config config;
+            if (!parse_config(args[i], config)) {
+                std::fprintf(stderr, "%s: not a valid cache\n",
+                             args[i].c_str());
+                return 2;
+            }
+            configs.push_back(config);
+        }
+        if (configs.empty()) configs = default_sweep();
+
+        std::vector<CacheModel> caches;
+        for (const auto& config : configs)
+            caches.emplace_back(config);
+
+        if (!replay_trace(trace_path, caches, threads)) {
+            std::fprintf(stderr, "%s: not a valid trace\n", trace_path);
+            return 1;
+        }
+
+        std::printf("%-20s %14s %14s %8s\n", "cache", "accesses", "misses",
+                    "miss %");
+        for (const CacheModel& cache : caches) {
+            const auto& stats = cache.get_stats();
+            std::printf("%-20s %14llu %14llu %8.3f\n",
+                        cache.get_config().name.c_str(),
+                        static_cast<unsigned long long>(stats.accesses),
+                        static_cast<unsigned long long>(stats.misses),
+                        stats.accesses ? 100.0 * stats.misses / stats.accesses
+                                       : 0.0);
+        }
+        return 0;
+    }
+} // namespace
+
+// Usage: mips_emulator_trace record <program.elf> <trace> [budget]
+//        mips_emulator_trace replay <trace> [-j threads] [caches]
+//        mips_emulator_trace profile <program.elf> <profile> [budget]
+//
+// record runs the program until it stops, or for budget instructions, and
+// writes its memory access trace. replay runs a trace through caches given
+// as name=stream:size:ways:line: stream is i (fetches), d (loads and
+// stores) or u (both), sizes take K and M suffixes and 0 ways is fully
+// associative. Without caches it sweeps a range of L1 caches and TLBs.
+// profile runs the program like record and writes how often each
+// instruction ran, the block profile of mips_emulator_recompile.
+int main(int argc, char** argv) {
+    if (argc < 3) return usage(argv[0]);
+
+    if (std::strcmp(argv[1], "record") == 0) {
+        if (argc != 4 && argc != 5) return usage(argv[0]);
+        const uint64_t budget =
+            argc == 5 ? std::strtoull(argv[4], nullptr, 10) : UINT64_MAX;
+        return record(argv[2], argv[3], budget);
+    }
+
+    if (std::strcmp(argv[1], "profile") == 0) {
+        if (argc != 4 && argc != 5) return usage(argv[0]);
+        const uint64_t budget =
+            argc == 5 ? std::strtoull(argv[4], nullptr, 10) : UINT64_MAX;
+        return profile(argv[2], argv[3], budget);
+    }
+
+    if (std::strcmp(argv[1], "replay") == 0)
+        return replay(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+
+    return usage(argv[0]);
+}